@@ -49,6 +49,7 @@ struct ac97_context
 	g_device_id deviceId = 0;
 	size_t streamBytes = 0;
 	size_t zeroDescriptors = 0;
+	uint8_t irq = 0;
 } g_ctx;
 
 size_t fillDescriptor(uint8_t index);
@@ -134,10 +135,10 @@ void configureMixer()
 
 bool initializeDma()
 {
+	// The bus master only takes 32-bit physical addresses
 	void* bdlPhys = nullptr;
-	auto* bdlVirt =
-	    reinterpret_cast<ac97_buffer_descriptor*>(g_alloc_mem_p(sizeof(ac97_buffer_descriptor) * AC97_BDL_ENTRY_COUNT,
-	                                                            &bdlPhys));
+	auto* bdlVirt = reinterpret_cast<ac97_buffer_descriptor*>(
+	    g_alloc_mem_dma(sizeof(ac97_buffer_descriptor) * AC97_BDL_ENTRY_COUNT, 8, G_ALLOC_MEM_FLAG_BELOW_4G, &bdlPhys));
 	if(!bdlVirt)
 	{
 		AC97_LOG("failed to allocate descriptor list");
@@ -148,19 +149,20 @@ bool initializeDma()
 	g_ctx.bdl = bdlVirt;
 	g_ctx.bdlPhys = reinterpret_cast<uint64_t>(bdlPhys);
 
-	for(size_t i = 0; i < AC97_BDL_ENTRY_COUNT; ++i)
+	void* buffersPhys = nullptr;
+	auto* buffersVirt = reinterpret_cast<uint8_t*>(
+	    g_alloc_mem_dma(AC97_DMA_BUFFER_SIZE * AC97_BDL_ENTRY_COUNT, G_PAGE_SIZE, G_ALLOC_MEM_FLAG_BELOW_4G, &buffersPhys));
+	if(!buffersVirt)
 	{
-		void* bufPhys = nullptr;
-		void* bufVirt = g_alloc_mem_p(AC97_DMA_BUFFER_SIZE, &bufPhys);
-		if(!bufVirt)
-		{
-			AC97_LOG("failed to allocate DMA buffer %zu", i);
-			return false;
-		}
+		AC97_LOG("failed to allocate DMA buffers");
+		return false;
+	}
+	std::memset(buffersVirt, 0, AC97_DMA_BUFFER_SIZE * AC97_BDL_ENTRY_COUNT);
 
-		std::memset(bufVirt, 0, AC97_DMA_BUFFER_SIZE);
-		g_ctx.buffers[i].virt = bufVirt;
-		g_ctx.buffers[i].phys = reinterpret_cast<uint64_t>(bufPhys);
+	for(size_t i = 0; i < AC97_BDL_ENTRY_COUNT; ++i)
+	{
+		g_ctx.buffers[i].virt = buffersVirt + i * AC97_DMA_BUFFER_SIZE;
+		g_ctx.buffers[i].phys = reinterpret_cast<uint64_t>(buffersPhys) + i * AC97_DMA_BUFFER_SIZE;
 		g_ctx.bdl[i].buffer = static_cast<uint32_t>(g_ctx.buffers[i].phys);
 		g_ctx.bdl[i].length = AC97_DMA_BUFFER_SIZE & 0xFFFE;
 		g_ctx.bdl[i].control = AC97_BDL_IOC;
@@ -182,6 +184,8 @@ bool initializeDma()
 
 	uint8_t control = g_io_port_read_byte(g_ctx.busMasterBase + AC97_BM_REG_PO_CR);
 	control |= AC97_PO_CR_RUN;
+	if(g_ctx.irq)
+		control |= AC97_PO_CR_IOCE;
 	g_io_port_write_byte(g_ctx.busMasterBase + AC97_BM_REG_PO_CR, control);
 	AC97_LOG("DMA initialized");
 	return true;
@@ -245,7 +249,10 @@ void feederLoop()
 
 		if(next == civ)
 		{
-			g_sleep(2);
+			if(g_ctx.irq)
+				g_await_irq_t(g_ctx.irq, 2);
+			else
+				g_sleep(2);
 			continue;
 		}
 
@@ -293,6 +300,10 @@ bool initializeDriver()
 	if(!preparePcmPipe())
 		return false;
 
+	// The 82801AA that QEMU emulates has no MSI capability, it is then polled
+	if(pciDriverSetupMsi(g_ctx.device, 1, &g_ctx.irq))
+		AC97_LOG("using MSI with IRQ %i", g_ctx.irq);
+
 	resetCodec();
 	configureMixer();
 	if(!initializeDma())
@@ -328,6 +339,12 @@ int main()
 	}
 
 	AC97_LOG("ready: waiting for PCM data via /dev/ac97");
+	if(g_ctx.irq)
+	{
+		// IRQs can only be awaited on core 0
+		g_join(g_create_task_a((void*) feederLoop, 0));
+		return 0;
+	}
 	feederLoop();
 	return 0;
 }
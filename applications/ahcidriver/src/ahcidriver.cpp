@@ -28,6 +28,11 @@
 
 static uint32_t controllerBar;
 static uint8_t controllerIntrLine;
+static g_pci_device_address controllerAddress;
+static uint8_t controllerIrq = 0;
+static volatile g_ahci_hba_ghc* controllerGhc;
+
+#define AHCI_IRQ_TIMEOUT 10
 
 void debugDumpBytes(const uint8_t* data, size_t len)
 {
@@ -75,12 +80,25 @@ int main()
 		return -1;
 	}
 
-	g_irq_create_redirect(controllerIntrLine, 2);
+	if(pciDriverSetupMsi(controllerAddress, 1, &controllerIrq))
+		klog("AHCI controller uses MSI with IRQ %i", controllerIrq);
+	else
+		g_irq_create_redirect(controllerIntrLine, 2);
+
+	// IRQs can only be awaited on core 0
+	g_tid scanner = g_create_task_a((void*) ahciDriverScanPorts, 0);
+	g_join(scanner);
+
+	g_sleep(999999);
+}
 
+void ahciDriverScanPorts()
+{
 	auto ahciControllerVirt = g_map_mmio((void*) controllerBar, 0x1000);
 	klog("mapped AHCI controller at %x to virtual %x", controllerBar, ahciControllerVirt);
 
 	auto ahciGhc = (volatile g_ahci_hba_ghc*) ahciControllerVirt;
+	controllerGhc = ahciGhc;
 	ahciGhc->ghc.ahciEnable = 1;
 	ahciGhc->ghc.interruptEnable = 1;
 	klog("AHCI ports implemented: %i", ahciGhc->pi);
@@ -115,8 +133,6 @@ int main()
 
 		debugDumpBytes((uint8_t*) outVirt, 512);
 	}
-
-	g_sleep(999999);
 }
 
 bool ahciDriverIdentifyController()
@@ -152,6 +168,7 @@ bool ahciDriverIdentifyController()
 
 			controllerBar = bar;
 			controllerIntrLine = interruptLine;
+			controllerAddress = devices[i].deviceAddress;
 			klog("AHCI controller at bar %x, intr line %x", bar, interruptLine);
 			found = true;
 			break;
@@ -197,6 +214,20 @@ void ahciPrintDeviceData(identify_device_response_t* id_data)
 	klog("sectors per track: %i", id_data->SectorsPerTrack);
 }
 
+void ahciAwaitInterrupt(g_ahci_device* ahciDevice)
+{
+	if(!controllerIrq)
+	{
+		g_sleep(1);
+		return;
+	}
+
+	// A new message is only sent once the pending status bits are cleared
+	g_await_irq_t(controllerIrq, AHCI_IRQ_TIMEOUT);
+	ahciDevice->port->is = ahciDevice->port->is;
+	controllerGhc->is = 1 << ahciDevice->portNumber;
+}
+
 bool ahciReadDMA(g_ahci_device* ahciDevice,
                  uint64_t lba,
                  uint16_t sectorCount,
@@ -207,17 +238,16 @@ bool ahciReadDMA(g_ahci_device* ahciDevice,
 		return false;
 
 	size_t bytes = (size_t) sectorCount * 512;
-	if(bytes > G_PAGE_SIZE)
+	if(bytes > G_HBA_PRDT_MAX_BYTES)
 	{
-		// TODO
-		klog("TODO: FAILED TO READ DMA - no contiugous physical alloc implemneted");
+		klog("failed to read DMA, %i bytes exceed a single PRDT entry", bytes);
 		return false;
 	}
 
 	size_t alloc_size = ((bytes + G_PAGE_SIZE - 1) / G_PAGE_SIZE) * G_PAGE_SIZE;
 	void* data_phys;
-	void* data_virt = g_alloc_mem_p(alloc_size, &data_phys);
-	if(!data_phys)
+	void* data_virt = g_alloc_mem_dma(alloc_size, G_PAGE_SIZE, 0, &data_phys);
+	if(!data_virt)
 		return false;
 	memset(data_virt, 0, alloc_size);
 
@@ -277,7 +307,7 @@ bool ahciReadDMA(g_ahci_device* ahciDevice,
 			klog("ahci: task file error on port");
 			return false;
 		}
-		g_sleep(1);
+		ahciAwaitInterrupt(ahciDevice);
 	}
 
 	if(outVirt)
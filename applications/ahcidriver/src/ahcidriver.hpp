@@ -44,6 +44,8 @@ struct g_ahci_device
 };
 
 bool ahciDriverIdentifyController();
+void ahciDriverScanPorts();
+void ahciAwaitInterrupt(g_ahci_device* ahciDevice);
 bool ahciPortStartCommands(volatile g_ahci_hba_port* port);
 bool ahciPortStopCommands(volatile g_ahci_hba_port* port);
 int ahciFindFreeCommandSlot(volatile g_ahci_hba_port* port);
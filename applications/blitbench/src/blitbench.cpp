@@ -0,0 +1,131 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <ghost.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Measures the throughput of full-screen fills and blits to the EFI framebuffer
+ * for each caching type that it can be mapped with. The framebuffer is unmapped
+ * between the runs, since mapping the same memory with different caching types at
+ * the same time is undefined. Requires driver security level.
+ */
+
+struct caching_mode
+{
+	const char* name;
+	g_memory_caching caching;
+};
+
+static const caching_mode modes[] = {
+		{"uncacheable", G_MEMORY_CACHING_UNCACHEABLE},
+		{"write-through", G_MEMORY_CACHING_WRITE_THROUGH},
+		{"write-combining", G_MEMORY_CACHING_WRITE_COMBINING},
+		{"write-back", G_MEMORY_CACHING_WRITE_BACK}
+};
+
+static uint64_t megabytesPerSecond(uint64_t bytes, uint64_t nanos)
+{
+	if(nanos == 0)
+		return 0;
+	return (bytes * 1000) / nanos;
+}
+
+static uint64_t measureFill(volatile uint32_t* lfb, uint32_t pitch, uint16_t width, uint16_t height,
+                            uint32_t frames)
+{
+	uint64_t start = g_nanos();
+	for(uint32_t frame = 0; frame < frames; frame++)
+	{
+		uint32_t color = 0xFF000000 | (frame * 0x00203040);
+		for(uint16_t y = 0; y < height; y++)
+		{
+			volatile uint32_t* line = (volatile uint32_t*) ((volatile uint8_t*) lfb + y * pitch);
+			for(uint16_t x = 0; x < width; x++)
+				line[x] = color;
+		}
+	}
+	return g_nanos() - start;
+}
+
+static uint64_t measureBlit(void* lfb, const uint8_t* buffer, uint32_t pitch, uint16_t height, uint32_t frames)
+{
+	uint64_t start = g_nanos();
+	for(uint32_t frame = 0; frame < frames; frame++)
+		memcpy(lfb, buffer, pitch * height);
+	return g_nanos() - start;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t frames = 10;
+	if(argc > 1)
+		frames = atoi(argv[1]);
+	if(frames == 0)
+		frames = 1;
+
+	g_address lfbPhysical;
+	uint16_t width;
+	uint16_t height;
+	uint16_t bpp;
+	uint32_t pitch;
+	g_get_efi_framebuffer(&lfbPhysical, &width, &height, &bpp, &pitch);
+	if(!lfbPhysical || bpp != 32)
+	{
+		printf("no usable 32 bpp EFI framebuffer available\n");
+		return -1;
+	}
+
+	uint32_t size = pitch * height;
+	uint8_t* buffer = (uint8_t*) malloc(size);
+	if(!buffer)
+	{
+		printf("failed to allocate a back buffer of %u bytes\n", size);
+		return -1;
+	}
+	for(uint32_t i = 0; i < size; i++)
+		buffer[i] = i;
+
+	printf("framebuffer %ix%i, %i frames per mode\n", width, height, frames);
+	for(auto& mode: modes)
+	{
+		auto lfb = (uint32_t*) g_map_mmio_c((void*) lfbPhysical, size, mode.caching);
+		if(!lfb)
+		{
+			printf("%-16s failed to map framebuffer\n", mode.name);
+			continue;
+		}
+
+		uint64_t fillNanos = measureFill(lfb, pitch, width, height, frames);
+		uint64_t blitNanos = measureBlit(lfb, buffer, pitch, height, frames);
+		g_unmap(lfb);
+
+		uint64_t bytes = (uint64_t) size * frames;
+		printf("%-16s fill %6llu MB/s   blit %6llu MB/s\n", mode.name,
+		       (unsigned long long) megabytesPerSecond(bytes, fillNanos),
+		       (unsigned long long) megabytesPerSecond(bytes, blitNanos));
+	}
+
+	free(buffer);
+	return 0;
+}
@@ -82,7 +82,7 @@ void efifbDriverHandleCommandSetMode(g_video_set_mode_request* request, g_tid re
 	g_get_efi_framebuffer(&lfb, &resX, &resY, &bpp, &pitch);
 
 	uint64_t lfbSize = pitch * resY;
-	auto localMapped = g_map_mmio((void*) lfb, lfbSize);
+	auto localMapped = g_map_mmio_c((void*) lfb, lfbSize, G_MEMORY_CACHING_WRITE_COMBINING);
 	// TODO: This is kind of unneccessary, we don't want to map it here
 	void* addressInRequestersSpace = g_share_mem((void*) localMapped, lfbSize, requestingTaskId);
 
@@ -33,18 +33,31 @@ namespace
 {
 constexpr uint16_t INTEL_VENDOR_ID = 0x8086;
 constexpr uint16_t INTEL_E1000_DEVICE_ID = 0x100E;
+constexpr uint16_t INTEL_82574L_DEVICE_ID = 0x10D3;
 constexpr uint32_t E1000_MMIO_SIZE = 0x20000;
 
 constexpr uint32_t E1000_RX_DESCRIPTOR_COUNT = 32;
 constexpr uint32_t E1000_TX_DESCRIPTOR_COUNT = 16;
 constexpr uint32_t E1000_RX_BUFFER_SIZE = 2048;
+constexpr uint32_t E1000_TX_BUFFER_SIZE = 2048;
+
+// Vectors for receiving, transmitting and other causes, allocated as a power of two
+constexpr uint8_t E1000_MSIX_VECTORS = 4;
+constexpr uint8_t E1000_MSIX_VECTOR_RX = 0;
+constexpr uint8_t E1000_MSIX_VECTOR_TX = 1;
+constexpr uint8_t E1000_MSIX_VECTOR_OTHER = 2;
+constexpr uint32_t E1000_IRQ_TIMEOUT = 20;
 
 // Register offsets
 constexpr uint32_t E1000_REG_CTRL = 0x0000;
 constexpr uint32_t E1000_REG_STATUS = 0x0008;
 constexpr uint32_t E1000_REG_EERD = 0x0014;
+constexpr uint32_t E1000_REG_CTRL_EXT = 0x0018;
+constexpr uint32_t E1000_REG_ICR = 0x00C0;
 constexpr uint32_t E1000_REG_IMS = 0x00D0;
 constexpr uint32_t E1000_REG_IMC = 0x00D8;
+constexpr uint32_t E1000_REG_EIAC = 0x00DC;
+constexpr uint32_t E1000_REG_IVAR = 0x00E4;
 constexpr uint32_t E1000_REG_RCTL = 0x0100;
 constexpr uint32_t E1000_REG_TCTL = 0x0400;
 constexpr uint32_t E1000_REG_TIPG = 0x0410;
@@ -69,6 +82,21 @@ constexpr uint32_t E1000_CTRL_RST = (1u << 26);
 constexpr uint32_t E1000_CTRL_ASDE = (1u << 5);
 constexpr uint32_t E1000_CTRL_SLU = (1u << 6);
 
+// CTRL_EXT bits (82574)
+constexpr uint32_t E1000_CTRL_EXT_PBA_SUPPORT = (1u << 31);
+
+// Interrupt causes, the queue causes only exist on the 82574
+constexpr uint32_t E1000_ICR_LSC = (1u << 2);
+constexpr uint32_t E1000_ICR_RXQ0 = (1u << 20);
+constexpr uint32_t E1000_ICR_TXQ0 = (1u << 22);
+constexpr uint32_t E1000_ICR_OTHER = (1u << 24);
+
+// IVAR fields (82574), each cause is assigned a vector with the valid bit set
+constexpr uint32_t E1000_IVAR_VALID = 0x8;
+constexpr uint32_t E1000_IVAR_RXQ0_SHIFT = 0;
+constexpr uint32_t E1000_IVAR_TXQ0_SHIFT = 8;
+constexpr uint32_t E1000_IVAR_OTHER_SHIFT = 16;
+
 // RCTL bits
 constexpr uint32_t E1000_RCTL_EN = (1u << 1);
 constexpr uint32_t E1000_RCTL_SBP = (1u << 2);
@@ -128,6 +156,7 @@ struct e1000_buffer
 struct ethdriver_context
 {
 	g_pci_device_address deviceAddress = 0;
+	uint16_t pciDeviceId = 0;
 	volatile uint8_t* mmio = nullptr;
 	volatile e1000_rx_desc* rxDescriptors = nullptr;
 	volatile e1000_tx_desc* txDescriptors = nullptr;
@@ -145,6 +174,10 @@ struct ethdriver_context
 	uint8_t mac[6]{};
 	g_device_id deviceId = 0;
 	bool linkReady = false;
+	bool msix = false;
+	uint8_t rxIrq = 0;
+	uint8_t txIrq = 0;
+	uint8_t otherIrq = 0;
 } g_ctx;
 
 inline volatile uint32_t* e1000Reg(uint32_t reg)
@@ -183,9 +216,10 @@ bool identifyDevice()
 		uint32_t vendorId = devices[i].vendorId;
 		uint32_t deviceId = devices[i].deviceId;
 
-		if(vendorId == INTEL_VENDOR_ID && deviceId == INTEL_E1000_DEVICE_ID)
+		if(vendorId == INTEL_VENDOR_ID && (deviceId == INTEL_E1000_DEVICE_ID || deviceId == INTEL_82574L_DEVICE_ID))
 		{
 			g_ctx.deviceAddress = devices[i].deviceAddress;
+			g_ctx.pciDeviceId = deviceId;
 			ETH_LOG("found controller at PCI address 0x%x", g_ctx.deviceAddress);
 			found = true;
 			break;
@@ -257,7 +291,16 @@ void monitorLink()
 			ETH_LOG("link state changed: %s", up ? "up" : "down");
 			last = up;
 		}
-		g_sleep(500);
+
+		if(g_ctx.msix)
+		{
+			g_await_irq_t(g_ctx.otherIrq, 500);
+			e1000WriteReg(E1000_REG_ICR, E1000_ICR_LSC | E1000_ICR_OTHER);
+		}
+		else
+		{
+			g_sleep(500);
+		}
 	}
 }
 
@@ -272,15 +315,16 @@ bool initRx()
 	g_ctx.rxDescriptors = reinterpret_cast<volatile e1000_rx_desc*>(descVirt);
 	g_ctx.rxDescriptorPhys = reinterpret_cast<uint64_t>(descPhys);
 
+	void* bufPhys = nullptr;
+	auto* bufVirt = reinterpret_cast<uint8_t*>(
+	    g_alloc_mem_dma(E1000_RX_BUFFER_SIZE * E1000_RX_DESCRIPTOR_COUNT, G_PAGE_SIZE, 0, &bufPhys));
+	if(!bufVirt)
+		return false;
+
 	for(uint32_t i = 0; i < E1000_RX_DESCRIPTOR_COUNT; i++)
 	{
-		void* bufPhys = nullptr;
-		void* bufVirt = g_alloc_mem_p(E1000_RX_BUFFER_SIZE, &bufPhys);
-		if(!bufVirt)
-			return false;
-
-		g_ctx.rxBuffers[i].virt = bufVirt;
-		g_ctx.rxBuffers[i].phys = reinterpret_cast<uint64_t>(bufPhys);
+		g_ctx.rxBuffers[i].virt = bufVirt + i * E1000_RX_BUFFER_SIZE;
+		g_ctx.rxBuffers[i].phys = reinterpret_cast<uint64_t>(bufPhys) + i * E1000_RX_BUFFER_SIZE;
 		g_ctx.rxDescriptors[i].address = g_ctx.rxBuffers[i].phys;
 		g_ctx.rxDescriptors[i].status = 0;
 	}
@@ -308,15 +352,16 @@ bool initTx()
 	g_ctx.txDescriptors = reinterpret_cast<volatile e1000_tx_desc*>(descVirt);
 	g_ctx.txDescriptorPhys = reinterpret_cast<uint64_t>(descPhys);
 
+	void* bufPhys = nullptr;
+	auto* bufVirt = reinterpret_cast<uint8_t*>(
+	    g_alloc_mem_dma(E1000_TX_BUFFER_SIZE * E1000_TX_DESCRIPTOR_COUNT, G_PAGE_SIZE, 0, &bufPhys));
+	if(!bufVirt)
+		return false;
+
 	for(uint32_t i = 0; i < E1000_TX_DESCRIPTOR_COUNT; i++)
 	{
-		void* bufPhys = nullptr;
-		void* bufVirt = g_alloc_mem_p(G_ETH_FRAME_DATA_SIZE, &bufPhys);
-		if(!bufVirt)
-			return false;
-
-		g_ctx.txBuffers[i].virt = bufVirt;
-		g_ctx.txBuffers[i].phys = reinterpret_cast<uint64_t>(bufPhys);
+		g_ctx.txBuffers[i].virt = bufVirt + i * E1000_TX_BUFFER_SIZE;
+		g_ctx.txBuffers[i].phys = reinterpret_cast<uint64_t>(bufPhys) + i * E1000_TX_BUFFER_SIZE;
 		g_ctx.txDescriptors[i].address = g_ctx.txBuffers[i].phys;
 		g_ctx.txDescriptors[i].status = E1000_TX_STATUS_DD;
 	}
@@ -390,7 +435,11 @@ bool transmit(const uint8_t* data, uint16_t length)
 			e1000WriteReg(E1000_REG_TDT, g_ctx.txTail);
 			return true;
 		}
-		g_sleep(1);
+
+		if(g_ctx.msix)
+			g_await_irq_t(g_ctx.txIrq, E1000_IRQ_TIMEOUT);
+		else
+			g_sleep(1);
 	}
 }
 
@@ -422,6 +471,10 @@ void rxLoop()
 			e1000WriteReg(E1000_REG_RDT, g_ctx.rxIndex);
 			g_ctx.rxIndex = (g_ctx.rxIndex + 1) % E1000_RX_DESCRIPTOR_COUNT;
 		}
+		else if(g_ctx.msix)
+		{
+			g_await_irq_t(g_ctx.rxIrq, E1000_IRQ_TIMEOUT);
+		}
 		else
 		{
 			g_sleep(2);
@@ -479,6 +532,41 @@ void messageLoop()
 	}
 }
 
+/**
+ * The 82574 (e1000e) has MSI-X with separate vectors for the receive queue, the
+ * transmit queue and other causes like link changes. Without it, or on the 82540
+ * (e1000), the driver keeps polling the descriptors.
+ */
+void setupInterrupts()
+{
+	if(g_ctx.pciDeviceId != INTEL_82574L_DEVICE_ID)
+		return;
+
+	uint8_t irq;
+	g_pci_msi_type type = G_PCI_MSI_TYPE_NONE;
+	if(!pciDriverSetupMsi(g_ctx.deviceAddress, E1000_MSIX_VECTORS, &irq, &type) || type != G_PCI_MSI_TYPE_MSIX)
+	{
+		ETH_LOG("MSI-X not available, polling descriptors");
+		return;
+	}
+
+	g_ctx.rxIrq = irq + E1000_MSIX_VECTOR_RX;
+	g_ctx.txIrq = irq + E1000_MSIX_VECTOR_TX;
+	g_ctx.otherIrq = irq + E1000_MSIX_VECTOR_OTHER;
+
+	e1000WriteReg(E1000_REG_CTRL_EXT, e1000ReadReg(E1000_REG_CTRL_EXT) | E1000_CTRL_EXT_PBA_SUPPORT);
+	e1000WriteReg(E1000_REG_IVAR, ((E1000_IVAR_VALID | E1000_MSIX_VECTOR_RX) << E1000_IVAR_RXQ0_SHIFT) |
+	                              ((E1000_IVAR_VALID | E1000_MSIX_VECTOR_TX) << E1000_IVAR_TXQ0_SHIFT) |
+	                              ((E1000_IVAR_VALID | E1000_MSIX_VECTOR_OTHER) << E1000_IVAR_OTHER_SHIFT));
+
+	// Queue causes are cleared when their message is sent
+	e1000WriteReg(E1000_REG_EIAC, E1000_ICR_RXQ0 | E1000_ICR_TXQ0);
+	e1000WriteReg(E1000_REG_IMS, E1000_ICR_RXQ0 | E1000_ICR_TXQ0 | E1000_ICR_OTHER | E1000_ICR_LSC);
+
+	g_ctx.msix = true;
+	ETH_LOG("using MSI-X, RX IRQ %i, TX IRQ %i, other IRQ %i", g_ctx.rxIrq, g_ctx.txIrq, g_ctx.otherIrq);
+}
+
 bool initializeDriver()
 {
 	ETH_LOG("initializing driver context");
@@ -536,6 +624,7 @@ bool initializeDriver()
 		        g_ctx.mac[3], g_ctx.mac[4], g_ctx.mac[5]);
 	}
 	e1000WriteReg(E1000_REG_IMC, 0xFFFFFFFF);
+	setupInterrupts();
 	return true;
 }
 
@@ -565,9 +654,11 @@ int main()
 		ETH_LOG("registered device id %u", g_ctx.deviceId);
 	}
 
-	g_tid linkTask = g_create_task((void*) monitorLink);
-	g_tid rxTask = g_create_task((void*) rxLoop);
-	g_tid txTask = g_create_task((void*) txLoop);
+	// IRQs can only be awaited on core 0
+	uint8_t affinity = g_ctx.msix ? 0 : G_TASK_CORE_AFFINITY_NONE;
+	g_tid linkTask = g_create_task_a((void*) monitorLink, affinity);
+	g_tid rxTask = g_create_task_a((void*) rxLoop, affinity);
+	g_tid txTask = g_create_task_a((void*) txLoop, affinity);
 	(void) rxTask;
 	(void) txTask;
 	(void) linkTask;
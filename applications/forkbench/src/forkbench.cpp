@@ -0,0 +1,133 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2025, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <ghost.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Measures how long it takes to create a process that immediately exits, once
+ * by forking the current process and once by spawning the same binary. The fork
+ * is also measured with a child that writes to memory, so that the pages it
+ * touches are copied.
+ */
+
+#define TOUCHED_PAGES 64
+
+static uint8_t touched[TOUCHED_PAGES * G_PAGE_SIZE];
+
+static uint64_t readTsc()
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+static bool forkAndExit(bool touch)
+{
+	g_tid child = g_fork();
+	if(child == G_PID_NONE)
+		return false;
+
+	if(child == 0)
+	{
+		if(touch)
+		{
+			for(uint32_t i = 0; i < TOUCHED_PAGES; i++)
+				touched[i * G_PAGE_SIZE] = i;
+		}
+		g_exit(0);
+	}
+
+	g_join(child);
+	return true;
+}
+
+static bool spawnAndExit(const char* path)
+{
+	g_pid child;
+	if(g_spawn_p(path, "--exit", "/", G_SECURITY_LEVEL_APPLICATION, &child) != G_SPAWN_STATUS_SUCCESSFUL)
+		return false;
+
+	g_join(child);
+	return true;
+}
+
+static void printResult(const char* name, uint64_t nanos, uint64_t cycles, uint32_t iterations)
+{
+	printf("%-12s %10llu ns/process %12llu cycles/process\n", name, (unsigned long long) (nanos / iterations),
+	       (unsigned long long) (cycles / iterations));
+}
+
+static void measureFork(const char* name, bool touch, uint32_t iterations)
+{
+	uint64_t startNanos = g_nanos();
+	uint64_t startTsc = readTsc();
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		if(!forkAndExit(touch))
+		{
+			printf("%s: fork failed\n", name);
+			return;
+		}
+	}
+	printResult(name, g_nanos() - startNanos, readTsc() - startTsc, iterations);
+}
+
+static void measureSpawn(const char* name, const char* path, uint32_t iterations)
+{
+	uint64_t startNanos = g_nanos();
+	uint64_t startTsc = readTsc();
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		if(!spawnAndExit(path))
+		{
+			printf("%s: failed to spawn %s\n", name, path);
+			return;
+		}
+	}
+	printResult(name, g_nanos() - startNanos, readTsc() - startTsc, iterations);
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1 && strcmp(argv[1], "--exit") == 0)
+		return 0;
+
+	uint32_t iterations = 100;
+	if(argc > 1)
+		iterations = atoi(argv[1]);
+	if(iterations == 0)
+		iterations = 1;
+
+	char path[G_PATH_MAX];
+	g_get_executable_path(path);
+
+	// Make sure the pages exist in the parent, so the child has to copy them
+	memset(touched, 1, sizeof(touched));
+
+	printf("process creation and exit, %i iterations\n", iterations);
+	measureFork("fork", false, iterations);
+	measureFork("fork+touch", true, iterations);
+	measureSpawn("spawn", path, iterations);
+	return 0;
+}
@@ -69,6 +69,7 @@ constexpr uint16_t AC97_PO_SR_FIFOE = (1u << 4);
 
 constexpr uint8_t AC97_PO_CR_RUN = (1u << 0);
 constexpr uint8_t AC97_PO_CR_RESET = (1u << 1);
+constexpr uint8_t AC97_PO_CR_IOCE = (1u << 4);
 
 constexpr uint16_t AC97_BDL_IOC = (1u << 15);
 
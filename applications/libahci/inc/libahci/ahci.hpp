@@ -173,6 +173,7 @@ typedef struct {
 } __attribute__((packed)) g_hba_prdt_entry;
 
 #define G_HBA_PRDT_MAX_ENTRIES	 256
+#define G_HBA_PRDT_MAX_BYTES	 0x400000
 
 
 /**
@@ -49,6 +49,8 @@ typedef int g_pci_command;
 #define G_PCI_READ_BAR                      ((g_pci_command) 4)
 #define G_PCI_READ_BAR_SIZE                 ((g_pci_command) 5)
 #define G_PCI_ENABLE_RESOURCE_ACCESS        ((g_pci_command) 6)
+#define G_PCI_QUERY_MSI                     ((g_pci_command) 7)
+#define G_PCI_ENABLE_MSI                    ((g_pci_command) 8)
 
 /**
  * Header structure for messages when communicating with the driver
@@ -180,4 +182,62 @@ struct g_pci_read_bar_size_response
     g_address value;
 }__attribute__((packed));
 
+/**
+ * Kind of message-signaled interrupts that a device was set up with.
+ */
+typedef uint8_t g_pci_msi_type;
+#define G_PCI_MSI_TYPE_NONE                 ((g_pci_msi_type) 0)
+#define G_PCI_MSI_TYPE_MSI                  ((g_pci_msi_type) 1)
+#define G_PCI_MSI_TYPE_MSIX                 ((g_pci_msi_type) 2)
+
+/**
+ * Queries how many MSI and MSI-X vectors a device supports, zero if it has no
+ * such capability.
+ */
+bool pciDriverQueryMsi(g_pci_device_address address, uint8_t* outMsiVectors, uint16_t* outMsixVectors);
+
+struct g_pci_query_msi_request
+{
+    g_pci_request_header header;
+    g_pci_device_address deviceAddress;
+}__attribute__((packed));
+
+struct g_pci_query_msi_response
+{
+    bool successful;
+    uint8_t msiVectors;
+    uint16_t msixVectors;
+}__attribute__((packed));
+
+/**
+ * Programs the MSI-X or MSI capability of a device with a message that was
+ * allocated with g_irq_allocate_msi and disables its legacy interrupt line. Vector i
+ * is programmed with the message data plus i. MSI-X is preferred if the device
+ * supports enough vectors.
+ */
+bool pciDriverEnableMsi(g_pci_device_address address, uint64_t messageAddress, uint32_t messageData, uint8_t count,
+                        g_pci_msi_type* outType);
+
+struct g_pci_enable_msi_request
+{
+    g_pci_request_header header;
+    g_pci_device_address deviceAddress;
+    uint64_t messageAddress;
+    uint32_t messageData;
+    uint8_t count;
+}__attribute__((packed));
+
+struct g_pci_enable_msi_response
+{
+    bool successful;
+    g_pci_msi_type type;
+}__attribute__((packed));
+
+/**
+ * Allocates interrupt vectors and sets the device up to use them, see
+ * pciDriverQueryMsi and pciDriverEnableMsi. Fails if the device doesn't support
+ * the number of vectors, so the caller can fall back to its legacy interrupt line.
+ */
+bool pciDriverSetupMsi(g_pci_device_address address, uint8_t count, uint8_t* outIrq, g_pci_msi_type* outType = nullptr);
+
 #endif
@@ -64,6 +64,33 @@
 #define PCI_CONFIG_OFF_MGNT					0x3E
 #define PCI_CONFIG_OFF_MLAT					0x3F
 
+/**
+* Command and status register bits
+*/
+#define PCI_COMMAND_INTX_DISABLE			(1 << 10)
+#define PCI_STATUS_REGISTER					0x06
+#define PCI_STATUS_CAPABILITIES				(1 << 4)
+
+/**
+* Capabilities for message-signaled interrupts
+*/
+#define PCI_CAP_ID_MSI						0x05
+#define PCI_CAP_ID_MSIX						0x11
+
+#define PCI_MSI_CONTROL_ENABLE				(1 << 0)
+#define PCI_MSI_CONTROL_MMC(control)		(((control) >> 1) & 0x7)
+#define PCI_MSI_CONTROL_MME_SHIFT			4
+#define PCI_MSI_CONTROL_MME_MASK			(0x7 << 4)
+#define PCI_MSI_CONTROL_64BIT				(1 << 7)
+
+#define PCI_MSIX_CONTROL_TABLE_SIZE(control)	(((control) & 0x7FF) + 1)
+#define PCI_MSIX_CONTROL_FUNCTION_MASK		(1 << 14)
+#define PCI_MSIX_CONTROL_ENABLE				(1 << 15)
+#define PCI_MSIX_TABLE_BIR(value)			((value) & 0x7)
+#define PCI_MSIX_TABLE_OFFSET(value)		((value) & ~0x7)
+#define PCI_MSIX_ENTRY_SIZE					16
+#define PCI_MSIX_ENTRY_VECTOR_CONTROL_MASKED	(1 << 0)
+
 /**
 * Class definitions (https://pcisig.com/sites/default/files/files/PCI_Code-ID_r_1_11__v24_Jan_2019.pdf)
 */
@@ -260,3 +260,88 @@ bool pciDriverReadBARSize(g_pci_device_address address, uint8_t bar, g_address*
 	g_mutex_release(g_pciRequestLock);
 	return success;
 }
+
+bool pciDriverQueryMsi(g_pci_device_address address, uint8_t* outMsiVectors, uint16_t* outMsixVectors)
+{
+	g_mutex_acquire(g_pciRequestLock);
+	bool success = false;
+	uint8_t responseBuffer[G_MESSAGE_MAXIMUM_MESSAGE_LENGTH];
+	size_t responseLength = 0;
+
+	g_pci_query_msi_request request{};
+	request.header.command = G_PCI_QUERY_MSI;
+	request.deviceAddress = address;
+
+	if(pciSendRequest(&request, sizeof(request), responseBuffer, sizeof(responseBuffer), &responseLength) &&
+	   responseLength == sizeof(g_pci_query_msi_response))
+	{
+		auto response = reinterpret_cast<g_pci_query_msi_response*>(responseBuffer);
+		success = response->successful;
+		if(success)
+		{
+			*outMsiVectors = response->msiVectors;
+			*outMsixVectors = response->msixVectors;
+		}
+	}
+
+	g_mutex_release(g_pciRequestLock);
+	return success;
+}
+
+bool pciDriverEnableMsi(g_pci_device_address address, uint64_t messageAddress, uint32_t messageData, uint8_t count,
+                        g_pci_msi_type* outType)
+{
+	g_mutex_acquire(g_pciRequestLock);
+	bool success = false;
+	uint8_t responseBuffer[G_MESSAGE_MAXIMUM_MESSAGE_LENGTH];
+	size_t responseLength = 0;
+
+	g_pci_enable_msi_request request{};
+	request.header.command = G_PCI_ENABLE_MSI;
+	request.deviceAddress = address;
+	request.messageAddress = messageAddress;
+	request.messageData = messageData;
+	request.count = count;
+
+	if(pciSendRequest(&request, sizeof(request), responseBuffer, sizeof(responseBuffer), &responseLength) &&
+	   responseLength == sizeof(g_pci_enable_msi_response))
+	{
+		auto response = reinterpret_cast<g_pci_enable_msi_response*>(responseBuffer);
+		success = response->successful;
+		if(success && outType)
+			*outType = response->type;
+	}
+
+	g_mutex_release(g_pciRequestLock);
+	return success;
+}
+
+bool pciDriverSetupMsi(g_pci_device_address address, uint8_t count, uint8_t* outIrq, g_pci_msi_type* outType)
+{
+	uint8_t msiVectors = 0;
+	uint16_t msixVectors = 0;
+	if(!pciDriverQueryMsi(address, &msiVectors, &msixVectors))
+		return false;
+
+	if(msixVectors < count && msiVectors < count)
+		return false;
+
+	uint8_t irq;
+	uint64_t messageAddress;
+	uint32_t messageData;
+	g_irq_allocate_msi_status status = g_irq_allocate_msi(count, &irq, &messageAddress, &messageData);
+	if(status != G_IRQ_ALLOCATE_MSI_STATUS_SUCCESSFUL)
+	{
+		klog("libpci: failed to allocate %i MSI vectors (%i)", count, status);
+		return false;
+	}
+
+	if(!pciDriverEnableMsi(address, messageAddress, messageData, count, outType))
+	{
+		klog("libpci: failed to enable MSI on device %x", address);
+		return false;
+	}
+
+	*outIrq = irq;
+	return true;
+}
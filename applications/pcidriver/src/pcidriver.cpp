@@ -86,6 +86,14 @@ void pciDriverServeRequests()
 			pciDriverHandleReadBarSize(msgHeader->sender, msgHeader->transaction,
 			                        reinterpret_cast<g_pci_read_bar_size_request*>(header));
 			break;
+		case G_PCI_QUERY_MSI:
+			pciDriverHandleQueryMsi(msgHeader->sender, msgHeader->transaction,
+			                        reinterpret_cast<g_pci_query_msi_request*>(header));
+			break;
+		case G_PCI_ENABLE_MSI:
+			pciDriverHandleEnableMsi(msgHeader->sender, msgHeader->transaction,
+			                         reinterpret_cast<g_pci_enable_msi_request*>(header));
+			break;
 		default:
 			klog("pcidriver: received unknown command %i", header->command);
 			break;
@@ -230,6 +238,154 @@ void pciDriverHandleReadBarSize(g_tid sender, g_message_transaction tx, g_pci_re
 	g_send_message_t(sender, &response, sizeof(response), tx);
 }
 
+void pciDriverHandleQueryMsi(g_tid sender, g_message_transaction tx, g_pci_query_msi_request* request)
+{
+	g_pci_query_msi_response response{};
+	uint8_t bus = G_PCI_DEVICE_ADDRESS_BUS(request->deviceAddress);
+	uint8_t device = G_PCI_DEVICE_ADDRESS_DEVICE(request->deviceAddress);
+	uint8_t function = G_PCI_DEVICE_ADDRESS_FUNCTION(request->deviceAddress);
+
+	uint8_t msi = pciFindCapabilityAt(bus, device, function, PCI_CAP_ID_MSI);
+	if(msi)
+	{
+		uint16_t control = pciConfigReadWordAt(bus, device, function, msi + 2);
+		response.msiVectors = 1 << PCI_MSI_CONTROL_MMC(control);
+	}
+
+	uint8_t msix = pciFindCapabilityAt(bus, device, function, PCI_CAP_ID_MSIX);
+	if(msix)
+	{
+		uint16_t control = pciConfigReadWordAt(bus, device, function, msix + 2);
+		response.msixVectors = PCI_MSIX_CONTROL_TABLE_SIZE(control);
+	}
+	response.successful = true;
+
+	g_send_message_t(sender, &response, sizeof(response), tx);
+}
+
+void pciDriverHandleEnableMsi(g_tid sender, g_message_transaction tx, g_pci_enable_msi_request* request)
+{
+	g_pci_enable_msi_response response{};
+	uint8_t bus = G_PCI_DEVICE_ADDRESS_BUS(request->deviceAddress);
+	uint8_t device = G_PCI_DEVICE_ADDRESS_DEVICE(request->deviceAddress);
+	uint8_t function = G_PCI_DEVICE_ADDRESS_FUNCTION(request->deviceAddress);
+
+	uint8_t msix = pciFindCapabilityAt(bus, device, function, PCI_CAP_ID_MSIX);
+	uint8_t msi = pciFindCapabilityAt(bus, device, function, PCI_CAP_ID_MSI);
+	if(msix && pciEnableMsixAt(bus, device, function, msix, request->messageAddress, request->messageData,
+	                           request->count))
+	{
+		response.type = G_PCI_MSI_TYPE_MSIX;
+	}
+	else if(msi && pciEnableMsiAt(bus, device, function, msi, request->messageAddress, request->messageData,
+	                              request->count))
+	{
+		response.type = G_PCI_MSI_TYPE_MSI;
+	}
+	else
+	{
+		klog("pcidriver: device %x can't send %i message-signaled interrupts", request->deviceAddress, request->count);
+		response.type = G_PCI_MSI_TYPE_NONE;
+	}
+
+	if(response.type != G_PCI_MSI_TYPE_NONE)
+	{
+		// Messages are memory writes by the device, the legacy line is no longer needed
+		uint16_t command = pciConfigReadWordAt(bus, device, function, PCI_CONFIG_OFF_COMMAND);
+		command |= 0x0006 | PCI_COMMAND_INTX_DISABLE;
+		pciConfigWriteWordAt(bus, device, function, PCI_CONFIG_OFF_COMMAND, command);
+
+		klog("pcidriver: enabled %s with %i vectors on %02x:%02x.%u", response.type == G_PCI_MSI_TYPE_MSIX ? "MSI-X" : "MSI",
+		     request->count, bus, device, function);
+		response.successful = true;
+	}
+
+	g_send_message_t(sender, &response, sizeof(response), tx);
+}
+
+uint8_t pciFindCapabilityAt(uint8_t bus, uint8_t device, uint8_t function, uint8_t id)
+{
+	uint16_t status = pciConfigReadWordAt(bus, device, function, PCI_STATUS_REGISTER);
+	if(!(status & PCI_STATUS_CAPABILITIES))
+		return 0;
+
+	// The list is limited to be safe against malformed loops
+	uint8_t offset = pciConfigReadByteAt(bus, device, function, PCI_CONFIG_OFF_CAP) & ~0x3;
+	for(int i = 0; offset && i < 48; i++)
+	{
+		if(pciConfigReadByteAt(bus, device, function, offset) == id)
+			return offset;
+		offset = pciConfigReadByteAt(bus, device, function, offset + 1) & ~0x3;
+	}
+	return 0;
+}
+
+bool pciEnableMsiAt(uint8_t bus, uint8_t device, uint8_t function, uint8_t capability, uint64_t address,
+                    uint32_t data, uint8_t count)
+{
+	uint16_t control = pciConfigReadWordAt(bus, device, function, capability + 2);
+	if((1 << PCI_MSI_CONTROL_MMC(control)) < count)
+		return false;
+
+	uint8_t enabledLog = 0;
+	while((1 << enabledLog) < count)
+		++enabledLog;
+
+	pciConfigWriteDwordAt(bus, device, function, capability + 4, (uint32_t) address);
+	if(control & PCI_MSI_CONTROL_64BIT)
+	{
+		pciConfigWriteDwordAt(bus, device, function, capability + 8, (uint32_t) (address >> 32));
+		pciConfigWriteWordAt(bus, device, function, capability + 12, (uint16_t) data);
+	}
+	else
+	{
+		pciConfigWriteWordAt(bus, device, function, capability + 8, (uint16_t) data);
+	}
+
+	control &= ~PCI_MSI_CONTROL_MME_MASK;
+	control |= (enabledLog << PCI_MSI_CONTROL_MME_SHIFT) | PCI_MSI_CONTROL_ENABLE;
+	pciConfigWriteWordAt(bus, device, function, capability + 2, control);
+	return true;
+}
+
+bool pciEnableMsixAt(uint8_t bus, uint8_t device, uint8_t function, uint8_t capability, uint64_t address,
+                     uint32_t data, uint8_t count)
+{
+	uint16_t control = pciConfigReadWordAt(bus, device, function, capability + 2);
+	if(PCI_MSIX_CONTROL_TABLE_SIZE(control) < count)
+		return false;
+
+	uint32_t tableInfo = pciConfigReadDwordAt(bus, device, function, capability + 4);
+	uint32_t bar = pciConfigGetBARAt(bus, device, function, PCI_MSIX_TABLE_BIR(tableInfo));
+	if(!bar)
+		return false;
+
+	g_address table = bar + PCI_MSIX_TABLE_OFFSET(tableInfo);
+	g_address tablePage = G_PAGE_ALIGN_DOWN(table);
+	uint32_t mappedSize = G_PAGE_ALIGN_UP(table + count * PCI_MSIX_ENTRY_SIZE) - tablePage;
+	auto mapped = (uint8_t*) g_map_mmio((void*) tablePage, mappedSize);
+	if(!mapped)
+		return false;
+
+	// Keep all vectors masked while the table is written
+	pciConfigWriteWordAt(bus, device, function, capability + 2,
+	                     control | PCI_MSIX_CONTROL_ENABLE | PCI_MSIX_CONTROL_FUNCTION_MASK);
+
+	for(uint8_t i = 0; i < count; i++)
+	{
+		auto entry = (volatile uint32_t*) (mapped + (table - tablePage) + i * PCI_MSIX_ENTRY_SIZE);
+		entry[0] = (uint32_t) address;
+		entry[1] = (uint32_t) (address >> 32);
+		entry[2] = data + i;
+		entry[3] &= ~PCI_MSIX_ENTRY_VECTOR_CONTROL_MASKED;
+	}
+	g_unmap(mapped);
+
+	control = (control | PCI_MSIX_CONTROL_ENABLE) & ~PCI_MSIX_CONTROL_FUNCTION_MASK;
+	pciConfigWriteWordAt(bus, device, function, capability + 2, control);
+	return true;
+}
+
 void pciDriverScanBus()
 {
 	int total = 0;
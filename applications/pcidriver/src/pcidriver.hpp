@@ -82,6 +82,21 @@ void pciConfigWriteDwordAt(uint8_t bus, uint8_t device, uint8_t function, uint8_
 void pciEnableResourceAccess(g_pci_device* dev, bool enabled);
 void pciEnableResourceAccessAddress(g_pci_device_address address, bool enabled);
 
+/**
+ * Walks the capability list of a device and returns the offset of the capability
+ * with the given id, or 0 if the device doesn't have it.
+ */
+uint8_t pciFindCapabilityAt(uint8_t bus, uint8_t device, uint8_t function, uint8_t id);
+
+/**
+ * Programs the MSI or MSI-X capability at the given offset so that vector i sends
+ * the message data plus i to the message address.
+ */
+bool pciEnableMsiAt(uint8_t bus, uint8_t device, uint8_t function, uint8_t capability, uint64_t address,
+                    uint32_t data, uint8_t count);
+bool pciEnableMsixAt(uint8_t bus, uint8_t device, uint8_t function, uint8_t capability, uint64_t address,
+                     uint32_t data, uint8_t count);
+
 /**
  * Serves incoming /dev requests.
  */
@@ -92,5 +107,7 @@ void pciDriverHandleReadConfig(g_tid sender, g_message_transaction tx, g_pci_rea
 void pciDriverHandleEnableResourceAccess(g_tid sender, g_message_transaction tx, g_pci_enable_resource_access_request* request);
 void pciDriverHandleReadBar(g_tid sender, g_message_transaction tx, g_pci_read_bar_request* request);
 void pciDriverHandleReadBarSize(g_tid sender, g_message_transaction tx, g_pci_read_bar_size_request* request);
+void pciDriverHandleQueryMsi(g_tid sender, g_message_transaction tx, g_pci_query_msi_request* request);
+void pciDriverHandleEnableMsi(g_tid sender, g_message_transaction tx, g_pci_enable_msi_request* request);
 
 #endif
@@ -0,0 +1,57 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "memory.hpp"
+
+#include <ghost.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int procMemory(int argc, char** argv)
+{
+	g_kernquery_memory_paging_data paging;
+	g_kernquery_status status = g_kernquery(G_KERNQUERY_MEMORY_PAGING, (uint8_t*) &paging);
+	if(status != G_KERNQUERY_STATUS_SUCCESSFUL)
+	{
+		fprintf(stderr, "failed to query the kernel for paging statistics (code %i)\n", status);
+		return -1;
+	}
+
+	println("large pages mapped:\t%llu", (unsigned long long) paging.large_pages);
+	println("large pages split:\t%llu", (unsigned long long) paging.large_pages_split);
+
+	for(int arg = 2; arg < argc; arg++)
+	{
+		g_kernquery_task_faults_data faults;
+		faults.id = atoi(argv[arg]);
+		if(g_kernquery(G_KERNQUERY_TASK_FAULTS, (uint8_t*) &faults) != G_KERNQUERY_STATUS_SUCCESSFUL)
+		{
+			fprintf(stderr, "task %s does not exist\n", argv[arg]);
+			continue;
+		}
+
+		println("");
+		println("task %i:", faults.id);
+		println("minor faults:\t\t%llu", (unsigned long long) faults.minor_faults);
+		println("major faults:\t\t%llu", (unsigned long long) faults.major_faults);
+		println("read from files:\t%llu bytes", (unsigned long long) faults.file_read_bytes);
+	}
+	return 0;
+}
@@ -27,6 +27,7 @@
 #define PATCH 1
 
 #include "list/list.hpp"
+#include "memory/memory.hpp"
 
 /**
  *
@@ -42,6 +43,10 @@ int main(int argc, char** argv)
 		{
 			return procList(argc, argv);
 		}
+		else if(strcmp(command, "-m") == 0 || strcmp(command, "--memory") == 0)
+		{
+			return procMemory(argc, argv);
+		}
 		else if(strcmp(command, "--top") == 0)
 		{
 			while(true)
@@ -92,6 +97,7 @@ int main(int argc, char** argv)
 			println("");
 			println("\t-l\t\tlists running tasks");
 			println("\t-k <id>\tkills a process");
+			println("\t-m [id...]\tshows memory statistics and page faults of tasks");
 			println("");
 		}
 		else
@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2025, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <ghost.h>
+#include <ghost/filesystem/callstructs.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Measures small writes to a pipe, once with one system call per write and once
+ * submitted in batches through the system call ring of the process. A second thread
+ * reads everything from the pipe, so that the writer doesn't block on a full pipe.
+ */
+
+#define WRITE_SIZE 8
+#define RING_ENTRIES 256
+
+struct reader_t
+{
+	g_fd fd;
+	uint64_t expected;
+};
+
+static void readPipe(reader_t* reader)
+{
+	uint8_t buffer[4096];
+	uint64_t total = 0;
+	while(total < reader->expected)
+	{
+		int32_t read = g_read(reader->fd, buffer, sizeof(buffer));
+		if(read <= 0)
+			break;
+		total += read;
+	}
+}
+
+static uint64_t readTsc()
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+static bool writeDirect(g_fd fd, uint32_t writes)
+{
+	uint8_t data[WRITE_SIZE] = {};
+	for(uint32_t i = 0; i < writes; i++)
+	{
+		if(g_write(fd, data, WRITE_SIZE) != WRITE_SIZE)
+			return false;
+	}
+	return true;
+}
+
+static bool writeBatched(g_fd fd, uint32_t writes, g_syscall_ring* ring)
+{
+	static g_syscall_fs_write calls[RING_ENTRIES];
+	uint8_t data[WRITE_SIZE] = {};
+
+	uint32_t written = 0;
+	while(written < writes)
+	{
+		uint32_t batch = writes - written;
+		if(batch > RING_ENTRIES)
+			batch = RING_ENTRIES;
+
+		for(uint32_t i = 0; i < batch; i++)
+		{
+			calls[i].fd = fd;
+			calls[i].buffer = data;
+			calls[i].length = WRITE_SIZE;
+			g_syscall_ring_submit(ring, G_SYSCALL_FS_WRITE, &calls[i], i);
+		}
+
+		if(g_syscall_ring_enter(ring) != batch)
+			return false;
+
+		g_syscall_ring_completion completion;
+		while(g_syscall_ring_complete(ring, &completion))
+		{
+			if(completion.status != G_SYSCALL_RING_STATUS_SUCCESSFUL || calls[completion.userData].result != WRITE_SIZE)
+				return false;
+		}
+		written += batch;
+	}
+	return true;
+}
+
+static void measure(const char* name, uint32_t writes, g_syscall_ring* ring)
+{
+	g_fd writeFd;
+	g_fd readFd;
+	if(g_pipe(&writeFd, &readFd) != G_FS_PIPE_SUCCESSFUL)
+	{
+		printf("%s: failed to create pipe\n", name);
+		return;
+	}
+
+	reader_t reader;
+	reader.fd = readFd;
+	reader.expected = (uint64_t) writes * WRITE_SIZE;
+	g_tid readerTask = g_create_task_d((void*) readPipe, &reader);
+
+	uint64_t startNanos = g_nanos();
+	uint64_t startTsc = readTsc();
+	bool successful = ring ? writeBatched(writeFd, writes, ring) : writeDirect(writeFd, writes);
+	uint64_t cycles = readTsc() - startTsc;
+	uint64_t nanos = g_nanos() - startNanos;
+
+	if(successful)
+		g_join(readerTask);
+	else
+		printf("%s: write failed\n", name);
+	g_close(writeFd);
+	g_close(readFd);
+
+	printf("%-8s %8llu ns/write %8llu cycles/write\n", name, (unsigned long long) (nanos / writes),
+	       (unsigned long long) (cycles / writes));
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t writes = 10000;
+	if(argc > 1)
+		writes = atoi(argv[1]);
+	if(writes == 0)
+		writes = 1;
+
+	g_syscall_ring_setup_status status;
+	g_syscall_ring* ring = g_syscall_ring_setup_s(RING_ENTRIES, &status);
+	if(!ring)
+	{
+		printf("failed to set up system call ring, status %i\n", status);
+		return 1;
+	}
+
+	printf("%i pipe writes of %i bytes\n", writes, WRITE_SIZE);
+	measure("direct", writes, nullptr);
+	measure("batched", writes, ring);
+	return 0;
+}
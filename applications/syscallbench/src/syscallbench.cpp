@@ -0,0 +1,104 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2025, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <ghost.h>
+#include <ghost/system/callstructs.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Measures the round-trip latency of a system call that does no work, once
+ * entering the kernel with "int 0x80" and once with SYSCALL.
+ */
+
+static void syscallInterrupt(g_syscall_test* data)
+{
+	asm volatile("int $0x80" :: "a"(G_SYSCALL_TEST), "D"(data) : "memory");
+}
+
+static void syscallInstruction(g_syscall_test* data)
+{
+	asm volatile("syscall" :: "a"(G_SYSCALL_TEST), "D"(data) : "rcx", "r11", "memory");
+}
+
+static bool syscallInstructionAvailable()
+{
+	uint32_t eax, ebx, ecx, edx;
+	asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000000));
+	if(eax < 0x80000001)
+		return false;
+
+	asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000001));
+	return edx & (1 << 11);
+}
+
+static uint64_t readTsc()
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+static void measure(const char* name, void (*call)(g_syscall_test*), uint32_t iterations)
+{
+	g_syscall_test data;
+
+	// Warm up caches and TLB
+	for(uint32_t i = 0; i < 1000; i++)
+	{
+		data.test = i;
+		call(&data);
+	}
+
+	uint64_t startNanos = g_nanos();
+	uint64_t startTsc = readTsc();
+	for(uint32_t i = 0; i < iterations; i++)
+	{
+		data.test = i;
+		call(&data);
+	}
+	uint64_t cycles = readTsc() - startTsc;
+	uint64_t nanos = g_nanos() - startNanos;
+
+	if(data.result != iterations - 1)
+		printf("%s: unexpected result %i\n", name, data.result);
+
+	printf("%-10s %8llu ns/call %8llu cycles/call\n", name, (unsigned long long) (nanos / iterations),
+	       (unsigned long long) (cycles / iterations));
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t iterations = 100000;
+	if(argc > 1)
+		iterations = atoi(argv[1]);
+	if(iterations == 0)
+		iterations = 1;
+
+	printf("null system call round-trip, %i iterations\n", iterations);
+	measure("int 0x80", syscallInterrupt, iterations);
+
+	if(syscallInstructionAvailable())
+		measure("syscall", syscallInstruction, iterations);
+	else
+		printf("syscall    not supported by this processor\n");
+	return 0;
+}
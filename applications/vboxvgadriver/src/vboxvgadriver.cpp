@@ -171,7 +171,7 @@ const g_address kDefaultFbSize = 16 * 1024 * 1024;	g_ctx.fbSize = kDefaultFbSize
 	// Extra tracing to see whether we reach g_map_mmio at all.
 	klog("vboxvgadriver: mapping framebuffer phys=%p size=%u", (void*) g_ctx.fbPhys, (uint32_t) g_ctx.fbSize);
 	klog("vboxvgadriver: before g_map_mmio");
-	g_ctx.fbMapping = g_map_mmio((void*) g_ctx.fbPhys, g_ctx.fbSize);
+	g_ctx.fbMapping = g_map_mmio_c((void*) g_ctx.fbPhys, g_ctx.fbSize, G_MEMORY_CACHING_WRITE_COMBINING);
 	klog("vboxvgadriver: after g_map_mmio result=%p", g_ctx.fbMapping);
 	if(!g_ctx.fbMapping)
 	{
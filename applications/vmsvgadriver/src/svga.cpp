@@ -175,7 +175,8 @@ void svgaSetMode(uint32_t width, uint32_t height, uint32_t bpp)
 		device.fb.mapped = nullptr;
 		return;
 	}
-	device.fb.mapped = (uint32_t*) g_map_mmio((void*) device.fb.physical, device.fb.size);
+	device.fb.mapped = (uint32_t*) g_map_mmio_c((void*) device.fb.physical, device.fb.size,
+	                                              G_MEMORY_CACHING_WRITE_COMBINING);
 	klog("svga: FB mapped at %p size %u", device.fb.mapped, device.fb.size);
 }
 
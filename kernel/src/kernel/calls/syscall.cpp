@@ -26,8 +26,11 @@
 #include "kernel/calls/syscall_tasking.hpp"
 #include "kernel/calls/syscall_mutex.hpp"
 #include "kernel/calls/syscall_kernquery.hpp"
+#include "kernel/calls/syscall_ring.hpp"
 #include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/panic.hpp"
 #include "kernel/logger/logger.hpp"
 
@@ -43,6 +46,32 @@ void syscallHandle(g_task* task)
 	syscall(callId, syscallData);
 }
 
+/**
+ * Called by the SYSCALL entry routine. Performs the same switch as the interrupt
+ * handler if the current task changed during the call.
+ */
+extern "C" volatile g_processor_state* _syscallFastHandler(volatile g_processor_state* state)
+{
+	g_task* task = taskingGetCurrentTask();
+	task->state = (g_processor_state*) state;
+	clockRefresh();
+
+	syscall(state->rax, (void*) state->rdi);
+
+	auto newTask = taskingGetCurrentTask();
+	if(newTask != task)
+	{
+		taskingSaveState(task, (g_processor_state*) state);
+		taskingRestoreState(newTask);
+	}
+
+	clockArmTimer();
+
+	if(newTask != task)
+		schedulerFinishSwitch(task);
+	return newTask->state;
+}
+
 
 void syscall(uint32_t callId, void* syscallData)
 {
@@ -90,9 +119,10 @@ void syscallRegisterAll()
 	_syscallRegister(G_SYSCALL_GET_PROCESS_ID, (g_syscall_handler) syscallGetProcessId);
 	_syscallRegister(G_SYSCALL_GET_TASK_ID, (g_syscall_handler) syscallGetTaskId);
 	_syscallRegister(G_SYSCALL_GET_PROCESS_ID_FOR_TASK_ID, (g_syscall_handler) syscallGetProcessIdForTaskId);
-	_syscallRegister(G_SYSCALL_FORK, (g_syscall_handler) syscallFork);
+	_syscallRegister(G_SYSCALL_FORK, (g_syscall_handler) syscallFork, true);
 	_syscallRegister(G_SYSCALL_JOIN, (g_syscall_handler) syscallJoin);
 	_syscallRegister(G_SYSCALL_SLEEP, (g_syscall_handler) syscallSleep);
+	_syscallRegister(G_SYSCALL_SLEEP_NANOS, (g_syscall_handler) syscallSleepNanos);
 	_syscallRegister(G_SYSCALL_RELEASE_CLI_ARGUMENTS, (g_syscall_handler) syscallReleaseCliArguments);
 	_syscallRegister(G_SYSCALL_GET_WORKING_DIRECTORY, (g_syscall_handler) syscallGetWorkingDirectory);
 	_syscallRegister(G_SYSCALL_SET_WORKING_DIRECTORY, (g_syscall_handler) syscallSetWorkingDirectory);
@@ -123,10 +153,8 @@ void syscallRegisterAll()
 	_syscallRegister(G_SYSCALL_SBRK, (g_syscall_handler) syscallSbrk, true);
 
 	// Mutex
-	_syscallRegister(G_SYSCALL_USER_MUTEX_INITIALIZE, (g_syscall_handler) syscallMutexInitialize);
-	_syscallRegister(G_SYSCALL_USER_MUTEX_ACQUIRE, (g_syscall_handler) sycallMutexAcquire);
-	_syscallRegister(G_SYSCALL_USER_MUTEX_RELEASE, (g_syscall_handler) syscallMutexRelease);
-	_syscallRegister(G_SYSCALL_USER_MUTEX_DESTROY, (g_syscall_handler) syscallMutexDestroy);
+	_syscallRegister(G_SYSCALL_USER_MUTEX_WAIT, (g_syscall_handler) syscallMutexWait);
+	_syscallRegister(G_SYSCALL_USER_MUTEX_WAKE, (g_syscall_handler) syscallMutexWake);
 
 	// Messages
 	_syscallRegister(G_SYSCALL_MESSAGE_SEND, (g_syscall_handler) syscallMessageSend);
@@ -166,9 +194,14 @@ void syscallRegisterAll()
 	_syscallRegister(G_SYSCALL_CALL_VM86, (g_syscall_handler) syscallCallVm86);
 	_syscallRegister(G_SYSCALL_IRQ_CREATE_REDIRECT, (g_syscall_handler) syscallIrqCreateRedirect);
 	_syscallRegister(G_SYSCALL_AWAIT_IRQ, (g_syscall_handler) syscallAwaitIrq, true);
+	_syscallRegister(G_SYSCALL_IRQ_ALLOCATE_MSI, (g_syscall_handler) syscallIrqAllocateMsi);
 	_syscallRegister(G_SYSCALL_GET_EFI_FRAMEBUFFER, (g_syscall_handler) syscallGetEfiFramebuffer);
 
 	// Kernquery
 	_syscallRegister(G_SYSCALL_KERNQUERY, (g_syscall_handler) syscallKernQuery);
 
+	// Syscall rings
+	_syscallRegister(G_SYSCALL_RING_SETUP, (g_syscall_handler) syscallRingSetup, true);
+	_syscallRegister(G_SYSCALL_RING_ENTER, (g_syscall_handler) syscallRingEnter);
+
 }
@@ -55,6 +55,11 @@ extern g_syscall_registration* syscallRegistrations;
 void syscallHandle(g_task* task);
 void syscall(uint32_t callId, void* data);
 
+/**
+ * Entry routine for the SYSCALL instruction, see syscall_routine.asm.
+ */
+extern "C" void _syscallRoutine();
+
 /**
  * Creates the system call table.
  */
@@ -19,6 +19,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "kernel/calls/syscall_kernquery.hpp"
+#include "kernel/memory/paging.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking_directory.hpp"
 #include "kernel/utils/hashmap.hpp"
@@ -85,6 +86,35 @@ void syscallKernQuery(g_task* task, g_syscall_kernquery* data)
 
 		mutexRelease(&target->lock);
 	}
+	else if(data->command == G_KERNQUERY_TASK_FAULTS)
+	{
+		auto out = (g_kernquery_task_faults_data*) data->buffer;
+
+		g_task* target = taskingGetById(out->id);
+		if(!target || target->status == G_TASK_STATUS_DEAD)
+		{
+			data->status = G_KERNQUERY_STATUS_UNKNOWN_ID;
+			out->found = false;
+		}
+		else
+		{
+			data->status = G_KERNQUERY_STATUS_SUCCESSFUL;
+			out->found = true;
+			out->minor_faults = target->process->faults.minor;
+			out->major_faults = target->process->faults.major;
+			out->file_read_bytes = target->process->faults.fileReadBytes;
+		}
+	}
+	else if(data->command == G_KERNQUERY_MEMORY_PAGING)
+	{
+		auto out = (g_kernquery_memory_paging_data*) data->buffer;
+
+		g_paging_statistics statistics;
+		pagingGetStatistics(&statistics);
+		out->large_pages = statistics.largePages;
+		out->large_pages_split = statistics.largePagesSplit;
+		data->status = G_KERNQUERY_STATUS_SUCCESSFUL;
+	}
 	else
 	{
 		data->status = G_KERNQUERY_STATUS_ERROR;
@@ -19,11 +19,13 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "kernel/calls/syscall_memory.hpp"
+#include "kernel/memory/heap.hpp"
 #include "kernel/memory/lower_heap.hpp"
 #include "kernel/memory/memory.hpp"
 #include "kernel/memory/page_reference_tracker.hpp"
 #include "kernel/tasking/tasking_memory.hpp"
 #include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
 #include "kernel/memory/constants.hpp"
 
 #include "kernel/logger/logger.hpp"
@@ -63,35 +65,86 @@ void syscallAllocateMemory(g_task* task, g_syscall_alloc_mem* data)
 		return;
 	}
 
-	g_virtual_address mapped = addressRangePoolAllocate(task->process->virtualRangePool, pages);
+	bool contiguous = (data->flags & G_ALLOC_MEM_FLAG_CONTIGUOUS) != 0;
+	if(contiguous && task->securityLevel > G_SECURITY_LEVEL_DRIVER)
+	{
+		logInfo("%! task %i is not permitted to allocate contiguous physical memory", "syscall", task->id);
+		return;
+	}
+
+	// Areas that are mapped right away can use large pages if aligned
+	bool populate = contiguous || (data->flags & G_ALLOC_MEM_FLAG_POPULATE);
+	g_size virtualAlignment = (populate && pages >= G_PAGE_LARGE_PAGES) ? G_PAGE_LARGE_SIZE : G_PAGE_SIZE;
+	g_virtual_address mapped = addressRangePoolAllocateAligned(task->process->virtualRangePool, pages,
+	                                                           virtualAlignment);
 	if(mapped == 0)
 	{
 		logInfo("%! task %i failed to allocate a virtual address range for memory mapping", "syscall", task->id);
 		return;
 	}
 
-	g_physical_address page = 0;
-	bool failedPhysical = false;
-	for(uint32_t i = 0; i < pages; i++)
+	if(contiguous)
 	{
-		page = memoryPhysicalAllocate();
-		if(!page)
+		g_size alignment = data->alignment > G_PAGE_SIZE ? data->alignment : G_PAGE_SIZE;
+		bool below4G = (data->flags & G_ALLOC_MEM_FLAG_BELOW_4G) != 0;
+		g_physical_address base = memoryPhysicalAllocateContiguous(pages, alignment, below4G);
+		if(!base)
 		{
-			failedPhysical = true;
+			logInfo("%! task %i failed to allocate %i contiguous physical pages", "syscall", task->id, pages);
+			addressRangePoolFree(task->process->virtualRangePool, mapped);
+			return;
+		}
+
+		pagingMapRangeContiguous(task->process->pageSpace, mapped, base, pages, G_PAGE_TABLE_USER_DEFAULT,
+		                         G_PAGE_USER_DEFAULT);
+
+		data->virtualResult = (void*) mapped;
+		data->physicalResult = (void*) base;
+		return;
+	}
+
+	// Unless the caller needs the pages right away, they are populated on first access
+	if(!(data->flags & G_ALLOC_MEM_FLAG_POPULATE))
+	{
+		memoryOnDemandMapZero(task->process, mapped, pages * G_PAGE_SIZE);
+		data->virtualResult = (void*) mapped;
+		data->physicalResult = nullptr;
+		return;
+	}
+
+	g_virtual_address end = mapped + pages * G_PAGE_SIZE;
+	for(g_virtual_address large = G_ALIGN_UP(mapped, G_PAGE_LARGE_SIZE); large + G_PAGE_LARGE_SIZE <= end;
+	    large += G_PAGE_LARGE_SIZE)
+	{
+		g_physical_address phys = memoryPhysicalAllocateLarge();
+		if(!phys)
 			break;
+		for(uint32_t i = 0; i < G_PAGE_LARGE_PAGES; i++)
+			memoryZeroPage((void*) G_MEM_PHYS_TO_VIRT(phys + i * G_PAGE_SIZE));
+
+		if(!pagingMapLargePage(task->process->pageSpace, large, phys, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT))
+		{
+			for(uint32_t i = 0; i < G_PAGE_LARGE_PAGES; i++)
+				memoryPhysicalFree(phys + i * G_PAGE_SIZE);
 		}
-		pagingMapPage(mapped + i * G_PAGE_SIZE, page, G_PAGE_TABLE_USER_DEFAULT,G_PAGE_TABLE_USER_DEFAULT,
-		              G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 	}
 
-	if(failedPhysical)
+	// The remaining pages are mapped one by one
+	g_physical_address page = 0;
+	uint32_t populated = pagingMapRange(task->process->pageSpace, mapped, pages, G_PAGE_TABLE_USER_DEFAULT,
+	                                    G_PAGE_USER_DEFAULT, [&page](uint32_t)
+	{
+		page = memoryPhysicalAllocateZeroed();
+		return page;
+	});
+
+	if(populated < pages)
 	{
 		logInfo("%! ran out of physical memory during allocate-memory syscall in %i", "syscall", task->id);
-		for(uint32_t i = 0; i < pages; i++)
+		pagingUnmapRange(task->process->pageSpace, mapped, pages, [](g_virtual_address, g_physical_address phys)
 		{
-			g_physical_address page = pagingVirtualToPhysical(mapped + i * G_PAGE_SIZE);
-			memoryPhysicalFree(page);
-		}
+			memoryPhysicalFree(phys);
+		});
 		addressRangePoolFree(task->process->virtualRangePool, mapped);
 		return;
 	}
@@ -106,18 +159,18 @@ void syscallUnmap(g_task* task, g_syscall_unmap* data)
 	if(!range)
 		return;
 
-	for(uint32_t i = 0; i < range->pages; i++)
+	if(range->flags & G_PROC_VIRTUAL_RANGE_FLAG_KERNEL)
 	{
-		g_virtual_address virt = range->base + i * G_PAGE_SIZE;
-		g_physical_address page = pagingVirtualToPhysical(virt);
-		if(!page)
-			continue;
+		logInfo("%! task %i tried to unmap range %h that is used by the kernel", "syscall", task->id, range->base);
+		return;
+	}
 
-		if((range->flags & G_PROC_VIRTUAL_RANGE_FLAG_WEAK) == 0)
-			memoryPhysicalFree(page);
+	// No more pages may be populated while the range is unmapped
+	memoryOnDemandUnmapZero(task->process, range->base);
 
-		pagingUnmapPage(virt);
-	}
+	// Pages may only be freed once no other processor can access them anymore
+	bool weak = (range->flags & G_PROC_VIRTUAL_RANGE_FLAG_WEAK) != 0;
+	memoryUnmapRange(task->process->pageSpace, range->base, range->pages, !weak);
 
 	addressRangePoolFree(task->process->virtualRangePool, range->base);
 }
@@ -133,8 +186,6 @@ void syscallShareMemory(g_task* task, g_syscall_share_mem* data)
 		        data->processId);
 		return;
 	}
-	g_process* targetProcess = targetTask->process;
-	mutexAcquire(&targetProcess->lock);
 
 	g_virtual_address memory = (g_virtual_address) data->memory;
 	uint32_t pages = G_PAGE_ALIGN_UP(data->size) / G_PAGE_SIZE;
@@ -145,12 +196,57 @@ void syscallShareMemory(g_task* task, g_syscall_share_mem* data)
 		return;
 	}
 
-	g_virtual_address virtualRangeBase = addressRangePoolAllocate(targetProcess->virtualRangePool, pages,
-	                                                              G_PROC_VIRTUAL_RANGE_FLAG_NONE);
-	mutexRelease(&targetProcess->lock);
+	// The caching type of the area is kept, for example for shared framebuffers
+	uint64_t caching = pagingVirtualToPageEntry(memory) & G_PAGE_CACHING_MASK;
+
+	auto physical = (g_physical_address*) heapAllocate(sizeof(g_physical_address) * pages);
+	for(uint32_t i = 0; i < pages; i++)
+	{
+		// Lazily allocated pages must exist before they can be shared
+		g_virtual_address virt = memory + i * G_PAGE_SIZE;
+		if(!pagingVirtualToPhysical(virt))
+			memoryOnDemandHandlePageFault(task, virt);
+
+		// A copy-on-write page must be resolved and stay shared on later forks
+		if(pagingVirtualToPageEntry(virt) & G_PAGE_COPY_ON_WRITE_FLAG)
+			memoryCopyOnWriteHandlePageFault(task, virt);
+		uint64_t sourceEntry = pagingVirtualToPageEntry(virt);
+		physical[i] = sourceEntry & ~G_PAGE_ALIGN_MASK;
+
+		// Only pages that could be copied on write after a fork must be marked
+		if(physical[i] && !(sourceEntry & G_PAGE_SHARED_FLAG) && pageReferenceTrackerGet(physical[i]) > 0 &&
+		   !(pageReferenceTrackerGetFlags(physical[i]) & G_PAGE_FRAME_FLAG_PINNED))
+		{
+			pagingMapPage(virt, physical[i], G_PAGE_TABLE_USER_DEFAULT,
+			              (sourceEntry & G_PAGE_ALIGN_MASK) | G_PAGE_SHARED_FLAG, true);
+		}
+	}
 
+	targetTask = taskingGetById(data->processId);
+	if(!targetTask)
+	{
+		logInfo("%! task %i was unable to share memory with no longer existing process %i", "syscall", task->id,
+		        data->processId);
+		heapFree(physical);
+		return;
+	}
+	g_process* targetProcess = targetTask->process;
+
+	// Physically contiguous areas like framebuffers can use large pages in the target
+	bool contiguous = true;
+	for(uint32_t i = 1; i < pages && contiguous; i++)
+		contiguous = physical[i] == physical[0] + i * G_PAGE_SIZE;
+	bool large = contiguous && pages >= G_PAGE_LARGE_PAGES && !(physical[0] & G_PAGE_LARGE_ALIGN_MASK);
+
+	// The target space is edited through the direct map, without switching to it
+	mutexAcquire(&targetProcess->lock);
+	g_virtual_address virtualRangeBase = addressRangePoolAllocateAligned(targetProcess->virtualRangePool, pages,
+	                                                                     large ? G_PAGE_LARGE_SIZE : G_PAGE_SIZE,
+	                                                                     G_PROC_VIRTUAL_RANGE_FLAG_NONE);
 	if(virtualRangeBase == 0)
 	{
+		mutexRelease(&targetProcess->lock);
+		heapFree(physical);
 		logInfo(
 				"%! task %i was unable to share memory area %h of size %h with task %i because there was no free virtual range",
 				"syscall",
@@ -158,27 +254,31 @@ void syscallShareMemory(g_task* task, g_syscall_share_mem* data)
 		return;
 	}
 
-	for(uint32_t i = 0; i < pages; i++)
+	uint64_t pageFlags = G_PAGE_USER_DEFAULT | G_PAGE_SHARED_FLAG | caching;
+	uint32_t mapped;
+	if(contiguous && physical[0])
 	{
-		g_physical_address physicalAddr = pagingVirtualToPhysical(memory + i * G_PAGE_SIZE);
-
-		targetTask = taskingGetById(data->processId);
-		if(!targetTask)
+		for(uint32_t i = 0; i < pages; i++)
+			pageReferenceTrackerIncrement(physical[i]);
+		mapped = pagingMapRangeContiguous(targetProcess->pageSpace, virtualRangeBase, physical[0], pages,
+		                                  G_PAGE_TABLE_USER_DEFAULT, pageFlags);
+	}
+	else
+	{
+		mapped = pagingMapRange(targetProcess->pageSpace, virtualRangeBase, pages, G_PAGE_TABLE_USER_DEFAULT,
+		                        pageFlags, [physical](uint32_t index)
 		{
-			logInfo("%! task %i was unable to share memory with no longer existing process %i", "syscall", task->id,
-			        data->processId);
-			return;
-		}
-
-		mutexAcquire(&targetProcess->lock);
-		targetProcess = targetTask->process;
-
-		g_physical_address back = taskingMemoryTemporarySwitchTo(targetProcess->pageSpace);
-		pagingMapPage(virtualRangeBase + i * G_PAGE_SIZE, physicalAddr, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
-		taskingMemoryTemporarySwitchBack(back);
-		mutexRelease(&targetProcess->lock);
+			pageReferenceTrackerIncrement(physical[index]);
+			return physical[index];
+		});
+	}
+	mutexRelease(&targetProcess->lock);
+	heapFree(physical);
 
-		pageReferenceTrackerIncrement(physicalAddr);
+	if(mapped < pages)
+	{
+		logInfo("%! task %i shared memory area %h partially, only %i of %i pages are mapped", "syscall", task->id,
+		        memory, mapped, pages);
 	}
 
 	data->virtualAddress = (void*) virtualRangeBase;
@@ -187,26 +287,51 @@ void syscallShareMemory(g_task* task, g_syscall_share_mem* data)
 	         pages * G_PAGE_SIZE, targetProcess->main->id, virtualRangeBase);
 }
 
+/**
+ * Translates a requested caching type to the page flags selecting it. Without PAT
+ * support, write-combining falls back to uncacheable. The default sets no caching
+ * flags, as mapped areas always had.
+ */
+uint64_t _syscallMapMmioCachingFlags(g_memory_caching caching)
+{
+	switch(caching)
+	{
+		case G_MEMORY_CACHING_DEFAULT:
+		case G_MEMORY_CACHING_WRITE_BACK:
+			return G_PAGE_CACHING_WRITE_BACK;
+		case G_MEMORY_CACHING_WRITE_THROUGH:
+			return G_PAGE_CACHING_WRITE_THROUGH;
+		case G_MEMORY_CACHING_WRITE_COMBINING:
+			if(processorHasFeature(g_cpuid_standard_edx_feature::PAT))
+				return G_PAGE_CACHING_WRITE_COMBINING;
+			return G_PAGE_CACHING_UNCACHEABLE;
+		default:
+			return G_PAGE_CACHING_UNCACHEABLE;
+	}
+}
+
 void syscallMapMmioArea(g_task* task, g_syscall_map_mmio* data)
 {
 	uint32_t pages = G_PAGE_ALIGN_UP(data->size) / G_PAGE_SIZE;
 	logInfo("%! map_mmio task=%i phys=%h size=%u pages=%u", "syscall", task->id, data->physicalAddress, data->size, pages);
 
-	g_virtual_address virtualRangeBase = addressRangePoolAllocate(task->process->virtualRangePool, pages,
-	                                                              G_PROC_VIRTUAL_RANGE_FLAG_WEAK);
+	// Large device memory like framebuffers is mapped with large pages if aligned
+	bool large = pages >= G_PAGE_LARGE_PAGES && !(data->physicalAddress & G_PAGE_LARGE_ALIGN_MASK);
+	g_virtual_address virtualRangeBase = addressRangePoolAllocateAligned(task->process->virtualRangePool, pages,
+	                                                                     large ? G_PAGE_LARGE_SIZE : G_PAGE_SIZE,
+	                                                                     G_PROC_VIRTUAL_RANGE_FLAG_WEAK);
 	if(virtualRangeBase == 0)
 	{
 		logInfo("%! map_mmio task=%i failed, could not allocate virtual range (pages=%u)", "syscall", task->id, pages);
 		return;
 	}
 
-	for(uint32_t i = 0; i < pages; i++)
-	{
-		pagingMapPage(virtualRangeBase + i * G_PAGE_SIZE, data->physicalAddress + i * G_PAGE_SIZE,
-		              G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
-	}
+	uint64_t pageFlags = G_PAGE_USER_DEFAULT | _syscallMapMmioCachingFlags(data->caching);
+	pagingMapRangeContiguous(task->process->pageSpace, virtualRangeBase, data->physicalAddress, pages,
+	                         G_PAGE_TABLE_USER_DEFAULT, pageFlags);
 
 	data->virtualAddress = (void*) virtualRangeBase;
-	logInfo("%! map_mmio task=%i success virt=%h pages=%u", "syscall", task->id, virtualRangeBase, pages);
+	logInfo("%! map_mmio task=%i success virt=%h pages=%u caching=%i", "syscall", task->id, virtualRangeBase, pages,
+	        data->caching);
 }
 
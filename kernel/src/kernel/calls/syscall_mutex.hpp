@@ -24,12 +24,8 @@
 #include "kernel/tasking/tasking.hpp"
 #include <ghost/mutex/callstructs.h>
 
-void syscallMutexInitialize(g_task* task, g_syscall_user_mutex_initialize* data);
+void syscallMutexWait(g_task* task, g_syscall_user_mutex_wait* data);
 
-void sycallMutexAcquire(g_task* task, g_syscall_user_mutex_acquire* data);
-
-void syscallMutexRelease(g_task* task, g_syscall_user_mutex_release* data);
-
-void syscallMutexDestroy(g_task* task, g_syscall_user_mutex_destroy* data);
+void syscallMutexWake(g_task* task, g_syscall_user_mutex_wake* data);
 
 #endif
@@ -0,0 +1,190 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/calls/syscall_ring.hpp"
+#include "kernel/calls/syscall.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/memory/paging.hpp"
+#include "kernel/logger/logger.hpp"
+
+#include <ghost/syscall.h>
+
+void syscallRingSetup(g_task* task, g_syscall_setup_ring* data)
+{
+	data->ring = nullptr;
+
+	uint32_t entries = data->entries;
+	if(entries == 0 || entries > G_SYSCALL_RING_MAX_ENTRIES || (entries & (entries - 1)) != 0)
+	{
+		data->status = G_SYSCALL_RING_SETUP_INVALID_ENTRIES;
+		return;
+	}
+
+	g_process* process = task->process;
+	mutexAcquire(&process->lock);
+	if(process->syscallRing.ring)
+	{
+		mutexRelease(&process->lock);
+		logInfo("%! task %i tried to set up a second ring", "syscall", task->id);
+		data->status = G_SYSCALL_RING_SETUP_ALREADY_EXISTS;
+		return;
+	}
+
+	// The ring is mapped right away and can't be unmapped, the kernel must not fault on it while draining
+	uint32_t pages = G_PAGE_ALIGN_UP(G_SYSCALL_RING_SIZE(entries)) / G_PAGE_SIZE;
+	g_virtual_address mapped = addressRangePoolAllocate(process->virtualRangePool, pages,
+	                                                    G_PROC_VIRTUAL_RANGE_FLAG_KERNEL);
+	if(mapped == 0)
+	{
+		mutexRelease(&process->lock);
+		data->status = G_SYSCALL_RING_SETUP_MEMORY_ERROR;
+		return;
+	}
+
+	uint32_t populated = pagingMapRange(process->pageSpace, mapped, pages, G_PAGE_TABLE_USER_DEFAULT,
+	                                    G_PAGE_USER_DEFAULT, [](uint32_t)
+	{
+		return memoryPhysicalAllocateZeroed();
+	});
+	if(populated < pages)
+	{
+		pagingUnmapRange(process->pageSpace, mapped, pages, [](g_virtual_address, g_physical_address phys)
+		{
+			memoryPhysicalFree(phys);
+		});
+		addressRangePoolFree(process->virtualRangePool, mapped);
+		mutexRelease(&process->lock);
+		logInfo("%! ran out of physical memory during ring setup in %i", "syscall", task->id);
+		data->status = G_SYSCALL_RING_SETUP_MEMORY_ERROR;
+		return;
+	}
+
+	auto ring = (g_syscall_ring*) mapped;
+	ring->entries = entries;
+
+	process->syscallRing.ring = ring;
+	process->syscallRing.entries = entries;
+	process->syscallRing.drainer = G_TID_NONE;
+	mutexRelease(&process->lock);
+
+	data->ring = ring;
+	data->status = G_SYSCALL_RING_SETUP_SUCCESSFUL;
+}
+
+/**
+ * Makes the task the drainer of the process ring unless another living task of the
+ * process is draining it. Must be called while holding the process lock.
+ */
+static bool _syscallRingClaim(g_process* process, g_task* task)
+{
+	g_tid drainer = process->syscallRing.drainer;
+	if(drainer != G_TID_NONE)
+	{
+		g_task* other = taskingGetById(drainer);
+		if(other && other->process == process && other->status != G_TASK_STATUS_DEAD)
+			return false;
+	}
+
+	process->syscallRing.drainer = task->id;
+	return true;
+}
+
+void syscallRingEnter(g_task* task, g_syscall_enter_ring* data)
+{
+	data->processed = 0;
+
+	g_process* process = task->process;
+	mutexAcquire(&process->lock);
+	g_syscall_ring* ring = process->syscallRing.ring;
+	uint32_t entries = process->syscallRing.entries;
+	if(!ring)
+	{
+		mutexRelease(&process->lock);
+		data->status = G_SYSCALL_RING_ENTER_NO_RING;
+		return;
+	}
+
+	// Only one thread may drain at a time, the handlers below may block; a thread
+	// that was killed while draining leaves the ring to the others
+	if(!_syscallRingClaim(process, task))
+	{
+		mutexRelease(&process->lock);
+		data->status = G_SYSCALL_RING_ENTER_BUSY;
+		return;
+	}
+	mutexRelease(&process->lock);
+
+	uint32_t mask = entries - 1;
+	auto submissions = (g_syscall_ring_submission*) ((uint8_t*) ring + sizeof(g_syscall_ring));
+	auto completions = (g_syscall_ring_completion*) (submissions + entries);
+
+	uint32_t head = ring->submissionHead;
+	uint32_t tail = __atomic_load_n(&ring->submissionTail, __ATOMIC_ACQUIRE);
+	uint32_t completionTail = ring->completionTail;
+	uint32_t processed = 0;
+	while(head != tail)
+	{
+		if(completionTail - __atomic_load_n(&ring->completionHead, __ATOMIC_ACQUIRE) >= entries)
+			break;
+
+		// Copy the entry, the process could change it while the call runs
+		g_syscall_ring_submission submission = submissions[head & mask];
+		__atomic_store_n(&ring->submissionHead, ++head, __ATOMIC_RELEASE);
+
+		g_syscall_ring_status status = G_SYSCALL_RING_STATUS_UNSUPPORTED;
+		if(syscallRingIsSupported(submission.call))
+		{
+			syscall(submission.call, (void*) submission.data);
+			status = G_SYSCALL_RING_STATUS_SUCCESSFUL;
+		}
+
+		g_syscall_ring_completion* completion = &completions[completionTail & mask];
+		completion->userData = submission.userData;
+		completion->status = status;
+		completion->reserved = 0;
+		__atomic_store_n(&ring->completionTail, ++completionTail, __ATOMIC_RELEASE);
+		++processed;
+	}
+
+	mutexAcquire(&process->lock);
+	process->syscallRing.drainer = G_TID_NONE;
+	mutexRelease(&process->lock);
+
+	data->processed = processed;
+	data->status = G_SYSCALL_RING_ENTER_SUCCESSFUL;
+}
+
+bool syscallRingIsSupported(uint32_t call)
+{
+	switch(call)
+	{
+		case G_SYSCALL_FS_READ:
+		case G_SYSCALL_FS_WRITE:
+		case G_SYSCALL_MESSAGE_SEND:
+		case G_SYSCALL_MESSAGE_RECEIVE:
+		case G_SYSCALL_SLEEP:
+		case G_SYSCALL_SLEEP_NANOS:
+		case G_SYSCALL_JOIN:
+		case G_SYSCALL_USER_MUTEX_WAIT:
+			return true;
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,48 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_SYSCALL_RING__
+#define __KERNEL_SYSCALL_RING__
+
+#include "kernel/tasking/tasking.hpp"
+#include <ghost/syscall/callstructs.h>
+
+/**
+ * Maps a system call ring into the process of the task. The ring consists of a
+ * submission and a completion array that are shared with the process, so that it
+ * can queue calls without entering the kernel and have them executed in a batch.
+ */
+void syscallRingSetup(g_task* task, g_syscall_setup_ring* data);
+
+/**
+ * Executes the queued submissions of the process ring in order with the regular
+ * handlers and writes a completion for each. Stops early once the completion ring
+ * is full. Only calls for which <syscallRingIsSupported> is true are executed, all
+ * others complete with G_SYSCALL_RING_STATUS_UNSUPPORTED.
+ */
+void syscallRingEnter(g_task* task, g_syscall_enter_ring* data);
+
+/**
+ * Whether a call may be submitted through a ring. These are the calls that
+ * transfer data or wait, where the cost of entering the kernel matters.
+ */
+bool syscallRingIsSupported(uint32_t call);
+
+#endif
@@ -0,0 +1,174 @@
+;* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+;*                                                                           *
+;*  Ghost, a micro-kernel based operating system for the x86 architecture    *
+;*  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+;*                                                                           *
+;*  This program is free software: you can redistribute it and/or modify     *
+;*  it under the terms of the GNU General Public License as published by     *
+;*  the Free Software Foundation, either version 3 of the License, or        *
+;*  (at your option) any later version.                                      *
+;*                                                                           *
+;*  This program is distributed in the hope that it will be useful,          *
+;*  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+;*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+;*  GNU General Public License for more details.                             *
+;*                                                                           *
+;*  You should have received a copy of the GNU General Public License        *
+;*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+;*                                                                           *
+;* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+BITS 64
+
+;
+; Offsets within g_kernel_threadlocal, see task.hpp
+;
+%define KERNEL_THREADLOCAL_SYSCALL_STACK	0x08
+%define KERNEL_THREADLOCAL_USER_STACK		0x10
+
+;
+; Selectors as in gdt.hpp
+;
+%define USER_CODE_SELECTOR	0x23
+%define USER_DATA_SELECTOR	0x1B
+
+;
+; C handler functions
+;
+extern _syscallFastHandler
+
+;
+; Entry point for the SYSCALL instruction, its address is written to LSTAR.
+;
+; On SYSCALL the processor loads RIP from LSTAR, saves the user RIP in RCX and
+; RFLAGS in R11 and masks RFLAGS with SFMASK, so interrupts are disabled here.
+; The stack is not switched, so the first thing to do is to move to the kernel
+; stack of the task.
+;
+; The routine builds the same image on the stack as an interrupt from ring 3
+; would, so the rest of the kernel (forking, signals, task switches within the
+; call) can treat the task exactly like one that entered with "int 0x80".
+;
+global _syscallRoutine
+_syscallRoutine:
+	; Use the kernel-only copy of the thread-local address
+	swapgs
+	mov [gs:KERNEL_THREADLOCAL_USER_STACK], rsp
+	mov rsp, [gs:KERNEL_THREADLOCAL_SYSCALL_STACK]
+
+	; Imitate what the processor pushes on an interrupt
+	push qword USER_DATA_SELECTOR
+	push qword [gs:KERNEL_THREADLOCAL_USER_STACK]
+	push r11
+	push qword USER_CODE_SELECTOR
+	push rcx
+	push qword 0		; error
+	push qword 0x80		; intr
+
+	; Store general purpose
+	push rax
+	push rcx
+	push rdx
+	push rbx
+	push rbp
+	push rsi
+	push rdi
+
+	push r8
+	push r9
+	push r10
+	push r11
+	push r12
+	push r13
+	push r14
+	push r15
+
+	; Store segments
+	mov ax, ds
+	push rax
+	mov ax, es
+	push rax
+
+	; Switch to kernel segments
+	mov ax, 0x10
+	mov ds, ax
+	mov es, ax
+
+	; Remember our own image, the handler returns the state to continue with
+	mov r12, rsp
+	mov rdi, rsp
+	call _syscallFastHandler
+	mov rsp, rax
+
+	; Only return with SYSRET to exactly the image that was built above and only
+	; to a canonical address, anything else takes the regular IRETQ path
+	cmp rax, r12
+	jne .returnWithIret
+	mov rax, [rsp + 19 * 8]		; rip
+	shr rax, 47
+	jnz .returnWithIret
+
+	; Restore segments
+	pop rax
+	mov ds, ax
+	pop rax
+	mov es, ax
+
+	; Restore registers, RCX and R11 are clobbered by SYSRET
+	pop r15
+	pop r14
+	pop r13
+	pop r12
+	add rsp, 8
+	pop r10
+	pop r9
+	pop r8
+
+	pop rdi
+	pop rsi
+	pop rbp
+	pop rbx
+	pop rdx
+	add rsp, 8
+	pop rax
+
+	; Skip past the error code and interrupt number
+	add rsp, 16
+
+	mov rcx, [rsp]				; rip
+	mov r11, [rsp + 16]			; rflags
+	mov rsp, [rsp + 24]			; rsp
+
+	swapgs
+	o64 sysret
+
+.returnWithIret:
+	; Restore segments
+	pop rax
+	mov ds, ax
+	pop rax
+	mov es, ax
+
+	; Restore all registers
+	pop r15
+	pop r14
+	pop r13
+	pop r12
+	pop r11
+	pop r10
+	pop r9
+	pop r8
+
+	pop rdi
+	pop rsi
+	pop rbp
+	pop rbx
+	pop rdx
+	pop rcx
+	pop rax
+
+	; Skip past the error code and interrupt number
+	add rsp, 16
+
+	swapgs
+	iretq
@@ -24,6 +24,7 @@
 #include "kernel/tasking/clock.hpp"
 #include "kernel/filesystem/filesystem.hpp"
 #include "kernel/system/interrupts/apic/ioapic.hpp"
+#include "kernel/system/interrupts/apic/lapic.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/tasking/elf/elf_object.hpp"
 #include "kernel/utils/string.hpp"
@@ -156,17 +157,50 @@ void syscallAwaitIrq(g_task* task, g_syscall_await_irq* data)
 		return taskingExit();
 	}
 
-	requestsSetHandlerTask(data->irq, task->id);
+	if(!requestsSetHandlerTask(data->irq, task))
+	{
+		logInfo("%! task %i tried to await IRQ %i that belongs to another process", "call", task->id, data->irq);
+		return;
+	}
+
 	taskingWait(task, __func__, [data, task]()
 	{
 		if(data->timeout)
-		{
-			clockUnwaitForTime(task->id);
-			clockWaitForTime(task->id, clockGetLocal()->time + data->timeout);
-		}
+			clockWaitForTime(task, clockGetNanos() + data->timeout * 1000000ULL);
 	});
 }
 
+void syscallIrqAllocateMsi(g_task* task, g_syscall_irq_allocate_msi* data)
+{
+	if(task->securityLevel > G_SECURITY_LEVEL_DRIVER || !lapicIsAvailable())
+	{
+		data->status = G_IRQ_ALLOCATE_MSI_STATUS_NOT_PERMITTED;
+		return;
+	}
+
+	if(data->count == 0 || data->count > G_REQUESTS_MSI_MAX_COUNT || (data->count & (data->count - 1)) != 0)
+	{
+		data->status = G_IRQ_ALLOCATE_MSI_STATUS_INVALID_COUNT;
+		return;
+	}
+
+	uint8_t irq = requestsAllocateMsi(task->process->id, data->count);
+	if(!irq)
+	{
+		data->status = G_IRQ_ALLOCATE_MSI_STATUS_NO_VECTORS;
+		return;
+	}
+
+	uint64_t address;
+	uint32_t message;
+	requestsGetMsiMessage(irq, &address, &message);
+	data->irq = irq;
+	data->address = address;
+	data->data = message;
+	data->status = G_IRQ_ALLOCATE_MSI_STATUS_SUCCESSFUL;
+	logInfo("%! task %i allocated %i vectors starting at IRQ %i", "msi", task->id, data->count, irq);
+}
+
 void syscallGetEfiFramebuffer(g_task* task, g_syscall_get_efi_framebuffer* data)
 {
 	if(task->securityLevel > G_SECURITY_LEVEL_DRIVER)
@@ -40,6 +40,8 @@ void syscallIrqCreateRedirect(g_task* task, g_syscall_irq_create_redirect* data)
 
 void syscallAwaitIrq(g_task* task, g_syscall_await_irq* data);
 
+void syscallIrqAllocateMsi(g_task* task, g_syscall_irq_allocate_msi* data);
+
 void syscallGetEfiFramebuffer(g_task* task, g_syscall_get_efi_framebuffer* data);
 
 #endif
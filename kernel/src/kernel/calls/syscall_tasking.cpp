@@ -27,7 +27,6 @@
 #include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/tasking/tasking_directory.hpp"
 #include "kernel/tasking/clock.hpp"
-#include "kernel/system/timing/hpet.hpp"
 #include "kernel/utils/wait_queue.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/utils/string.hpp"
@@ -36,7 +35,15 @@ void syscallSleep(g_task* task, g_syscall_sleep* data)
 {
 	taskingWait(task, __func__, [task, data]()
 	{
-		clockWaitForTime(task->id, clockGetLocal()->time + data->milliseconds);
+		clockWaitForTime(task, clockGetNanos() + data->milliseconds * 1000000);
+	});
+}
+
+void syscallSleepNanos(g_task* task, g_syscall_sleep_nanos* data)
+{
+	taskingWait(task, __func__, [task, data]()
+	{
+		clockWaitForTime(task, clockGetNanos() + data->nanoseconds);
 	});
 }
 
@@ -124,7 +131,7 @@ void syscallSpawn(g_task* task, g_syscall_spawn* data)
 			if(data->workdir)
 				target.process->environment.workingDirectory = stringDuplicate(data->workdir);
 
-			target.process->main->status = G_TASK_STATUS_RUNNING;
+			taskingWake(target.process->main);
 		}
 	}
 	else
@@ -248,8 +255,19 @@ void syscallGetTaskEntry(g_task* task, g_syscall_get_task_entry* data)
 
 void syscallFork(g_task* task, g_syscall_fork* data)
 {
-	logInfo("syscall not implemented: fork");
-	data->forkedId = G_PID_NONE;
+	// Written before the space is cloned, so the child sees 0
+	data->forkedId = 0;
+
+	g_task* child = taskingFork(task);
+	if(!child)
+	{
+		logInfo("%! task %i failed to fork", "syscall", task->id);
+		data->forkedId = G_PID_NONE;
+		return;
+	}
+
+	data->forkedId = child->id;
+	taskingAssignBalanced(child);
 }
 
 void syscallGetParentProcessId(g_task* task, g_syscall_get_parent_pid* data)
@@ -275,10 +293,7 @@ void syscallGetMilliseconds(g_task* task, g_syscall_millis* data)
 
 void syscallGetNanoseconds(g_task* task, g_syscall_nanos* data)
 {
-	if(hpetIsAvailable())
-		data->nanos = hpetGetNanos();
-	else
-		data->nanos = clockGetLocal()->time * 1000000LL;
+	data->nanos = clockGetNanos();
 }
 
 void syscallGetExecutablePath(g_task* task, g_syscall_get_executable_path* data)
@@ -366,15 +381,15 @@ void syscallTaskAwaitByName(g_task* task, g_syscall_task_await_by_name* data)
 	{
 		taskingWait(task, __func__, [data, task]()
 		{
-			clockWaitForTime(task->id, clockGetLocal()->time + 100);
+			clockWaitForTime(task, clockGetNanos() + 100 * 1000000ULL);
 			taskingDirectoryWaitForRegister(data->name, task->id);
 		});
-		clockUnwaitForTime(task->id);
+		clockUnwaitForTime(task);
 		taskingDirectoryUnwaitForRegister(data->name, task->id);
 
 		taskingWait(task, __func__, [data, task]()
 		{
-			clockWaitForTime(task->id, clockGetLocal()->time + 500);
+			clockWaitForTime(task, clockGetNanos() + 500 * 1000000ULL);
 		});
 	}
 	data->task = target;
@@ -42,6 +42,8 @@ void syscallJoin(g_task* task, g_syscall_join* data);
 
 void syscallSleep(g_task* task, g_syscall_sleep* data);
 
+void syscallSleepNanos(g_task* task, g_syscall_sleep_nanos* data);
+
 void syscallSpawn(g_task* task, g_syscall_spawn* data);
 
 void syscallTaskGetTls(g_task* task, g_syscall_task_get_tls* data);
@@ -116,6 +116,7 @@ void filesystemCreateRoot()
 	procfsDelegate->open = filesystemProcfsDelegateOpen;
 	procfsDelegate->discover = filesystemProcfsDelegateDiscover;
 	procfsDelegate->read = filesystemProcfsDelegateRead;
+	procfsDelegate->write = filesystemProcfsDelegateWrite;
 	procfsDelegate->getLength = filesystemProcfsDelegateGetLength;
 	procfsDelegate->refreshDir = filesystemProcfsDelegateRefreshDir;
 	procfsDelegate->close = filesystemProcfsDelegateClose;
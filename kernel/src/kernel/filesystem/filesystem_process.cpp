@@ -145,6 +145,28 @@ g_fs_clonefd_status filesystemProcessCloneDescriptor(g_pid sourcePid, g_fd sourc
 	return G_FS_CLONEFD_SUCCESSFUL;
 }
 
+void filesystemProcessCloneAll(g_pid sourcePid, g_pid targetPid)
+{
+	g_filesystem_process* source = hashmapGet<g_pid, g_filesystem_process*>(filesystemProcessInfo, sourcePid, 0);
+	g_filesystem_process* target = hashmapGet<g_pid, g_filesystem_process*>(filesystemProcessInfo, targetPid, 0);
+	if(!source || !target)
+		return;
+
+	auto iter = hashmapIteratorStart<g_fd, g_file_descriptor*>(source->descriptors);
+	while(hashmapIteratorHasNext<g_fd, g_file_descriptor*>(&iter))
+	{
+		auto entry = hashmapIteratorNext<g_fd, g_file_descriptor*>(&iter);
+
+		g_fd clonedFd;
+		filesystemProcessCloneDescriptor(sourcePid, entry->key, targetPid, entry->key, &clonedFd);
+	}
+	hashmapIteratorEnd<g_fd, g_file_descriptor*>(&iter);
+
+	mutexAcquire(&source->nextDescriptorLock);
+	target->nextDescriptor = source->nextDescriptor;
+	mutexRelease(&source->nextDescriptorLock);
+}
+
 /**
  *
  */
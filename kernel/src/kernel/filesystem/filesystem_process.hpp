@@ -84,6 +84,12 @@ void filesystemProcessRemoveDescriptor(g_pid pid, g_fd fd);
 g_fs_clonefd_status filesystemProcessCloneDescriptor(g_pid sourcePid, g_fd sourceFd, g_pid targetPid, g_fd targetFd,
                                                      g_fd* outFd);
 
+/**
+ * Clones all file descriptors of a process into another process, keeping their
+ * numbers. Used when forking a process.
+ */
+void filesystemProcessCloneAll(g_pid sourcePid, g_pid targetPid);
+
 /**
  * Creates stdio for a new process (and possibly maps requested values).
  */
@@ -24,6 +24,8 @@
 #include "kernel/memory/heap.hpp"
 #include "kernel/memory/memory.hpp"
 #include "kernel/memory/constants.hpp"
+#include "kernel/memory/slab.hpp"
+#include "kernel/memory/zero_pool.hpp"
 #include "kernel/system/processor/processor.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking.hpp"
@@ -41,6 +43,10 @@ enum procfs_node_type
 	PROCFS_NODE_LOADAVG,
 	PROCFS_NODE_CPUINFO,
 	PROCFS_NODE_VERSION,
+	PROCFS_NODE_SCHEDSTAT,
+	PROCFS_NODE_LOCKSTAT,
+	PROCFS_NODE_SLABINFO,
+	PROCFS_NODE_ZEROPOOL,
 	PROCFS_NODE_PID_DIR,
 	PROCFS_NODE_PID_STAT,
 	PROCFS_NODE_PID_STATUS,
@@ -242,11 +248,11 @@ static bool procfsBuildRootFile(procfs_node_type type, procfs_buffer* buf)
 	}
 	hashmapIteratorEnd(&iter);
 
-	auto locals = taskingGetLocal();
 	for(int i = 0; i < processorGetNumberOfProcessors(); ++i)
 	{
-		if(locals[i].scheduling.idleTask)
-			idleTicks += locals[i].scheduling.idleTask->statistics.timesScheduled;
+		auto local = taskingGetLocal(i);
+		if(local->scheduling.idleTask)
+			idleTicks += local->scheduling.idleTask->statistics.timesScheduled;
 	}
 
 	uint64_t userTicks = (totalTicks >= idleTicks) ? (totalTicks - idleTicks) : 0;
@@ -299,8 +305,8 @@ static bool procfsBuildRootFile(procfs_node_type type, procfs_buffer* buf)
 
 	if(type == PROCFS_NODE_MEMINFO)
 	{
-		uint64_t totalKb = (uint64_t) memoryPhysicalAllocator.totalPageCount * G_PAGE_SIZE / 1024;
-		uint64_t freeKb = (uint64_t) memoryPhysicalAllocator.freePageCount * G_PAGE_SIZE / 1024;
+		uint64_t totalKb = memoryPhysicalAllocator.totalPageCount * G_PAGE_SIZE / 1024;
+		uint64_t freeKb = buddyAllocatorGetFreePageCount(&memoryPhysicalAllocator) * G_PAGE_SIZE / 1024;
 
 		procfsBufferAppendStr(buf, "MemTotal: ");
 		procfsBufferAppendU64(buf, totalKb);
@@ -382,6 +388,95 @@ static bool procfsBuildRootFile(procfs_node_type type, procfs_buffer* buf)
 		return true;
 	}
 
+	if(type == PROCFS_NODE_SCHEDSTAT)
+	{
+		for(int i = 0; i < processorGetNumberOfProcessors(); ++i)
+		{
+			auto local = taskingGetLocal(i);
+			procfsBufferAppendStr(buf, "cpu");
+			procfsBufferAppendU64(buf, (uint64_t) i);
+			procfsBufferAppendStr(buf, " ready ");
+			procfsBufferAppendU64(buf, local->scheduling.readyCount);
+			procfsBufferAppendStr(buf, " steals ");
+			procfsBufferAppendU64(buf, local->balancing.steals);
+			procfsBufferAppendStr(buf, " migrations ");
+			procfsBufferAppendU64(buf, local->balancing.migrations);
+			procfsBufferAppendChar(buf, '\n');
+		}
+		return true;
+	}
+
+	if(type == PROCFS_NODE_LOCKSTAT)
+	{
+		auto statistics = (g_mutex_statistics*) heapAllocate(sizeof(g_mutex_statistics) * G_MUTEX_STATISTICS_SLOTS);
+		uint32_t count = mutexGetStatistics(statistics, G_MUTEX_STATISTICS_SLOTS);
+
+		procfsBufferAppendStr(buf, "location acquires contended wait_cycles\n");
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			procfsBufferAppendStr(buf, statistics[i].location);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].acquires);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].contended);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].waitCycles);
+			procfsBufferAppendChar(buf, '\n');
+		}
+
+		heapFree(statistics);
+		return true;
+	}
+
+	if(type == PROCFS_NODE_SLABINFO)
+	{
+		g_slab_statistics statistics[G_SLAB_CLASS_COUNT];
+		uint32_t count = slabGetStatistics(statistics, G_SLAB_CLASS_COUNT);
+
+		procfsBufferAppendStr(buf, "size slabs in_use allocations frees refills flushes\n");
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			procfsBufferAppendU64(buf, statistics[i].size);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].slabs);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].objectsInUse);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].allocations);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].frees);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].refills);
+			procfsBufferAppendChar(buf, ' ');
+			procfsBufferAppendU64(buf, statistics[i].flushes);
+			procfsBufferAppendChar(buf, '\n');
+		}
+		return true;
+	}
+
+	if(type == PROCFS_NODE_ZEROPOOL)
+	{
+		g_zero_pool_statistics statistics;
+		zeroPoolGetStatistics(&statistics);
+
+		procfsBufferAppendStr(buf, "pages ");
+		procfsBufferAppendU64(buf, statistics.pages);
+		procfsBufferAppendStr(buf, "\nlow ");
+		procfsBufferAppendU64(buf, statistics.low);
+		procfsBufferAppendStr(buf, "\nhigh ");
+		procfsBufferAppendU64(buf, statistics.high);
+		procfsBufferAppendStr(buf, "\nhits ");
+		procfsBufferAppendU64(buf, statistics.hits);
+		procfsBufferAppendStr(buf, "\nmisses ");
+		procfsBufferAppendU64(buf, statistics.misses);
+		procfsBufferAppendStr(buf, "\nrefilled ");
+		procfsBufferAppendU64(buf, statistics.refilled);
+		procfsBufferAppendStr(buf, "\nreclaimed ");
+		procfsBufferAppendU64(buf, statistics.reclaimed);
+		procfsBufferAppendChar(buf, '\n');
+		return true;
+	}
+
 	if(type == PROCFS_NODE_VERSION)
 	{
 		procfsBufferAppendStr(buf, "Ghost ");
@@ -569,6 +664,14 @@ g_fs_open_status filesystemProcfsDelegateDiscover(g_fs_node* parent, const char*
 			procfsEnsureChild(parent, name, PROCFS_NODE_CPUINFO, 0, G_FS_NODE_TYPE_FILE);
 		else if(stringEquals(name, "version"))
 			procfsEnsureChild(parent, name, PROCFS_NODE_VERSION, 0, G_FS_NODE_TYPE_FILE);
+		else if(stringEquals(name, "schedstat"))
+			procfsEnsureChild(parent, name, PROCFS_NODE_SCHEDSTAT, 0, G_FS_NODE_TYPE_FILE);
+		else if(stringEquals(name, "lockstat"))
+			procfsEnsureChild(parent, name, PROCFS_NODE_LOCKSTAT, 0, G_FS_NODE_TYPE_FILE);
+		else if(stringEquals(name, "slabinfo"))
+			procfsEnsureChild(parent, name, PROCFS_NODE_SLABINFO, 0, G_FS_NODE_TYPE_FILE);
+		else if(stringEquals(name, "zeropool"))
+			procfsEnsureChild(parent, name, PROCFS_NODE_ZEROPOOL, 0, G_FS_NODE_TYPE_FILE);
 		else
 		{
 			g_pid pid = 0;
@@ -617,6 +720,10 @@ g_fs_directory_refresh_status filesystemProcfsDelegateRefreshDir(g_fs_node* node
 		procfsEnsureChild(node, "loadavg", PROCFS_NODE_LOADAVG, 0, G_FS_NODE_TYPE_FILE);
 		procfsEnsureChild(node, "cpuinfo", PROCFS_NODE_CPUINFO, 0, G_FS_NODE_TYPE_FILE);
 		procfsEnsureChild(node, "version", PROCFS_NODE_VERSION, 0, G_FS_NODE_TYPE_FILE);
+		procfsEnsureChild(node, "schedstat", PROCFS_NODE_SCHEDSTAT, 0, G_FS_NODE_TYPE_FILE);
+		procfsEnsureChild(node, "lockstat", PROCFS_NODE_LOCKSTAT, 0, G_FS_NODE_TYPE_FILE);
+		procfsEnsureChild(node, "slabinfo", PROCFS_NODE_SLABINFO, 0, G_FS_NODE_TYPE_FILE);
+		procfsEnsureChild(node, "zeropool", PROCFS_NODE_ZEROPOOL, 0, G_FS_NODE_TYPE_FILE);
 
 		auto iter = hashmapIteratorStart(taskGlobalMap);
 		while(hashmapIteratorHasNext(&iter))
@@ -710,3 +817,54 @@ g_fs_length_status filesystemProcfsDelegateGetLength(g_fs_node* node, uint64_t*
 	heapFree(content.data);
 	return G_FS_LENGTH_SUCCESSFUL;
 }
+
+/**
+ * Parses a decimal number, skipping leading whitespace.
+ *
+ * @return the position after the number or nullptr if there is none
+ */
+static const uint8_t* procfsParseNumber(const uint8_t* pos, const uint8_t* end, uint32_t* outValue)
+{
+	while(pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n'))
+		++pos;
+
+	if(pos == end || *pos < '0' || *pos > '9')
+		return nullptr;
+
+	uint32_t value = 0;
+	while(pos < end && *pos >= '0' && *pos <= '9')
+	{
+		value = value * 10 + (*pos - '0');
+		++pos;
+	}
+	*outValue = value;
+	return pos;
+}
+
+g_fs_write_status filesystemProcfsDelegateWrite(g_fs_node* node, uint8_t* buffer, uint64_t offset, uint64_t length,
+                                                int64_t* outWrote)
+{
+	(void) offset;
+	if(!node || !buffer || !outWrote)
+		return G_FS_WRITE_ERROR;
+
+	// The watermarks of the zero page pool are set by writing "<low> <high>"
+	if(procfsNodeType(node) != PROCFS_NODE_ZEROPOOL)
+		return G_FS_WRITE_NOT_SUPPORTED;
+
+	// Only drivers may decide how much memory the pool withholds
+	if(taskingGetCurrentTask()->securityLevel > G_SECURITY_LEVEL_DRIVER)
+		return G_FS_WRITE_ERROR;
+
+	uint32_t low, high;
+	const uint8_t* end = buffer + length;
+	const uint8_t* pos = procfsParseNumber(buffer, end, &low);
+	if(!pos || !procfsParseNumber(pos, end, &high))
+		return G_FS_WRITE_ERROR;
+
+	if(!zeroPoolSetWatermarks(low, high))
+		return G_FS_WRITE_ERROR;
+
+	*outWrote = length;
+	return G_FS_WRITE_SUCCESSFUL;
+}
@@ -28,6 +28,8 @@ g_fs_phys_id filesystemProcfsRootId();
 g_fs_open_status filesystemProcfsDelegateDiscover(g_fs_node* parent, const char* name, g_fs_node** outNode);
 g_fs_read_status filesystemProcfsDelegateRead(g_fs_node* node, uint8_t* buffer, uint64_t offset, uint64_t length,
                                               int64_t* outRead);
+g_fs_write_status filesystemProcfsDelegateWrite(g_fs_node* node, uint8_t* buffer, uint64_t offset, uint64_t length,
+                                                int64_t* outWrote);
 g_fs_length_status filesystemProcfsDelegateGetLength(g_fs_node* node, uint64_t* outLength);
 g_fs_close_status filesystemProcfsDelegateClose(g_fs_node* node, g_file_flag_mode openFlags);
 g_fs_directory_refresh_status filesystemProcfsDelegateRefreshDir(g_fs_node* node);
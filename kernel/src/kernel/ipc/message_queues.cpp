@@ -39,7 +39,7 @@ g_message_queue* _messageQueuesGetOrCreate(g_tid receiver);
 void messageQueuesInitialize()
 {
 	messageQueues = hashmapCreateNumeric<g_tid, g_message_queue*>(64);
-	mutexInitializeTask(&messageTxLock);
+	mutexInitializeTask(&messageTxLock, __func__);
 	mutexInitializeGlobal(&messageQueuesLock);
 }
 
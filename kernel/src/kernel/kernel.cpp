@@ -241,7 +241,7 @@ void kernelInitializationThread()
 	// 	auto task = taskingGetCurrentTask();
 	// 	taskingWait(task, __func__, [task]()
 	// 	{
-	// 		clockWaitForTime(task->id, clockGetLocal()->time + 1000);
+	// 		clockWaitForTime(task, clockGetNanos() + 1000 * 1000000ULL);
 	// 	});
 	// 	logInfo("alive...");
 	// }
@@ -23,10 +23,6 @@
 
 #include <ghost/memory/types.h>
 
-struct g_bitmap_page_allocator;
-
-extern g_bitmap_page_allocator* kernelPhysicalAllocator;
-
 /**
  * Main entry point of the kernel. The loader calls this function on the
  * bootstrap processor. The setup information structure contains information
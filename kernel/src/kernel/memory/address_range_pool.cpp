@@ -23,110 +23,354 @@
 #include "kernel/logger/logger.hpp"
 #include "kernel/panic.hpp"
 
-void addressRangePoolInitialize(g_address_range_pool* pool)
+static inline uint32_t _addressRangeHeight(g_address_range* range)
 {
-	pool->first = 0;
-	mutexInitializeGlobal(&pool->lock, __func__);
+	return range ? range->height : 0;
 }
 
-void addressRangePoolDestroy(g_address_range_pool* pool)
+static inline uint32_t _addressRangeLargestFree(g_address_range* range)
+{
+	return range ? range->largestFree : 0;
+}
+
+static inline g_address _addressRangeEnd(g_address_range* range)
 {
-	auto entry = pool->first;
-	while(entry)
+	return range->base + (g_address) range->pages * G_PAGE_SIZE;
+}
+
+/**
+ * Recalculates the height and the largest free range of a node from its children.
+ */
+static void _addressRangeUpdate(g_address_range* range)
+{
+	uint32_t leftHeight = _addressRangeHeight(range->left);
+	uint32_t rightHeight = _addressRangeHeight(range->right);
+	range->height = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+
+	uint32_t largest = range->used ? 0 : range->pages;
+	uint32_t leftFree = _addressRangeLargestFree(range->left);
+	uint32_t rightFree = _addressRangeLargestFree(range->right);
+	if(leftFree > largest)
+		largest = leftFree;
+	if(rightFree > largest)
+		largest = rightFree;
+	range->largestFree = largest;
+}
+
+static g_address_range* _addressRangeRotateLeft(g_address_range* range)
+{
+	g_address_range* right = range->right;
+	range->right = right->left;
+	right->left = range;
+	_addressRangeUpdate(range);
+	_addressRangeUpdate(right);
+	return right;
+}
+
+static g_address_range* _addressRangeRotateRight(g_address_range* range)
+{
+	g_address_range* left = range->left;
+	range->left = left->right;
+	left->right = range;
+	_addressRangeUpdate(range);
+	_addressRangeUpdate(left);
+	return left;
+}
+
+/**
+ * Updates the node and rotates it if its subtrees differ in height by more than one.
+ *
+ * @return the new root of the subtree
+ */
+static g_address_range* _addressRangeBalance(g_address_range* range)
+{
+	_addressRangeUpdate(range);
+
+	int32_t balance = (int32_t) _addressRangeHeight(range->left) - (int32_t) _addressRangeHeight(range->right);
+	if(balance > 1)
+	{
+		if(_addressRangeHeight(range->left->left) < _addressRangeHeight(range->left->right))
+			range->left = _addressRangeRotateLeft(range->left);
+		return _addressRangeRotateRight(range);
+	}
+	if(balance < -1)
 	{
-		auto next = entry->next;
-		heapFree(entry);
-		entry = next;
+		if(_addressRangeHeight(range->right->right) < _addressRangeHeight(range->right->left))
+			range->right = _addressRangeRotateRight(range->right);
+		return _addressRangeRotateLeft(range);
 	}
+	return range;
 }
 
-void addressRangePoolAddRange(g_address_range_pool* pool, g_address start, g_address end)
+static g_address_range* _addressRangeInsert(g_address_range* node, g_address_range* range)
 {
-	mutexAcquire(&pool->lock);
+	if(!node)
+	{
+		range->left = nullptr;
+		range->right = nullptr;
+		_addressRangeUpdate(range);
+		return range;
+	}
+
+	if(range->base < node->base)
+		node->left = _addressRangeInsert(node->left, range);
+	else
+		node->right = _addressRangeInsert(node->right, range);
+	return _addressRangeBalance(node);
+}
+
+static g_address_range* _addressRangeRemoveMinimum(g_address_range* node, g_address_range** outMinimum)
+{
+	if(!node->left)
+	{
+		*outMinimum = node;
+		return node->right;
+	}
 
-	g_address_range* newRange = (g_address_range*) heapAllocate(sizeof(g_address_range));
-	newRange->base = start;
-	newRange->used = false;
-	newRange->next = 0;
-	newRange->pages = (end - start) / G_PAGE_SIZE;
-	newRange->flags = 0;
+	node->left = _addressRangeRemoveMinimum(node->left, outMinimum);
+	return _addressRangeBalance(node);
+}
+
+/**
+ * Unlinks the range with the given base from the tree. The range itself is not freed.
+ */
+static g_address_range* _addressRangeRemove(g_address_range* node, g_address base)
+{
+	if(!node)
+		return nullptr;
 
-	if(pool->first == 0)
+	if(base < node->base)
 	{
-		// If the pool is empty, add it as first
-		newRange->next = 0;
-		pool->first = newRange;
+		node->left = _addressRangeRemove(node->left, base);
+	}
+	else if(base > node->base)
+	{
+		node->right = _addressRangeRemove(node->right, base);
 	}
 	else
 	{
-		// Find the last range that has a lower base than this one
-		g_address_range* lastBelow = 0;
-		g_address_range* range = pool->first;
-		while(range)
+		if(!node->left)
+			return node->right;
+		if(!node->right)
+			return node->left;
+
+		g_address_range* successor;
+		g_address_range* right = _addressRangeRemoveMinimum(node->right, &successor);
+		successor->left = node->left;
+		successor->right = right;
+		node = successor;
+	}
+	return _addressRangeBalance(node);
+}
+
+/**
+ * Updates all nodes on the path to the range with the given base after its size or
+ * state has changed.
+ */
+static void _addressRangeRefresh(g_address_range* node, g_address base)
+{
+	if(!node)
+		return;
+
+	if(base < node->base)
+		_addressRangeRefresh(node->left, base);
+	else if(base > node->base)
+		_addressRangeRefresh(node->right, base);
+	_addressRangeUpdate(node);
+}
+
+static g_address_range* _addressRangeFind(g_address_range* node, g_address base)
+{
+	while(node && node->base != base)
+		node = base < node->base ? node->left : node->right;
+	return node;
+}
+
+/**
+ * @return the range with the highest base below the given one
+ */
+static g_address_range* _addressRangePredecessor(g_address_range* node, g_address base)
+{
+	g_address_range* predecessor = nullptr;
+	while(node)
+	{
+		if(node->base < base)
 		{
-			if(range->base < newRange->base)
-			{
-				lastBelow = range;
-			}
-			range = range->next;
+			predecessor = node;
+			node = node->right;
 		}
+		else
+		{
+			node = node->left;
+		}
+	}
+	return predecessor;
+}
 
-		if(lastBelow)
+/**
+ * @return the range with the lowest base above the given one
+ */
+static g_address_range* _addressRangeSuccessor(g_address_range* node, g_address base)
+{
+	g_address_range* successor = nullptr;
+	while(node)
+	{
+		if(node->base > base)
 		{
-			// Place the new range between the lastBelow and the one after it
-			newRange->next = lastBelow->next;
-			lastBelow->next = newRange;
+			successor = node;
+			node = node->left;
 		}
 		else
 		{
-			// There was no range found that has a lower base than this,
-			// so add it as first
-			newRange->next = pool->first;
-			pool->first = newRange;
+			node = node->right;
 		}
 	}
-	mutexRelease(&pool->lock);
-
-	addressRangePoolMerge(pool);
+	return successor;
 }
 
-void addressRangePoolCloneRanges(g_address_range_pool* pool, g_address_range_pool* other)
+/**
+ * Searches the free range with the lowest address that fits the requested pages at
+ * an aligned base. Subtrees without a large enough free range are skipped, so without
+ * alignment the first candidate that is visited fits.
+ */
+static g_address_range* _addressRangeFindFit(g_address_range* node, uint32_t pages, g_size alignment,
+                                              g_address* outBase)
 {
-	mutexAcquire(&pool->lock);
+	if(!node || node->largestFree < pages)
+		return nullptr;
 
-	if(pool->first)
-		addressRangePoolReleaseRanges(pool);
+	g_address_range* fit = _addressRangeFindFit(node->left, pages, alignment, outBase);
+	if(fit)
+		return fit;
 
-	g_address_range* otherCurrent = (g_address_range*) other->first;
-	g_address_range* last = 0;
-	while(otherCurrent)
+	if(!node->used && node->pages >= pages)
 	{
-		g_address_range* newRange = (g_address_range*) heapAllocate(sizeof(g_address_range));
-		*newRange = *otherCurrent;
-		newRange->next = 0;
-
-		if(last)
-		{
-			last->next = newRange;
-			last = newRange;
-		}
-		else
+		g_address alignedBase = (node->base + (alignment - 1)) & ~((g_address) alignment - 1);
+		if(alignedBase >= node->base && alignedBase + (g_address) pages * G_PAGE_SIZE <= _addressRangeEnd(node))
 		{
-			pool->first = newRange;
-			last = newRange;
+			*outBase = alignedBase;
+			return node;
 		}
-		otherCurrent = otherCurrent->next;
 	}
 
+	return _addressRangeFindFit(node->right, pages, alignment, outBase);
+}
+
+static g_address_range* _addressRangeCreate(g_address base, uint32_t pages)
+{
+	g_address_range* range = (g_address_range*) heapAllocate(sizeof(g_address_range));
+	range->left = nullptr;
+	range->right = nullptr;
+	range->height = 1;
+	range->used = false;
+	range->base = base;
+	range->pages = pages;
+	range->largestFree = pages;
+	range->flags = 0;
+	return range;
+}
+
+/**
+ * Merges a free range with its free neighbours.
+ */
+static void _addressRangePoolCoalesce(g_address_range_pool* pool, g_address_range* range)
+{
+	g_address_range* successor = _addressRangeSuccessor(pool->root, range->base);
+	if(successor && !successor->used && _addressRangeEnd(range) == successor->base)
+	{
+		pool->root = _addressRangeRemove(pool->root, successor->base);
+		range->pages += successor->pages;
+		heapFree(successor);
+	}
+
+	g_address_range* predecessor = _addressRangePredecessor(pool->root, range->base);
+	if(predecessor && !predecessor->used && _addressRangeEnd(predecessor) == range->base)
+	{
+		pool->root = _addressRangeRemove(pool->root, range->base);
+		predecessor->pages += range->pages;
+		heapFree(range);
+		range = predecessor;
+	}
+
+	_addressRangeRefresh(pool->root, range->base);
+}
+
+static void _addressRangeRelease(g_address_range* node)
+{
+	if(!node)
+		return;
+
+	_addressRangeRelease(node->left);
+	_addressRangeRelease(node->right);
+	heapFree(node);
+}
+
+static g_address_range* _addressRangeClone(g_address_range* node)
+{
+	if(!node)
+		return nullptr;
+
+	g_address_range* clone = (g_address_range*) heapAllocate(sizeof(g_address_range));
+	*clone = *node;
+	clone->left = _addressRangeClone(node->left);
+	clone->right = _addressRangeClone(node->right);
+	return clone;
+}
+
+static void _addressRangeDump(g_address_range* node, bool onlyFree)
+{
+	if(!node)
+		return;
+
+	_addressRangeDump(node->left, onlyFree);
+	if(!onlyFree || !node->used)
+	{
+		logDebug("%#  used: %b, base: %h, pages: %i (- %h)", node->used, node->base, node->pages,
+		         _addressRangeEnd(node));
+	}
+	_addressRangeDump(node->right, onlyFree);
+}
+
+void addressRangePoolInitialize(g_address_range_pool* pool)
+{
+	pool->root = nullptr;
+	mutexInitializeGlobal(&pool->lock, __func__);
+}
+
+void addressRangePoolDestroy(g_address_range_pool* pool)
+{
+	addressRangePoolReleaseRanges(pool);
+}
+
+void addressRangePoolAddRange(g_address_range_pool* pool, g_address start, g_address end)
+{
+	mutexAcquire(&pool->lock);
+
+	g_address_range* range = _addressRangeCreate(start, (end - start) / G_PAGE_SIZE);
+	pool->root = _addressRangeInsert(pool->root, range);
+	_addressRangePoolCoalesce(pool, range);
+
 	mutexRelease(&pool->lock);
 }
 
-g_address_range* addressRangePoolGetRanges(g_address_range_pool* pool)
+void addressRangePoolCloneRanges(g_address_range_pool* pool, g_address_range_pool* other)
 {
-	return pool->first;
+	mutexAcquire(&pool->lock);
+
+	if(pool->root)
+		addressRangePoolReleaseRanges(pool);
+	pool->root = _addressRangeClone(other->root);
+
+	mutexRelease(&pool->lock);
 }
 
 g_address addressRangePoolAllocate(g_address_range_pool* pool, uint32_t requestedPages, uint8_t flags)
+{
+	return addressRangePoolAllocateAligned(pool, requestedPages, G_PAGE_SIZE, flags);
+}
+
+g_address addressRangePoolAllocateAligned(g_address_range_pool* pool, uint32_t requestedPages, g_size alignment,
+                                          uint8_t flags)
 {
 	if(pool == 0)
 		panic("%! tried to access null pool", "addrpool");
@@ -138,33 +382,36 @@ g_address addressRangePoolAllocate(g_address_range_pool* pool, uint32_t requeste
 		requestedPages = 1;
 	}
 
-	// Find an unused range that has more/equal requested pages
-	g_address_range* range = pool->first;
-	while(range)
-	{
-		if(!range->used && range->pages >= requestedPages)
-			break;
-
-		range = range->next;
-	}
-
+	g_address alignedBase = 0;
+	g_address_range* range = _addressRangeFindFit(pool->root, requestedPages, alignment, &alignedBase);
 	if(range)
 	{
+		// The unaligned part before the base stays free
+		if(alignedBase != range->base)
+		{
+			uint32_t skippedPages = (alignedBase - range->base) / G_PAGE_SIZE;
+			g_address_range* aligned = _addressRangeCreate(alignedBase, range->pages - skippedPages);
+			range->pages = skippedPages;
+			_addressRangeRefresh(pool->root, range->base);
+			pool->root = _addressRangeInsert(pool->root, aligned);
+			range = aligned;
+		}
+
 		range->used = true;
 		range->flags = flags;
 
 		int32_t remainingPages = range->pages - requestedPages;
 		if(remainingPages > 0)
 		{
-			g_address_range* splinter = (g_address_range*) heapAllocate(sizeof(g_address_range));
-			splinter->used = false;
-			splinter->pages = remainingPages;
-			splinter->base = range->base + requestedPages * G_PAGE_SIZE;
-			splinter->flags = 0;
-
-			splinter->next = range->next;
-			range->next = splinter;
 			range->pages = requestedPages;
+			_addressRangeRefresh(pool->root, range->base);
+
+			g_address_range* splinter = _addressRangeCreate(_addressRangeEnd(range), remainingPages);
+			pool->root = _addressRangeInsert(pool->root, splinter);
+		}
+		else
+		{
+			_addressRangeRefresh(pool->root, range->base);
 		}
 
 		mutexRelease(&pool->lock);
@@ -183,16 +430,7 @@ int32_t addressRangePoolFree(g_address_range_pool* pool, g_address base)
 
 	int32_t freedPages = -1;
 
-	g_address_range* range = pool->first;
-	while(range)
-	{
-		if(range->base == base)
-		{
-			break;
-		}
-		range = range->next;
-	}
-
+	g_address_range* range = _addressRangeFind(pool->root, base);
 	if(!range)
 	{
 		logInfo("%! bug: tried to free a range (%h) that doesn't exist", "addrpool", base);
@@ -208,82 +446,34 @@ int32_t addressRangePoolFree(g_address_range_pool* pool, g_address base)
 
 	range->used = false;
 	freedPages = range->pages;
-	addressRangePoolMerge(pool);
+	_addressRangePoolCoalesce(pool, range);
 
 	mutexRelease(&pool->lock);
 	return freedPages;
 }
 
-void addressRangePoolMerge(g_address_range_pool* pool)
-{
-	g_address_range* current = (g_address_range*) pool->first;
-
-	while(current && current->next)
-	{
-		if(!current->used && !current->next->used && (
-			   (current->base + current->pages * G_PAGE_SIZE) == current->next->base))
-		{
-			current->pages += current->next->pages;
-
-			g_address_range* nextnext = current->next->next;
-			heapFree(current->next);
-			current->next = nextnext;
-		}
-		else
-		{
-			current = current->next;
-		}
-	}
-}
-
 void addressRangePoolDump(g_address_range_pool* pool, bool onlyFree)
 {
 	logDebug("%! range structure:", "vra");
-	if(pool->first == 0)
+	if(pool->root == 0)
 	{
-		logDebug("%#  cannot dump, no first entry");
+		logDebug("%#  cannot dump, no ranges");
 		return;
 	}
 
-	g_address_range* current = (g_address_range*) pool->first;
-	while(current)
-	{
-		if(!onlyFree || !current->used)
-		{
-			logDebug("%#  used: %b, base: %h, pages: %i (- %h)", current->used, current->base, current->pages,
-			         current->base + current->pages * G_PAGE_SIZE);
-		}
-		current = current->next;
-	}
+	_addressRangeDump(pool->root, onlyFree);
 }
 
 void addressRangePoolReleaseRanges(g_address_range_pool* pool)
 {
-	g_address_range* range = pool->first;
-	while(range)
-	{
-		g_address_range* next = range->next;
-		heapFree(range);
-		range = next;
-	}
-	pool->first = 0;
+	_addressRangeRelease(pool->root);
+	pool->root = 0;
 }
 
 g_address_range* addressRangePoolFind(g_address_range_pool* pool, g_address base)
 {
 	mutexAcquire(&pool->lock);
-
-	g_address_range* range = pool->first;
-	while(range)
-	{
-		if(range->base == base)
-		{
-			break;
-		}
-		range = range->next;
-	}
-
+	g_address_range* range = _addressRangeFind(pool->root, base);
 	mutexRelease(&pool->lock);
-
 	return range;
 }
@@ -24,9 +24,23 @@
 #include "kernel/system/mutex.hpp"
 #include <ghost/memory/types.h>
 
+/**
+ * A range of virtual memory in the pool, either free or used. The ranges are the
+ * nodes of an AVL tree ordered by their base, where each node knows the size of the
+ * largest free range in its subtree. This allows to find a free range and its
+ * neighbours in logarithmic time.
+ */
 struct g_address_range
 {
-	g_address_range* next;
+	g_address_range* left;
+	g_address_range* right;
+	uint32_t height;
+
+	/**
+	 * Number of pages of the largest free range in this subtree.
+	 */
+	uint32_t largestFree;
+
 	bool used;
 	g_address base;
 	uint32_t pages;
@@ -35,7 +49,7 @@ struct g_address_range
 
 struct g_address_range_pool
 {
-	g_address_range* first;
+	g_address_range* root;
 	g_mutex lock;
 };
 
@@ -43,20 +57,34 @@ void addressRangePoolInitialize(g_address_range_pool* pool);
 
 void addressRangePoolDestroy(g_address_range_pool* pool);
 
+/**
+ * Adds a free range to the pool. It must not overlap any range of the pool.
+ */
 void addressRangePoolAddRange(g_address_range_pool* pool, g_address start, g_address end);
 
 void addressRangePoolCloneRanges(g_address_range_pool* pool, g_address_range_pool* other);
 
 void addressRangePoolReleaseRanges(g_address_range_pool* pool);
 
-void addressRangePoolMerge(g_address_range_pool* pool);
-
+/**
+ * Allocates the free range with the lowest address that has enough pages.
+ */
 g_address addressRangePoolAllocate(g_address_range_pool* pool, uint32_t pages, uint8_t flags = 0);
 
+/**
+ * Allocates a range whose base is aligned to the given power of two, for example
+ * so that it can be mapped with large pages.
+ */
+g_address addressRangePoolAllocateAligned(g_address_range_pool* pool, uint32_t pages, g_size alignment,
+                                          uint8_t flags = 0);
+
+/**
+ * Frees the used range at the given base and merges it with free neighbours.
+ *
+ * @return the number of pages of the range or -1 if there is no such used range
+ */
 int32_t addressRangePoolFree(g_address_range_pool* pool, g_address base);
 
-g_address_range* addressRangePoolGetRanges(g_address_range_pool* pool);
-
 g_address_range* addressRangePoolFind(g_address_range_pool* pool, g_address base);
 
 void addressRangePoolDump(g_address_range_pool* pool, bool onlyFree = false);
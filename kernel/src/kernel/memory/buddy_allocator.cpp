@@ -0,0 +1,381 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/memory/buddy_allocator.hpp"
+#include "kernel/memory/constants.hpp"
+#include "kernel/memory/heap.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/system.hpp"
+#include "kernel/logger/logger.hpp"
+#include "kernel/panic.hpp"
+
+#define G_BUDDY_BLOCK_SIZE(order) (G_PAGE_SIZE << (order))
+
+g_physical_address _buddyAllocatorEarlyAllocate(limine_memmap_response* memoryMap, uint64_t pages);
+void _buddyAllocatorAddRange(g_buddy_allocator* allocator, g_physical_address start, g_physical_address end);
+g_physical_address _buddyZoneAllocate(g_buddy_allocator* allocator, g_buddy_zone* zone, uint32_t order);
+void _buddyZoneFree(g_buddy_allocator* allocator, g_buddy_zone* zone, g_physical_address block, uint32_t order);
+void _buddyCacheRefill(g_buddy_allocator* allocator, g_buddy_cache* cache);
+void _buddyCacheFlush(g_buddy_allocator* allocator, g_buddy_cache* cache);
+
+static g_buddy_zone* _buddyZoneOf(g_buddy_allocator* allocator, g_physical_address address)
+{
+	return &allocator->zones[address < G_BUDDY_DMA32_LIMIT ? G_BUDDY_ZONE_DMA32 : G_BUDDY_ZONE_NORMAL];
+}
+
+void buddyAllocatorInitialize(g_buddy_allocator* allocator, limine_memmap_response* memoryMap)
+{
+	for(int i = 0; i < G_BUDDY_ZONE_COUNT; i++)
+	{
+		g_buddy_zone* zone = &allocator->zones[i];
+		mutexInitializeGlobal(&zone->lock, __func__);
+		for(int order = 0; order <= G_BUDDY_MAX_ORDER; order++)
+		{
+			zone->freeLists[order] = nullptr;
+			zone->freeBlocks[order] = 0;
+		}
+		zone->freePages = 0;
+		zone->totalPages = 0;
+	}
+	allocator->caches = nullptr;
+	allocator->totalPageCount = 0;
+
+	g_physical_address highest = 0;
+	for(uint64_t i = 0; i < memoryMap->entry_count; i++)
+	{
+		auto entry = memoryMap->entries[i];
+		if(entry->type == LIMINE_MEMMAP_USABLE && entry->base + entry->length > highest)
+			highest = entry->base + entry->length;
+	}
+
+	// Frame states are needed before any range can be added
+	allocator->frameCount = G_PAGE_ALIGN_DOWN(highest) / G_PAGE_SIZE;
+	uint64_t statePages = G_PAGE_ALIGN_UP(allocator->frameCount * sizeof(g_page_frame)) / G_PAGE_SIZE;
+	allocator->frames = (g_page_frame*) G_MEM_PHYS_TO_VIRT(_buddyAllocatorEarlyAllocate(memoryMap, statePages));
+	for(uint64_t i = 0; i < allocator->frameCount; i++)
+	{
+		allocator->frames[i].state = G_BUDDY_FRAME_UNMANAGED;
+		allocator->frames[i].flags = 0;
+		allocator->frames[i].referenceCount = 0;
+	}
+
+	for(uint64_t i = 0; i < memoryMap->entry_count; i++)
+	{
+		auto entry = memoryMap->entries[i];
+		if(entry->type != LIMINE_MEMMAP_USABLE)
+			continue;
+
+		g_physical_address start = G_PAGE_ALIGN_UP(entry->base);
+		g_physical_address end = G_PAGE_ALIGN_DOWN(entry->base + entry->length);
+		if(start < G_MEM_LOWER_END)
+			start = G_MEM_LOWER_END;
+		if(start >= end)
+			continue;
+
+		if(start < G_BUDDY_DMA32_LIMIT && end > G_BUDDY_DMA32_LIMIT)
+		{
+			_buddyAllocatorAddRange(allocator, start, G_BUDDY_DMA32_LIMIT);
+			start = G_BUDDY_DMA32_LIMIT;
+		}
+		_buddyAllocatorAddRange(allocator, start, end);
+	}
+}
+
+/**
+ * Early allocation function that modifies the memory map to simply cut off the
+ * requested amount of pages from one of the usable areas. Does not use the
+ * lower memory area.
+ */
+g_physical_address _buddyAllocatorEarlyAllocate(limine_memmap_response* memoryMap, uint64_t pages)
+{
+	uint64_t allocatedSize = pages * G_PAGE_SIZE;
+
+	for(uint64_t i = 0; i < memoryMap->entry_count; i++)
+	{
+		auto entry = memoryMap->entries[i];
+		if(entry->type != LIMINE_MEMMAP_USABLE)
+			continue;
+
+		if(entry->base >= G_MEM_LOWER_END && entry->length > allocatedSize)
+		{
+			g_physical_address address = G_PAGE_ALIGN_DOWN(entry->base + entry->length - allocatedSize);
+			entry->length = address - entry->base;
+			return address;
+		}
+	}
+
+	panic("%! failed to allocate %i physical pages", "buddy", pages);
+}
+
+/**
+ * Splits the range into the largest naturally aligned blocks and adds them to
+ * the free lists of their zone.
+ */
+void _buddyAllocatorAddRange(g_buddy_allocator* allocator, g_physical_address start, g_physical_address end)
+{
+	g_buddy_zone* zone = _buddyZoneOf(allocator, start);
+
+	while(start < end)
+	{
+		uint32_t order = G_BUDDY_MAX_ORDER;
+		while(order > 0 && ((start & (G_BUDDY_BLOCK_SIZE(order) - 1)) || start + G_BUDDY_BLOCK_SIZE(order) > end))
+			order--;
+
+		for(uint64_t frame = 0; frame < (1ULL << order); frame++)
+			allocator->frames[start / G_PAGE_SIZE + frame].state = G_BUDDY_FRAME_USED;
+		_buddyZoneFree(allocator, zone, start, order);
+
+		zone->totalPages += 1ULL << order;
+		allocator->totalPageCount += 1ULL << order;
+		start += G_BUDDY_BLOCK_SIZE(order);
+	}
+}
+
+static void _buddyListPush(g_buddy_allocator* allocator, g_buddy_zone* zone, g_physical_address block, uint32_t order)
+{
+	auto entry = (g_buddy_free_block*) G_MEM_PHYS_TO_VIRT(block);
+	entry->previous = nullptr;
+	entry->next = zone->freeLists[order];
+	if(entry->next)
+		entry->next->previous = entry;
+	zone->freeLists[order] = entry;
+
+	allocator->frames[block / G_PAGE_SIZE].state = G_BUDDY_FRAME_FREE | order;
+	zone->freeBlocks[order]++;
+	zone->freePages += 1ULL << order;
+}
+
+static void _buddyListRemove(g_buddy_allocator* allocator, g_buddy_zone* zone, g_physical_address block, uint32_t order)
+{
+	auto entry = (g_buddy_free_block*) G_MEM_PHYS_TO_VIRT(block);
+	if(entry->previous)
+		entry->previous->next = entry->next;
+	else
+		zone->freeLists[order] = entry->next;
+	if(entry->next)
+		entry->next->previous = entry->previous;
+
+	allocator->frames[block / G_PAGE_SIZE].state = G_BUDDY_FRAME_USED;
+	zone->freeBlocks[order]--;
+	zone->freePages -= 1ULL << order;
+}
+
+g_physical_address _buddyZoneAllocate(g_buddy_allocator* allocator, g_buddy_zone* zone, uint32_t order)
+{
+	uint32_t current = order;
+	while(current <= G_BUDDY_MAX_ORDER && !zone->freeLists[current])
+		current++;
+	if(current > G_BUDDY_MAX_ORDER)
+		return 0;
+
+	g_physical_address block = (g_address) zone->freeLists[current] - G_MEM_HIGHER_HALF_DIRECT_MAP_OFFSET;
+	_buddyListRemove(allocator, zone, block, current);
+
+	// Give back the upper halves until the block has the requested size
+	while(current > order)
+	{
+		current--;
+		_buddyListPush(allocator, zone, block + G_BUDDY_BLOCK_SIZE(current), current);
+	}
+	return block;
+}
+
+void _buddyZoneFree(g_buddy_allocator* allocator, g_buddy_zone* zone, g_physical_address block, uint32_t order)
+{
+	while(order < G_BUDDY_MAX_ORDER)
+	{
+		g_physical_address buddy = block ^ G_BUDDY_BLOCK_SIZE(order);
+		uint64_t buddyFrame = buddy / G_PAGE_SIZE;
+		if(buddyFrame >= allocator->frameCount || allocator->frames[buddyFrame].state != (G_BUDDY_FRAME_FREE | order))
+			break;
+
+		_buddyListRemove(allocator, zone, buddy, order);
+		block &= ~G_BUDDY_BLOCK_SIZE(order);
+		order++;
+	}
+	_buddyListPush(allocator, zone, block, order);
+}
+
+void buddyAllocatorInitializeCaches(g_buddy_allocator* allocator)
+{
+	uint32_t count = processorGetNumberOfProcessors();
+	auto caches = (g_buddy_cache*) heapAllocate(sizeof(g_buddy_cache) * count);
+	for(uint32_t i = 0; i < count; i++)
+		caches[i].count = 0;
+	allocator->caches = caches;
+}
+
+g_physical_address buddyAllocatorAllocate(g_buddy_allocator* allocator, uint32_t order, uint32_t flags)
+{
+	if(order > G_BUDDY_MAX_ORDER)
+		return 0;
+
+	// The processor id is only reliable once the system is ready
+	if(order == 0 && !(flags & G_BUDDY_ALLOCATE_BELOW_4G) && allocator->caches && systemIsReady())
+	{
+		g_physical_address page = 0;
+
+		INTERRUPTS_PAUSE;
+		g_buddy_cache* cache = &allocator->caches[processorGetCurrentId()];
+		if(cache->count == 0)
+			_buddyCacheRefill(allocator, cache);
+		if(cache->count > 0)
+			page = cache->pages[--cache->count];
+		INTERRUPTS_RESUME;
+
+		return page;
+	}
+
+	// Memory above 4 GiB is preferred to keep the lower zone for devices
+	for(int i = G_BUDDY_ZONE_COUNT - 1; i >= 0; i--)
+	{
+		if(i != G_BUDDY_ZONE_DMA32 && (flags & G_BUDDY_ALLOCATE_BELOW_4G))
+			continue;
+
+		g_buddy_zone* zone = &allocator->zones[i];
+		mutexAcquire(&zone->lock);
+		g_physical_address block = _buddyZoneAllocate(allocator, zone, order);
+		mutexRelease(&zone->lock);
+
+		if(block)
+			return block;
+	}
+	return 0;
+}
+
+g_physical_address buddyAllocatorAllocateContiguous(g_buddy_allocator* allocator, uint32_t pages, g_size alignment,
+                                                    uint32_t flags)
+{
+	if(pages == 0)
+		return 0;
+
+	uint32_t order = 0;
+	while((1ULL << order) < pages || G_BUDDY_BLOCK_SIZE(order) < alignment)
+	{
+		if(++order > G_BUDDY_MAX_ORDER)
+			return 0;
+	}
+
+	g_physical_address block = buddyAllocatorAllocate(allocator, order, flags);
+	if(!block)
+		return 0;
+
+	// Give back the pages beyond the requested amount in the largest possible blocks
+	uint64_t total = 1ULL << order;
+	uint64_t offset = pages;
+	if(offset < total)
+	{
+		g_buddy_zone* zone = _buddyZoneOf(allocator, block);
+		mutexAcquire(&zone->lock);
+		while(offset < total)
+		{
+			uint32_t tailOrder = 0;
+			while(!(offset & (1ULL << tailOrder)))
+				tailOrder++;
+			_buddyZoneFree(allocator, zone, block + offset * G_PAGE_SIZE, tailOrder);
+			offset += 1ULL << tailOrder;
+		}
+		mutexRelease(&zone->lock);
+	}
+	return block;
+}
+
+void buddyAllocatorFree(g_buddy_allocator* allocator, g_physical_address address, uint32_t order)
+{
+	if(G_PAGE_ALIGN_DOWN(address) != address)
+		panic("%! attempted to free unaligned physical address %x", "buddy", address);
+
+	uint64_t frame = address / G_PAGE_SIZE;
+	if(frame >= allocator->frameCount || allocator->frames[frame].state != G_BUDDY_FRAME_USED)
+	{
+		logWarn("%! failed to free physical address %x", "buddy", address);
+		return;
+	}
+
+	if(order == 0 && allocator->caches && systemIsReady())
+	{
+		INTERRUPTS_PAUSE;
+		g_buddy_cache* cache = &allocator->caches[processorGetCurrentId()];
+		if(cache->count == G_BUDDY_CACHE_SIZE)
+			_buddyCacheFlush(allocator, cache);
+		cache->pages[cache->count++] = address;
+		INTERRUPTS_RESUME;
+		return;
+	}
+
+	g_buddy_zone* zone = _buddyZoneOf(allocator, address);
+	mutexAcquire(&zone->lock);
+	_buddyZoneFree(allocator, zone, address, order);
+	mutexRelease(&zone->lock);
+}
+
+void _buddyCacheRefill(g_buddy_allocator* allocator, g_buddy_cache* cache)
+{
+	for(int i = G_BUDDY_ZONE_COUNT - 1; i >= 0 && cache->count < G_BUDDY_CACHE_BATCH; i--)
+	{
+		g_buddy_zone* zone = &allocator->zones[i];
+		mutexAcquire(&zone->lock);
+		while(cache->count < G_BUDDY_CACHE_BATCH)
+		{
+			g_physical_address page = _buddyZoneAllocate(allocator, zone, 0);
+			if(!page)
+				break;
+			cache->pages[cache->count++] = page;
+		}
+		mutexRelease(&zone->lock);
+	}
+}
+
+void _buddyCacheFlush(g_buddy_allocator* allocator, g_buddy_cache* cache)
+{
+	g_buddy_zone* locked = nullptr;
+	while(cache->count > G_BUDDY_CACHE_SIZE - G_BUDDY_CACHE_BATCH)
+	{
+		g_physical_address page = cache->pages[--cache->count];
+		g_buddy_zone* zone = _buddyZoneOf(allocator, page);
+		if(zone != locked)
+		{
+			if(locked)
+				mutexRelease(&locked->lock);
+			mutexAcquire(&zone->lock);
+			locked = zone;
+		}
+		_buddyZoneFree(allocator, zone, page, 0);
+	}
+	if(locked)
+		mutexRelease(&locked->lock);
+}
+
+uint64_t buddyAllocatorGetFreePageCount(g_buddy_allocator* allocator)
+{
+	uint64_t free = 0;
+	for(int i = 0; i < G_BUDDY_ZONE_COUNT; i++)
+		free += allocator->zones[i].freePages;
+
+	if(allocator->caches)
+	{
+		uint32_t processors = processorGetNumberOfProcessors();
+		for(uint32_t i = 0; i < processors; i++)
+			free += allocator->caches[i].count;
+	}
+	return free;
+}
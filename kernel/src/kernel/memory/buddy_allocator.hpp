@@ -0,0 +1,140 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_MEMORY_BUDDY_ALLOCATOR__
+#define __KERNEL_MEMORY_BUDDY_ALLOCATOR__
+
+#include "kernel/memory/page_frame.hpp"
+#include "kernel/system/mutex.hpp"
+#include <ghost/memory/types.h>
+#include <limine.h>
+
+/**
+ * Largest block order, blocks of this order are 4 MiB. Blocks never cross the
+ * 4 GiB boundary because it is aligned to the largest block size.
+ */
+#define G_BUDDY_MAX_ORDER 10
+
+#define G_BUDDY_ZONE_DMA32 0
+#define G_BUDDY_ZONE_NORMAL 1
+#define G_BUDDY_ZONE_COUNT 2
+#define G_BUDDY_DMA32_LIMIT 0x100000000ULL
+
+/**
+ * Number of single pages each processor caches and how many are moved between
+ * the cache and the zones at once.
+ */
+#define G_BUDDY_CACHE_SIZE 64
+#define G_BUDDY_CACHE_BATCH (G_BUDDY_CACHE_SIZE / 2)
+
+/**
+ * State of a physical frame. Only the first frame of a free block is marked as
+ * free and holds the order of the block.
+ */
+#define G_BUDDY_FRAME_USED 0x00
+#define G_BUDDY_FRAME_UNMANAGED 0x40
+#define G_BUDDY_FRAME_FREE 0x80
+#define G_BUDDY_FRAME_ORDER_MASK 0x0F
+
+/**
+ * Allocation flags
+ */
+#define G_BUDDY_ALLOCATE_BELOW_4G 1
+
+/**
+ * Stored in the first page of each free block, accessed through the higher
+ * half direct map.
+ */
+struct g_buddy_free_block
+{
+	g_buddy_free_block* next;
+	g_buddy_free_block* previous;
+};
+
+struct g_buddy_zone
+{
+	g_mutex lock;
+	g_buddy_free_block* freeLists[G_BUDDY_MAX_ORDER + 1];
+	uint64_t freeBlocks[G_BUDDY_MAX_ORDER + 1];
+	uint64_t freePages;
+	uint64_t totalPages;
+};
+
+/**
+ * Per-processor cache of single pages. Only accessed by its processor with
+ * interrupts disabled, so it needs no lock.
+ */
+struct g_buddy_cache
+{
+	uint32_t count;
+	g_physical_address pages[G_BUDDY_CACHE_SIZE];
+};
+
+struct g_buddy_allocator
+{
+	g_page_frame* frames;
+	uint64_t frameCount;
+	uint64_t totalPageCount;
+
+	g_buddy_zone zones[G_BUDDY_ZONE_COUNT];
+	g_buddy_cache* caches;
+};
+
+/**
+ * Initializes the allocator with all usable areas of the memory map. The frame
+ * descriptor array is cut off from the memory map, memory below 1 MiB is not used.
+ */
+void buddyAllocatorInitialize(g_buddy_allocator* allocator, limine_memmap_response* memoryMap);
+
+/**
+ * Creates the per-processor caches once the number of processors is known. They
+ * are used as soon as the system is ready.
+ */
+void buddyAllocatorInitializeCaches(g_buddy_allocator* allocator);
+
+/**
+ * Allocates a block of 2^order pages that is aligned to its own size.
+ *
+ * @return the physical address or 0 if no such block is available
+ */
+g_physical_address buddyAllocatorAllocate(g_buddy_allocator* allocator, uint32_t order, uint32_t flags = 0);
+
+/**
+ * Allocates a physically contiguous range of pages. Pages beyond the requested
+ * amount are immediately given back, so the pages can later be freed one by one.
+ *
+ * @param alignment
+ * 		required alignment in bytes, a power of two
+ * @return the physical address or 0 if no such range is available
+ */
+g_physical_address buddyAllocatorAllocateContiguous(g_buddy_allocator* allocator, uint32_t pages, g_size alignment,
+                                                    uint32_t flags = 0);
+
+/**
+ * Frees a block of 2^order pages and merges it with its free buddies.
+ */
+void buddyAllocatorFree(g_buddy_allocator* allocator, g_physical_address address, uint32_t order = 0);
+
+/**
+ * @return number of free pages, including those in the processor caches
+ */
+uint64_t buddyAllocatorGetFreePageCount(g_buddy_allocator* allocator);
+
+#endif
@@ -51,8 +51,8 @@
 #define G_MEM_KERN_VIRT_RANGES_START			    0xffffff8090000000
 #define G_MEM_KERN_VIRT_RANGES_END			        0xffffff89ffc00000
 #define G_MEM_HEAP_START                            0xffffff8a00000000
-#define G_MEM_HEAP_INITIAL_SIZE                     0x100000
-#define G_MEM_KERN_HEAP_EXPAND_STEP			    	0x100000
+#define G_MEM_HEAP_INITIAL_SIZE                     0x200000
+#define G_MEM_KERN_HEAP_EXPAND_STEP			    	0x200000
 
 
 #endif
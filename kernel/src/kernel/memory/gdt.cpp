@@ -60,12 +60,13 @@ void gdtInitializeLocal()
 	_gdtWriteEntry(&localGdt->entry[2], 0, 0xFFFFFFFF, G_ACCESS_BYTE__KERNEL_DATA_SEGMENT,
 	               G_GDT_GRANULARITY_4KB | G_GDT_GRANULARITY_64BIT);
 
-	// User code segment descriptor, position 0x18
-	_gdtWriteEntry(&localGdt->entry[3], 0, 0xFFFFFFFF, G_ACCESS_BYTE__USER_CODE_SEGMENT,
+	// User data segment descriptor, position 0x18
+	// SYSRET requires the user data segment to directly precede the user code segment
+	_gdtWriteEntry(&localGdt->entry[3], 0, 0xFFFFFFFF, G_ACCESS_BYTE__USER_DATA_SEGMENT,
 	               G_GDT_GRANULARITY_4KB | G_GDT_GRANULARITY_64BIT);
 
-	// User data segment descriptor, position 0x20
-	_gdtWriteEntry(&localGdt->entry[4], 0, 0xFFFFFFFF, G_ACCESS_BYTE__USER_DATA_SEGMENT,
+	// User code segment descriptor, position 0x20
+	_gdtWriteEntry(&localGdt->entry[4], 0, 0xFFFFFFFF, G_ACCESS_BYTE__USER_CODE_SEGMENT,
 	               G_GDT_GRANULARITY_4KB | G_GDT_GRANULARITY_64BIT);
 
 	// TSS descriptor, position 0x28
@@ -110,6 +111,9 @@ void gdtSetTlsAddresses(g_user_threadlocal* userThreadLocal, g_kernel_threadloca
 
 	auto kernelAddress = (g_address) kernelThreadLocal;
 	processorWriteMsr(0xC0000101, kernelAddress & 0xFFFFFFFF, kernelAddress >> 32);
+
+	// The SYSCALL entry swaps this copy in, so it can't be tampered with from user space
+	processorWriteMsr(0xC0000102, kernelAddress & 0xFFFFFFFF, kernelAddress >> 32);
 }
 
 void _gdtWriteEntry(g_gdt_descriptor* entry, uint64_t base, uint64_t limit, uint8_t access, uint8_t granularity)
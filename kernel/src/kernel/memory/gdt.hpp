@@ -86,8 +86,8 @@
  */
 #define G_GDT_DESCRIPTOR_KERNEL_CODE        0x08
 #define G_GDT_DESCRIPTOR_KERNEL_DATA        0x10
-#define G_GDT_DESCRIPTOR_USER_CODE          0x18
-#define G_GDT_DESCRIPTOR_USER_DATA          0x20
+#define G_GDT_DESCRIPTOR_USER_DATA          0x18
+#define G_GDT_DESCRIPTOR_USER_CODE          0x20
 #define G_GDT_DESCRIPTOR_TSS                0x28
 
 #define G_SEGMENT_SELECTOR_RING0            0 // 00
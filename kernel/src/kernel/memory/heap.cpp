@@ -22,6 +22,7 @@
 #include "kernel/memory/allocator.hpp"
 #include "kernel/memory/memory.hpp"
 #include "kernel/memory/paging.hpp"
+#include "kernel/memory/slab.hpp"
 #include "kernel/memory/constants.hpp"
 #include "kernel/panic.hpp"
 #include "kernel/system/mutex.hpp"
@@ -36,6 +37,7 @@ static g_mutex heapLock;
 
 bool _heapExpand();
 void _heapMapInitialArea();
+bool _heapMapArea(g_virtual_address start, g_virtual_address end);
 
 void heapInitialize()
 {
@@ -45,6 +47,7 @@ void heapInitialize()
 	_heapMapInitialArea();
 	mutexInitializeGlobal(&heapLock, __func__);
 	memoryAllocatorInitialize(&heapAllocator, G_ALLOCATOR_TYPE_HEAP, heapStart, heapEnd);
+	slabInitialize();
 
 	logDebug("%! initialized with area: %h - %h", "heap", heapStart, heapEnd);
 	heapInitialized = true;
@@ -55,23 +58,57 @@ void _heapMapInitialArea()
 	heapStart = G_MEM_HEAP_START;
 	heapEnd = heapStart + G_MEM_HEAP_INITIAL_SIZE;
 
-	g_address virt = heapStart;
-	while(virt < heapEnd)
+	if(!_heapMapArea(heapStart, heapEnd))
+		panic("%! failed to allocate physical memory for initial heap", "kernheap");
+}
+
+/**
+ * Maps physical memory to an area of the heap. Aligned parts are mapped with large
+ * pages if there is contiguous memory, which saves page tables and TLB entries.
+ */
+bool _heapMapArea(g_virtual_address start, g_virtual_address end)
+{
+	g_virtual_address virt = start;
+	while(virt < end)
 	{
-		g_physical_address addr = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
-		pagingMapPage(virt, addr, G_PAGE_TABLE_KERNEL_DEFAULT, G_PAGE_KERNEL_DEFAULT);
+		if(!(virt & G_PAGE_LARGE_ALIGN_MASK) && virt + G_PAGE_LARGE_SIZE <= end)
+		{
+			g_physical_address large = memoryPhysicalAllocateLarge(true);
+			if(large)
+			{
+				if(pagingMapLargePage(pagingGetCurrentSpace(), virt, large, G_PAGE_TABLE_KERNEL_DEFAULT,
+				                      G_PAGE_KERNEL_DEFAULT))
+				{
+					virt += G_PAGE_LARGE_SIZE;
+					continue;
+				}
+				for(uint32_t i = 0; i < G_PAGE_LARGE_PAGES; i++)
+					memoryPhysicalFree(large + i * G_PAGE_SIZE);
+			}
+		}
+
+		g_physical_address phys = memoryPhysicalAllocate(true);
+		if(!phys)
+			return false;
+		pagingMapPage(virt, phys, G_PAGE_TABLE_KERNEL_DEFAULT, G_PAGE_KERNEL_DEFAULT);
 		virt += G_PAGE_SIZE;
 	}
+	return true;
 }
 
 void* heapAllocate(uint32_t size)
 {
-	mutexAcquire(&heapLock);
-
 	if(!heapInitialized)
 		panic("%! tried to use uninitialized kernel heap", "kernheap");
 
-	void* ptr = memoryAllocatorAllocate(&heapAllocator, size);
+	// Small objects come from slabs without taking the heap lock
+	void* ptr = slabAllocate(size);
+	if(ptr)
+		return ptr;
+
+	mutexAcquire(&heapLock);
+
+	ptr = memoryAllocatorAllocate(&heapAllocator, size);
 	if(!ptr)
 	{
 		if(_heapExpand())
@@ -109,6 +146,12 @@ void heapFree(void* ptr)
 		return;
 	}
 
+	if(slabOwns(ptr))
+	{
+		slabFree(ptr);
+		return;
+	}
+
 	mutexAcquire(&heapLock);
 
 	heapAmountInUse -= memoryAllocatorFree(&heapAllocator, ptr);
@@ -118,21 +161,15 @@ void heapFree(void* ptr)
 
 uint32_t heapGetUsedAmount()
 {
-	return heapAmountInUse;
+	return heapAmountInUse + slabGetUsedAmount();
 }
 
 bool _heapExpand()
 {
-	for(g_virtual_address virt = heapEnd; virt < heapEnd + G_MEM_KERN_HEAP_EXPAND_STEP; virt += G_PAGE_SIZE)
+	if(!_heapMapArea(heapEnd, heapEnd + G_MEM_KERN_HEAP_EXPAND_STEP))
 	{
-		g_physical_address phys = memoryPhysicalAllocate(true);
-		if(phys == 0)
-		{
-			logWarn("%! failed to expand kernel heap, out of physical memory", "kernheap");
-			return false;
-		}
-
-		pagingMapPage(virt, phys, G_PAGE_TABLE_KERNEL_DEFAULT, G_PAGE_KERNEL_DEFAULT);
+		logWarn("%! failed to expand kernel heap, out of physical memory", "kernheap");
+		return false;
 	}
 
 	memoryAllocatorExpand(&heapAllocator, G_MEM_KERN_HEAP_EXPAND_STEP);
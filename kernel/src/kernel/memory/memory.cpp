@@ -26,42 +26,154 @@
 #include "kernel/memory/constants.hpp"
 #include "kernel/memory/page_reference_tracker.hpp"
 #include "kernel/memory/paging.hpp"
+#include "kernel/memory/tlb_shootdown.hpp"
+#include "kernel/memory/zero_pool.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/timing/pit.hpp"
 #include "kernel/tasking/task.hpp"
 #include "kernel/logger/logger.hpp"
+#include "kernel/panic.hpp"
+
+/**
+ * Below this size, the startup cost of the string instructions is higher than that
+ * of a simple loop, unless the processor has fast short REP MOVSB.
+ */
+#define G_MEMORY_REP_THRESHOLD 128
 
 g_address_range_pool* memoryVirtualRangePool = nullptr;
-g_bitmap_page_allocator memoryPhysicalAllocator;
+g_buddy_allocator memoryPhysicalAllocator;
+
+static bool memoryRepStringOperations = false;
+static bool memoryRepShortCopy = false;
+
+void _memoryInitializeStringOperations();
+void _memoryTestStringOperations();
 
 void memoryInitialize(limine_memmap_response* memoryMap)
 {
 	logInfo("%! initializing kernel memory with map at %x", "mem", memoryMap);
+	_memoryInitializeStringOperations();
 
-	bitmapPageAllocatorInitialize(&memoryPhysicalAllocator, memoryMap);
-	logInfo("%! available: %i MiB", "memory", (memoryPhysicalAllocator.freePageCount * G_PAGE_SIZE) / 1024 / 1024);
+	buddyAllocatorInitialize(&memoryPhysicalAllocator, memoryMap);
+	logInfo("%! available: %i MiB", "memory", (buddyAllocatorGetFreePageCount(&memoryPhysicalAllocator) * G_PAGE_SIZE) / 1024 / 1024);
 
 	heapInitialize();
+	zeroPoolInitialize();
 
 	memoryVirtualRangePool = (g_address_range_pool*) heapAllocate(sizeof(g_address_range_pool));
 	addressRangePoolInitialize(memoryVirtualRangePool);
 	addressRangePoolAddRange(memoryVirtualRangePool, G_MEM_KERN_VIRT_RANGES_START, G_MEM_KERN_VIRT_RANGES_END);
 
-	pageReferenceTrackerInitialize();
+	_memoryTestStringOperations();
 }
 
 g_physical_address memoryPhysicalAllocate(bool untracked)
 {
-	g_physical_address page = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
+	g_physical_address page = buddyAllocatorAllocate(&memoryPhysicalAllocator, 0);
+	if(!page)
+		page = zeroPoolReclaim();
 	if(!untracked && page)
 		pageReferenceTrackerIncrement(page);
 	return page;
 }
 
+g_physical_address memoryPhysicalAllocateZeroed()
+{
+	g_physical_address page = zeroPoolTake();
+	if(page)
+	{
+		pageReferenceTrackerIncrement(page);
+		return page;
+	}
+
+	zeroPoolCountMiss();
+	page = memoryPhysicalAllocate();
+	if(page)
+		memoryZeroPage((void*) G_MEM_PHYS_TO_VIRT(page));
+	return page;
+}
+
+g_physical_address memoryPhysicalAllocateContiguous(uint32_t pages, g_size alignment, bool below4G)
+{
+	uint32_t flags = below4G ? G_BUDDY_ALLOCATE_BELOW_4G : 0;
+	g_physical_address base = buddyAllocatorAllocateContiguous(&memoryPhysicalAllocator, pages, alignment, flags);
+
+	// Pooled pages may prevent blocks from being merged
+	if(!base && zeroPoolDrain())
+		base = buddyAllocatorAllocateContiguous(&memoryPhysicalAllocator, pages, alignment, flags);
+
+	if(base)
+	{
+		for(uint32_t i = 0; i < pages; i++)
+		{
+			pageReferenceTrackerIncrement(base + i * G_PAGE_SIZE);
+			pageReferenceTrackerSetFlags(base + i * G_PAGE_SIZE, G_PAGE_FRAME_FLAG_DMA | G_PAGE_FRAME_FLAG_PINNED);
+		}
+	}
+	return base;
+}
+
+g_physical_address memoryPhysicalAllocateLarge(bool untracked)
+{
+	g_physical_address base = buddyAllocatorAllocateContiguous(&memoryPhysicalAllocator, G_PAGE_LARGE_PAGES,
+	                                                           G_PAGE_LARGE_SIZE);
+	if(!base && zeroPoolDrain())
+		base = buddyAllocatorAllocateContiguous(&memoryPhysicalAllocator, G_PAGE_LARGE_PAGES, G_PAGE_LARGE_SIZE);
+
+	if(!untracked && base)
+	{
+		for(uint32_t i = 0; i < G_PAGE_LARGE_PAGES; i++)
+			pageReferenceTrackerIncrement(base + i * G_PAGE_SIZE);
+	}
+	return base;
+}
+
 void memoryPhysicalFree(g_physical_address page)
 {
 	if(!page)
 		return;
 	if(pageReferenceTrackerDecrement(page) == 0)
-		bitmapPageAllocatorMarkFree(&memoryPhysicalAllocator, page);
+		buddyAllocatorFree(&memoryPhysicalAllocator, page);
+}
+
+uint32_t memoryAllocateRange(g_physical_address space, g_virtual_address start, uint32_t pages, uint64_t tableFlags,
+                             uint64_t pageFlags)
+{
+	return pagingMapRange(space, start, pages, tableFlags, pageFlags, [](uint32_t)
+	{
+		return memoryPhysicalAllocateZeroed();
+	});
+}
+
+void memoryUnmapRange(g_physical_address space, g_virtual_address start, uint32_t pages, bool free)
+{
+	g_physical_address freed[G_TLB_SHOOTDOWN_BATCH_MAX];
+	uint32_t freedCount = 0;
+
+	g_tlb_shootdown_batch batch;
+	tlbShootdownBegin(&batch, space);
+	pagingUnmapRange(space, start, pages,
+	                 [&batch, &freed, &freedCount, space, free](g_virtual_address virt, g_physical_address page)
+	{
+		tlbShootdownAdd(&batch, virt);
+		if(!free)
+			return;
+
+		// Once the batch is full, its pages are invalidated everywhere and can be freed
+		freed[freedCount++] = page;
+		if(freedCount == G_TLB_SHOOTDOWN_BATCH_MAX)
+		{
+			tlbShootdownFinish(&batch);
+			for(uint32_t i = 0; i < freedCount; i++)
+				memoryPhysicalFree(freed[i]);
+			freedCount = 0;
+			tlbShootdownBegin(&batch, space);
+		}
+	});
+	tlbShootdownFinish(&batch);
+
+	for(uint32_t i = 0; i < freedCount; i++)
+		memoryPhysicalFree(freed[i]);
 }
 
 g_virtual_address memoryAllocateKernel(int32_t pages)
@@ -95,39 +207,185 @@ void memoryFreeKernelRange(g_virtual_address address)
 	addressRangePoolFree(memoryVirtualRangePool, address);
 }
 
+static inline g_address _memoryOnDemandStart(g_memory_file_ondemand* mapping)
+{
+	return G_PAGE_ALIGN_DOWN(mapping->fileStart);
+}
+
+static inline bool _memoryOnDemandContains(g_memory_file_ondemand* mapping, g_address address)
+{
+	return address >= _memoryOnDemandStart(mapping) && address < G_PAGE_ALIGN_UP(mapping->fileStart + mapping->memSize);
+}
+
+/**
+ * @return index of the first mapping that starts above the address
+ */
+static uint32_t _memoryOnDemandUpperBound(g_memory_ondemand_mappings* mappings, g_address address)
+{
+	uint32_t low = 0;
+	uint32_t high = mappings->count;
+	while(low < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+		if(_memoryOnDemandStart(mappings->entries[middle]) <= address)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/**
+ * Inserts the mapping behind all mappings that start at the same page. ELF segments
+ * can share the page at their boundary, which is then covered by the later one.
+ */
+static void _memoryOnDemandInsert(g_memory_ondemand_mappings* mappings, g_memory_file_ondemand* mapping)
+{
+	if(mappings->count == mappings->capacity)
+	{
+		uint32_t capacity = mappings->capacity ? mappings->capacity * 2 : G_MEMORY_ONDEMAND_INITIAL_CAPACITY;
+		auto entries = (g_memory_file_ondemand**) heapAllocate(sizeof(g_memory_file_ondemand*) * capacity);
+		if(mappings->entries)
+		{
+			memoryCopy(entries, mappings->entries, sizeof(g_memory_file_ondemand*) * mappings->count);
+			heapFree(mappings->entries);
+		}
+		mappings->entries = entries;
+		mappings->capacity = capacity;
+	}
+
+	uint32_t index = _memoryOnDemandUpperBound(mappings, _memoryOnDemandStart(mapping));
+	for(uint32_t i = mappings->count; i > index; i--)
+		mappings->entries[i] = mappings->entries[i - 1];
+	mappings->entries[index] = mapping;
+	mappings->count++;
+}
+
 void memoryOnDemandMapFile(g_process* process, g_fd file, g_offset fileOffset, g_address fileStart, g_ptrsize fileSize,
                            g_ptrsize memorySize)
 {
 	g_memory_file_ondemand* mapping = (g_memory_file_ondemand*) heapAllocate(sizeof(g_memory_file_ondemand));
+	mapping->type = G_MEMORY_ONDEMAND_TYPE_FILE;
+	mapping->faultAround = 1;
 	mapping->fd = file;
 	mapping->fileStart = fileStart;
 	mapping->fileOffset = fileOffset;
 	mapping->fileSize = fileSize;
 	mapping->memSize = memorySize;
 
-	mapping->next = process->onDemandMappings;
-	process->onDemandMappings = mapping;
+	mutexAcquire(&process->lock);
+	_memoryOnDemandInsert(&process->onDemandMappings, mapping);
+	mutexRelease(&process->lock);
 }
 
-g_memory_file_ondemand* memoryOnDemandFindMapping(g_task* task, g_address address)
+void memoryOnDemandMapZero(g_process* process, g_address start, g_ptrsize size)
+{
+	g_memory_file_ondemand* mapping = (g_memory_file_ondemand*) heapAllocate(sizeof(g_memory_file_ondemand));
+	mapping->type = G_MEMORY_ONDEMAND_TYPE_ZERO;
+	mapping->faultAround = G_MEMORY_ONDEMAND_ZERO_FAULT_AROUND;
+	mapping->fd = G_FD_NONE;
+	mapping->fileStart = start;
+	mapping->fileOffset = 0;
+	mapping->fileSize = 0;
+	mapping->memSize = size;
+
+	mutexAcquire(&process->lock);
+	_memoryOnDemandInsert(&process->onDemandMappings, mapping);
+	mutexRelease(&process->lock);
+}
+
+void memoryOnDemandUnmapZero(g_process* process, g_address start)
 {
-	auto mapping = task->process->onDemandMappings;
-	while(mapping)
+	mutexAcquire(&process->lock);
+	g_memory_ondemand_mappings* mappings = &process->onDemandMappings;
+	g_memory_file_ondemand* mapping = nullptr;
+
+	uint32_t index = _memoryOnDemandUpperBound(mappings, start);
+	if(index > 0)
 	{
-		if(address >= G_PAGE_ALIGN_DOWN(mapping->fileStart) &&
-		   address < G_PAGE_ALIGN_UP(mapping->fileStart + mapping->memSize))
+		mapping = mappings->entries[index - 1];
+		if(mapping->type == G_MEMORY_ONDEMAND_TYPE_ZERO && mapping->fileStart == start)
 		{
-			return mapping;
+			for(uint32_t i = index; i < mappings->count; i++)
+				mappings->entries[i - 1] = mappings->entries[i];
+			mappings->count--;
 		}
-		mapping = mapping->next;
+		else
+		{
+			mapping = nullptr;
+		}
+	}
+	mutexRelease(&process->lock);
+
+	if(mapping)
+		heapFree(mapping);
+}
+
+g_memory_file_ondemand* memoryOnDemandFindMapping(g_task* task, g_address address)
+{
+	g_memory_ondemand_mappings* mappings = &task->process->onDemandMappings;
+
+	// The last hit is only valid if it is still the last mapping that starts below the address
+	uint32_t last = mappings->lastHit;
+	if(last < mappings->count && _memoryOnDemandContains(mappings->entries[last], address) &&
+	   (last + 1 == mappings->count || _memoryOnDemandStart(mappings->entries[last + 1]) > address))
+	{
+		return mappings->entries[last];
+	}
+
+	uint32_t index = _memoryOnDemandUpperBound(mappings, address);
+	if(index == 0 || !_memoryOnDemandContains(mappings->entries[index - 1], address))
+		return nullptr;
+
+	mappings->lastHit = index - 1;
+	return mappings->entries[index - 1];
+}
+
+/**
+ * Populates the unmapped pages in the fault-around window of the accessed page
+ * with zeroed pages.
+ */
+bool _memoryOnDemandPopulateZero(g_memory_file_ondemand* mapping, g_address accessed)
+{
+	g_address start = G_PAGE_ALIGN_DOWN(mapping->fileStart);
+	g_address end = G_PAGE_ALIGN_UP(mapping->fileStart + mapping->memSize);
+	g_address accessedPage = G_PAGE_ALIGN_DOWN(accessed);
+
+	g_ptrsize window = mapping->faultAround * G_PAGE_SIZE;
+	g_address left = start + ((accessedPage - start) / window) * window;
+	g_address right = left + window < end ? left + window : end;
+
+	for(g_address page = left; page < right; page += G_PAGE_SIZE)
+	{
+		if(pagingVirtualToPhysical(page))
+			continue;
+
+		g_physical_address phys = memoryPhysicalAllocateZeroed();
+		if(!phys)
+			break;
+		pagingMapPage(page, phys, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 	}
 
-	return nullptr;
+	// Another thread may have populated the page already
+	return pagingVirtualToPhysical(accessedPage) != 0;
 }
 
 bool memoryOnDemandHandlePageFault(g_task* task, g_address accessed)
 {
+	g_process* process = task->process;
+	mutexAcquire(&process->lock);
 	auto mapping = memoryOnDemandFindMapping(task, accessed);
+	if(mapping && mapping->type == G_MEMORY_ONDEMAND_TYPE_ZERO)
+	{
+		bool populated = _memoryOnDemandPopulateZero(mapping, accessed);
+		mutexRelease(&process->lock);
+		if(populated)
+			__sync_fetch_and_add(&process->faults.minor, 1);
+		return populated;
+	}
+	mutexRelease(&process->lock);
+
+	// File mappings are only removed when the process image is replaced
 	if(!mapping)
 		return false;
 
@@ -152,6 +410,13 @@ bool memoryOnDemandHandlePageFault(g_task* task, g_address accessed)
 		g_offset fileOffset = mapping->fileOffset + (copyLeft - mapping->fileStart);
 		if(!filesystemReadToMemory(mapping->fd, fileOffset, (uint8_t*) copyLeft, copyRight - copyLeft))
 			return false;
+
+		__sync_fetch_and_add(&process->faults.major, 1);
+		__sync_fetch_and_add(&process->faults.fileReadBytes, copyRight - copyLeft);
+	}
+	else
+	{
+		__sync_fetch_and_add(&process->faults.minor, 1);
 	}
 
 	// Zero everything after content
@@ -163,9 +428,109 @@ bool memoryOnDemandHandlePageFault(g_task* task, g_address accessed)
 	return true;
 }
 
+bool memoryCopyOnWriteHandlePageFault(g_task* task, g_address accessed)
+{
+	g_virtual_address page = G_PAGE_ALIGN_DOWN(accessed);
+	if(page > G_MEM_LOWER_HALF_END)
+		return false;
+
+	g_process* process = task->process;
+	mutexAcquire(&process->lock);
+
+	uint64_t entry = pagingVirtualToPageEntry(page);
+	if(!(entry & G_PAGE_PRESENT) || !(entry & G_PAGE_USER_FLAG))
+	{
+		mutexRelease(&process->lock);
+		return false;
+	}
+
+	// Another thread resolved the fault while this processor still had the old entry
+	if(entry & G_PAGE_WRITABLE_FLAG)
+	{
+		pagingInvalidatePage(page);
+		mutexRelease(&process->lock);
+		return true;
+	}
+
+	if(!(entry & G_PAGE_COPY_ON_WRITE_FLAG))
+	{
+		mutexRelease(&process->lock);
+		return false;
+	}
+
+	g_physical_address shared = entry & ~G_PAGE_ALIGN_MASK;
+	uint64_t flags = ((entry & G_PAGE_ALIGN_MASK) & ~G_PAGE_COPY_ON_WRITE_FLAG) | G_PAGE_WRITABLE_FLAG;
+
+	// If the other processes have dropped the page already, it can be taken over
+	if(pageReferenceTrackerGet(shared) <= 1)
+	{
+		pageReferenceTrackerClearFlags(shared, G_PAGE_FRAME_FLAG_COPY_ON_WRITE);
+		pagingMapPage(page, shared, G_PAGE_TABLE_USER_DEFAULT, flags, true);
+		__sync_fetch_and_add(&process->faults.minor, 1);
+		mutexRelease(&process->lock);
+		return true;
+	}
+
+	g_physical_address copy = memoryPhysicalAllocate();
+	if(!copy)
+	{
+		logWarn("%! out of memory while copying page %h of process %i", "memory", page, process->id);
+		mutexRelease(&process->lock);
+		return false;
+	}
+	memoryCopy((void*) G_MEM_PHYS_TO_VIRT(copy), (void*) G_MEM_PHYS_TO_VIRT(shared), G_PAGE_SIZE);
+	pagingMapPage(page, copy, G_PAGE_TABLE_USER_DEFAULT, flags, true);
+
+	// Other threads must not keep reading the old page
+	g_tlb_shootdown_batch batch;
+	tlbShootdownBegin(&batch, process->pageSpace);
+	tlbShootdownAdd(&batch, page);
+	tlbShootdownFinish(&batch);
+
+	__sync_fetch_and_add(&process->faults.minor, 1);
+	mutexRelease(&process->lock);
+
+	memoryPhysicalFree(shared);
+	return true;
+}
+
+void _memoryInitializeStringOperations()
+{
+	memoryRepStringOperations = processorHasFeature(g_cpuid_structured_ebx_feature::ERMS);
+	memoryRepShortCopy = memoryRepStringOperations && processorHasFeature(g_cpuid_structured_edx_feature::FSRM);
+	logDebug("%! string operations: ERMS %i, FSRM %i", "memory", memoryRepStringOperations, memoryRepShortCopy);
+}
+
 void* memorySetBytes(void* target, uint8_t value, int32_t length)
 {
+	if(length <= 0)
+		return target;
+
+	if(memoryRepStringOperations && length >= G_MEMORY_REP_THRESHOLD)
+	{
+		void* pos = target;
+		uint64_t count = length;
+		asm volatile("rep stosb"
+			: "+D"(pos), "+c"(count)
+			: "a"(value)
+			: "memory");
+		return target;
+	}
+
 	auto pos = (uint8_t*) target;
+	while(length && ((g_address) pos & 7))
+	{
+		*pos++ = value;
+		length--;
+	}
+
+	uint64_t pattern = value * 0x0101010101010101ULL;
+	while(length >= 8)
+	{
+		*(uint64_t*) pos = pattern;
+		pos += 8;
+		length -= 8;
+	}
 
 	while(length--)
 		*pos++ = value;
@@ -173,6 +538,26 @@ void* memorySetBytes(void* target, uint8_t value, int32_t length)
 	return target;
 }
 
+void memoryZeroPage(void* page)
+{
+	// Non-temporal stores don't push other data out of the cache for a page that is
+	// usually not accessed right away
+	auto pos = (uint64_t*) page;
+	auto end = pos + G_PAGE_SIZE / sizeof(uint64_t);
+	uint64_t zero = 0;
+	for(; pos < end; pos += 4)
+	{
+		asm volatile("movnti %1, (%0)\n"
+		             "movnti %1, 8(%0)\n"
+		             "movnti %1, 16(%0)\n"
+		             "movnti %1, 24(%0)"
+			:
+			: "r"(pos), "r"(zero)
+			: "memory");
+	}
+	asm volatile("sfence" ::: "memory");
+}
+
 void* memorySetWords(void* target, uint16_t value, int32_t length)
 {
 	auto pos = (uint16_t*) target;
@@ -185,25 +570,37 @@ void* memorySetWords(void* target, uint16_t value, int32_t length)
 
 void* memoryCopy(void* target, const void* source, int32_t size)
 {
+	if(size <= 0)
+		return target;
+
+	if(memoryRepStringOperations && (memoryRepShortCopy || size >= G_MEMORY_REP_THRESHOLD))
+	{
+		void* targetPos = target;
+		const void* sourcePos = source;
+		uint64_t count = size;
+		asm volatile("rep movsb"
+			: "+D"(targetPos), "+S"(sourcePos), "+c"(count)
+			:
+			: "memory");
+		return target;
+	}
+
 	auto targetPtr = (uint8_t*) target;
 	auto sourcePtr = (const uint8_t*) source;
 
-	// TODO qword copying
-
-	while(size >= 4)
+	// Align the stores, unaligned loads are cheap
+	while(size && ((g_address) targetPtr & 7))
 	{
-		*(uint32_t*) targetPtr = *(const uint32_t*) sourcePtr;
-		targetPtr += 4;
-		sourcePtr += 4;
-		size -= 4;
+		*targetPtr++ = *sourcePtr++;
+		size--;
 	}
 
-	while(size >= 2)
+	while(size >= 8)
 	{
-		*(uint16_t*) targetPtr = *(const uint16_t*) sourcePtr;
-		targetPtr += 2;
-		sourcePtr += 2;
-		size -= 2;
+		*(uint64_t*) targetPtr = *(const uint64_t*) sourcePtr;
+		targetPtr += 8;
+		sourcePtr += 8;
+		size -= 8;
 	}
 
 	while(size--)
@@ -211,3 +608,97 @@ void* memoryCopy(void* target, const void* source, int32_t size)
 
 	return target;
 }
+
+/**
+ * Checks the string operations with all combinations of small alignments and sizes
+ * around the thresholds, then measures their throughput.
+ */
+void _memoryTestStringOperations()
+{
+	const int32_t bufferSize = 2 * G_PAGE_SIZE;
+	auto source = (uint8_t*) memoryAllocateKernel(2);
+	auto target = (uint8_t*) memoryAllocateKernel(2);
+	for(int32_t i = 0; i < bufferSize; i++)
+		source[i] = (uint8_t) (i * 7 + 3);
+
+	const int32_t sizes[] = {0, 1, 7, 8, 9, 63, 64, 127, 128, 129, 1000, 4095, 4096};
+	for(int32_t size: sizes)
+	{
+		for(int32_t targetOffset = 0; targetOffset < 8; targetOffset++)
+		{
+			int32_t checked = targetOffset + size + 16;
+			if(checked > bufferSize)
+				checked = bufferSize;
+
+			for(int32_t sourceOffset = 0; sourceOffset < 8; sourceOffset++)
+			{
+				for(int32_t i = 0; i < checked; i++)
+					target[i] = 0xCC;
+				memoryCopy(target + targetOffset, source + sourceOffset, size);
+				for(int32_t i = 0; i < checked; i++)
+				{
+					bool inside = i >= targetOffset && i < targetOffset + size;
+					uint8_t expected = inside ? source[i - targetOffset + sourceOffset] : 0xCC;
+					if(target[i] != expected)
+						panic("%! memoryCopy self-test failed: size %i, offsets %i/%i", "memory", size, targetOffset,
+						      sourceOffset);
+				}
+			}
+
+			for(int32_t i = 0; i < checked; i++)
+				target[i] = 0xCC;
+			memorySetBytes(target + targetOffset, 0x5A, size);
+			for(int32_t i = 0; i < checked; i++)
+			{
+				bool inside = i >= targetOffset && i < targetOffset + size;
+				if(inside ? target[i] != 0x5A : target[i] == 0x5A)
+					panic("%! memorySetBytes self-test failed: size %i, offset %i", "memory", size, targetOffset);
+			}
+		}
+	}
+
+	memoryZeroPage(target);
+	for(int32_t i = 0; i < (int32_t) G_PAGE_SIZE; i++)
+	{
+		if(target[i] != 0)
+			panic("%! memoryZeroPage self-test failed at %i", "memory", i);
+	}
+
+	memoryFreeKernelRange((g_virtual_address) source);
+	memoryFreeKernelRange((g_virtual_address) target);
+
+	// Throughput with a buffer larger than most caches
+	const int32_t benchmarkPages = 256;
+	const int32_t benchmarkSize = benchmarkPages * G_PAGE_SIZE;
+	source = (uint8_t*) memoryAllocateKernel(benchmarkPages);
+	target = (uint8_t*) memoryAllocateKernel(benchmarkPages);
+
+	uint64_t calibrationStart = processorReadTsc();
+	pitPrepareSleep(10000);
+	pitPerformSleep();
+	uint64_t cyclesPerMicrosecond = (processorReadTsc() - calibrationStart) / 10000;
+	if(cyclesPerMicrosecond == 0)
+		cyclesPerMicrosecond = 1;
+
+	uint64_t start = processorReadTsc();
+	memoryCopy(target, source, benchmarkSize);
+	uint64_t copyCycles = processorReadTsc() - start;
+
+	start = processorReadTsc();
+	memorySetBytes(target, 0, benchmarkSize);
+	uint64_t setCycles = processorReadTsc() - start;
+
+	start = processorReadTsc();
+	for(int32_t i = 0; i < benchmarkPages; i++)
+		memoryZeroPage(target + i * G_PAGE_SIZE);
+	uint64_t zeroCycles = processorReadTsc() - start;
+
+	// Bytes per microsecond are MB/s
+	logInfo("%! copy %i MB/s, set %i MB/s, zero page %i MB/s", "memory",
+	        benchmarkSize * cyclesPerMicrosecond / (copyCycles + 1),
+	        benchmarkSize * cyclesPerMicrosecond / (setCycles + 1),
+	        benchmarkSize * cyclesPerMicrosecond / (zeroCycles + 1));
+
+	memoryFreeKernelRange((g_virtual_address) source);
+	memoryFreeKernelRange((g_virtual_address) target);
+}
@@ -27,11 +27,22 @@
 
 #include "kernel/filesystem/filesystem.hpp"
 #include "kernel/memory/address_range_pool.hpp"
-#include "kernel/memory/bitmap_page_allocator.hpp"
+#include "kernel/memory/buddy_allocator.hpp"
+#include "kernel/memory/paging.hpp"
 
 #define G_ALIGN_UP(value, boundary)    (((value) + ((boundary) - 1)) & ~((boundary) - 1))
 #define G_ALIGN_DOWN(value, boundary)  ((value) & ~((boundary) - 1))
 
+/**
+ * Number of pages that are populated at once when a zero mapping is accessed.
+ */
+#define G_MEMORY_ONDEMAND_ZERO_FAULT_AROUND 4
+
+/**
+ * Initial number of entries of the on-demand mapping array of a process.
+ */
+#define G_MEMORY_ONDEMAND_INITIAL_CAPACITY 8
+
 class g_task;
 class g_process;
 
@@ -44,11 +55,54 @@ void memoryInitialize(limine_memmap_response* memoryMap);
  */
 g_physical_address memoryPhysicalAllocate(bool untracked = false);
 
+/**
+ * Allocates a physical memory page that is filled with zeros. The page is taken from
+ * the pool of pages that idle processors have zeroed in advance if possible.
+ */
+g_physical_address memoryPhysicalAllocateZeroed();
+
+/**
+ * Allocates a physically contiguous range of pages, for example for DMA buffers.
+ * The pages are tracked individually and can be freed with <memoryPhysicalFree>.
+ *
+ * @param alignment
+ * 		required alignment in bytes, a power of two
+ * @param below4G
+ * 		whether the range must lie below 4 GiB for devices that use 32-bit addresses
+ * @return the physical address of the first page or 0 if no such range is available
+ */
+g_physical_address memoryPhysicalAllocateContiguous(uint32_t pages, g_size alignment = G_PAGE_SIZE, bool below4G = false);
+
 /**
  * Frees a physical memory page.
  */
 void memoryPhysicalFree(g_physical_address page);
 
+/**
+ * Allocates the memory for a large page, 2 MiB of physically contiguous memory that
+ * is aligned to its size. Unlike <memoryPhysicalAllocateContiguous>, the pages are
+ * not pinned; they are tracked individually and freed with <memoryPhysicalFree>.
+ *
+ * @return the physical address or 0 if there is no such block
+ */
+g_physical_address memoryPhysicalAllocateLarge(bool untracked = false);
+
+/**
+ * Allocates zeroed physical pages for all pages of a range in the given space that
+ * are not mapped yet, see <pagingMapRange>.
+ *
+ * @return the number of pages that were allocated, less than required if out of memory
+ */
+uint32_t memoryAllocateRange(g_physical_address space, g_virtual_address start, uint32_t pages, uint64_t tableFlags,
+                             uint64_t pageFlags);
+
+/**
+ * Unmaps a range of the given space and frees the physical pages unless <free> is
+ * false. Whenever a shootdown batch is full, its pages are invalidated on all
+ * processors and freed before continuing, so no list of pages must be allocated.
+ */
+void memoryUnmapRange(g_physical_address space, g_virtual_address start, uint32_t pages, bool free = true);
+
 /**
  * Allocates and maps a memory range with the given number of pages.
  */
@@ -66,19 +120,43 @@ void memoryOnDemandMapFile(g_process* process, g_fd file, g_offset fileOffset, g
                            g_ptrsize memorySize);
 
 /**
- * Searches for an on-demand mapping containing the given address.
+ * Creates an on-demand mapping for anonymous memory that is filled with zeros
+ * when it is first accessed.
+ */
+void memoryOnDemandMapZero(g_process* process, g_address start, g_ptrsize size);
+
+/**
+ * Removes the zero mapping that starts at the given address. Pages that were
+ * already populated must be unmapped by the caller afterwards.
+ */
+void memoryOnDemandUnmapZero(g_process* process, g_address start);
+
+/**
+ * Searches for an on-demand mapping containing the given address. The mapping of
+ * the previous lookup is checked first, then the sorted mappings are searched. The
+ * caller must hold the process lock.
  */
 g_memory_file_ondemand* memoryOnDemandFindMapping(g_task* task, g_address address);
 
 /**
- * Handles loading of the on-demand mapped file content.
+ * Handles loading of the on-demand mapped file content or populates zero pages.
+ *
+ * @return whether the accessed page is now mapped
  */
 bool memoryOnDemandHandlePageFault(g_task* task, g_address accessed);
 
+/**
+ * Resolves a write to a copy-on-write page. While the page is still referenced by
+ * another process it is copied, otherwise it is made writable again.
+ *
+ * @return whether the accessed page is now writable
+ */
+bool memoryCopyOnWriteHandlePageFault(g_task* task, g_address accessed);
+
 /**
  * Reference to the loaders or kernels physical page allocator.
  */
-extern g_bitmap_page_allocator memoryPhysicalAllocator;
+extern g_buddy_allocator memoryPhysicalAllocator;
 
 /**
  * Sets number bytes at target to value.
@@ -89,6 +167,14 @@ extern g_bitmap_page_allocator memoryPhysicalAllocator;
  */
 void* memorySetBytes(void* target, uint8_t value, int32_t number);
 
+/**
+ * Zeroes a page with non-temporal stores, so that it does not replace other data in
+ * the cache. Should only be used for pages that are not accessed right afterwards.
+ *
+ * @param page	the page-aligned address of the page
+ */
+void memoryZeroPage(void* page);
+
 /**
  * Sets number words at target to value.
  *
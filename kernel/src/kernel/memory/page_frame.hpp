@@ -0,0 +1,49 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_MEMORY_PAGE_FRAME__
+#define __KERNEL_MEMORY_PAGE_FRAME__
+
+#include <ghost/stdint.h>
+
+/**
+ * Flags of a physical frame
+ */
+#define G_PAGE_FRAME_FLAG_COPY_ON_WRITE 0x01 // Mapped copy-on-write by at least one process
+#define G_PAGE_FRAME_FLAG_PINNED 0x02        // Must stay writable in every mapping, for example for devices
+#define G_PAGE_FRAME_FLAG_DMA 0x04           // Part of a physically contiguous DMA buffer
+#define G_PAGE_FRAME_FLAG_CACHED 0x08        // Holds cached file content
+
+/**
+ * Descriptor of a physical frame. One exists for each frame up to the highest usable
+ * address of the memory map, indexed by the frame number.
+ *
+ * The state is owned by the physical allocator and only changed with its zone
+ * locked. Flags and reference count are only modified atomically, so they can be
+ * read and updated without a lock.
+ */
+struct g_page_frame
+{
+	uint8_t state;
+	volatile uint8_t flags;
+	volatile int32_t referenceCount;
+};
+
+#endif
@@ -19,58 +19,83 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "kernel/memory/page_reference_tracker.hpp"
-#include "kernel/memory/paging.hpp"
-#include "kernel/system/mutex.hpp"
+#include "kernel/memory/memory.hpp"
 
-static g_pp_reference_count_directory directory;
-static g_mutex lock;
-
-#if __x86_64__
-#warning "This class does not support 64 bits"
-#endif
-
-void pageReferenceTrackerInitialize()
+g_page_frame* pageReferenceTrackerGetFrame(g_physical_address address)
 {
-	mutexInitializeGlobal(&lock, __func__);
+	uint64_t frame = address / G_PAGE_SIZE;
+	if(frame >= memoryPhysicalAllocator.frameCount)
+		return nullptr;
+
+	g_page_frame* descriptor = &memoryPhysicalAllocator.frames[frame];
+	if(descriptor->state == G_BUDDY_FRAME_UNMANAGED)
+		return nullptr;
+	return descriptor;
 }
 
 void pageReferenceTrackerIncrement(g_physical_address address)
 {
-	mutexAcquire(&lock);
-
-	uint32_t ti = G_TABLE_IN_DIRECTORY_INDEX(address);
-	uint32_t pi = G_PAGE_IN_TABLE_INDEX(address);
-
-	if(directory.tables[ti] == 0)
-	{
-		directory.tables[ti] = new g_pp_reference_count_table;
-
-		for(uint32_t i = 0; i < 1024; i++)
-		{
-			directory.tables[ti]->referenceCount[i] = 0;
-		}
-	}
+	g_page_frame* frame = pageReferenceTrackerGetFrame(address);
+	if(frame)
+		__sync_fetch_and_add(&frame->referenceCount, 1);
+}
 
-	++(directory.tables[ti]->referenceCount[pi]);
+bool pageReferenceTrackerTryIncrement(g_physical_address address)
+{
+	g_page_frame* frame = pageReferenceTrackerGetFrame(address);
+	if(!frame)
+		return false;
 
-	mutexRelease(&lock);
+	int32_t refs = frame->referenceCount;
+	while(refs > 0 && !__sync_bool_compare_and_swap(&frame->referenceCount, refs, refs + 1))
+		refs = frame->referenceCount;
+	return refs > 0;
 }
 
-int16_t pageReferenceTrackerDecrement(g_physical_address address)
+int32_t pageReferenceTrackerDecrement(g_physical_address address)
 {
-	mutexAcquire(&lock);
+	g_page_frame* frame = pageReferenceTrackerGetFrame(address);
+	if(!frame)
+		return 0;
 
-	uint32_t ti = G_TABLE_IN_DIRECTORY_INDEX(address);
-	uint32_t pi = G_PAGE_IN_TABLE_INDEX(address);
+	int32_t refs = frame->referenceCount;
+	while(refs > 0 && !__sync_bool_compare_and_swap(&frame->referenceCount, refs, refs - 1))
+		refs = frame->referenceCount;
 
-	if(directory.tables[ti] == 0)
+	if(refs <= 1)
 	{
-		mutexRelease(&lock);
+		frame->flags = 0;
 		return 0;
 	}
+	return refs - 1;
+}
 
-	int16_t refs = --(directory.tables[ti]->referenceCount[pi]);
-	mutexRelease(&lock);
+int32_t pageReferenceTrackerGet(g_physical_address address)
+{
+	g_page_frame* frame = pageReferenceTrackerGetFrame(address);
+	if(!frame)
+		return 0;
 
+	int32_t refs = frame->referenceCount;
 	return refs < 0 ? 0 : refs;
 }
+
+void pageReferenceTrackerSetFlags(g_physical_address address, uint8_t flags)
+{
+	g_page_frame* frame = pageReferenceTrackerGetFrame(address);
+	if(frame)
+		__sync_fetch_and_or(&frame->flags, flags);
+}
+
+void pageReferenceTrackerClearFlags(g_physical_address address, uint8_t flags)
+{
+	g_page_frame* frame = pageReferenceTrackerGetFrame(address);
+	if(frame)
+		__sync_fetch_and_and(&frame->flags, (uint8_t) ~flags);
+}
+
+uint8_t pageReferenceTrackerGetFlags(g_physical_address address)
+{
+	g_page_frame* frame = pageReferenceTrackerGetFrame(address);
+	return frame ? frame->flags : 0;
+}
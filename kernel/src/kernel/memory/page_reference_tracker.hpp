@@ -23,24 +23,19 @@
 
 #include <ghost/stdint.h>
 #include <ghost/memory/types.h>
+#include "kernel/memory/page_frame.hpp"
 
 /**
- *
+ * The reference tracker counts how often a physical page is in use, for example
+ * when it is shared between processes. The counts are kept in the frame descriptors
+ * of the physical allocator, so lookups need no lock. Pages outside of the usable
+ * memory (like MMIO) are never tracked.
  */
-struct g_pp_reference_count_table
-{
-	int16_t referenceCount[1024];
-};
 
 /**
- *
+ * @return the descriptor of a physical frame or null if it is not tracked
  */
-struct g_pp_reference_count_directory
-{
-	g_pp_reference_count_table* tables[1024];
-};
-
-void pageReferenceTrackerInitialize();
+g_page_frame* pageReferenceTrackerGetFrame(g_physical_address address);
 
 /**
  * Increments the number of references on a physical page.
@@ -48,10 +43,36 @@ void pageReferenceTrackerInitialize();
 void pageReferenceTrackerIncrement(g_physical_address address);
 
 /**
- * Decrements the number of references on a physical page.
- * 
+ * Increments the number of references on a physical page, but only if it is still
+ * referenced. This allows taking a reference on a page that another task could free
+ * at the same time, without reviving it after it was returned to the allocator.
+ *
+ * @return whether a reference was taken
+ */
+bool pageReferenceTrackerTryIncrement(g_physical_address address);
+
+/**
+ * Decrements the number of references on a physical page. Once the last reference
+ * is dropped, the flags of the frame are cleared.
+ *
  * @return the remaining number of references
  */
-int16_t pageReferenceTrackerDecrement(g_physical_address address);
+int32_t pageReferenceTrackerDecrement(g_physical_address address);
+
+/**
+ * @return the number of references on a physical page, 0 if it is not tracked
+ */
+int32_t pageReferenceTrackerGet(g_physical_address address);
+
+/**
+ * Sets or clears flags of a physical frame, see G_PAGE_FRAME_FLAG_*.
+ */
+void pageReferenceTrackerSetFlags(g_physical_address address, uint8_t flags);
+void pageReferenceTrackerClearFlags(g_physical_address address, uint8_t flags);
+
+/**
+ * @return the flags of a physical frame, 0 if it is not tracked
+ */
+uint8_t pageReferenceTrackerGetFlags(g_physical_address address);
 
 #endif
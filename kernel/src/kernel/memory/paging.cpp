@@ -22,8 +22,36 @@
 #include "kernel/logger/logger.hpp"
 #include "kernel/memory/constants.hpp"
 #include "kernel/memory/memory.hpp"
+#include "kernel/system/processor/processor.hpp"
 #include "kernel/panic.hpp"
 
+#define G_CR3_NO_FLUSH (1ULL << 63)
+
+static bool pagingPcid = false;
+static volatile uint64_t pagingTlbGenerations[G_PAGING_TLB_GENERATION_SLOTS] = {};
+static volatile int64_t pagingLargePages = 0;
+static volatile uint64_t pagingLargePagesSplit = 0;
+
+/**
+ * Converts the flags of a large page to those of a small page and back, only the
+ * PAT bit is at a different position.
+ */
+static uint64_t _pagingLargeToSmallFlags(uint64_t entry)
+{
+	uint64_t flags = entry & (G_PAGE_ALIGN_MASK | G_PAGE_NX_FLAG) & ~G_PAGE_LARGE_PAGE_FLAG;
+	if(entry & G_PAGE_LARGE_PAT_FLAG)
+		flags |= G_PAGE_PAT_FLAG;
+	return flags;
+}
+
+static uint64_t _pagingSmallToLargeFlags(uint64_t flags)
+{
+	uint64_t large = (flags & (G_PAGE_ALIGN_MASK | G_PAGE_NX_FLAG) & ~G_PAGE_PAT_FLAG) | G_PAGE_LARGE_PAGE_FLAG;
+	if(flags & G_PAGE_PAT_FLAG)
+		large |= G_PAGE_LARGE_PAT_FLAG;
+	return large;
+}
+
 g_physical_address pagingVirtualToPageEntry(g_virtual_address addr)
 {
 	auto pml4 = (g_address*) G_MEM_PHYS_TO_VIRT(pagingGetCurrentSpace());
@@ -46,7 +74,10 @@ g_physical_address pagingVirtualToPageEntry(g_virtual_address addr)
 		return 0;
 
 	if(pdValue & G_PAGE_LARGE_PAGE_FLAG)
-		return pdValue & ~G_PAGE_ALIGN_MASK;
+	{
+		g_physical_address page = (pdValue & G_PAGE_LARGE_ADDRESS_MASK) + (addr & G_PAGE_LARGE_ALIGN_MASK & ~G_PAGE_ALIGN_MASK);
+		return page | _pagingLargeToSmallFlags(pdValue);
+	}
 
 	auto pt = (g_address*) G_MEM_PHYS_TO_VIRT(ptAddr);
 	uint64_t ptIndex = G_PT_INDEX(addr);
@@ -63,6 +94,115 @@ void pagingSwitchToSpace(g_physical_address dir)
 	asm volatile("mov %0, %%cr3" : : "b"(dir));
 }
 
+void pagingSwitchToSpace(g_physical_address dir, uint16_t pcid, bool flush)
+{
+	uint64_t value = dir | (pcid & G_PAGING_PCID_MAX);
+	if(!flush)
+		value |= G_CR3_NO_FLUSH;
+	asm volatile("mov %0, %%cr3" : : "b"(value));
+}
+
+void pagingFlushTlb()
+{
+	// Keeps the current PCID, only entries tagged with it are flushed
+	uint64_t value;
+	asm volatile("mov %%cr3, %0" : "=r"(value));
+	asm volatile("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+void pagingFlushTlbGlobal()
+{
+	uint64_t cr4;
+	asm volatile("mov %%cr4, %0" : "=r"(cr4));
+	asm volatile("mov %0, %%cr4" : : "r"(cr4 & ~G_CR4_PGE) : "memory");
+	asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+void pagingInitializePcid()
+{
+	// Kernel pages must be global so that invalidating them is not limited to one PCID
+	uint64_t cr4;
+	asm volatile("mov %%cr4, %0" : "=r"(cr4));
+	if(processorHasFeature(g_cpuid_standard_edx_feature::PGE))
+	{
+		cr4 |= G_CR4_PGE;
+		asm volatile("mov %0, %%cr4" : : "r"(cr4));
+	}
+
+	if(!processorHasFeature(g_cpuid_extended_ecx_feature::PCID))
+		return;
+
+	// CR3[11:0] must be zero when enabling; boot code never sets them
+	cr4 |= G_CR4_PCIDE;
+	asm volatile("mov %0, %%cr4" : : "r"(cr4));
+	pagingPcid = true;
+
+	logDebug("%! %i: PCID support enabled", "paging", processorGetCurrentId());
+}
+
+bool pagingPcidEnabled()
+{
+	return pagingPcid;
+}
+
+static volatile uint64_t* _pagingGetTlbGenerationSlot(g_physical_address space)
+{
+	return &pagingTlbGenerations[(space / G_PAGE_SIZE) % G_PAGING_TLB_GENERATION_SLOTS];
+}
+
+uint64_t pagingGetTlbGeneration(g_physical_address space)
+{
+	return *_pagingGetTlbGenerationSlot(space);
+}
+
+void pagingMarkTlbStale(g_physical_address space)
+{
+	__sync_fetch_and_add(_pagingGetTlbGenerationSlot(space), 1);
+}
+
+/**
+ * Marks the TLB entries for a changed address as stale. Higher half pages are global,
+ * "invlpg" and the shootdown already remove them for all PCIDs.
+ */
+static void _pagingMarkTlbStale(g_physical_address space, g_virtual_address virt)
+{
+	if(virt <= G_MEM_LOWER_HALF_END)
+		pagingMarkTlbStale(space);
+}
+
+static g_physical_address _pagingAllocateTable()
+{
+	g_physical_address table = memoryPhysicalAllocate(true);
+	if(!table)
+		panic("%! failed to allocate physical memory for a page table", "paging");
+	return table;
+}
+
+/**
+ * Replaces a large page entry with a page table that maps the same memory. Since
+ * the translation stays the same, other processors may keep using the old entry.
+ */
+static void _pagingSplitLargeEntry(g_physical_address space, volatile uint64_t* entry, g_virtual_address virt,
+                                   bool current)
+{
+	uint64_t large = *entry;
+	g_physical_address base = large & G_PAGE_LARGE_ADDRESS_MASK;
+	uint64_t flags = _pagingLargeToSmallFlags(large);
+
+	g_physical_address table = _pagingAllocateTable();
+	auto pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(table);
+	for(uint32_t i = 0; i < G_PAGE_LARGE_PAGES; i++)
+		pt[i] = (base + i * G_PAGE_SIZE) | flags;
+
+	*entry = table | (large & (G_PAGE_PRESENT | G_PAGE_WRITABLE_FLAG | G_PAGE_USER_FLAG));
+	_pagingMarkTlbStale(space, virt);
+	if(current)
+		pagingInvalidatePage(virt & ~G_PAGE_LARGE_ALIGN_MASK);
+
+	__sync_fetch_and_sub(&pagingLargePages, 1);
+	__sync_fetch_and_add(&pagingLargePagesSplit, 1);
+}
+
 bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
                    uint64_t tableFlags, uint64_t ptFlags,
                    bool allowOverride)
@@ -78,7 +218,8 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
 	if((virt & G_PAGE_ALIGN_MASK) || (phys & G_PAGE_ALIGN_MASK))
 		panic("%! tried to map unaligned addresses: %h -> %h", "paging", virt, phys);
 
-	auto pml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pagingGetCurrentSpace());
+	g_physical_address space = pagingGetCurrentSpace();
+	auto pml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(space);
 
 
 	// Get PDPT from PML4
@@ -86,7 +227,7 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
 	volatile uint64_t* pdpt;
 	if(!pml4[pml4Index])
 	{
-		g_physical_address newPdpt = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
+		g_physical_address newPdpt = _pagingAllocateTable();
 		pml4[pml4Index] = newPdpt | pdptFlags;
 
 		pdpt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(newPdpt);
@@ -103,7 +244,7 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
 	volatile uint64_t* pd;
 	if(!pdpt[pdptIndex])
 	{
-		g_physical_address newPd = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
+		g_physical_address newPd = _pagingAllocateTable();
 		pdpt[pdptIndex] = newPd | pdFlags;
 
 		pd = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(newPd);
@@ -120,7 +261,7 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
 	volatile uint64_t* pt;
 	if(!pd[pdIndex])
 	{
-		g_physical_address newPt = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
+		g_physical_address newPt = _pagingAllocateTable();
 		pd[pdIndex] = newPt | ptFlags;
 
 		pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(newPt);
@@ -129,14 +270,19 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
 	}
 	else
 	{
+		if(pd[pdIndex] & G_PAGE_LARGE_PAGE_FLAG)
+			_pagingSplitLargeEntry(space, &pd[pdIndex], virt, true);
 		pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pd[pdIndex] & ~G_PAGE_ALIGN_MASK);
 	}
 
 	// Write page into page table
 	uint64_t ptIndex = G_PT_INDEX(virt);
-	if(!pt[ptIndex] || allowOverride)
+	uint64_t previous = pt[ptIndex];
+	if(!previous || allowOverride)
 	{
 		pt[ptIndex] = phys | pageFlags;
+		if(previous & G_PAGE_PRESENT)
+			_pagingMarkTlbStale(space, virt);
 		pagingInvalidatePage(virt);
 		return true;
 	}
@@ -145,9 +291,238 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
 	return false;
 }
 
+/**
+ * Returns the table that an entry points to, creating it if requested.
+ */
+static volatile uint64_t* _pagingGetNextLevel(volatile uint64_t* table, uint64_t index, uint64_t flags, bool create)
+{
+	if(table[index])
+		return (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(table[index] & ~G_PAGE_ALIGN_MASK);
+
+	if(!create)
+		return nullptr;
+
+	g_physical_address next = _pagingAllocateTable();
+	auto nextVirt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(next);
+	for(int i = 0; i < 512; i++)
+		nextVirt[i] = 0;
+
+	table[index] = next | flags;
+	return nextVirt;
+}
+
+/**
+ * Returns the page directory that holds the entry for an address in the given space,
+ * or null if it doesn't exist.
+ */
+static volatile uint64_t* _pagingGetPageDirectory(g_physical_address space, g_virtual_address virt, uint64_t flags,
+                                                  bool create)
+{
+	auto pml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(space);
+	auto pdpt = _pagingGetNextLevel(pml4, G_PML4_INDEX(virt), flags, create);
+	if(!pdpt)
+		return nullptr;
+
+	return _pagingGetNextLevel(pdpt, G_PDPT_INDEX(virt), flags, create);
+}
+
+uint32_t pagingMapRange(g_physical_address space, g_virtual_address virt, uint32_t pages,
+                        uint64_t tableFlags, uint64_t pageFlags,
+                        const std::function<g_physical_address(uint32_t index)>& supplier,
+                        bool allowOverride)
+{
+	if(virt & G_PAGE_ALIGN_MASK)
+		panic("%! tried to map range at unaligned address %h", "paging", virt);
+
+	bool current = space == pagingGetCurrentSpace();
+	bool changedPresent = false;
+	uint32_t mapped = 0;
+
+	volatile uint64_t* pt = nullptr;
+	for(uint32_t i = 0; i < pages; i++)
+	{
+		g_virtual_address page = virt + i * G_PAGE_SIZE;
+		if(!pt || G_PT_INDEX(page) == 0)
+		{
+			auto pd = _pagingGetPageDirectory(space, page, tableFlags, true);
+			volatile uint64_t* pdEntry = &pd[G_PD_INDEX(page)];
+
+			// All pages of a large page are mapped, it is only split to override some of them
+			if(*pdEntry & G_PAGE_LARGE_PAGE_FLAG)
+			{
+				if(!allowOverride)
+				{
+					i += G_PAGE_LARGE_PAGES - 1 - G_PT_INDEX(page);
+					pt = nullptr;
+					continue;
+				}
+				_pagingSplitLargeEntry(space, pdEntry, page, current);
+			}
+			pt = _pagingGetNextLevel(pd, G_PD_INDEX(page), tableFlags, true);
+		}
+
+		volatile uint64_t* entry = &pt[G_PT_INDEX(page)];
+		uint64_t previous = *entry;
+		if(previous && !allowOverride)
+			continue;
+
+		g_physical_address phys = supplier(i);
+		if(!phys)
+			break;
+		if(phys & G_PAGE_ALIGN_MASK)
+			panic("%! tried to map unaligned addresses: %h -> %h", "paging", page, phys);
+
+		*entry = phys | pageFlags;
+		mapped++;
+
+		if(previous & G_PAGE_PRESENT)
+		{
+			changedPresent = true;
+			if(current)
+				pagingInvalidatePage(page);
+		}
+	}
+
+	if(changedPresent)
+		_pagingMarkTlbStale(space, virt);
+	return mapped;
+}
+
+uint32_t pagingMapRangeContiguous(g_physical_address space, g_virtual_address virt, g_physical_address phys,
+                                  uint32_t pages, uint64_t tableFlags, uint64_t pageFlags)
+{
+	uint32_t mapped = 0;
+	uint32_t i = 0;
+	while(i < pages)
+	{
+		g_virtual_address pageVirt = virt + i * G_PAGE_SIZE;
+		g_physical_address pagePhys = phys + i * G_PAGE_SIZE;
+		if(!((pageVirt | pagePhys) & G_PAGE_LARGE_ALIGN_MASK) && pages - i >= G_PAGE_LARGE_PAGES &&
+		   pagingMapLargePage(space, pageVirt, pagePhys, tableFlags, pageFlags))
+		{
+			mapped += G_PAGE_LARGE_PAGES;
+			i += G_PAGE_LARGE_PAGES;
+			continue;
+		}
+
+		// Map small pages up to the next large page boundary
+		uint32_t count = (G_PAGE_LARGE_SIZE - (pageVirt & G_PAGE_LARGE_ALIGN_MASK)) / G_PAGE_SIZE;
+		if(count > pages - i)
+			count = pages - i;
+		mapped += pagingMapRange(space, pageVirt, count, tableFlags, pageFlags, [pagePhys](uint32_t index)
+		{
+			return pagePhys + index * G_PAGE_SIZE;
+		});
+		i += count;
+	}
+	return mapped;
+}
+
+bool pagingMapLargePage(g_physical_address space, g_virtual_address virt, g_physical_address phys,
+                        uint64_t tableFlags, uint64_t pageFlags)
+{
+	if((virt & G_PAGE_LARGE_ALIGN_MASK) || (phys & G_PAGE_LARGE_ALIGN_MASK))
+		panic("%! tried to map unaligned large page: %h -> %h", "paging", virt, phys);
+
+	auto pd = _pagingGetPageDirectory(space, virt, tableFlags, true);
+	volatile uint64_t* entry = &pd[G_PD_INDEX(virt)];
+	if(*entry)
+		return false;
+
+	*entry = phys | _pagingSmallToLargeFlags(pageFlags);
+	__sync_fetch_and_add(&pagingLargePages, 1);
+	return true;
+}
+
+void pagingSplitLargePage(g_physical_address space, g_virtual_address virt)
+{
+	auto pd = _pagingGetPageDirectory(space, virt, 0, false);
+	if(pd && (pd[G_PD_INDEX(virt)] & G_PAGE_LARGE_PAGE_FLAG))
+		_pagingSplitLargeEntry(space, &pd[G_PD_INDEX(virt)], virt, space == pagingGetCurrentSpace());
+}
+
+void pagingCountLargePages(int32_t delta)
+{
+	__sync_fetch_and_add(&pagingLargePages, delta);
+}
+
+void pagingGetStatistics(g_paging_statistics* out)
+{
+	int64_t largePages = pagingLargePages;
+	out->largePages = largePages < 0 ? 0 : largePages;
+	out->largePagesSplit = pagingLargePagesSplit;
+}
+
+uint32_t pagingUnmapRange(g_physical_address space, g_virtual_address virt, uint32_t pages,
+                          const std::function<void(g_virtual_address virt, g_physical_address phys)>& visitor)
+{
+	bool current = space == pagingGetCurrentSpace();
+	uint32_t unmapped = 0;
+
+	volatile uint64_t* pt = nullptr;
+	for(uint32_t i = 0; i < pages; i++)
+	{
+		g_virtual_address page = virt + i * G_PAGE_SIZE;
+		if(!pt || G_PT_INDEX(page) == 0)
+		{
+			auto pd = _pagingGetPageDirectory(space, page, 0, false);
+			volatile uint64_t* pdEntry = pd ? &pd[G_PD_INDEX(page)] : nullptr;
+
+			// A large page is removed at once if the range covers it completely
+			if(pdEntry && (*pdEntry & G_PAGE_LARGE_PAGE_FLAG))
+			{
+				if(G_PT_INDEX(page) == 0 && pages - i >= G_PAGE_LARGE_PAGES)
+				{
+					g_physical_address base = *pdEntry & G_PAGE_LARGE_ADDRESS_MASK;
+					*pdEntry = 0;
+					__sync_fetch_and_sub(&pagingLargePages, 1);
+					if(current)
+						pagingInvalidatePage(page);
+
+					unmapped += G_PAGE_LARGE_PAGES;
+					if(visitor)
+					{
+						for(uint32_t j = 0; j < G_PAGE_LARGE_PAGES; j++)
+							visitor(page + j * G_PAGE_SIZE, base + j * G_PAGE_SIZE);
+					}
+					i += G_PAGE_LARGE_PAGES - 1;
+					pt = nullptr;
+					continue;
+				}
+				_pagingSplitLargeEntry(space, pdEntry, page, current);
+			}
+			pt = pd ? _pagingGetNextLevel(pd, G_PD_INDEX(page), 0, false) : nullptr;
+		}
+
+		// Nothing is mapped up to the next table
+		if(!pt)
+		{
+			i += 511 - G_PT_INDEX(page);
+			continue;
+		}
+
+		volatile uint64_t* entry = &pt[G_PT_INDEX(page)];
+		uint64_t previous = *entry;
+		if(!previous)
+			continue;
+
+		*entry = 0;
+		unmapped++;
+		if(current)
+			pagingInvalidatePage(page);
+		if(visitor)
+			visitor(page, previous & ~G_PAGE_ALIGN_MASK);
+	}
+
+	if(unmapped)
+		_pagingMarkTlbStale(space, virt);
+	return unmapped;
+}
+
 void pagingUnmapPage(g_virtual_address virt)
 {
-	auto pml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pagingGetCurrentSpace());
+	g_physical_address space = pagingGetCurrentSpace();
+	auto pml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(space);
 	uint64_t pml4Index = G_PML4_INDEX(virt);
 	if(!pml4[pml4Index])
 		return;
@@ -161,6 +536,8 @@ void pagingUnmapPage(g_virtual_address virt)
 	uint64_t pdIndex = G_PD_INDEX(virt);
 	if(!pd[pdIndex])
 		return;
+	if(pd[pdIndex] & G_PAGE_LARGE_PAGE_FLAG)
+		_pagingSplitLargeEntry(space, &pd[pdIndex], virt, true);
 
 	auto pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pd[pdIndex] & ~G_PAGE_ALIGN_MASK);
 	uint64_t ptIndex = G_PT_INDEX(virt);
@@ -168,6 +545,7 @@ void pagingUnmapPage(g_virtual_address virt)
 		return;
 
 	pt[ptIndex] = 0;
+	_pagingMarkTlbStale(space, virt);
 	pagingInvalidatePage(virt);
 }
 
@@ -175,5 +553,5 @@ g_physical_address pagingGetCurrentSpace()
 {
 	g_physical_address directory;
 	asm volatile("mov %%cr3, %0" : "=r"(directory));
-	return directory;
+	return directory & ~G_PAGE_ALIGN_MASK;
 }
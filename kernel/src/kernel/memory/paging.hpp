@@ -23,6 +23,7 @@
 
 #include <ghost/stdint.h>
 #include <ghost/memory/types.h>
+#include "kernel/runtime/itanium_cxx_abi_support.hpp"
 
 #define G_PAGE_PRESENT          (1ULL << 0)  // Page is present
 #define G_PAGE_WRITABLE_FLAG    (1ULL << 1)  // Page is writable
@@ -32,9 +33,21 @@
 #define G_PAGE_ACCESSED_FLAG    (1ULL << 5)  // Page has been accessed
 #define G_PAGE_DIRTY_FLAG       (1ULL << 6)  // Page has been written to (only for PT entries)
 #define G_PAGE_LARGE_PAGE_FLAG  (1ULL << 7)  // Page is a large page (2MB or 1GB)
+#define G_PAGE_PAT_FLAG         (1ULL << 7)  // Selects the upper PAT entries (only for PT entries)
 #define G_PAGE_GLOBAL_FLAG      (1ULL << 8)  // Page is global (only for PT entries)
+#define G_PAGE_COPY_ON_WRITE_FLAG (1ULL << 9) // Page is shared read-only until first write (ignored by CPU)
+#define G_PAGE_SHARED_FLAG      (1ULL << 10) // Page is shared writable between processes (ignored by CPU)
+#define G_PAGE_LARGE_PAT_FLAG   (1ULL << 12) // Selects the upper PAT entries (only for large PD entries)
 #define G_PAGE_NX_FLAG          (1ULL << 63) // No-execute flag (if supported)
 
+/**
+ * Large pages are mapped directly in the page directory and cover 2 MiB
+ */
+#define G_PAGE_LARGE_SIZE           0x200000ULL
+#define G_PAGE_LARGE_PAGES          ((uint32_t) (G_PAGE_LARGE_SIZE / G_PAGE_SIZE))
+#define G_PAGE_LARGE_ALIGN_MASK     (G_PAGE_LARGE_SIZE - 1)
+#define G_PAGE_LARGE_ADDRESS_MASK   0x000FFFFFFFE00000ULL
+
 /**
  * Default flag definitions
  */
@@ -45,6 +58,17 @@
 #define G_PAGE_KERNEL_UNCACHED      (G_PAGE_KERNEL_DEFAULT | G_PAGE_CACHE_DISABLE)
 #define G_PAGE_USER_DEFAULT         (G_PAGE_PRESENT | G_PAGE_WRITABLE_FLAG | G_PAGE_USER_FLAG)
 
+/**
+ * Caching type flags of PT entries, selecting an entry of the PAT as it is
+ * programmed by <processorFinalizeSetup>. Entries 0-3 keep their power-on
+ * defaults, entry 4 is changed to write-combining.
+ */
+#define G_PAGE_CACHING_WRITE_BACK       0
+#define G_PAGE_CACHING_WRITE_THROUGH    (G_PAGE_WRITE_THROUGH)
+#define G_PAGE_CACHING_UNCACHEABLE      (G_PAGE_WRITE_THROUGH | G_PAGE_CACHE_DISABLE)
+#define G_PAGE_CACHING_WRITE_COMBINING  (G_PAGE_PAT_FLAG)
+#define G_PAGE_CACHING_MASK             (G_PAGE_WRITE_THROUGH | G_PAGE_CACHE_DISABLE | G_PAGE_PAT_FLAG)
+
 #define G_PML4_INDEX(addr) (((addr) >> 39) & 0x1FF)
 #define G_PDPT_INDEX(addr) (((addr) >> 30) & 0x1FF)
 #define G_PD_INDEX(addr)   (((addr) >> 21) & 0x1FF)
@@ -53,6 +77,17 @@
     ((((uint64_t)(pml4) << 39) | ((uint64_t)(pdpt) << 30) | ((uint64_t)(pd) << 21) | ((uint64_t)(pt) << 12)) | \
     ((((uint64_t)(pml4) & 0x100) ? 0xFFFF000000000000ULL : 0)))
 
+/**
+ * Highest process-context identifier; PCID 0 is used for untagged switches.
+ */
+#define G_PAGING_PCID_MAX 4095
+
+/**
+ * Number of TLB generation counters. Page spaces are assigned to a counter by the
+ * address of their PML4, spaces that share a counter only flush more often.
+ */
+#define G_PAGING_TLB_GENERATION_SLOTS 1024
+
 /**
  * Switches to the given page directory.
  *
@@ -61,6 +96,59 @@
  */
 void pagingSwitchToSpace(g_physical_address dir);
 
+/**
+ * Switches to the given page directory and tags the TLB entries that are created
+ * while it is active with the PCID. Only allowed if PCIDs are enabled.
+ *
+ * @param dir
+ * 		the directory to switch to
+ * @param pcid
+ * 		the process-context identifier
+ * @param flush
+ * 		whether TLB entries that are tagged with this PCID must be flushed
+ */
+void pagingSwitchToSpace(g_physical_address dir, uint16_t pcid, bool flush);
+
+/**
+ * Flushes all non-global TLB entries of the current address space by reloading CR3.
+ */
+void pagingFlushTlb();
+
+/**
+ * Flushes all TLB entries including global ones and those of other PCIDs by toggling
+ * global pages off and on again.
+ */
+void pagingFlushTlbGlobal();
+
+/**
+ * Enables global pages and process-context identifiers on the current processor if
+ * supported.
+ */
+void pagingInitializePcid();
+
+/**
+ * @return whether process-context identifiers are enabled
+ */
+bool pagingPcidEnabled();
+
+/**
+ * Each time a present mapping of a page space is changed or removed, the TLB generation
+ * of that space is increased. As "invlpg" only affects the current PCID on the current
+ * processor, a processor that sees a different generation than when it last loaded the
+ * space must not trust the TLB entries tagged for it nor skip a switch to it. Changes in
+ * the higher half do not affect any generation, these pages are global and are
+ * invalidated on all processors by the TLB shootdown.
+ *
+ * @return the current TLB generation of the space
+ */
+uint64_t pagingGetTlbGeneration(g_physical_address space);
+
+/**
+ * Increases the TLB generation of the space, for example when it is destroyed and its
+ * physical address may be reused for another one.
+ */
+void pagingMarkTlbStale(g_physical_address space);
+
 /**
  * Maps a page to the current address space.
  *
@@ -86,6 +174,79 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
                    uint64_t ptFlags, uint64_t pageFlags,
                    bool allowOverride = false);
 
+/**
+ * Maps a range of pages in the given page space. The page tables are edited through
+ * the higher half direct map, so the space does not have to be the current one, and
+ * each table is only looked up once for all of its entries.
+ *
+ * Pages that are already mapped are skipped unless overriding is allowed. For each
+ * page that is mapped, the supplier is asked for the physical page; if it returns 0,
+ * mapping stops.
+ *
+ * If a present entry is overridden in a space other than the current one, the caller
+ * must perform a TLB shootdown.
+ *
+ * @return the number of pages that were mapped
+ */
+uint32_t pagingMapRange(g_physical_address space, g_virtual_address virt, uint32_t pages,
+                        uint64_t tableFlags, uint64_t pageFlags,
+                        const std::function<g_physical_address(uint32_t index)>& supplier,
+                        bool allowOverride = false);
+
+/**
+ * Maps a range of pages to physically contiguous memory, see <pagingMapRange>. Parts
+ * where both addresses are aligned to 2 MiB are mapped with large pages if nothing
+ * is mapped there yet.
+ */
+uint32_t pagingMapRangeContiguous(g_physical_address space, g_virtual_address virt, g_physical_address phys,
+                                  uint32_t pages, uint64_t tableFlags, uint64_t pageFlags);
+
+/**
+ * Unmaps a range of pages in the given page space. Tables that don't exist are skipped
+ * as a whole. For each page that was mapped, the visitor is called with its previous
+ * physical address, for example to free it or add it to a TLB shootdown. Large pages
+ * are removed at once if the range covers them and are split otherwise.
+ *
+ * @return the number of pages that were unmapped
+ */
+uint32_t pagingUnmapRange(g_physical_address space, g_virtual_address virt, uint32_t pages,
+                          const std::function<void(g_virtual_address virt, g_physical_address phys)>& visitor = nullptr);
+
+/**
+ * Maps a 2 MiB page in the given space. Both addresses must be aligned to the
+ * large page size and there must be no page table for the area yet.
+ *
+ * @param pageFlags
+ * 		flags like for a small page, the caching type is translated
+ * @return whether the page was mapped
+ */
+bool pagingMapLargePage(g_physical_address space, g_virtual_address virt, g_physical_address phys,
+                        uint64_t tableFlags, uint64_t pageFlags);
+
+/**
+ * Replaces the large page that covers the given address with a page table that maps
+ * the same memory with the same flags. Functions that change single pages do this
+ * on their own, so this is only required when walking the tables directly.
+ */
+void pagingSplitLargePage(g_physical_address space, g_virtual_address virt);
+
+/**
+ * Adjusts the number of mapped large pages for code that copies or frees page
+ * tables directly.
+ */
+void pagingCountLargePages(int32_t delta);
+
+struct g_paging_statistics
+{
+	uint64_t largePages;
+	uint64_t largePagesSplit;
+};
+
+/**
+ * Fills the statistics about the use of large pages.
+ */
+void pagingGetStatistics(g_paging_statistics* out);
+
 /**
  * Unmaps the given virtual page in the current address space.
  *
@@ -120,6 +281,10 @@ static inline void pagingInvalidatePage(g_address addr)
  */
 g_physical_address pagingVirtualToPhysical(g_virtual_address addr);
 
+/**
+ * Returns the entry that maps an address in the current space. If it is covered by
+ * a large page, the entry of a small page that maps the same memory is returned.
+ */
 g_physical_address pagingVirtualToPageEntry(g_virtual_address addr);
 
 #endif
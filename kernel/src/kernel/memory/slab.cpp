@@ -0,0 +1,332 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/memory/slab.hpp"
+#include "kernel/memory/constants.hpp"
+#include "kernel/memory/heap.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/system.hpp"
+#include "kernel/panic.hpp"
+
+/**
+ * Objects start after the header, aligned to 16 bytes.
+ */
+#define G_SLAB_OBJECTS_OFFSET G_ALIGN_UP(sizeof(g_slab), 16)
+
+static const uint32_t slabClassSizes[G_SLAB_CLASS_COUNT] = {16, 32, 64, 96, 128, 192, 256, 512, 1024};
+static g_slab_class slabClasses[G_SLAB_CLASS_COUNT];
+
+/**
+ * Maps (size - 1) / 16 to the class index for sizes up to 256.
+ */
+static uint8_t slabSmallClassIndex[16];
+
+static g_slab_magazine* slabMagazines = nullptr;
+
+g_slab* _slabCreate(g_slab_class* cls);
+void* _slabTake(g_slab_class* cls);
+void _slabGive(g_slab* slab, void* object);
+void _slabRefill(g_slab_class* cls, g_slab_magazine* magazine);
+void _slabFlush(g_slab_class* cls, g_slab_magazine* magazine);
+
+void slabInitialize()
+{
+	for(uint32_t i = 0; i < G_SLAB_CLASS_COUNT; i++)
+	{
+		g_slab_class* cls = &slabClasses[i];
+		mutexInitializeGlobal(&cls->lock, __func__);
+		cls->size = slabClassSizes[i];
+		cls->partial = nullptr;
+		cls->emptySlabs = 0;
+		cls->refills = 0;
+		cls->flushes = 0;
+		cls->slabs = 0;
+		cls->objectsInUse = 0;
+	}
+
+	uint32_t index = 0;
+	for(uint32_t i = 0; i < 16; i++)
+	{
+		while(slabClassSizes[index] < (i + 1) * 16)
+			index++;
+		slabSmallClassIndex[i] = index;
+	}
+}
+
+void slabInitializeMagazines()
+{
+	uint32_t count = processorGetNumberOfProcessors() * G_SLAB_CLASS_COUNT;
+	auto magazines = (g_slab_magazine*) heapAllocate(sizeof(g_slab_magazine) * count);
+	for(uint32_t i = 0; i < count; i++)
+	{
+		magazines[i].count = 0;
+		magazines[i].allocations = 0;
+		magazines[i].frees = 0;
+	}
+	slabMagazines = magazines;
+}
+
+static int _slabClassIndex(uint32_t size)
+{
+	if(size == 0)
+		size = 1;
+	if(size <= 256)
+		return slabSmallClassIndex[(size - 1) / 16];
+	if(size <= 512)
+		return G_SLAB_CLASS_COUNT - 2;
+	if(size <= G_SLAB_MAX_SIZE)
+		return G_SLAB_CLASS_COUNT - 1;
+	return -1;
+}
+
+void* slabAllocate(uint32_t size)
+{
+	int index = _slabClassIndex(size);
+	if(index < 0)
+		return nullptr;
+	g_slab_class* cls = &slabClasses[index];
+
+	// The processor id is only reliable once the system is ready
+	if(slabMagazines && systemIsReady())
+	{
+		void* object = nullptr;
+
+		INTERRUPTS_PAUSE;
+		g_slab_magazine* magazine = &slabMagazines[processorGetCurrentId() * G_SLAB_CLASS_COUNT + index];
+		if(magazine->count == 0)
+			_slabRefill(cls, magazine);
+		if(magazine->count > 0)
+		{
+			object = magazine->objects[--magazine->count];
+			magazine->allocations++;
+		}
+		INTERRUPTS_RESUME;
+
+		return object;
+	}
+
+	mutexAcquire(&cls->lock);
+	void* object = _slabTake(cls);
+	mutexRelease(&cls->lock);
+	return object;
+}
+
+bool slabOwns(void* memory)
+{
+	// Slabs are accessed through the direct map, the heap lies above it
+	auto address = (g_address) memory;
+	return address >= G_MEM_HIGHER_HALF_DIRECT_MAP_OFFSET && address < G_MEM_KERN_VIRT_RANGES_START;
+}
+
+uint32_t slabFree(void* memory)
+{
+	auto slab = (g_slab*) G_ALIGN_DOWN((g_address) memory, G_PAGE_SIZE);
+	if(slab->magic != G_SLAB_MAGIC)
+		panic("%! attempted to free %x which is not in a slab", "slab", memory);
+
+	g_slab_class* cls = slab->owner;
+	if(slabMagazines && systemIsReady())
+	{
+		INTERRUPTS_PAUSE;
+		g_slab_magazine* magazine = &slabMagazines[processorGetCurrentId() * G_SLAB_CLASS_COUNT + (cls - slabClasses)];
+		if(magazine->count == G_SLAB_MAGAZINE_SIZE)
+			_slabFlush(cls, magazine);
+		magazine->objects[magazine->count++] = memory;
+		magazine->frees++;
+		INTERRUPTS_RESUME;
+		return cls->size;
+	}
+
+	mutexAcquire(&cls->lock);
+	_slabGive(slab, memory);
+	mutexRelease(&cls->lock);
+	return cls->size;
+}
+
+void _slabRefill(g_slab_class* cls, g_slab_magazine* magazine)
+{
+	mutexAcquire(&cls->lock);
+	while(magazine->count < G_SLAB_MAGAZINE_SIZE / 2)
+	{
+		void* object = _slabTake(cls);
+		if(!object)
+			break;
+		magazine->objects[magazine->count++] = object;
+	}
+	cls->refills++;
+	mutexRelease(&cls->lock);
+}
+
+void _slabFlush(g_slab_class* cls, g_slab_magazine* magazine)
+{
+	mutexAcquire(&cls->lock);
+	while(magazine->count > G_SLAB_MAGAZINE_SIZE / 2)
+	{
+		void* object = magazine->objects[--magazine->count];
+		_slabGive((g_slab*) G_ALIGN_DOWN((g_address) object, G_PAGE_SIZE), object);
+	}
+	cls->flushes++;
+	mutexRelease(&cls->lock);
+}
+
+g_slab* _slabCreate(g_slab_class* cls)
+{
+	g_physical_address page = memoryPhysicalAllocate(true);
+	if(!page)
+		return nullptr;
+
+	auto slab = (g_slab*) G_MEM_PHYS_TO_VIRT(page);
+	slab->magic = G_SLAB_MAGIC;
+	slab->owner = cls;
+	slab->inUse = 0;
+	slab->capacity = (G_PAGE_SIZE - G_SLAB_OBJECTS_OFFSET) / cls->size;
+
+	// Thread the free list through the objects
+	auto objects = (g_address) slab + G_SLAB_OBJECTS_OFFSET;
+	slab->freeList = nullptr;
+	for(int i = slab->capacity - 1; i >= 0; i--)
+	{
+		auto object = (void**) (objects + i * cls->size);
+		*object = slab->freeList;
+		slab->freeList = object;
+	}
+
+	slab->previous = nullptr;
+	slab->next = cls->partial;
+	if(cls->partial)
+		cls->partial->previous = slab;
+	cls->partial = slab;
+
+	cls->slabs++;
+	cls->emptySlabs++;
+	return slab;
+}
+
+void* _slabTake(g_slab_class* cls)
+{
+	g_slab* slab = cls->partial;
+	if(!slab)
+	{
+		slab = _slabCreate(cls);
+		if(!slab)
+			return nullptr;
+	}
+
+	if(slab->inUse == 0)
+		cls->emptySlabs--;
+
+	void** object = (void**) slab->freeList;
+	slab->freeList = *object;
+	slab->inUse++;
+	cls->objectsInUse++;
+
+	// Full slabs are not kept in any list, a free puts them back
+	if(!slab->freeList)
+	{
+		cls->partial = slab->next;
+		if(slab->next)
+			slab->next->previous = nullptr;
+		slab->next = nullptr;
+	}
+	return object;
+}
+
+void _slabGive(g_slab* slab, void* object)
+{
+	g_slab_class* cls = slab->owner;
+
+	bool wasFull = slab->freeList == nullptr;
+	*((void**) object) = slab->freeList;
+	slab->freeList = object;
+	slab->inUse--;
+	cls->objectsInUse--;
+
+	if(wasFull)
+	{
+		slab->previous = nullptr;
+		slab->next = cls->partial;
+		if(cls->partial)
+			cls->partial->previous = slab;
+		cls->partial = slab;
+	}
+
+	if(slab->inUse > 0)
+		return;
+
+	// Keep one empty slab per class, give the others back
+	if(cls->emptySlabs == 0)
+	{
+		cls->emptySlabs++;
+		return;
+	}
+
+	if(slab->previous)
+		slab->previous->next = slab->next;
+	else
+		cls->partial = slab->next;
+	if(slab->next)
+		slab->next->previous = slab->previous;
+
+	slab->magic = 0;
+	cls->slabs--;
+	buddyAllocatorFree(&memoryPhysicalAllocator, (g_address) slab - G_MEM_HIGHER_HALF_DIRECT_MAP_OFFSET);
+}
+
+uint64_t slabGetUsedAmount()
+{
+	uint64_t amount = 0;
+	for(uint32_t i = 0; i < G_SLAB_CLASS_COUNT; i++)
+		amount += (uint64_t) slabClasses[i].objectsInUse * slabClasses[i].size;
+	return amount;
+}
+
+uint32_t slabGetStatistics(g_slab_statistics* out, uint32_t max)
+{
+	uint32_t count = max < G_SLAB_CLASS_COUNT ? max : G_SLAB_CLASS_COUNT;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		g_slab_class* cls = &slabClasses[i];
+		g_slab_statistics* entry = &out[i];
+
+		mutexAcquire(&cls->lock);
+		entry->size = cls->size;
+		entry->refills = cls->refills;
+		entry->flushes = cls->flushes;
+		entry->slabs = cls->slabs;
+		entry->objectsInUse = cls->objectsInUse;
+		mutexRelease(&cls->lock);
+
+		// Per-processor counters are read without synchronization, they're only statistics
+		entry->allocations = 0;
+		entry->frees = 0;
+		if(slabMagazines)
+		{
+			for(uint32_t p = 0; p < processorGetNumberOfProcessors(); p++)
+			{
+				g_slab_magazine* magazine = &slabMagazines[p * G_SLAB_CLASS_COUNT + i];
+				entry->allocations += magazine->allocations;
+				entry->frees += magazine->frees;
+			}
+		}
+	}
+	return count;
+}
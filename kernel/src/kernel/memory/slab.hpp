@@ -0,0 +1,144 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_MEMORY_SLAB__
+#define __KERNEL_MEMORY_SLAB__
+
+#include "kernel/system/mutex.hpp"
+#include <ghost/memory/types.h>
+
+/**
+ * Number of size classes and the largest size that is served from slabs. Anything
+ * larger is allocated by the heap allocator directly.
+ */
+#define G_SLAB_CLASS_COUNT 9
+#define G_SLAB_MAX_SIZE 1024
+
+/**
+ * Number of objects each processor caches per size class.
+ */
+#define G_SLAB_MAGAZINE_SIZE 32
+
+#define G_SLAB_MAGIC 0x51AB51AB
+
+struct g_slab_class;
+
+/**
+ * Header at the start of each slab. A slab is one physical page, accessed through
+ * the higher half direct map, so the slab of an object is found by aligning its
+ * address down to the page.
+ */
+struct g_slab
+{
+	uint32_t magic;
+	uint16_t inUse;
+	uint16_t capacity;
+	g_slab_class* owner;
+	g_slab* next;
+	g_slab* previous;
+	void* freeList;
+};
+
+struct g_slab_statistics
+{
+	uint32_t size;
+	uint64_t allocations;
+	uint64_t frees;
+	uint64_t refills;
+	uint64_t flushes;
+	uint32_t slabs;
+	uint32_t objectsInUse;
+};
+
+struct g_slab_class
+{
+	g_mutex lock;
+	uint32_t size;
+
+	/**
+	 * Slabs that have at least one free object.
+	 */
+	g_slab* partial;
+	uint32_t emptySlabs;
+
+	uint64_t refills;
+	uint64_t flushes;
+	uint32_t slabs;
+	uint32_t objectsInUse;
+};
+
+/**
+ * Per-processor cache of free objects of one size class. Only accessed by its
+ * processor with interrupts disabled, so it needs no lock.
+ */
+struct g_slab_magazine
+{
+	uint32_t count;
+	void* objects[G_SLAB_MAGAZINE_SIZE];
+
+	uint64_t allocations;
+	uint64_t frees;
+};
+
+/**
+ * Initializes the size classes. Until <slabInitializeMagazines> is called, all
+ * allocations go through the class locks.
+ */
+void slabInitialize();
+
+/**
+ * Creates the per-processor magazines once the number of processors is known.
+ * They are used as soon as the system is ready.
+ */
+void slabInitializeMagazines();
+
+/**
+ * Allocates an object of at least the given size.
+ *
+ * @return the object or nullptr if the size is too large for slabs or there is
+ * 	no physical memory left
+ */
+void* slabAllocate(uint32_t size);
+
+/**
+ * @return whether the memory was allocated by <slabAllocate>
+ */
+bool slabOwns(void* memory);
+
+/**
+ * Frees an object that was allocated by <slabAllocate>.
+ *
+ * @return the size of its class
+ */
+uint32_t slabFree(void* memory);
+
+/**
+ * @return number of bytes that are allocated from slabs
+ */
+uint64_t slabGetUsedAmount();
+
+/**
+ * Fills the statistics of each size class.
+ *
+ * @return number of entries written
+ */
+uint32_t slabGetStatistics(g_slab_statistics* out, uint32_t max);
+
+#endif
@@ -0,0 +1,137 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/memory/tlb_shootdown.hpp"
+#include "kernel/memory/heap.hpp"
+#include "kernel/memory/constants.hpp"
+#include "kernel/memory/paging.hpp"
+#include "kernel/system/interrupts/apic/lapic.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/mutex.hpp"
+#include "kernel/system/system.hpp"
+#include "kernel/tasking/tasking.hpp"
+
+/**
+ * Only one shootdown is in flight at a time. The targets read the request while
+ * the initiator waits for them, so it doesn't need to be copied.
+ */
+static g_mutex shootdownLock;
+static g_tlb_shootdown_batch* shootdownRequest = nullptr;
+static volatile uint32_t shootdownOutstanding = 0;
+static volatile bool* shootdownPending = nullptr;
+
+void tlbShootdownInitialize()
+{
+	mutexInitializeGlobal(&shootdownLock, __func__);
+
+	uint32_t numProcs = processorGetNumberOfProcessors();
+	auto pending = (volatile bool*) heapAllocate(sizeof(bool) * numProcs);
+	for(uint32_t i = 0; i < numProcs; i++)
+		pending[i] = false;
+	shootdownPending = pending;
+}
+
+void tlbShootdownBegin(g_tlb_shootdown_batch* batch, g_physical_address space)
+{
+	batch->space = space;
+	batch->full = false;
+	batch->shared = false;
+	batch->count = 0;
+}
+
+void tlbShootdownAdd(g_tlb_shootdown_batch* batch, g_virtual_address page)
+{
+	if(page > G_MEM_LOWER_HALF_END)
+		batch->shared = true;
+
+	if(batch->full)
+		return;
+
+	if(batch->count == G_TLB_SHOOTDOWN_BATCH_MAX)
+	{
+		batch->full = true;
+		return;
+	}
+	batch->pages[batch->count++] = page;
+}
+
+void tlbShootdownAddAll(g_tlb_shootdown_batch* batch)
+{
+	batch->full = true;
+}
+
+void tlbShootdownFinish(g_tlb_shootdown_batch* batch)
+{
+	if(batch->count == 0 && !batch->full)
+		return;
+
+	if(!shootdownPending || !systemIsReady() || !lapicIsAvailable() || processorGetNumberOfProcessors() == 1)
+		return;
+
+	mutexAcquire(&shootdownLock);
+	shootdownRequest = batch;
+
+	uint32_t self = processorGetCurrentId();
+	g_processor* processor = processorGetList();
+	while(processor)
+	{
+		if(processor->id != self && (batch->shared || taskingGetLocal(processor->id)->spaces.loaded == batch->space))
+		{
+			__sync_fetch_and_add(&shootdownOutstanding, 1);
+			shootdownPending[processor->id] = true;
+			lapicSendIpi(processor->apicId, G_TLB_SHOOTDOWN_VECTOR);
+		}
+		processor = processor->next;
+	}
+
+	while(shootdownOutstanding > 0)
+		asm volatile("pause");
+
+	shootdownRequest = nullptr;
+	mutexRelease(&shootdownLock);
+}
+
+void tlbShootdownHandlePending()
+{
+	if(!shootdownPending)
+		return;
+
+	uint32_t self = processorGetCurrentId();
+	if(!shootdownPending[self])
+		return;
+
+	g_tlb_shootdown_batch* request = shootdownRequest;
+	if(request->full)
+	{
+		if(request->shared)
+			pagingFlushTlbGlobal();
+		else
+			pagingFlushTlb();
+	}
+	else
+	{
+		for(uint32_t i = 0; i < request->count; i++)
+			pagingInvalidatePage(request->pages[i]);
+	}
+
+	shootdownPending[self] = false;
+	__sync_fetch_and_sub(&shootdownOutstanding, 1);
+}
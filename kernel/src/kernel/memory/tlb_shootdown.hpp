@@ -0,0 +1,92 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_TLB_SHOOTDOWN__
+#define __KERNEL_TLB_SHOOTDOWN__
+
+#include <ghost/memory/types.h>
+
+/**
+ * Interrupt vector of the shootdown IPI.
+ */
+#define G_TLB_SHOOTDOWN_VECTOR 0x83
+
+/**
+ * Maximum number of pages that are invalidated one by one. If more pages are
+ * added to a batch, the targets flush their whole TLB instead.
+ */
+#define G_TLB_SHOOTDOWN_BATCH_MAX 32
+
+/**
+ * Collects the pages that were unmapped or remapped within one address space
+ * during an operation, so that other processors are only interrupted once.
+ */
+struct g_tlb_shootdown_batch
+{
+    g_physical_address space;
+    bool full;
+
+    /**
+     * Whether pages of the higher half were added. They are mapped in every space
+     * and may be global, so all processors must invalidate them.
+     */
+    bool shared;
+    uint32_t count;
+    g_virtual_address pages[G_TLB_SHOOTDOWN_BATCH_MAX];
+};
+
+/**
+ * Initializes the shootdown mechanism once the processors are known.
+ */
+void tlbShootdownInitialize();
+
+/**
+ * Starts a batch for the given address space.
+ */
+void tlbShootdownBegin(g_tlb_shootdown_batch* batch, g_physical_address space);
+
+/**
+ * Adds a page to the batch. The caller must already have invalidated it on the
+ * current processor, for example via <pagingUnmapPage>.
+ */
+void tlbShootdownAdd(g_tlb_shootdown_batch* batch, g_virtual_address page);
+
+/**
+ * Makes the targets flush their whole TLB, for example after all writable mappings
+ * of a space were changed. The caller must already have flushed the current processor.
+ */
+void tlbShootdownAddAll(g_tlb_shootdown_batch* batch);
+
+/**
+ * Invalidates the pages of the batch on all other processors that currently have
+ * the address space loaded, or on all of them if the batch is shared, and waits
+ * until they are done. Only after this, physical
+ * pages that were mapped there may be reused.
+ */
+void tlbShootdownFinish(g_tlb_shootdown_batch* batch);
+
+/**
+ * Handles a pending shootdown request for the current processor. Called by the IPI
+ * handler and while spinning with interrupts disabled, so that two processors that
+ * wait for each other can't deadlock.
+ */
+void tlbShootdownHandlePending();
+
+#endif
@@ -0,0 +1,201 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/memory/zero_pool.hpp"
+#include "kernel/memory/constants.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/memory/paging.hpp"
+#include "kernel/system/mutex.hpp"
+#include "kernel/tasking/tasking.hpp"
+
+/**
+ * The free pages are linked through their first quadword, accessed through the
+ * higher half direct map. It is cleared again when a page is taken.
+ */
+static g_mutex zeroPoolLock;
+static g_physical_address zeroPoolHead = 0;
+static uint32_t zeroPoolPages = 0;
+static uint32_t zeroPoolLow = G_ZERO_POOL_DEFAULT_LOW;
+static uint32_t zeroPoolHigh = G_ZERO_POOL_DEFAULT_HIGH;
+
+static uint64_t zeroPoolHits = 0;
+static uint64_t zeroPoolMisses = 0;
+static uint64_t zeroPoolRefilled = 0;
+static uint64_t zeroPoolReclaimed = 0;
+
+/**
+ * Set once the pool dropped below its low watermark, until it is filled up to the
+ * high watermark again.
+ */
+static bool zeroPoolRefilling = true;
+
+g_physical_address _zeroPoolPop();
+uint32_t _zeroPoolShrink(uint32_t keep);
+
+void zeroPoolInitialize()
+{
+	mutexInitializeGlobal(&zeroPoolLock, __func__);
+}
+
+g_physical_address _zeroPoolPop()
+{
+	g_physical_address page = zeroPoolHead;
+	if(page)
+	{
+		auto link = (g_physical_address*) G_MEM_PHYS_TO_VIRT(page);
+		zeroPoolHead = *link;
+		*link = 0;
+		zeroPoolPages--;
+
+		if(zeroPoolPages < zeroPoolLow)
+			zeroPoolRefilling = true;
+	}
+	return page;
+}
+
+g_physical_address zeroPoolTake()
+{
+	mutexAcquire(&zeroPoolLock);
+	g_physical_address page = _zeroPoolPop();
+	if(page)
+		zeroPoolHits++;
+	mutexRelease(&zeroPoolLock);
+	return page;
+}
+
+g_physical_address zeroPoolReclaim()
+{
+	mutexAcquire(&zeroPoolLock);
+	g_physical_address page = _zeroPoolPop();
+	if(page)
+		zeroPoolReclaimed++;
+	mutexRelease(&zeroPoolLock);
+	return page;
+}
+
+uint32_t zeroPoolDrain()
+{
+	return _zeroPoolShrink(0);
+}
+
+void zeroPoolCountMiss()
+{
+	mutexAcquire(&zeroPoolLock);
+	zeroPoolMisses++;
+	mutexRelease(&zeroPoolLock);
+}
+
+void zeroPoolRefill()
+{
+	if(!zeroPoolRefilling)
+		return;
+
+	g_tasking_local* local = taskingGetLocal();
+	while(zeroPoolRefilling && *((volatile uint32_t*) &local->scheduling.readyCount) == 0)
+	{
+		if(buddyAllocatorGetFreePageCount(&memoryPhysicalAllocator) < G_ZERO_POOL_MINIMUM_FREE)
+			return;
+
+		g_physical_address page = buddyAllocatorAllocate(&memoryPhysicalAllocator, 0);
+		if(!page)
+			return;
+		memoryZeroPage((void*) G_MEM_PHYS_TO_VIRT(page));
+
+		mutexAcquire(&zeroPoolLock);
+		bool full = zeroPoolPages >= zeroPoolHigh;
+		if(!full)
+		{
+			*((g_physical_address*) G_MEM_PHYS_TO_VIRT(page)) = zeroPoolHead;
+			zeroPoolHead = page;
+			zeroPoolPages++;
+			zeroPoolRefilled++;
+		}
+		if(zeroPoolPages >= zeroPoolHigh)
+			zeroPoolRefilling = false;
+		mutexRelease(&zeroPoolLock);
+
+		// Another processor filled the pool in the meantime
+		if(full)
+			buddyAllocatorFree(&memoryPhysicalAllocator, page);
+	}
+}
+
+bool zeroPoolSetWatermarks(uint32_t low, uint32_t high)
+{
+	if(low > high || high == 0)
+		return false;
+
+	uint64_t available = buddyAllocatorGetFreePageCount(&memoryPhysicalAllocator);
+
+	mutexAcquire(&zeroPoolLock);
+	available += zeroPoolPages;
+	if(high > available / G_ZERO_POOL_MAXIMUM_SHARE)
+	{
+		mutexRelease(&zeroPoolLock);
+		return false;
+	}
+	zeroPoolLow = low;
+	zeroPoolHigh = high;
+	zeroPoolRefilling = zeroPoolPages < low;
+	mutexRelease(&zeroPoolLock);
+
+	_zeroPoolShrink(high);
+	return true;
+}
+
+/**
+ * Returns pages of the pool to the physical allocator until at most <keep> are left.
+ */
+uint32_t _zeroPoolShrink(uint32_t keep)
+{
+	uint32_t count = 0;
+	g_physical_address excess = 0;
+
+	mutexAcquire(&zeroPoolLock);
+	while(zeroPoolPages > keep)
+	{
+		g_physical_address page = _zeroPoolPop();
+		*((g_physical_address*) G_MEM_PHYS_TO_VIRT(page)) = excess;
+		excess = page;
+		count++;
+	}
+	mutexRelease(&zeroPoolLock);
+
+	while(excess)
+	{
+		g_physical_address next = *((g_physical_address*) G_MEM_PHYS_TO_VIRT(excess));
+		buddyAllocatorFree(&memoryPhysicalAllocator, excess);
+		excess = next;
+	}
+	return count;
+}
+
+void zeroPoolGetStatistics(g_zero_pool_statistics* out)
+{
+	mutexAcquire(&zeroPoolLock);
+	out->pages = zeroPoolPages;
+	out->low = zeroPoolLow;
+	out->high = zeroPoolHigh;
+	out->hits = zeroPoolHits;
+	out->misses = zeroPoolMisses;
+	out->refilled = zeroPoolRefilled;
+	out->reclaimed = zeroPoolReclaimed;
+	mutexRelease(&zeroPoolLock);
+}
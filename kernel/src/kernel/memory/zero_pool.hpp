@@ -0,0 +1,103 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_MEMORY_ZERO_POOL__
+#define __KERNEL_MEMORY_ZERO_POOL__
+
+#include <ghost/memory/types.h>
+
+/**
+ * Default watermarks of the pool in pages. Once the pool drops below the low
+ * watermark, idle processors refill it up to the high watermark.
+ */
+#define G_ZERO_POOL_DEFAULT_LOW 256
+#define G_ZERO_POOL_DEFAULT_HIGH 1024
+
+/**
+ * The pool is not refilled while fewer pages than this are free, so that it never
+ * takes memory from allocations that cannot be served from it.
+ */
+#define G_ZERO_POOL_MINIMUM_FREE 4096
+
+/**
+ * The high watermark may be at most this fraction of the free physical memory.
+ */
+#define G_ZERO_POOL_MAXIMUM_SHARE 8
+
+struct g_zero_pool_statistics
+{
+	uint32_t pages;
+	uint32_t low;
+	uint32_t high;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t refilled;
+	uint64_t reclaimed;
+};
+
+void zeroPoolInitialize();
+
+/**
+ * Takes a zeroed page from the pool.
+ *
+ * @return the physical address of an untracked page or 0 if the pool is empty
+ */
+g_physical_address zeroPoolTake();
+
+/**
+ * Takes a page from the pool when the physical allocator is out of memory. This
+ * is not counted as a hit, as the caller does not rely on the page being zeroed.
+ *
+ * @return the physical address of an untracked page or 0 if the pool is empty
+ */
+g_physical_address zeroPoolReclaim();
+
+/**
+ * Returns all pages of the pool to the physical allocator, so that they can be
+ * merged into larger blocks again. Used when a contiguous allocation fails.
+ *
+ * @return the number of pages that were returned
+ */
+uint32_t zeroPoolDrain();
+
+/**
+ * Counts an allocation that could not be served from the pool.
+ */
+void zeroPoolCountMiss();
+
+/**
+ * Zeroes pages with non-temporal stores and adds them to the pool if it has dropped
+ * below its low watermark, until the high watermark is reached or the processor has
+ * something else to do. Called by the idle task of each processor.
+ */
+void zeroPoolRefill();
+
+/**
+ * Changes the watermarks. Pages above the new high watermark are returned to the
+ * physical allocator.
+ *
+ * @return false if the watermarks are invalid or the high watermark is more than
+ * 		the allowed share of free memory, see G_ZERO_POOL_MAXIMUM_SHARE
+ */
+bool zeroPoolSetWatermarks(uint32_t low, uint32_t high);
+
+void zeroPoolGetStatistics(g_zero_pool_statistics* out);
+
+#endif
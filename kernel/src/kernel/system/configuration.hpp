@@ -26,4 +26,10 @@
  */
 #define G_TIMER_FREQUENCY 1000
 
+/**
+ * Whether the timer should only be armed for the next event instead of firing
+ * periodically. Requires a TSC with a constant rate.
+ */
+#define G_TIMER_TICKLESS true
+
 #endif
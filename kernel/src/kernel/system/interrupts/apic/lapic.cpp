@@ -23,11 +23,25 @@
 #include "kernel/system/acpi/acpi.hpp"
 #include "kernel/system/configuration.hpp"
 #include "kernel/system/timing/pit.hpp"
+#include "kernel/system/timing/tsc.hpp"
+#include "kernel/system/processor/processor.hpp"
 #include "kernel/panic.hpp"
 #include "kernel/logger/logger.hpp"
 
 static bool available = false;
 
+enum class g_lapic_timer_mode
+{
+	PERIODIC,
+	ONESHOT,
+	TSC_DEADLINE
+};
+
+static g_lapic_timer_mode timerMode = g_lapic_timer_mode::PERIODIC;
+
+// The timer runs with the bus frequency, which is the same on all processors
+static uint32_t timerTicksPer10ms = 0;
+
 // All APICs are at the same physical and virtual address
 static g_physical_address physicalBase = 0;
 static g_virtual_address virtualBase = 0;
@@ -115,6 +129,24 @@ void lapicStartTimer()
 {
 	logDebug("%! starting timer", "lapic");
 
+	if(G_TIMER_TICKLESS && tscIsAvailable())
+	{
+		if(processorHasFeature(g_cpuid_extended_ecx_feature::TSC_DEADLINE))
+		{
+			timerMode = g_lapic_timer_mode::TSC_DEADLINE;
+
+			// The deadline MSR must only be written once the LVT is in deadline mode
+			lapicWrite(APIC_REGISTER_LVT_TIMER, 0x20 | APIC_LVT_TIMER_MODE_TSC_DEADLINE);
+			asm volatile("mfence" ::: "memory");
+
+			// Fire once, so that scheduling starts when interrupts are enabled
+			lapicArmTimer(0);
+			return;
+		}
+
+		timerMode = g_lapic_timer_mode::ONESHOT;
+	}
+
 	// Tell APIC timer to use divider 16
 	lapicWrite(APIC_REGISTER_TIMER_DIV, 0x3);
 
@@ -132,13 +164,55 @@ void lapicStartTimer()
 
 	// Now we know how often the APIC timer has ticked in 10ms
 	uint32_t ticksPer10ms = 0xFFFFFFFF - lapicRead(APIC_REGISTER_TIMER_CURRCNT);
+	timerTicksPer10ms = ticksPer10ms;
 
-	// Start timer as periodic on IRQ 0
 	lapicWrite(APIC_REGISTER_TIMER_DIV, 0x3);
+	if(timerMode == g_lapic_timer_mode::ONESHOT)
+	{
+		// One-shot on IRQ 0, fire once so that scheduling starts when interrupts are enabled
+		lapicWrite(APIC_REGISTER_LVT_TIMER, 0x20 | APIC_LVT_TIMER_MODE_ONESHOT);
+		lapicArmTimer(0);
+		return;
+	}
+
+	// Start timer as periodic on IRQ 0
 	lapicWrite(APIC_REGISTER_LVT_TIMER, 0x20 | APIC_LVT_TIMER_MODE_PERIODIC);
 	lapicWrite(APIC_REGISTER_TIMER_INITCNT, ticksPer10ms / (G_TIMER_FREQUENCY / 100));
 }
 
+bool lapicIsTimerOneShot()
+{
+	return timerMode != g_lapic_timer_mode::PERIODIC;
+}
+
+void lapicArmTimer(uint64_t nanos)
+{
+	if(timerMode == g_lapic_timer_mode::TSC_DEADLINE)
+	{
+		// Zero would disarm the timer
+		uint64_t deadline = tscFromNanos(nanos);
+		if(deadline == 0)
+			deadline = 1;
+		processorWriteMsr(IA32_TSC_DEADLINE_MSR, deadline & 0xFFFFFFFF, deadline >> 32);
+		return;
+	}
+
+	if(timerMode == g_lapic_timer_mode::ONESHOT)
+	{
+		uint64_t now = tscGetNanos();
+		uint64_t delay = nanos > now ? nanos - now : 0;
+		if(delay > G_LAPIC_TIMER_MAX_DELAY)
+			delay = G_LAPIC_TIMER_MAX_DELAY;
+
+		uint64_t ticks = delay * timerTicksPer10ms / 10000000;
+		if(ticks == 0)
+			ticks = 1;
+		else if(ticks > 0xFFFFFFFF)
+			ticks = 0xFFFFFFFF;
+		lapicWrite(APIC_REGISTER_TIMER_INITCNT, (uint32_t) ticks);
+	}
+}
+
 void lapicSendEndOfInterrupt()
 {
 	lapicWrite(APIC_REGISTER_EOI, 0);
@@ -146,7 +220,16 @@ void lapicSendEndOfInterrupt()
 
 void lapicWaitForIcrSend()
 {
-	while(APIC_LVT_GET_DELIVERY_STATUS(lapicRead(APIC_REGISTER_INT_COMMAND_HIGH)) == APIC_ICR_DELIVS_SEND_PENDING)
+	while(APIC_LVT_GET_DELIVERY_STATUS(lapicRead(APIC_REGISTER_INT_COMMAND_LOW)) == 1)
 	{
+		asm volatile("pause");
 	}
 }
+
+void lapicSendIpi(uint32_t apicId, uint8_t vector)
+{
+	lapicWaitForIcrSend();
+	lapicWrite(APIC_REGISTER_INT_COMMAND_HIGH, apicId << 24);
+	lapicWrite(APIC_REGISTER_INT_COMMAND_LOW, vector | APIC_ICR_DELMOD_FIXED | APIC_ICR_LEVEL_ASSERT |
+	                                          APIC_ICR_DEST_SHORTHAND_NONE);
+}
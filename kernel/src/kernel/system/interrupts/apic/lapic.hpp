@@ -25,6 +25,12 @@
 
 #define G_EXPECTED_APIC_PHYSICAL_ADDRESS 0xFEE00000
 
+/**
+ * Longest delay that the timer is armed for in one-shot mode, to keep the counter
+ * from overflowing.
+ */
+#define G_LAPIC_TIMER_MAX_DELAY 1000000000ULL
+
 /**
  * APIC register offsets (to APICs base address)
  */
@@ -122,14 +128,37 @@ uint32_t lapicReadId();
 
 void lapicCreateMapping();
 
+/**
+ * Starts the timer of the current processor. With <G_TIMER_TICKLESS> and a usable TSC,
+ * the timer is put into TSC-deadline mode or, if that's not supported, one-shot mode
+ * and must be armed with <lapicArmTimer>. Otherwise it fires periodically with
+ * <G_TIMER_FREQUENCY>.
+ */
 void lapicStartTimer();
 
+/**
+ * @return whether the timer only fires when armed with <lapicArmTimer>
+ */
+bool lapicIsTimerOneShot();
+
+/**
+ * Arms the timer of the current processor to fire at the given time, as returned by
+ * <tscGetNanos>. Replaces the previous deadline; times in the past fire immediately.
+ */
+void lapicArmTimer(uint64_t nanos);
+
 uint32_t lapicRead(uint32_t reg);
 
 void lapicWrite(uint32_t reg, uint32_t value);
 
 void lapicWaitForIcrSend();
 
+/**
+ * Sends a fixed inter-processor interrupt with the given vector to the processor
+ * with the given local APIC id.
+ */
+void lapicSendIpi(uint32_t apicId, uint8_t vector);
+
 void lapicSendEndOfInterrupt();
 
 #endif
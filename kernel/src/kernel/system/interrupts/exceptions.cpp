@@ -101,6 +101,10 @@ g_elf_object* exceptionsFindResponsibleObject(g_task* task, g_address rip)
 {
 	g_elf_object* object = nullptr;
 
+	// Forked processes don't own the objects of their parent
+	if(!task->process->object)
+		return nullptr;
+
 	auto iter = hashmapIteratorStart(task->process->object->loadedObjects);
 	while(hashmapIteratorHasNext(&iter))
 	{
@@ -212,7 +216,9 @@ void exceptionsDumpState(g_task* task, volatile g_processor_state* state)
 	{
 		logInfo("%#   task stack: %h - %h", task->stack.start, task->stack.end);
 		logInfo("%#   intr stack: %h - %h", task->interruptStack.start, task->interruptStack.end);
-
+	}
+	if(task && task->process->object)
+	{
 		logInfo("%# loaded objects:");
 		auto iter = hashmapIteratorStart(task->process->object->loadedObjects);
 		while(hashmapIteratorHasNext(&iter))
@@ -234,6 +240,10 @@ bool exceptionsHandlePageFault(g_task* task, volatile g_processor_state* state)
 
 	if(task)
 	{
+		// Write to a present page
+		if((state->error & 3) == 3 && memoryCopyOnWriteHandlePageFault(task, accessed))
+			return true;
+
 		if(taskingMemoryHandleStackOverflow(task, accessed))
 			return true;
 
@@ -316,6 +326,13 @@ void exceptionsHandle(g_task* task, volatile g_processor_state* state)
 			resolved = exceptionsKillTask(task);
 			break;
 		}
+		case 0x07:
+		{
+			// Device not available, FPU used while CR0.TS is set
+			taskingHandleFpuTrap(task);
+			resolved = true;
+			break;
+		}
 	}
 
 	if(!resolved)
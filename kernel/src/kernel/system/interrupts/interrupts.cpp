@@ -22,6 +22,7 @@
 #include "kernel/memory/gdt.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/calls/syscall.hpp"
+#include "kernel/memory/tlb_shootdown.hpp"
 #include "kernel/system/interrupts/apic/ioapic.hpp"
 #include "kernel/system/interrupts/apic/lapic.hpp"
 #include "kernel/system/interrupts/exceptions.hpp"
@@ -32,6 +33,7 @@
 #include "kernel/system/timing/pit.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/panic.hpp"
 
 void _interruptsSendEndOfInterrupt(uint8_t irq);
@@ -70,6 +72,7 @@ extern "C" volatile g_processor_state* _interruptHandler(volatile g_processor_st
 	g_task* task = taskingGetCurrentTask();
 	if(task)
 		taskingSaveState(task, (g_processor_state*) state);
+	clockRefresh();
 
 	if(state->intr < 0x20) // Exception
 	{
@@ -87,6 +90,15 @@ extern "C" volatile g_processor_state* _interruptHandler(volatile g_processor_st
 	{
 		taskingFinalizeSpawn(task);
 	}
+	else if(state->intr == G_TLB_SHOOTDOWN_VECTOR) // TLB shootdown IPI
+	{
+		tlbShootdownHandlePending();
+		lapicSendEndOfInterrupt();
+	}
+	else if(state->intr == G_SCHEDULER_WAKE_VECTOR) // Task became ready, timer is armed below
+	{
+		lapicSendEndOfInterrupt();
+	}
 	else
 	{
 		uint8_t irq = state->intr - 0x20;
@@ -108,6 +120,12 @@ extern "C" volatile g_processor_state* _interruptHandler(volatile g_processor_st
 	if(newTask != task)
 		taskingRestoreState(newTask);
 
+	clockArmTimer();
+
+	// Nothing on the stack of the previous task is used after this
+	if(task && newTask != task)
+		schedulerFinishSwitch(task);
+
 	return newTask->state;
 }
 
@@ -268,8 +286,8 @@ void interruptsInstallRoutines()
 	idtCreateGate(0x80, (void*) _isr80, G_IDT_FLAGS_INTERRUPT_GATE_USER); // syscall
 	idtCreateGate(0x81, (void*) _isr81, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // yield
 	idtCreateGate(0x82, (void*) _isr82, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // privilege downgrade
-	idtCreateGate(0x83, (void*) _isr83, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
-	idtCreateGate(0x84, (void*) _isr84, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
+	idtCreateGate(0x83, (void*) _isr83, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // TLB shootdown
+	idtCreateGate(0x84, (void*) _isr84, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // Scheduler wake
 	idtCreateGate(0x85, (void*) _isr85, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
 	idtCreateGate(0x86, (void*) _isr86, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
 	idtCreateGate(0x87, (void*) _isr87, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
@@ -22,8 +22,10 @@
 #include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/system/interrupts/requests.hpp"
 #include "kernel/system/processor/processor.hpp"
+#include "kernel/logger/logger.hpp"
 
 static g_tid registrations[256] = {};
+static g_pid msiOwners[256] = {};
 static g_mutex registrationsLock;
 
 void requestsInitialize()
@@ -32,14 +34,21 @@ void requestsInitialize()
 	for(int i = 0; i < 256; i++)
 	{
 		registrations[i] = G_TID_NONE;
+		msiOwners[i] = G_PID_NONE;
 	}
 }
 
-void requestsSetHandlerTask(uint8_t irq, g_tid task)
+bool requestsSetHandlerTask(uint8_t irq, g_task* task)
 {
+	uint32_t vector = irq + 0x20;
+	bool msi = vector >= G_REQUESTS_MSI_VECTOR_START && vector < G_REQUESTS_MSI_VECTOR_END;
+
 	mutexAcquire(&registrationsLock);
-	registrations[irq] = task;
+	bool permitted = !msi || msiOwners[vector] == task->process->id;
+	if(permitted)
+		registrations[irq] = task->id;
 	mutexRelease(&registrationsLock);
+	return permitted;
 }
 
 g_tid requestsGetHandlerTask(uint8_t irq)
@@ -61,9 +70,77 @@ void requestsHandle(g_task* currentTask, uint8_t irq)
 		return;
 
 	taskingWake(handlerTask);
+
+	// Only switch directly if the handler is scheduled on this processor, otherwise it
+	// is picked from the ready queue of the processor it is assigned to
+	if(handlerTask->assignment != taskingGetLocal())
+		return;
+
 	taskingSetCurrent(handlerTask);
 
 	// Once the handler has finished, let the scheduler go back to interrupted task
 	if(currentTask)
 		schedulerPrefer(currentTask->id);
 }
+
+uint8_t requestsAllocateMsi(g_pid owner, uint8_t count)
+{
+	if(count == 0 || count > G_REQUESTS_MSI_MAX_COUNT || (count & (count - 1)) != 0)
+		return 0;
+
+	mutexAcquire(&registrationsLock);
+	for(uint32_t first = G_REQUESTS_MSI_VECTOR_START; first + count <= G_REQUESTS_MSI_VECTOR_END; first += count)
+	{
+		bool free = true;
+		for(uint32_t vector = first; vector < first + count; vector++)
+		{
+			if(msiOwners[vector] != G_PID_NONE)
+			{
+				free = false;
+				break;
+			}
+		}
+		if(!free)
+			continue;
+
+		for(uint32_t vector = first; vector < first + count; vector++)
+			msiOwners[vector] = owner;
+		mutexRelease(&registrationsLock);
+		return first - 0x20;
+	}
+	mutexRelease(&registrationsLock);
+
+	logInfo("%! no block of %i vectors free for process %i", "msi", count, owner);
+	return 0;
+}
+
+void requestsFreeMsi(g_pid owner)
+{
+	mutexAcquire(&registrationsLock);
+	for(uint32_t vector = G_REQUESTS_MSI_VECTOR_START; vector < G_REQUESTS_MSI_VECTOR_END; vector++)
+	{
+		if(msiOwners[vector] != owner)
+			continue;
+
+		msiOwners[vector] = G_PID_NONE;
+		registrations[vector - 0x20] = G_TID_NONE;
+	}
+	mutexRelease(&registrationsLock);
+}
+
+void requestsGetMsiMessage(uint8_t irq, uint64_t* outAddress, uint32_t* outData)
+{
+	uint32_t apicId = 0;
+	for(g_processor* processor = processorGetList(); processor; processor = processor->next)
+	{
+		if(processor->bsp)
+		{
+			apicId = processor->apicId;
+			break;
+		}
+	}
+
+	// Fixed delivery, edge-triggered, physical destination
+	*outAddress = 0xFEE00000 | (apicId << 12);
+	*outData = 0x20 + irq;
+}
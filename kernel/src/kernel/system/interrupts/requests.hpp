@@ -23,6 +23,14 @@
 
 #include "kernel/tasking/task.hpp"
 
+/**
+ * Range of vectors that are handed out for message-signaled interrupts. It lies
+ * between the IRQs routed by the I/O APIC and the system call vector.
+ */
+#define G_REQUESTS_MSI_VECTOR_START 0x40
+#define G_REQUESTS_MSI_VECTOR_END 0x80
+#define G_REQUESTS_MSI_MAX_COUNT 32
+
 void requestsInitialize();
 
 /**
@@ -31,13 +39,39 @@ void requestsInitialize();
 g_tid requestsGetHandlerTask(uint8_t irq);
 
 /**
- * Sets the registered task for an IRQ.
+ * Sets the registered task for an IRQ. Vectors for message-signaled interrupts may
+ * only be handled by a task of the process they were allocated for.
+ *
+ * @return whether the task was registered
  */
-void requestsSetHandlerTask(uint8_t irq, g_tid task);
+bool requestsSetHandlerTask(uint8_t irq, g_task* task);
 
 /**
  * Wakes a registered IRQ handler.
  */
 void requestsHandle(g_task* currentTask, uint8_t irq);
 
+/**
+ * Allocates a block of consecutive vectors for message-signaled interrupts. The
+ * block is aligned to its size, since a device with multiple MSI messages only
+ * changes the low bits of the message data.
+ *
+ * @param owner the process that the vectors belong to
+ * @param count number of vectors, a power of two
+ * @return the IRQ of the first vector or 0 if no block was free
+ */
+uint8_t requestsAllocateMsi(g_pid owner, uint8_t count);
+
+/**
+ * Frees all message-signaled interrupt vectors of a process and removes their
+ * handler tasks.
+ */
+void requestsFreeMsi(g_pid owner);
+
+/**
+ * Returns the message address and data that a device must write to raise the given
+ * IRQ. Messages are delivered to the bootstrap processor, where IRQs are awaited.
+ */
+void requestsGetMsiMessage(uint8_t irq, uint64_t* outAddress, uint32_t* outData);
+
 #endif
@@ -23,6 +23,7 @@
 #include "kernel/system/processor/processor.hpp"
 #include "kernel/system/system.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/memory/tlb_shootdown.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/panic.hpp"
 
@@ -32,8 +33,13 @@
 
 g_spinlock mutexInitializerLock = 0;
 
+static g_mutex_statistics mutexStatistics[G_MUTEX_STATISTICS_SLOTS] = {};
+static g_spinlock mutexStatisticsLock = 0;
+
 bool _mutexTryAcquire(g_mutex* mutex, uint32_t owner, bool hadIF);
 void _mutexInitialize(g_mutex* mutex, g_mutex_type type, const char* location);
+bool _mutexSleep(g_mutex* mutex, uint32_t owner);
+void _mutexRecordAcquire(g_mutex* mutex, bool contended, uint64_t waitStart);
 
 void mutexErrorUninitialized(g_mutex* mutex)
 {
@@ -60,6 +66,9 @@ void _mutexInitialize(g_mutex* mutex, g_mutex_type type, const char* location)
 	mutex->owner = -1;
 	mutex->type = type;
 	mutex->location = location;
+	mutex->waitersHead = nullptr;
+	mutex->waitersTail = nullptr;
+	mutex->statistics = nullptr;
 
 	G_SPINLOCK_RELEASE(mutexInitializerLock);
 }
@@ -90,17 +99,34 @@ void mutexAcquire(g_mutex* mutex)
 
 	int deadlock = 0;
 	uint32_t pauses = 1;
+	bool contended = false;
+	uint64_t waitStart = 0;
 	while(!_mutexTryAcquire(mutex, owner, hadIF))
 	{
+		if(!contended)
+		{
+			contended = true;
+			waitStart = processorReadTsc();
+		}
+
 		// As long as any global mutex is locked, we may never yield
 		if(mutex->type == G_MUTEX_TYPE_GLOBAL || taskingGetLocal()->locking.globalLockCount > 0)
 		{
+			// Interrupts are disabled, so answer shootdowns the owner might be waiting for
+			tlbShootdownHandlePending();
+
 			for(uint32_t i = 0; i < pauses; i++)
 				asm volatile("pause");
 			pauses *= 2;
 			if(pauses > G_MUTEX_MAX_PAUSES)
 				pauses = G_MUTEX_MAX_PAUSES;
 		}
+		else if(systemIsReady())
+		{
+			// Sleep until the releasing task hands over the mutex
+			if(_mutexSleep(mutex, owner))
+				break;
+		}
 		else
 		{
 			taskingYield();
@@ -113,11 +139,225 @@ void mutexAcquire(g_mutex* mutex)
 					 mutex->location, mutex->owner);
 	}
 
+	if(mutex->type == G_MUTEX_TYPE_TASK)
+		_mutexRecordAcquire(mutex, contended, waitStart);
+
 	// Only for task mutexes (and if previously enabled) interrupts are enabled again
 	if(mutex->type == G_MUTEX_TYPE_TASK && hadIF)
 		interruptsEnable();
 }
 
+/**
+ * Checks whether the mutex was handed over to the waiter. If so, the waiter takes it and
+ * is detached from the mutex, until then a cleanup could still pass the mutex on.
+ */
+bool _mutexTakeHandOver(g_mutex* mutex, g_mutex_waiter* waiter)
+{
+	G_SPINLOCK_ACQUIRE(mutex->lock);
+	bool owned = mutex->depth > 0 && mutex->owner == waiter->task;
+	if(owned)
+		waiter->mutex = nullptr;
+	G_SPINLOCK_RELEASE(mutex->lock);
+	return owned;
+}
+
+void _mutexSetWaiting(g_task* task, g_mutex* mutex)
+{
+	mutexAcquire(&task->lock);
+	task->status = G_TASK_STATUS_WAITING;
+	task->waitsFor = mutex->location;
+	mutexRelease(&task->lock);
+}
+
+/**
+ * Puts the current task to sleep until the mutex is handed over to it. The task is marked
+ * as waiting before it is queued so that a handover in between can't be missed.
+ *
+ * @return true if the mutex is now owned by the task, false if it should try again
+ */
+bool _mutexSleep(g_mutex* mutex, uint32_t owner)
+{
+	g_task* task = taskingGetCurrentTask();
+	g_mutex_waiter* waiter = &task->mutexWaiter;
+
+	_mutexSetWaiting(task, mutex);
+
+	G_SPINLOCK_ACQUIRE(mutex->lock);
+	if(mutex->depth == 0)
+	{
+		// Released in the meantime
+		G_SPINLOCK_RELEASE(mutex->lock);
+		taskingWake(task);
+		return false;
+	}
+
+	waiter->task = owner;
+	waiter->next = nullptr;
+	waiter->mutex = mutex;
+	if(mutex->waitersTail)
+		mutex->waitersTail->next = waiter;
+	else
+		mutex->waitersHead = waiter;
+	mutex->waitersTail = waiter;
+	G_SPINLOCK_RELEASE(mutex->lock);
+
+	for(;;)
+	{
+		taskingYield();
+		if(_mutexTakeHandOver(mutex, waiter))
+			return true;
+
+		// Woken for a different reason while still queued
+		_mutexSetWaiting(task, mutex);
+		if(_mutexTakeHandOver(mutex, waiter))
+		{
+			taskingWake(task);
+			return true;
+		}
+	}
+}
+
+/**
+ * Hands the mutex over to the first waiter that is still alive. Must be called while holding
+ * the spinlock of the mutex. The waiter stays attached to the mutex until its task takes it.
+ *
+ * @return the task that now owns the mutex or null
+ */
+g_task* _mutexHandOver(g_mutex* mutex)
+{
+	while(mutex->waitersHead)
+	{
+		g_mutex_waiter* waiter = mutex->waitersHead;
+		mutex->waitersHead = waiter->next;
+		if(!mutex->waitersHead)
+			mutex->waitersTail = nullptr;
+
+		waiter->next = nullptr;
+
+		g_task* task = taskingGetById(waiter->task);
+		if(task && task->status != G_TASK_STATUS_DEAD)
+		{
+			mutex->owner = waiter->task;
+			mutex->depth = 1;
+			return task;
+		}
+		waiter->mutex = nullptr;
+	}
+	return nullptr;
+}
+
+void mutexRemoveWaiter(g_mutex_waiter* waiter)
+{
+	g_mutex* mutex = waiter->mutex;
+	if(!mutex)
+		return;
+
+	bool hadIF = interruptsAreEnabled();
+	interruptsDisable();
+	G_SPINLOCK_ACQUIRE(mutex->lock);
+
+	// May have been taken by the task in the meantime
+	g_task* handedTo = nullptr;
+	if(waiter->mutex == mutex)
+	{
+		if(mutex->depth > 0 && mutex->owner == waiter->task)
+		{
+			// Handed over, but the task never ran to take it; pass it on
+			mutex->depth = 0;
+			mutex->owner = G_MUTEX_NO_OWNER;
+			handedTo = _mutexHandOver(mutex);
+		}
+		else
+		{
+			g_mutex_waiter* previous = nullptr;
+			g_mutex_waiter* entry = mutex->waitersHead;
+			while(entry && entry != waiter)
+			{
+				previous = entry;
+				entry = entry->next;
+			}
+
+			if(entry)
+			{
+				if(previous)
+					previous->next = waiter->next;
+				else
+					mutex->waitersHead = waiter->next;
+
+				if(mutex->waitersTail == waiter)
+					mutex->waitersTail = previous;
+			}
+		}
+
+		waiter->next = nullptr;
+		waiter->mutex = nullptr;
+	}
+
+	G_SPINLOCK_RELEASE(mutex->lock);
+
+	if(handedTo)
+		taskingWake(handedTo);
+
+	if(hadIF)
+		interruptsEnable();
+}
+
+g_mutex_statistics* _mutexFindStatistics(const char* location)
+{
+	uint32_t slot = (uint32_t) (((g_address) location >> 3) % G_MUTEX_STATISTICS_SLOTS);
+	g_mutex_statistics* found = nullptr;
+
+	G_SPINLOCK_ACQUIRE(mutexStatisticsLock);
+	for(uint32_t i = 0; i < G_MUTEX_STATISTICS_SLOTS; i++)
+	{
+		g_mutex_statistics* entry = &mutexStatistics[(slot + i) % G_MUTEX_STATISTICS_SLOTS];
+		if(entry->location == location)
+		{
+			found = entry;
+			break;
+		}
+		if(entry->location == nullptr)
+		{
+			entry->location = location;
+			found = entry;
+			break;
+		}
+	}
+	G_SPINLOCK_RELEASE(mutexStatisticsLock);
+
+	return found;
+}
+
+void _mutexRecordAcquire(g_mutex* mutex, bool contended, uint64_t waitStart)
+{
+	g_mutex_statistics* statistics = mutex->statistics;
+	if(!statistics)
+	{
+		statistics = _mutexFindStatistics(mutex->location);
+		if(!statistics)
+			return;
+		mutex->statistics = statistics;
+	}
+
+	__sync_fetch_and_add(&statistics->acquires, 1);
+	if(contended)
+	{
+		__sync_fetch_and_add(&statistics->contended, 1);
+		__sync_fetch_and_add(&statistics->waitCycles, processorReadTsc() - waitStart);
+	}
+}
+
+uint32_t mutexGetStatistics(g_mutex_statistics* out, uint32_t max)
+{
+	uint32_t count = 0;
+	for(uint32_t i = 0; i < G_MUTEX_STATISTICS_SLOTS && count < max; i++)
+	{
+		if(mutexStatistics[i].location)
+			out[count++] = mutexStatistics[i];
+	}
+	return count;
+}
+
 bool _mutexTryAcquire(g_mutex* mutex, uint32_t owner, bool hadIF)
 {
 	bool wasSet = false;
@@ -158,6 +398,8 @@ void mutexRelease(g_mutex* mutex)
 	bool setIF = false;
 	interruptsDisable();
 
+	g_task* handedTo = nullptr;
+
 	G_SPINLOCK_ACQUIRE(mutex->lock);
 
 	if(mutex->depth > 0)
@@ -179,11 +421,18 @@ void mutexRelease(g_mutex* mutex)
 
 			// Remove owner
 			mutex->owner = -1;
+
+			// Hand task mutexes over to the next waiter in line
+			if(mutex->type == G_MUTEX_TYPE_TASK)
+				handedTo = _mutexHandOver(mutex);
 		}
 	}
 
 	G_SPINLOCK_RELEASE(mutex->lock);
 
+	if(handedTo)
+		taskingWake(handedTo);
+
 	// Restore IF state according to rules above
 	if(setIF)
 		interruptsEnable();
@@ -29,7 +29,42 @@ typedef int g_mutex_type;
 #define G_MUTEX_TYPE_GLOBAL   ((g_mutex_type) 0)
 #define G_MUTEX_TYPE_TASK     ((g_mutex_type) 1)
 
-typedef struct
+/**
+ * Number of different mutex locations for which contention statistics are recorded.
+ */
+#define G_MUTEX_STATISTICS_SLOTS 256
+
+struct g_mutex;
+
+/**
+ * Task waiting for a task mutex to be handed over. Each task has one, since a task
+ * sleeps on at most one mutex at a time.
+ */
+struct g_mutex_waiter
+{
+    uint32_t task;
+    g_mutex_waiter* next;
+
+    /**
+     * Mutex this waiter is queued in or was handed over but not yet taken, or null.
+     * Only changed while holding the spinlock of that mutex.
+     */
+    g_mutex* mutex;
+};
+
+/**
+ * Contention statistics, shared by all task mutexes that were initialized with
+ * the same location.
+ */
+struct g_mutex_statistics
+{
+    const char* location;
+    uint64_t acquires;
+    uint64_t contended;
+    uint64_t waitCycles;
+};
+
+typedef struct g_mutex
 {
     volatile int initialized;
     g_spinlock lock;
@@ -38,10 +73,19 @@ typedef struct
     g_mutex_type type;
     int depth;
     uint32_t owner;
+
+    /**
+     * Tasks sleeping on a task mutex, in the order they will receive it.
+     */
+    g_mutex_waiter* waitersHead;
+    g_mutex_waiter* waitersTail;
+
+    g_mutex_statistics* statistics;
 } __attribute__((packed)) g_mutex;
 
 /**
- * Initializes a task mutex. This mutex will yield until it can be acquired.
+ * Initializes a task mutex. On contention, the acquiring task sleeps until the
+ * mutex is handed over to it by the releasing task.
  */
 void mutexInitializeTask(g_mutex* mutex, const char* location = "unknown");
 
@@ -61,4 +105,18 @@ void mutexAcquire(g_mutex* mutex);
  */
 void mutexRelease(g_mutex* mutex);
 
+/**
+ * Removes the waiter from the mutex it is queued in, if any. If the mutex was already
+ * handed over to it, it is passed on to the next waiter. Must be called before the
+ * task that the waiter belongs to is destroyed.
+ */
+void mutexRemoveWaiter(g_mutex_waiter* waiter);
+
+/**
+ * Copies the recorded contention statistics of task mutexes to the given array.
+ *
+ * @return number of entries written
+ */
+uint32_t mutexGetStatistics(g_mutex_statistics* out, uint32_t max);
+
 #endif
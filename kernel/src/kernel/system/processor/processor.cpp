@@ -24,12 +24,25 @@
 #include "kernel/system/system.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/memory/gdt.hpp"
+#include "kernel/calls/syscall.hpp"
 #include "kernel/panic.hpp"
 
 static g_processor* processors = nullptr;
 static uint32_t processorsAvailable = 0;
 static uint32_t* apicIdToProcessorMapping = nullptr;
 
+/**
+ * FPU state format; all processors are assumed to support the same features.
+ */
+static bool fpuXsaveAvailable = false;
+static bool fpuXsaveoptAvailable = false;
+static uint32_t fpuStateSize = G_SSE_STATE_SIZE;
+
+void _processorInitializeSyscallInstruction();
+void _processorInitializeXsave();
+void _processorInitializeWriteProtect();
+void _processorInitializePat();
+
 /**
  * @return the current processor structure; only available after all cores have
  *	been initialized and the system was marked ready
@@ -58,19 +71,120 @@ void processorFinalizeSetup()
 	if(processorHasFeature(g_cpuid_standard_edx_feature::SSE))
 	{
 		_enableSSE();
+		_processorInitializeXsave();
 		auto core = _processorGetCurrent();
 		core->sseReady = true;
 		logDebug("%! %i: SSE2 support enabled", "cpu", processorGetCurrentId());
 
 		// TODO Allocator not capable of aligned allocation
-		core->fpu.initialStateMem = (uint8_t*) heapAllocate(G_SSE_STATE_SIZE + G_SSE_STATE_ALIGNMENT);
-		core->fpu.initialState = (uint8_t*) G_ALIGN_UP((g_address) core->fpu.initialStateMem, G_SSE_STATE_ALIGNMENT);
+		core->fpu.initialStateMem = (uint8_t*) heapAllocate(fpuStateSize + G_FPU_STATE_ALIGNMENT);
+		core->fpu.initialState = (uint8_t*) G_ALIGN_UP((g_address) core->fpu.initialStateMem, G_FPU_STATE_ALIGNMENT);
+		memorySetBytes(core->fpu.initialState, 0, fpuStateSize);
 		processorSaveFpuState(core->fpu.initialState);
 	}
 	else
 	{
 		logWarn("%! no SSE support", "cpu");
 	}
+
+	_processorInitializeSyscallInstruction();
+	_processorInitializeWriteProtect();
+	_processorInitializePat();
+}
+
+void _processorInitializeWriteProtect()
+{
+	// Kernel writes to read-only user pages must fault for copy-on-write to work,
+	// the application processors don't inherit this from the bootloader
+	uint64_t cr0;
+	asm volatile("mov %%cr0, %0"
+		: "=r"(cr0));
+	cr0 |= G_CR0_WP;
+	asm volatile("mov %0, %%cr0"
+		:
+		: "r"(cr0));
+}
+
+void _processorInitializePat()
+{
+	if(!processorHasFeature(g_cpuid_standard_edx_feature::PAT))
+	{
+		logWarn("%! %i: no PAT support, write-combining is not available", "cpu", processorGetCurrentId());
+		return;
+	}
+
+	// Keep the lower half at the power-on defaults so that PWT/PCD keep their meaning,
+	// PAT entry 4 becomes write-combining. Must be identical on all processors.
+	uint32_t lo = IA32_PAT_WB | (IA32_PAT_WT << 8) | (IA32_PAT_UC_MINUS << 16) | (IA32_PAT_UC << 24);
+	uint32_t hi = IA32_PAT_WC | (IA32_PAT_WT << 8) | (IA32_PAT_UC_MINUS << 16) | (IA32_PAT_UC << 24);
+	processorWriteMsr(IA32_PAT_MSR, lo, hi);
+
+	logDebug("%! %i: PAT initialized", "cpu", processorGetCurrentId());
+}
+
+void _processorInitializeSyscallInstruction()
+{
+	if(!processorHasFeature(g_cpuid_extended_edx_feature::SYSCALL))
+	{
+		logDebug("%! %i: no SYSCALL support, only int 0x80 is available", "cpu", processorGetCurrentId());
+		return;
+	}
+
+	// SYSCALL loads CS from STAR[47:32] and SS from that + 8. SYSRET loads SS from
+	// STAR[63:48] + 8 and CS from that + 16, which requires user data to precede user code.
+	uint32_t starHi = (G_GDT_DESCRIPTOR_KERNEL_CODE) | ((G_GDT_DESCRIPTOR_USER_DATA - 8) << 16);
+	processorWriteMsr(IA32_STAR_MSR, 0, starHi);
+
+	auto entry = (g_address) _syscallRoutine;
+	processorWriteMsr(IA32_LSTAR_MSR, entry & 0xFFFFFFFF, entry >> 32);
+
+	// Clear IF, TF, DF and AC on entry
+	processorWriteMsr(IA32_FMASK_MSR, (1 << 9) | (1 << 8) | (1 << 10) | (1 << 18), 0);
+
+	uint32_t eferLo;
+	uint32_t eferHi;
+	processorReadMsr(IA32_EFER_MSR, &eferLo, &eferHi);
+	processorWriteMsr(IA32_EFER_MSR, eferLo | IA32_EFER_SCE, eferHi);
+
+	logDebug("%! %i: SYSCALL support enabled", "cpu", processorGetCurrentId());
+}
+
+void _processorInitializeXsave()
+{
+	if(!processorHasFeature(g_cpuid_extended_ecx_feature::XSAVE))
+		return;
+
+	uint32_t eax;
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	processorCpuidSubleaf(0xD, 0, &eax, &ebx, &ecx, &edx);
+	uint32_t supported = eax;
+
+	uint64_t cr4;
+	asm volatile("mov %%cr4, %0"
+		: "=r"(cr4));
+	cr4 |= G_CR4_OSXSAVE;
+	asm volatile("mov %0, %%cr4"
+		:
+		: "r"(cr4));
+
+	uint32_t components = G_XCR0_X87 | G_XCR0_SSE;
+	if(processorHasFeature(g_cpuid_extended_ecx_feature::AVX) && (supported & G_XCR0_AVX))
+		components |= G_XCR0_AVX;
+	asm volatile("xsetbv"
+		:
+		: "c"(0), "a"(components), "d"(0));
+
+	// EBX now reports the area size for the components enabled in XCR0
+	processorCpuidSubleaf(0xD, 0, &eax, &ebx, &ecx, &edx);
+	fpuStateSize = ebx;
+	processorCpuidSubleaf(0xD, 1, &eax, &ebx, &ecx, &edx);
+	fpuXsaveoptAvailable = (eax & (1 << 0));
+	fpuXsaveAvailable = true;
+
+	logDebug("%! %i: XSAVE%s enabled, components %x, state size %i", "cpu", processorGetCurrentId(),
+	         fpuXsaveoptAvailable ? "OPT" : "", components, fpuStateSize);
 }
 
 bool processorHasFeatureReady(g_cpuid_standard_edx_feature feature)
@@ -186,6 +300,14 @@ void processorCpuid(uint32_t code, uint32_t* outA, uint32_t* outB, uint32_t* out
 		: "a"(code));
 }
 
+void processorCpuidSubleaf(uint32_t code, uint32_t subleaf, uint32_t* outA, uint32_t* outB, uint32_t* outC,
+                           uint32_t* outD)
+{
+	asm volatile("cpuid"
+		: "=a"(*outA), "=b"(*outB), "=c"(*outC), "=d"(*outD)
+		: "a"(code), "c"(subleaf));
+}
+
 bool processorHasFeature(g_cpuid_standard_edx_feature feature)
 {
 	uint32_t eax;
@@ -206,6 +328,62 @@ bool processorHasFeature(g_cpuid_extended_ecx_feature feature)
 	return (ecx & (uint64_t) feature);
 }
 
+bool processorHasFeature(g_cpuid_extended_edx_feature feature)
+{
+	uint32_t eax;
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	processorCpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+	if(eax < 0x80000001)
+		return false;
+
+	processorCpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+	return (edx & (uint64_t) feature);
+}
+
+bool processorHasFeature(g_cpuid_power_edx_feature feature)
+{
+	uint32_t eax;
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	processorCpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+	if(eax < 0x80000007)
+		return false;
+
+	processorCpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+	return (edx & (uint64_t) feature);
+}
+
+bool processorHasFeature(g_cpuid_structured_ebx_feature feature)
+{
+	uint32_t eax;
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	processorCpuid(0, &eax, &ebx, &ecx, &edx);
+	if(eax < 7)
+		return false;
+
+	processorCpuidSubleaf(7, 0, &eax, &ebx, &ecx, &edx);
+	return (ebx & (uint64_t) feature);
+}
+
+bool processorHasFeature(g_cpuid_structured_edx_feature feature)
+{
+	uint32_t eax;
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	processorCpuid(0, &eax, &ebx, &ecx, &edx);
+	if(eax < 7)
+		return false;
+
+	processorCpuidSubleaf(7, 0, &eax, &ebx, &ecx, &edx);
+	return (edx & (uint64_t) feature);
+}
+
 void processorGetVendor(char* out)
 {
 	uint32_t eax;
@@ -283,22 +461,77 @@ uint64_t processorReadEflags()
 
 void processorSaveFpuState(uint8_t* target)
 {
-	asm volatile (
-		"fxsave (%0)"
-		:
-		: "r" (target)
-		: "memory"
-	);
+	if(fpuXsaveoptAvailable)
+	{
+		// Skips components that are unmodified since the last XRSTOR from this buffer
+		asm volatile (
+			"xsaveopt (%0)"
+			:
+			: "r" (target), "a" (0xFFFFFFFF), "d" (0xFFFFFFFF)
+			: "memory"
+		);
+	}
+	else if(fpuXsaveAvailable)
+	{
+		asm volatile (
+			"xsave (%0)"
+			:
+			: "r" (target), "a" (0xFFFFFFFF), "d" (0xFFFFFFFF)
+			: "memory"
+		);
+	}
+	else
+	{
+		asm volatile (
+			"fxsave (%0)"
+			:
+			: "r" (target)
+			: "memory"
+		);
+	}
 }
 
 void processorRestoreFpuState(uint8_t* source)
 {
-	asm volatile (
-		"fxrstor (%0)"
+	if(fpuXsaveAvailable)
+	{
+		asm volatile (
+			"xrstor (%0)"
+			:
+			: "r" (source), "a" (0xFFFFFFFF), "d" (0xFFFFFFFF)
+			: "memory"
+		);
+	}
+	else
+	{
+		asm volatile (
+			"fxrstor (%0)"
+			:
+			: "r" (source)
+			: "memory"
+		);
+	}
+}
+
+uint32_t processorGetFpuStateSize()
+{
+	return fpuStateSize;
+}
+
+void processorSetTaskSwitched()
+{
+	uint64_t cr0;
+	asm volatile("mov %%cr0, %0"
+		: "=r"(cr0));
+	cr0 |= G_CR0_TS;
+	asm volatile("mov %0, %%cr0"
 		:
-		: "r" (source)
-		: "memory"
-	);
+		: "r"(cr0));
+}
+
+void processorClearTaskSwitched()
+{
+	asm volatile("clts");
 }
 
 const uint8_t* processorGetInitialFpuState()
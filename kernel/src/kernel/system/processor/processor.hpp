@@ -24,7 +24,23 @@
 #include <ghost/stdint.h>
 
 #define G_SSE_STATE_SIZE       512
-#define G_SSE_STATE_ALIGNMENT  0x10
+#define G_FPU_STATE_ALIGNMENT  0x40
+
+/**
+ * Control register bits
+ */
+#define G_CR0_TS        (1 << 3)
+#define G_CR0_WP        (1 << 16)
+#define G_CR4_PGE       (1 << 7)
+#define G_CR4_PCIDE     (1 << 17)
+#define G_CR4_OSXSAVE   (1 << 18)
+
+/**
+ * XCR0 state components
+ */
+#define G_XCR0_X87      (1 << 0)
+#define G_XCR0_SSE      (1 << 1)
+#define G_XCR0_AVX      (1 << 2)
 
 /**
  * CPUID.1 feature flags
@@ -83,16 +99,55 @@ enum class g_cpuid_extended_ecx_feature
     CX16 = 1 << 13,
     ETPRD = 1 << 14,
     PDCM = 1 << 15,
+    PCID = 1 << 17,
     DCA = 1 << 18,
     SSE4_1 = 1 << 19,
     SSE4_2 = 1 << 20,
     x2APIC = 1 << 21,
     MOVBE = 1 << 22,
     POPCNT = 1 << 23,
+    TSC_DEADLINE = 1 << 24,
     AES = 1 << 25,
     XSAVE = 1 << 26,
     OSXSAVE = 1 << 27,
-    AVX = 1 << 28
+    AVX = 1 << 28,
+    HYPERVISOR = (int) (1u << 31) // Running in a virtual machine
+};
+
+/**
+ * CPUID.80000001h EDX feature flags
+ */
+enum class g_cpuid_extended_edx_feature
+{
+    SYSCALL = 1 << 11, // SYSCALL / SYSRET
+    NX = 1 << 20, // No-execute bit
+    PAGE1GB = 1 << 26, // 1 GiB pages
+    RDTSCP = 1 << 27, // RDTSCP instruction
+    LM = 1 << 29 // Long mode
+};
+
+/**
+ * CPUID.80000007h EDX advanced power management flags
+ */
+enum class g_cpuid_power_edx_feature
+{
+    INVARIANT_TSC = 1 << 8 // TSC runs at a constant rate in all states
+};
+
+/**
+ * CPUID.7.0 EBX structured extended feature flags
+ */
+enum class g_cpuid_structured_ebx_feature
+{
+    ERMS = 1 << 9 // Enhanced REP MOVSB / STOSB
+};
+
+/**
+ * CPUID.7.0 EDX structured extended feature flags
+ */
+enum class g_cpuid_structured_edx_feature
+{
+    FSRM = 1 << 4 // Fast short REP MOVSB
 };
 
 /**
@@ -102,6 +157,21 @@ enum class g_cpuid_extended_ecx_feature
 #define IA32_APIC_BASE_MSR_BSP		0x100
 #define IA32_APIC_BASE_MSR_ENABLE	0x800
 
+#define IA32_TSC_DEADLINE_MSR		0x6E0
+
+#define IA32_PAT_MSR				0x277
+#define IA32_PAT_UC					0x00
+#define IA32_PAT_WC					0x01
+#define IA32_PAT_WT					0x04
+#define IA32_PAT_WB					0x06
+#define IA32_PAT_UC_MINUS			0x07
+
+#define IA32_EFER_MSR				0xC0000080
+#define IA32_EFER_SCE				0x1
+#define IA32_STAR_MSR				0xC0000081
+#define IA32_LSTAR_MSR				0xC0000082
+#define IA32_FMASK_MSR				0xC0000084
+
 struct g_processor
 {
     uint32_t id;
@@ -125,6 +195,12 @@ struct g_processor
  */
 void processorCpuid(uint32_t code, uint32_t* outA, uint32_t* outB, uint32_t* outC, uint32_t* outD);
 
+/**
+ * Performs a CPUID call for a leaf with sub-leaves (passed in ECX).
+ */
+void processorCpuidSubleaf(uint32_t code, uint32_t subleaf, uint32_t* outA, uint32_t* outB, uint32_t* outC,
+                           uint32_t* outD);
+
 /**
  * Enables SSE on the current processor.
  */
@@ -193,6 +269,26 @@ bool processorHasFeature(g_cpuid_standard_edx_feature feature);
  */
 bool processorHasFeature(g_cpuid_extended_ecx_feature feature);
 
+/**
+ * Checks if the processor supports the given extended EDX feature.
+ */
+bool processorHasFeature(g_cpuid_extended_edx_feature feature);
+
+/**
+ * Checks if the processor supports the given advanced power management feature.
+ */
+bool processorHasFeature(g_cpuid_power_edx_feature feature);
+
+/**
+ * Checks if the processor supports the given structured extended EBX feature.
+ */
+bool processorHasFeature(g_cpuid_structured_ebx_feature feature);
+
+/**
+ * Checks if the processor supports the given structured extended EDX feature.
+ */
+bool processorHasFeature(g_cpuid_structured_edx_feature feature);
+
 /**
  * Prints information about the processor.
  */
@@ -220,19 +316,37 @@ void processorWriteMsr(uint32_t msr, uint32_t lo, uint32_t hi);
 uint64_t processorReadEflags();
 
 /**
- * Saves the FPU state to the target
+ * Saves the FPU state to the target. Uses XSAVEOPT or XSAVE if available,
+ * otherwise FXSAVE.
  *
- * @param target the 16-byte aligned target buffer
+ * @param target the 64-byte aligned target buffer
  */
 void processorSaveFpuState(uint8_t* target);
 
 /**
  * Restore the FPU state from the source.
  *
- * @param source the 16-byte aligned source buffer
+ * @param source the 64-byte aligned source buffer
  */
 void processorRestoreFpuState(uint8_t* source);
 
+/**
+ * Returns the size of a buffer required to hold the FPU state. This depends
+ * on the state components that were enabled in XCR0.
+ */
+uint32_t processorGetFpuStateSize();
+
+/**
+ * Sets CR0.TS, so the next FPU/SSE instruction raises a device-not-available
+ * exception (#NM).
+ */
+void processorSetTaskSwitched();
+
+/**
+ * Clears CR0.TS, allowing FPU/SSE instructions to execute.
+ */
+void processorClearTaskSwitched();
+
 /**
  * Checks if a processor feature is available and initialized.
  *
@@ -244,7 +358,7 @@ bool processorHasFeatureReady(g_cpuid_standard_edx_feature feature);
 /**
  * Returns a pointer to the FPU state as it was after initialization.
  *
- * @return a 16-byte aligned pointer to the buffer
+ * @return a 64-byte aligned pointer to the buffer
  */
 const uint8_t* processorGetInitialFpuState();
 
@@ -25,10 +25,14 @@
 #include "kernel/system/interrupts/apic/apic.hpp"
 #include "kernel/system/interrupts/interrupts.hpp"
 #include "kernel/system/timing/hpet.hpp"
+#include "kernel/system/timing/tsc.hpp"
 #include "kernel/system/smp.hpp"
 #include "kernel/panic.hpp"
 #include "kernel/logger/logger.hpp"
+#include "kernel/memory/memory.hpp"
 #include "kernel/memory/paging.hpp"
+#include "kernel/memory/slab.hpp"
+#include "kernel/memory/tlb_shootdown.hpp"
 
 static int applicationCoresWaiting;
 static bool bspInitialized = false;
@@ -41,6 +45,7 @@ void systemInitializeBsp(g_physical_address rsdp)
 	acpiInitialize(rsdp);
 	apicDetect();
 	hpetInitialize();
+	tscInitialize();
 
 	if(!processorListAvailable())
 		panic("%! no processors found", "system");
@@ -52,6 +57,10 @@ void systemInitializeBsp(g_physical_address rsdp)
 	syscallRegisterAll();
 
 	processorFinalizeSetup();
+	pagingInitializePcid();
+	tlbShootdownInitialize();
+	slabInitializeMagazines();
+	buddyAllocatorInitializeCaches(&memoryPhysicalAllocator);
 
 	auto numCores = processorGetNumberOfProcessors();
 	if(numCores > 1)
@@ -66,6 +75,7 @@ void systemInitializeAp()
 	gdtInitializeLocal();
 	interruptsInitializeAp();
 	processorFinalizeSetup();
+	pagingInitializePcid();
 }
 
 void systemWaitForApplicationCores()
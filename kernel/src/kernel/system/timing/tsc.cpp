@@ -0,0 +1,125 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/system/timing/tsc.hpp"
+#include "kernel/system/timing/hpet.hpp"
+#include "kernel/system/timing/pit.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/logger/logger.hpp"
+
+static bool available = false;
+static uint64_t frequency = 0;
+static uint64_t base = 0;
+
+/**
+ * Nanoseconds per TSC tick as 32.32 fixed point, and TSC ticks per nanosecond as
+ * 40.24 fixed point. Converting only multiplies, no 128-bit division is needed.
+ */
+static uint64_t nanosPerTick = 0;
+static uint64_t ticksPerNano = 0;
+
+#define G_TSC_TICKS_SHIFT 24
+
+uint64_t _tscMeasure();
+
+void tscInitialize()
+{
+	if(!processorHasFeature(g_cpuid_standard_edx_feature::TSC))
+	{
+		logInfo("%! not supported", "tsc");
+		return;
+	}
+
+	// Take the shortest of a few runs, the others were disturbed
+	uint64_t ticks = 0;
+	for(int run = 0; run < 3; run++)
+	{
+		uint64_t measured = _tscMeasure();
+		if(ticks == 0 || measured < ticks)
+			ticks = measured;
+	}
+
+	frequency = ticks * (1000000 / G_TSC_CALIBRATION_TIME);
+	if(frequency == 0)
+	{
+		logInfo("%! calibration failed", "tsc");
+		return;
+	}
+	nanosPerTick = (1000000000ULL << G_TSC_NANOS_SHIFT) / frequency;
+	ticksPerNano = (frequency << G_TSC_TICKS_SHIFT) / 1000000000ULL;
+	base = processorReadTsc();
+
+	// Without an invariant TSC the rate changes with power states. Virtual machines
+	// usually don't report it, but give a constant rate anyway.
+	available = processorHasFeature(g_cpuid_power_edx_feature::INVARIANT_TSC) ||
+	            processorHasFeature(g_cpuid_extended_ecx_feature::HYPERVISOR);
+
+	logInfo("%! calibrated to %i MHz against %s, %s", "tsc", (uint32_t) (frequency / 1000000),
+	        hpetIsAvailable() ? "hpet" : "pit", available ? "invariant" : "not invariant");
+}
+
+uint64_t _tscMeasure()
+{
+	if(hpetIsAvailable())
+	{
+		uint64_t startNanos = hpetGetNanos();
+		uint64_t start = processorReadTsc();
+		while(hpetGetNanos() - startNanos < G_TSC_CALIBRATION_TIME * 1000ULL)
+		{
+		}
+		return processorReadTsc() - start;
+	}
+
+	pitPrepareSleep(G_TSC_CALIBRATION_TIME);
+	uint64_t start = processorReadTsc();
+	pitPerformSleep();
+	return processorReadTsc() - start;
+}
+
+bool tscIsAvailable()
+{
+	return available;
+}
+
+uint64_t tscGetFrequency()
+{
+	return frequency;
+}
+
+uint64_t tscGetNanos()
+{
+	return tscToNanos(processorReadTsc());
+}
+
+uint64_t tscToNanos(uint64_t tsc)
+{
+	uint64_t ticks = tsc - base;
+	return (uint64_t) (((unsigned __int128) ticks * nanosPerTick) >> G_TSC_NANOS_SHIFT);
+}
+
+uint64_t tscGetNanosMultiplier()
+{
+	return nanosPerTick;
+}
+
+uint64_t tscFromNanos(uint64_t nanos)
+{
+	return base + (uint64_t) (((unsigned __int128) nanos * ticksPerNano) >> G_TSC_TICKS_SHIFT);
+}
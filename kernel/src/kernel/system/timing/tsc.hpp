@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_TSC__
+#define __KERNEL_TSC__
+
+#include <ghost/stdint.h>
+
+/**
+ * Duration in microseconds over which the TSC frequency is measured.
+ */
+#define G_TSC_CALIBRATION_TIME 10000
+
+/**
+ * Fixed-point shift of the multiplier returned by <tscGetNanosMultiplier>.
+ */
+#define G_TSC_NANOS_SHIFT 32
+
+/**
+ * Measures the frequency of the time stamp counter against the HPET, or against
+ * the PIT if there is no HPET. Must be called on the BSP.
+ */
+void tscInitialize();
+
+/**
+ * @return whether the TSC runs at a constant rate and can be used as clock source
+ */
+bool tscIsAvailable();
+
+/**
+ * @return the TSC frequency in Hz
+ */
+uint64_t tscGetFrequency();
+
+/**
+ * @return nanoseconds since the TSC was calibrated
+ */
+uint64_t tscGetNanos();
+
+/**
+ * Converts a TSC value to nanoseconds since the TSC was calibrated.
+ */
+uint64_t tscToNanos(uint64_t tsc);
+
+/**
+ * @return nanoseconds per TSC tick, shifted left by <G_TSC_NANOS_SHIFT>
+ */
+uint64_t tscGetNanosMultiplier();
+
+/**
+ * Converts a time as returned by <tscGetNanos> to the matching TSC value.
+ */
+uint64_t tscFromNanos(uint64_t nanos);
+
+#endif
@@ -21,6 +21,7 @@
 #include "kernel/memory/heap.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/system/interrupts/interrupts.hpp"
 
 void taskingCleanupThread()
@@ -48,6 +49,7 @@ void taskingCleanupThread()
 					previous->next = next;
 				else
 					local->scheduling.list = next;
+				schedulerRemove(local, task);
 
 				entry->next = deadList;
 				deadList = entry;
@@ -78,7 +80,7 @@ void taskingCleanupThread()
 		self->status = G_TASK_STATUS_WAITING;
 		self->waitsFor = "cleanup-sleep";
 		mutexRelease(&self->lock);
-		clockWaitForTime(self->id, clockGetLocal()->time + 3000);
+		clockWaitForTime(self, clockGetNanos() + 3000 * 1000000ULL);
 		taskingYield();
 		INTERRUPTS_RESUME;
 	}
@@ -17,34 +17,38 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
  *                                                                           *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-
 #include "kernel/tasking/clock.hpp"
 #include "kernel/memory/heap.hpp"
 #include "kernel/system/configuration.hpp"
 #include "kernel/system/processor/processor.hpp"
+#include "kernel/system/interrupts/apic/lapic.hpp"
 #include "kernel/system/timing/hpet.hpp"
+#include "kernel/system/timing/tsc.hpp"
+#include "kernel/tasking/clock_page.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/panic.hpp"
 #include "kernel/logger/logger.hpp"
 
 static g_clock_local* locals = nullptr;
 
+void _clockWheelAdd(g_clock_local* local, g_clock_waiter* waiter);
+void _clockWheelRemove(g_clock_waiter* waiter);
+void _clockWheelAdvance(g_clock_local* local, uint64_t now);
+uint64_t _clockWheelNext(g_clock_wheel* wheel);
+
 void clockInitialize()
 {
 	uint32_t numProcs = processorGetNumberOfProcessors();
-	locals = (g_clock_local*) heapAllocate(sizeof(g_clock_local) * numProcs);
+	locals = (g_clock_local*) heapAllocateClear(sizeof(g_clock_local) * numProcs);
 
 	for(uint32_t i = 0; i < numProcs; i++)
 	{
 		mutexInitializeGlobal(&locals[i].lock, __func__);
-		locals[i].waiters = nullptr;
-		locals[i].time = 0;
-		locals[i].lastNanoTime = 0;
-		locals[i].lastRecalibrateMilliTime = 0;
-#if G_DEBUG_THREAD_DUMPING
-		locals[i].lastLogTime = 0;
-#endif
+		locals[i].sliceTask = G_TID_NONE;
 	}
+
+	clockPageInitialize();
 }
 
 g_clock_local* clockGetLocal()
@@ -55,64 +59,223 @@ g_clock_local* clockGetLocal()
 	return &locals[processorGetCurrentId()];
 }
 
-void clockWaitForTime(g_tid task, uint64_t wakeTime)
+/**
+ * Locks the local that the waiter is queued in. Returns null if it isn't queued.
+ */
+g_clock_local* _clockLockWaiter(g_clock_waiter* waiter)
 {
+	for(;;)
+	{
+		g_clock_local* local = waiter->local;
+		if(!local)
+			return nullptr;
+
+		mutexAcquire(&local->lock);
+		if(waiter->local == local)
+			return local;
+		mutexRelease(&local->lock);
+	}
+}
+
+void clockWaitForTime(g_task* task, uint64_t wakeTime)
+{
+	g_clock_waiter* waiter = &task->clockWaiter;
+
+	auto previous = _clockLockWaiter(waiter);
+	if(previous)
+	{
+		_clockWheelRemove(waiter);
+		mutexRelease(&previous->lock);
+	}
+
 	auto local = clockGetLocal();
 	mutexAcquire(&local->lock);
-
-	g_clock_waiter* waiter = (g_clock_waiter*) heapAllocate(sizeof(g_clock_waiter));
 	waiter->task = task;
 	waiter->wakeTime = wakeTime;
+	_clockWheelAdd(local, waiter);
+	mutexRelease(&local->lock);
+}
+
+void clockUnwaitForTime(g_task* task)
+{
+	g_clock_waiter* waiter = &task->clockWaiter;
+
+	auto local = _clockLockWaiter(waiter);
+	if(local)
+	{
+		_clockWheelRemove(waiter);
+		mutexRelease(&local->lock);
+	}
+}
+
+bool clockHasTimedOut(g_task* task)
+{
+	auto local = _clockLockWaiter(&task->clockWaiter);
+	if(!local)
+		return true;
+
+	mutexRelease(&local->lock);
+	return false;
+}
+
+void _clockWheelAdd(g_clock_local* local, g_clock_waiter* waiter)
+{
+	g_clock_wheel* wheel = &local->wheel;
+
+	// Round up, so that a waiter never expires early
+	uint64_t unit = (waiter->wakeTime >> G_CLOCK_WHEEL_RESOLUTION_SHIFT) +
+	                ((waiter->wakeTime & ((1ULL << G_CLOCK_WHEEL_RESOLUTION_SHIFT) - 1)) ? 1 : 0);
+	if(unit < wheel->current)
+		unit = wheel->current;
+
+	// Find the lowest level that covers the distance
+	uint64_t delta = unit - wheel->current;
+	uint8_t level = 0;
+	while(level < G_CLOCK_WHEEL_LEVELS - 1 && delta >= (1ULL << (G_CLOCK_WHEEL_SLOT_BITS * (level + 1))))
+		level++;
+
+	// Too far away, the waiter is put back in when the last slot is reached
+	uint64_t range = 1ULL << (G_CLOCK_WHEEL_SLOT_BITS * G_CLOCK_WHEEL_LEVELS);
+	if(delta >= range)
+		unit = wheel->current + range - 1;
+
+	uint8_t slot = (unit >> (G_CLOCK_WHEEL_SLOT_BITS * level)) & (G_CLOCK_WHEEL_SLOTS - 1);
+
+	waiter->local = local;
+	waiter->level = level;
+	waiter->slot = slot;
+	waiter->previous = nullptr;
+	waiter->next = wheel->slots[level][slot];
+	if(waiter->next)
+		waiter->next->previous = waiter;
+	wheel->slots[level][slot] = waiter;
+	wheel->occupied[level] |= (1ULL << slot);
+	wheel->count++;
+}
+
+void _clockWheelRemove(g_clock_waiter* waiter)
+{
+	g_clock_wheel* wheel = &waiter->local->wheel;
+
+	if(waiter->previous)
+		waiter->previous->next = waiter->next;
+	else
+		wheel->slots[waiter->level][waiter->slot] = waiter->next;
+	if(waiter->next)
+		waiter->next->previous = waiter->previous;
+
+	if(!wheel->slots[waiter->level][waiter->slot])
+		wheel->occupied[waiter->level] &= ~(1ULL << waiter->slot);
+	wheel->count--;
+
+	waiter->local = nullptr;
+	waiter->previous = nullptr;
 	waiter->next = nullptr;
+}
+
+/**
+ * Takes all waiters out of the slot and either wakes them, if their time has come,
+ * or puts them into the slot of a lower level.
+ */
+void _clockWheelProcessSlot(g_clock_local* local, uint8_t level, uint8_t slot)
+{
+	g_clock_wheel* wheel = &local->wheel;
+	uint64_t currentTime = wheel->current << G_CLOCK_WHEEL_RESOLUTION_SHIFT;
 
-	if(local->waiters)
+	g_clock_waiter* waiter = wheel->slots[level][slot];
+	while(waiter)
 	{
-		g_clock_waiter* prev = nullptr;
-		g_clock_waiter* entry = local->waiters;
-		while(entry)
+		g_clock_waiter* next = waiter->next;
+		_clockWheelRemove(waiter);
+
+		if(waiter->wakeTime <= currentTime)
+			taskingWake(waiter->task);
+		else
+			_clockWheelAdd(local, waiter);
+
+		waiter = next;
+	}
+}
+
+void _clockWheelAdvance(g_clock_local* local, uint64_t now)
+{
+	g_clock_wheel* wheel = &local->wheel;
+	uint64_t nowUnit = now >> G_CLOCK_WHEEL_RESOLUTION_SHIFT;
+
+	while(wheel->current <= nowUnit)
+	{
+		if(wheel->count == 0)
+		{
+			wheel->current = nowUnit + 1;
+			break;
+		}
+
+		// When the lowest level wraps around, distribute the next slots of the higher levels
+		uint8_t slot = wheel->current & (G_CLOCK_WHEEL_SLOTS - 1);
+		if(slot == 0)
 		{
-			// Insert in middle
-			if(entry->wakeTime > wakeTime)
+			for(uint8_t level = 1; level < G_CLOCK_WHEEL_LEVELS; level++)
 			{
-				waiter->next = entry;
-				if(prev)
-					prev->next = waiter;
-				else
-					local->waiters = waiter;
-				break;
+				uint8_t higherSlot = (wheel->current >> (G_CLOCK_WHEEL_SLOT_BITS * level)) & (G_CLOCK_WHEEL_SLOTS - 1);
+				if(wheel->occupied[level] & (1ULL << higherSlot))
+					_clockWheelProcessSlot(local, level, higherSlot);
+				if(higherSlot != 0)
+					break;
 			}
-			prev = entry;
-			entry = entry->next;
+		}
+
+		if(wheel->occupied[0] & (1ULL << slot))
+			_clockWheelProcessSlot(local, 0, slot);
+		wheel->current++;
 
-			// Insert at tail
-			if(!entry)
-				prev->next = waiter;
+		// Skip to the end of the lowest level if nothing else is in it
+		slot = wheel->current & (G_CLOCK_WHEEL_SLOTS - 1);
+		if(slot != 0 && (wheel->occupied[0] >> slot) == 0)
+		{
+			uint64_t end = (wheel->current | (G_CLOCK_WHEEL_SLOTS - 1)) + 1;
+			wheel->current = end < nowUnit + 1 ? end : nowUnit + 1;
 		}
 	}
-	else
-	{
-		// Insert at head
-		local->waiters = waiter;
-	}
-
-	mutexRelease(&local->lock);
 }
 
-void clockWakeWaiters(g_clock_local* local)
+/**
+ * @return the time in nanoseconds when the wheel has to be advanced next, either to wake
+ * a waiter or to distribute a slot of a higher level
+ */
+uint64_t _clockWheelNext(g_clock_wheel* wheel)
 {
-	while(local->waiters && local->time >= local->waiters->wakeTime)
+	uint64_t next = UINT64_MAX;
+	if(wheel->count == 0)
+		return next;
+
+	for(uint8_t level = 0; level < G_CLOCK_WHEEL_LEVELS; level++)
 	{
-		g_task* task = taskingGetById(local->waiters->task);
-		taskingWake(task);
+		uint64_t occupied = wheel->occupied[level];
+		if(!occupied)
+			continue;
 
-		auto next = local->waiters->next;
-		heapFree(local->waiters);
-		local->waiters = next;
+		// First slot of this level that the wheel reaches, counted from the current one
+		uint8_t shift = G_CLOCK_WHEEL_SLOT_BITS * level;
+		uint64_t first = (wheel->current + (1ULL << shift) - 1) >> shift;
+		uint8_t rotation = first & (G_CLOCK_WHEEL_SLOTS - 1);
+		if(rotation)
+			occupied = (occupied >> rotation) | (occupied << (G_CLOCK_WHEEL_SLOTS - rotation));
+
+		uint64_t unit = (first + __builtin_ctzll(occupied)) << shift;
+		if(unit < next)
+			next = unit;
 	}
+	return next << G_CLOCK_WHEEL_RESOLUTION_SHIFT;
 }
 
 void clockUpdateTime(g_clock_local* local)
 {
+	if(tscIsAvailable())
+	{
+		local->time = tscGetNanos() / 1000000;
+		return;
+	}
+
 	local->time += (1000 / G_TIMER_FREQUENCY);
 
 	// Use HPET timing if available
@@ -136,58 +299,78 @@ void clockUpdate()
 	auto local = clockGetLocal();
 	mutexAcquire(&local->lock);
 	clockUpdateTime(local);
-	clockWakeWaiters(local);
+	_clockWheelAdvance(local, clockGetNanos());
+	if(processorIsBsp())
+		clockPageUpdate();
+
+	// Timer has fired, the scheduler starts a new slice
+	local->sliceTask = G_TID_NONE;
+	local->armedDeadline = 0;
 	mutexRelease(&local->lock);
 }
 
-void clockUnwaitForTime(g_tid task)
+void clockRefresh()
+{
+	if(!locals || !tscIsAvailable())
+		return;
+
+	clockGetLocal()->time = tscGetNanos() / 1000000;
+}
+
+void clockArmTimer()
 {
+	if(!locals || !lapicIsTimerOneShot())
+		return;
+
 	auto local = clockGetLocal();
+	auto tasking = taskingGetLocal();
+	uint64_t now = tscGetNanos();
+
+	// Idle processors must still wake up to balance
+	uint64_t deadline = now + G_SCHEDULER_BALANCE_INTERVAL * 1000000ULL;
+
 	mutexAcquire(&local->lock);
+	uint64_t wake = _clockWheelNext(&local->wheel);
+	if(wake < deadline)
+		deadline = wake;
 
-	g_clock_waiter* prev = nullptr;
-	g_clock_waiter* entry = local->waiters;
-	while(entry)
+	auto current = tasking->scheduling.current;
+	if(tasking->scheduling.readyCount == 0 || !current)
 	{
-		if(entry->task == task)
-		{
-			auto next = entry->next;
-			if(prev)
-				prev->next = next;
-			else
-				local->waiters = next;
-
-			heapFree(entry);
-			entry = next;
-		}
-		else
+		local->sliceTask = G_TID_NONE;
+	}
+	else if(current == tasking->scheduling.idleTask)
+	{
+		// A task was woken while idling, switch to it right away
+		deadline = now;
+	}
+	else
+	{
+		if(local->sliceTask != current->id)
 		{
-			prev = entry;
-			entry = entry->next;
+			local->sliceTask = current->id;
+			local->sliceStart = now;
 		}
+		if(local->sliceStart + G_CLOCK_TIME_SLICE < deadline)
+			deadline = local->sliceStart + G_CLOCK_TIME_SLICE;
 	}
 
+	if(deadline != local->armedDeadline)
+	{
+		local->armedDeadline = deadline;
+		lapicArmTimer(deadline);
+	}
 	mutexRelease(&local->lock);
 }
 
-bool clockHasTimedOut(g_tid task)
+uint64_t clockGetNanos()
 {
-	auto local = clockGetLocal();
-	mutexAcquire(&local->lock);
+	if(tscIsAvailable())
+		return tscGetNanos();
 
-	bool timeout = true;
-
-	g_clock_waiter* entry = local->waiters;
-	while(entry)
-	{
-		if(entry->task == task && local->time < entry->wakeTime)
-		{
-			timeout = false;
-			break;
-		}
-		entry = entry->next;
-	}
+	if(hpetIsAvailable())
+		return hpetGetNanos();
 
-	mutexRelease(&local->lock);
-	return timeout;
+	return clockGetLocal()->time * 1000000;
 }
+
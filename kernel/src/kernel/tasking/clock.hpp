@@ -31,19 +31,77 @@
  */
 #define G_CLOCK_RECALIBRATION_INTERVAL   1000
 
+/**
+ * Nanoseconds that a task may run in tickless mode before the timer preempts it
+ * for another ready task.
+ */
+#define G_CLOCK_TIME_SLICE   1000000
+
+/**
+ * Timer wheel dimensions. A slot on the lowest level covers 2^G_CLOCK_WHEEL_RESOLUTION_SHIFT
+ * nanoseconds (about 65 microseconds), each higher level covers G_CLOCK_WHEEL_SLOTS slots
+ * of the level below. Four levels cover about 18 minutes, later wake-ups are put into
+ * the last slot and re-sorted when it is reached.
+ */
+#define G_CLOCK_WHEEL_RESOLUTION_SHIFT   16
+#define G_CLOCK_WHEEL_SLOT_BITS          6
+#define G_CLOCK_WHEEL_SLOTS              (1 << G_CLOCK_WHEEL_SLOT_BITS)
+#define G_CLOCK_WHEEL_LEVELS             4
+
+struct g_task;
+struct g_clock_local;
+
+/**
+ * Entry of a task in the timer wheel of a processor. Each task has one, so waiting for
+ * a time replaces the previous wake-up time of the task.
+ */
 struct g_clock_waiter
 {
-    g_tid task;
+    g_task* task;
+
+    /**
+     * Time to wake up, in nanoseconds as returned by <clockGetNanos>.
+     */
     uint64_t wakeTime;
+
+    /**
+     * Local whose wheel this waiter is queued in, or null. Only changed while
+     * holding the lock of that local.
+     */
+    g_clock_local* local;
+    uint8_t level;
+    uint8_t slot;
+    g_clock_waiter* previous;
     g_clock_waiter* next;
 };
 
+/**
+ * Hierarchical timer wheel. Waiters are put into a slot depending on how far their
+ * wake-up is away, so adding, removing and expiring each take constant time. Slots of
+ * higher levels are distributed to the lower levels when the wheel reaches them.
+ */
+struct g_clock_wheel
+{
+    g_clock_waiter* slots[G_CLOCK_WHEEL_LEVELS][G_CLOCK_WHEEL_SLOTS];
+
+    /**
+     * Bitmap of the non-empty slots per level.
+     */
+    uint64_t occupied[G_CLOCK_WHEEL_LEVELS];
+
+    /**
+     * Next lowest-level slot to process, in units of the resolution.
+     */
+    uint64_t current;
+    uint32_t count;
+};
+
 /**
  * Processor local clock information.
  */
 struct g_clock_local
 {
-    g_clock_waiter* waiters;
+    g_clock_wheel wheel;
     g_mutex lock;
 
     /**
@@ -57,6 +115,14 @@ struct g_clock_local
     uint64_t lastNanoTime;
     uint64_t lastRecalibrateMilliTime;
 
+    /**
+     * Tickless mode: task whose time slice started at the given time and the
+     * deadline that the timer is currently armed for.
+     */
+    g_tid sliceTask;
+    uint64_t sliceStart;
+    uint64_t armedDeadline;
+
 #if G_DEBUG_THREAD_DUMPING
     uint64_t lastLogTime;
 #endif
@@ -73,25 +139,43 @@ void clockInitialize();
 g_clock_local* clockGetLocal();
 
 /**
- * Adds the task to the queue of tasks that are waiting for a specific time. This
- * queue is ordered ascending by the time of wake-up.
+ * Wakes the task at the given time in nanoseconds, as returned by <clockGetNanos>. The
+ * task is added to the timer wheel of the current processor; if it was already waiting
+ * for a time, that wake-up is replaced.
  */
-void clockWaitForTime(g_tid task, uint64_t wakeTime);
+void clockWaitForTime(g_task* task, uint64_t wakeTime);
 
 /**
- * Called when the local time has changed. Wakes all tasks on top of the wait queue
- * for which the wake-up time is lower than the current.
+ * Called when the local time has changed. Wakes all tasks whose wake-up time has passed.
  */
 void clockUpdate();
 
 /**
- * Removes the task from the wake queue.
+ * If the TSC is used as clock source, updates the local time from it. Called on each
+ * interrupt so that handlers see the current time, also when the timer runs tickless.
+ */
+void clockRefresh();
+
+/**
+ * In tickless mode, arms the timer of this processor for the next event: the first
+ * waiter, the end of the current time slice if other tasks are ready, or at latest
+ * the next load balancing interval. Called before leaving an interrupt.
+ */
+void clockArmTimer();
+
+/**
+ * @return nanoseconds from the TSC if it is usable, otherwise from the HPET or the local time
+ */
+uint64_t clockGetNanos();
+
+/**
+ * Removes the task from the timer wheel it waits in.
  */
-void clockUnwaitForTime(g_tid task);
+void clockUnwaitForTime(g_task* task);
 
 /**
- * @returns true when the wake-up time for this task was reached or the queue entry removed.
+ * @returns true when the wake-up time for this task was reached or the wait removed.
  */
-bool clockHasTimedOut(g_tid task);
+bool clockHasTimedOut(g_task* task);
 
 #endif
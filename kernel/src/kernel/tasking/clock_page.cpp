@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/tasking/clock_page.hpp"
+#include "kernel/memory/constants.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/memory/page_reference_tracker.hpp"
+#include "kernel/memory/paging.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/timing/tsc.hpp"
+#include "kernel/panic.hpp"
+#include "kernel/logger/logger.hpp"
+
+static g_physical_address clockPagePhysical = 0;
+static g_clock_page* clockPage = nullptr;
+
+void clockPageInitialize()
+{
+	clockPagePhysical = memoryPhysicalAllocateZeroed();
+	if(!clockPagePhysical)
+		panic("%! failed to allocate clock page", "clock");
+
+	clockPage = (g_clock_page*) G_MEM_PHYS_TO_VIRT(clockPagePhysical);
+	if(!tscIsAvailable())
+	{
+		logInfo("%! TSC not usable, processes read the time with system calls", "clock");
+		return;
+	}
+
+	clockPage->multiplier = tscGetNanosMultiplier();
+	clockPage->shift = G_TSC_NANOS_SHIFT;
+	clockPageUpdate();
+	clockPage->flags = G_CLOCK_PAGE_FLAG_TSC;
+}
+
+void clockPageUpdate()
+{
+	if(!clockPage || !tscIsAvailable())
+		return;
+
+	uint64_t tsc = processorReadTsc();
+
+	// Stores are not reordered with other stores, the compiler must not do it either
+	clockPage->sequence++;
+	asm volatile("" ::: "memory");
+	clockPage->baseTsc = tsc;
+	clockPage->baseNanos = tscToNanos(tsc);
+	asm volatile("" ::: "memory");
+	clockPage->sequence++;
+}
+
+const g_clock_page* clockPageMap(g_virtual_address address)
+{
+	if(!clockPage)
+		return nullptr;
+
+	if(!pagingMapPage(address, clockPagePhysical, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_PRESENT | G_PAGE_USER_FLAG))
+		return nullptr;
+
+	// Each mapping holds a reference, so destroying a process doesn't free the page
+	pageReferenceTrackerIncrement(clockPagePhysical);
+	return (const g_clock_page*) address;
+}
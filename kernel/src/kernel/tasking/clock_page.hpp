@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_CLOCK_PAGE__
+#define __KERNEL_CLOCK_PAGE__
+
+#include <ghost/memory/types.h>
+#include <ghost/tasks/types.h>
+
+/**
+ * Allocates the clock page and fills in the TSC parameters. Must be called after
+ * the TSC was calibrated.
+ */
+void clockPageInitialize();
+
+/**
+ * Moves the base of the clock page to the current TSC value, so that the difference
+ * that user space multiplies stays small. Called by the timer on the BSP.
+ */
+void clockPageUpdate();
+
+/**
+ * Maps the clock page read-only to the given address of the current address space.
+ *
+ * @return the mapped page or null on failure
+ */
+const g_clock_page* clockPageMap(g_virtual_address address);
+
+#endif
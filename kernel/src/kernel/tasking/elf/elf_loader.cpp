@@ -23,6 +23,7 @@
 #include "kernel/calls/syscall.hpp"
 #include "kernel/filesystem/filesystem.hpp"
 #include "kernel/memory/memory.hpp"
+#include "kernel/tasking/clock_page.hpp"
 #include "kernel/tasking/elf/elf_tls.hpp"
 #include "kernel/tasking/tasking_memory.hpp"
 #include "kernel/utils/string.hpp"
@@ -82,11 +83,7 @@ g_virtual_address elfUserProcessCreateInfo(g_process* process, g_elf_object* roo
 	// Map required memory all loaded objects
 	g_address areaStart = imageEnd;
 	uint32_t pages = G_PAGE_ALIGN_UP(totalRequired) / G_PAGE_SIZE;
-	for(uint32_t i = 0; i < pages; i++)
-	{
-		g_physical_address page = memoryPhysicalAllocate();
-		pagingMapPage(areaStart + i * G_PAGE_SIZE, page, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
-	}
+	memoryAllocateRange(process->pageSpace, areaStart, pages, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 
 	// Fill with data
 	g_process_info* info = (g_process_info*) areaStart;
@@ -124,7 +121,11 @@ g_virtual_address elfUserProcessCreateInfo(g_process* process, g_elf_object* roo
 	info->syscallKernelEntry = syscall;
 	process->userProcessInfo = info;
 
-	return imageEnd + G_PAGE_ALIGN_UP(totalRequired);
+	// Clock page follows the information area
+	g_virtual_address clockPageStart = imageEnd + G_PAGE_ALIGN_UP(totalRequired);
+	info->clockPage = clockPageMap(clockPageStart);
+
+	return clockPageStart + G_PAGE_SIZE;
 }
 
 g_spawn_validation_details elfReadAndValidateHeader(g_fd file, Elf64_Ehdr* headerBuffer, bool root)
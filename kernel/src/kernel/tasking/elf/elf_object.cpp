@@ -159,12 +159,9 @@ g_spawn_status elfObjectLoadLoadSegment(g_fd file, Elf64_Phdr phdr, g_virtual_ad
 	g_address alignedEnd = G_PAGE_ALIGN_UP(fileStart + phdr.p_memsz);
 
 	// Allocate required memory
+	// Segments may share a page at their boundary, it is only allocated once
 	uint32_t pages = (alignedEnd - alignedStart) / G_PAGE_SIZE;
-	for(uint32_t i = 0; i < pages; i++)
-	{
-		g_physical_address page = memoryPhysicalAllocate();
-		pagingMapPage(alignedStart + i * G_PAGE_SIZE, page, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
-	}
+	memoryAllocateRange(pagingGetCurrentSpace(), alignedStart, pages, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 
 	// Zero everything before content
 	uint32_t spaceBefore = fileStart - alignedStart;
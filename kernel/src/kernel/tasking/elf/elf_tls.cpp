@@ -71,15 +71,9 @@ void elfTlsCreateMasterImage(g_fd file, g_process* process, g_elf_object* rootOb
 	uint32_t size = G_PAGE_ALIGN_UP(rootObject->tlsMaster.totalSize);
 	uint32_t requiredPages = size / G_PAGE_SIZE;
 	g_virtual_address tlsStart = addressRangePoolAllocate(process->virtualRangePool, requiredPages);
-	for(uint32_t i = 0; i < requiredPages; i++)
-	{
-		g_physical_address page = memoryPhysicalAllocate();
-		pagingMapPage(tlsStart + i * G_PAGE_SIZE, page, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
-	}
+	memoryAllocateRange(process->pageSpace, tlsStart, requiredPages, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 
 	// Load contents from all loaded objects to memory
-	memorySetBytes((uint8_t*) tlsStart, 0, rootObject->tlsMaster.totalSize);
-
 	auto it = hashmapIteratorStart(rootObject->loadedObjects);
 	while(hashmapIteratorHasNext(&it))
 	{
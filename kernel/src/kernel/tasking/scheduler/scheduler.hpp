@@ -23,6 +23,34 @@
 
 #include "kernel/tasking/tasking.hpp"
 
+/**
+ * Interval in milliseconds in which each processor checks whether it should pull
+ * tasks from a processor that has a lot more ready tasks.
+ */
+#define G_SCHEDULER_BALANCE_INTERVAL 100
+
+/**
+ * Difference of ready tasks between two processors before periodic balancing
+ * moves a task.
+ */
+#define G_SCHEDULER_BALANCE_IMBALANCE 2
+
+/**
+ * Tasks that have run within this amount of milliseconds are considered to have
+ * a warm cache and are not migrated.
+ */
+#define G_SCHEDULER_CACHE_HOT_TIME 5
+
+/**
+ * Maximum number of queued tasks that are checked when looking for a task to steal.
+ */
+#define G_SCHEDULER_STEAL_SCAN_LIMIT 8
+
+/**
+ * Vector of the IPI that tells a tickless processor about a task that became ready.
+ */
+#define G_SCHEDULER_WAKE_VECTOR 0x84
+
 /**
  * Initializes the scheduler locally.
  */
@@ -33,6 +61,23 @@ void schedulerInitializeLocal();
  */
 void schedulerPrepareEntry(g_schedule_entry* entry);
 
+/**
+ * Puts the task at the end of the ready queue for its priority on the given local.
+ * Does nothing if the task is already queued.
+ */
+void schedulerEnqueue(g_tasking_local* local, g_task* task);
+
+/**
+ * If the given local belongs to another processor that has no periodic timer, sends
+ * it an IPI so that it arms its timer for the newly ready task.
+ */
+void schedulerNotify(g_tasking_local* local);
+
+/**
+ * Removes the task from the ready queue of the given local if it is queued.
+ */
+void schedulerRemove(g_tasking_local* local, g_task* task);
+
 /**
  * Applies the given task as the current one.
  */
@@ -43,6 +88,12 @@ void schedulerSetCurrent(g_tasking_local* local, g_task* task);
  */
 void schedulerSchedule(g_tasking_local* local);
 
+/**
+ * Called once the processor has completely switched away from the previous task,
+ * so that it may be run on another processor.
+ */
+void schedulerFinishSwitch(g_task* previous);
+
 /**
  * Log information about all current tasks.
  */
@@ -0,0 +1,453 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/tasking/scheduler/scheduler.hpp"
+#include "kernel/logger/logger.hpp"
+
+#include "kernel/tasking/clock.hpp"
+#include "kernel/system/interrupts/apic/lapic.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/tasking/tasking_directory.hpp"
+
+#define G_DEBUG_LOG_PAUSE 5000
+
+/**
+ * The "preferred task" is just a hint to scheduling that it would make sense to
+ * switch to a specific task. It is currently not taken into account, since
+ * following it made yielding unfair and the system slower.
+ */
+g_tid preferredTask;
+
+void schedulerInitializeLocal()
+{
+	preferredTask = G_TID_NONE;
+
+	g_tasking_local* local = taskingGetLocal();
+	local->scheduling.readyBitmap = 0;
+	local->scheduling.readyCount = 0;
+	local->balancing.lastBalanceTime = 0;
+	local->balancing.steals = 0;
+	local->balancing.migrations = 0;
+	for(int i = 0; i < G_SCHEDULER_PRIORITY_LEVELS; i++)
+	{
+		local->scheduling.ready[i].head = nullptr;
+		local->scheduling.ready[i].tail = nullptr;
+	}
+}
+
+void schedulerPrepareEntry(g_schedule_entry* entry)
+{
+	g_task* task = entry->task;
+	if(task->scheduling.priority >= G_SCHEDULER_PRIORITY_LEVELS)
+		task->scheduling.priority = G_SCHEDULER_PRIORITY_DEFAULT;
+}
+
+void schedulerEnqueue(g_tasking_local* local, g_task* task)
+{
+	if(task == local->scheduling.idleTask)
+		return;
+
+	mutexAcquire(&local->lock);
+
+	if(!task->scheduling.queued)
+	{
+		uint8_t priority = task->scheduling.priority;
+		g_schedule_queue* queue = &local->scheduling.ready[priority];
+
+		task->scheduling.previous = queue->tail;
+		task->scheduling.next = nullptr;
+		if(queue->tail)
+			queue->tail->scheduling.next = task;
+		else
+			queue->head = task;
+		queue->tail = task;
+
+		task->scheduling.queued = true;
+		local->scheduling.readyBitmap |= (1 << priority);
+		local->scheduling.readyCount++;
+	}
+
+	mutexRelease(&local->lock);
+}
+
+void schedulerNotify(g_tasking_local* local)
+{
+	if(!lapicIsTimerOneShot() || local->processor == processorGetCurrentId())
+		return;
+
+	g_processor* processor = processorGetList();
+	while(processor)
+	{
+		if(processor->id == local->processor)
+		{
+			lapicSendIpi(processor->apicId, G_SCHEDULER_WAKE_VECTOR);
+			break;
+		}
+		processor = processor->next;
+	}
+}
+
+void schedulerRemove(g_tasking_local* local, g_task* task)
+{
+	mutexAcquire(&local->lock);
+
+	if(task->scheduling.queued)
+	{
+		uint8_t priority = task->scheduling.priority;
+		g_schedule_queue* queue = &local->scheduling.ready[priority];
+
+		if(task->scheduling.previous)
+			task->scheduling.previous->scheduling.next = task->scheduling.next;
+		else
+			queue->head = task->scheduling.next;
+
+		if(task->scheduling.next)
+			task->scheduling.next->scheduling.previous = task->scheduling.previous;
+		else
+			queue->tail = task->scheduling.previous;
+
+		task->scheduling.previous = nullptr;
+		task->scheduling.next = nullptr;
+		task->scheduling.queued = false;
+		local->scheduling.readyCount--;
+
+		if(!queue->head)
+			local->scheduling.readyBitmap &= ~(1 << priority);
+	}
+
+	mutexRelease(&local->lock);
+}
+
+/**
+ * Takes the first task of the highest non-empty priority level. Tasks that were set to another
+ * status while they were queued (for example killed) are dropped from the queue on the way.
+ */
+g_task* schedulerTakeNextTask(g_tasking_local* local)
+{
+	while(local->scheduling.readyBitmap)
+	{
+		uint32_t priority = __builtin_ctz(local->scheduling.readyBitmap);
+		g_task* task = local->scheduling.ready[priority].head;
+		schedulerRemove(local, task);
+
+		if(task->status == G_TASK_STATUS_RUNNING)
+			return task;
+	}
+	return nullptr;
+}
+
+/**
+ * Whether the task may be moved to a different processor. Kernel and vital tasks
+ * stay where they were created, as well as tasks that were explicitly assigned.
+ */
+bool schedulerIsMigratable(g_task* task, uint64_t now)
+{
+	if(task->scheduling.pinned || task->type != G_TASK_TYPE_DEFAULT ||
+	   task->securityLevel == G_SECURITY_LEVEL_KERNEL)
+		return false;
+
+	if(task->status != G_TASK_STATUS_RUNNING)
+		return false;
+
+	// The time was stamped by the clock of another processor, which may be ahead
+	uint64_t lastScheduled = task->scheduling.lastScheduled;
+	if(now < lastScheduled)
+		return false;
+
+	return now - lastScheduled >= G_SCHEDULER_CACHE_HOT_TIME;
+}
+
+/**
+ * Whether the victim has completely switched away from the task. Its FPU state must
+ * also not be left unsaved in the registers of the victim.
+ */
+bool schedulerIsSwitchedOut(g_tasking_local* victim, g_task* task)
+{
+	if(task == victim->scheduling.current || task->scheduling.onProcessor)
+		return false;
+
+	return victim->fpu.owner != task || !victim->fpu.dirty;
+}
+
+/**
+ * Finds a queued task on the victim that may be migrated. Must be called while
+ * holding the lock of the victim. Only tasks that the victim has completely
+ * switched away from are taken.
+ */
+g_task* schedulerFindStealable(g_tasking_local* victim, uint64_t now)
+{
+	int scanned = 0;
+	uint32_t levels = victim->scheduling.readyBitmap;
+	while(levels && scanned < G_SCHEDULER_STEAL_SCAN_LIMIT)
+	{
+		uint32_t priority = __builtin_ctz(levels);
+		levels &= ~(1 << priority);
+
+		// Tasks at the head of a queue have waited the longest and are most likely cold
+		g_task* task = victim->scheduling.ready[priority].head;
+		while(task && scanned < G_SCHEDULER_STEAL_SCAN_LIMIT)
+		{
+			if(schedulerIsSwitchedOut(victim, task) && schedulerIsMigratable(task, now))
+				return task;
+			task = task->scheduling.next;
+			++scanned;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Moves the schedule entry of the task from the victims task list. Must be called while
+ * holding the lock of the victim.
+ */
+g_schedule_entry* schedulerUnlinkEntry(g_tasking_local* victim, g_task* task)
+{
+	g_schedule_entry* previous = nullptr;
+	g_schedule_entry* entry = victim->scheduling.list;
+	while(entry)
+	{
+		if(entry->task == task)
+		{
+			if(previous)
+				previous->next = entry->next;
+			else
+				victim->scheduling.list = entry->next;
+			entry->next = nullptr;
+			return entry;
+		}
+		previous = entry;
+		entry = entry->next;
+	}
+	return nullptr;
+}
+
+/**
+ * Pulls one task from the processor with the most ready tasks to the given local. When the
+ * local is idle, any ready task on the victim is worth taking, otherwise the victim must have
+ * considerably more ready tasks.
+ */
+bool schedulerSteal(g_tasking_local* local, bool idle)
+{
+	uint32_t numProcs = processorGetNumberOfProcessors();
+
+	// Find the busiest processor; the counts are only read as a hint here
+	g_tasking_local* victim = nullptr;
+	uint32_t victimReady = 0;
+	for(uint32_t i = 0; i < numProcs; i++)
+	{
+		g_tasking_local* other = taskingGetLocal(i);
+		if(other == local)
+			continue;
+
+		uint32_t ready = other->scheduling.readyCount;
+		if(ready > victimReady)
+		{
+			victim = other;
+			victimReady = ready;
+		}
+	}
+
+	if(!victim)
+		return false;
+	if(!idle && victimReady < local->scheduling.readyCount + G_SCHEDULER_BALANCE_IMBALANCE)
+		return false;
+
+	uint64_t now = clockGetLocal()->time;
+
+	mutexAcquire(&victim->lock);
+	g_task* task = schedulerFindStealable(victim, now);
+	g_schedule_entry* entry = nullptr;
+	if(task)
+	{
+		schedulerRemove(victim, task);
+		entry = schedulerUnlinkEntry(victim, task);
+		victim->balancing.migrations++;
+	}
+	mutexRelease(&victim->lock);
+
+	if(!task)
+		return false;
+
+	mutexAcquire(&local->lock);
+	if(entry)
+	{
+		entry->next = local->scheduling.list;
+		local->scheduling.list = entry;
+	}
+	task->assignment = local;
+	task->threadLocal.kernelThreadLocal->processor = local->processor;
+	if(task->status == G_TASK_STATUS_RUNNING)
+		schedulerEnqueue(local, task);
+	local->balancing.steals++;
+	mutexRelease(&local->lock);
+	return true;
+}
+
+/**
+ * Idle processors try to steal on every scheduling, busy processors check for a
+ * large imbalance in a fixed interval.
+ */
+void schedulerBalance(g_tasking_local* local)
+{
+	if(processorGetNumberOfProcessors() < 2)
+		return;
+
+	g_task* current = local->scheduling.current;
+	bool idle = local->scheduling.readyCount == 0 &&
+	            (!current || current == local->scheduling.idleTask || current->status != G_TASK_STATUS_RUNNING);
+	if(idle)
+	{
+		schedulerSteal(local, true);
+		return;
+	}
+
+	uint64_t now = clockGetLocal()->time;
+	if(now - local->balancing.lastBalanceTime >= G_SCHEDULER_BALANCE_INTERVAL)
+	{
+		local->balancing.lastBalanceTime = now;
+		schedulerSteal(local, false);
+	}
+}
+
+void schedulerFinishSwitch(g_task* previous)
+{
+	__atomic_store_n(&previous->scheduling.onProcessor, false, __ATOMIC_RELEASE);
+}
+
+void schedulerSetCurrent(g_tasking_local* local, g_task* task)
+{
+	mutexAcquire(&local->lock);
+
+	g_task* previous = local->scheduling.current;
+	if(previous && previous != task)
+	{
+		previous->scheduling.lastScheduled = clockGetLocal()->time;
+		if(previous->status == G_TASK_STATUS_RUNNING)
+			schedulerEnqueue(local, previous);
+	}
+
+	schedulerRemove(local, task);
+	local->scheduling.current = task;
+	task->scheduling.onProcessor = true;
+
+	mutexRelease(&local->lock);
+}
+
+void schedulerPrefer(g_tid task)
+{
+	preferredTask = task;
+}
+
+void schedulerSchedule(g_tasking_local* local)
+{
+	schedulerBalance(local);
+
+	mutexAcquire(&local->lock);
+
+	// Put the interrupted task at the end of its queue if it may continue
+	g_task* current = local->scheduling.current;
+	if(current)
+	{
+		current->scheduling.lastScheduled = clockGetLocal()->time;
+		if(current->status == G_TASK_STATUS_RUNNING)
+			schedulerEnqueue(local, current);
+	}
+
+	g_task* next = schedulerTakeNextTask(local);
+	if(!next)
+		next = local->scheduling.idleTask;
+
+	local->scheduling.current = next;
+	next->statistics.timesScheduled++;
+	next->scheduling.onProcessor = true;
+
+	mutexRelease(&local->lock);
+
+#if G_DEBUG_THREAD_DUMPING
+	if(processorGetCurrentId() == 0 && (clockGetLocal()->time - clockGetLocal()->lastLogTime) > G_DEBUG_LOG_PAUSE)
+	{
+		clockGetLocal()->lastLogTime = clockGetLocal()->time;
+		schedulerDump();
+	}
+#endif
+}
+
+#define USAGE(timesScheduled, timesYielded) ((timesScheduled - timesYielded) / (G_DEBUG_LOG_PAUSE / 1000))
+
+void schedulerDump()
+{
+	// This only works because the interrupt comes in on CPU0:
+	logInfo("%! printing task dump:", "scheduler");
+	auto firstClock = clockGetLocal();
+	for(int i = 0; i < processorGetNumberOfProcessors(); i++)
+	{
+		auto local = taskingGetLocal(i);
+		auto clock = &firstClock[i];
+		mutexAcquire(&local->lock);
+
+		logInfo("%# processor %i: time %i, ready: %i, steals: %i, migrations: %i", i, (uint32_t) clock->time,
+		        local->scheduling.readyCount, local->balancing.steals, local->balancing.migrations);
+		g_schedule_entry* entry = local->scheduling.list;
+		while(entry)
+		{
+			auto task = entry->task;
+			const char* taskState;
+			if(task->status == G_TASK_STATUS_RUNNING)
+			{
+				taskState = "";
+			}
+			else if(task->status == G_TASK_STATUS_DEAD)
+			{
+				taskState = " [dead]";
+			}
+			else if(task->status == G_TASK_STATUS_WAITING)
+			{
+				taskState = " [waiting]";
+			}
+			else
+			{
+				taskState = "?";
+			}
+
+			if(task->status != G_TASK_STATUS_DEAD)
+			{
+				auto identifier = taskingDirectoryGetIdentifier(task->id);
+				logInfo("%# - (%i:%i) usage: %i, %s %s %s", task->process->id, task->id,
+				        USAGE(task->statistics.timesScheduled, task->statistics.timesYielded),
+				        identifier == nullptr ? "" : identifier, taskState,
+				        task->status == G_TASK_STATUS_WAITING ? task->waitsFor : "");
+				task->statistics.timesScheduled = 0;
+				task->statistics.timesYielded = 0;
+			}
+
+			entry = entry->next;
+		}
+
+		g_task* idle = local->scheduling.idleTask;
+		logInfo("%# - (%i:%i) usage: %i, idle",
+		        idle->process->id, idle->id,
+		        USAGE(idle->statistics.timesScheduled, idle->statistics.timesYielded)
+				);
+		idle->statistics.timesScheduled = 0;
+		idle->statistics.timesYielded = 0;
+
+		mutexRelease(&local->lock);
+	}
+}
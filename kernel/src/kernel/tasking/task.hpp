@@ -25,8 +25,10 @@
 #include "kernel/system/processor/processor_state.hpp"
 #include "kernel/utils/wait_queue.hpp"
 #include "kernel/system/mutex.hpp"
+#include "kernel/tasking/clock.hpp"
 
 #include <ghost/tasks/types.h>
+#include <ghost/syscall/types.h>
 #include <ghost/system/types.h>
 
 struct g_process;
@@ -34,6 +36,11 @@ struct g_task;
 struct g_tasking_local;
 struct g_elf_object;
 
+/**
+ * Value of a tasks FPU processor when its state was never loaded
+ */
+#define G_FPU_PROCESSOR_NONE 0xFFFFFFFF
+
 /**
  * Data used by virtual 8086 processes
  */
@@ -54,11 +61,18 @@ struct g_stack
 };
 
 /**
- * Thread-local information used by the kernel
+ * Thread-local information used by the kernel. The SYSCALL entry routine accesses
+ * the stack fields by their offsets, keep them in sync with syscall_routine.asm.
  */
 struct g_kernel_threadlocal
 {
     uint32_t processor;
+
+    /**
+     * Kernel stack to switch to on SYSCALL and scratch slot for the user stack
+     */
+    g_address syscallStack;
+    g_address userStack;
 };
 
 /**
@@ -97,6 +111,46 @@ struct g_task
         int timesYielded;
     } statistics;
 
+    /**
+     * Intrusive links for the ready queue of the processor this task is assigned to.
+     * Only modified while holding the lock of the assigned processor-local tasking structure.
+     */
+    struct
+    {
+        uint8_t priority;
+        bool queued;
+        g_task* previous;
+        g_task* next;
+
+        /**
+         * Pinned tasks are never migrated to a different processor by load balancing.
+         */
+        bool pinned;
+
+        /**
+         * Clock time of the last time this task was switched out, used to avoid
+         * migrating tasks that probably still have a warm cache.
+         */
+        uint64_t lastScheduled;
+
+        /**
+         * Set from the moment a processor picks the task until it has completely
+         * switched away from it, including saving its FPU state and leaving its
+         * interrupt stack. The task may not be migrated while it is set.
+         */
+        volatile bool onProcessor;
+    } scheduling;
+
+    /**
+     * Entry in the timer wheel while the task waits for a time.
+     */
+    g_clock_waiter clockWaiter;
+
+    /**
+     * Entry in the waiter queue of a task mutex while the task sleeps on it.
+     */
+    g_mutex_waiter mutexWaiter;
+
     /**
      * Sometimes a task needs to do work in the address space of a different process.
      * If the override page directory is set, it switches here instead of the current
@@ -122,11 +176,16 @@ struct g_task
      */
     volatile g_processor_state* state;
 
+    /**
+     * FPU state is switched lazily, see <taskingHandleFpuTrap>. The registers
+     * hold this tasks state if it is the FPU owner of "processor" and was last
+     * loaded on it.
+     */
     struct
     {
         uint8_t* stateMem;
         uint8_t* state;
-        bool stored;
+        uint32_t processor;
     } fpu;
 
     /**
@@ -179,6 +238,8 @@ struct g_task_entry
 #define G_PROC_VIRTUAL_RANGE_FLAG_NONE 0
 /* Weak flag signals that the physical memory mapped behind the virtual range is not managed by the kernel (for example MMIO). */
 #define G_PROC_VIRTUAL_RANGE_FLAG_WEAK 1
+/* Kernel flag signals that the kernel accesses the range itself, so the process may not unmap it. */
+#define G_PROC_VIRTUAL_RANGE_FLAG_KERNEL 2
 
 struct g_process_spawn_arguments
 {
@@ -192,10 +253,24 @@ struct g_process_spawn_arguments
 };
 
 /**
- * On-demand mapping for a file in memory.
+ * Types of on-demand mappings
+ */
+#define G_MEMORY_ONDEMAND_TYPE_FILE 0
+#define G_MEMORY_ONDEMAND_TYPE_ZERO 1
+
+/**
+ * On-demand mapping for a file in memory or for anonymous memory that is filled
+ * with zeros on first access. Zero mappings have no file and a file size of 0.
  */
 struct g_memory_file_ondemand
 {
+    uint8_t type;
+
+    /**
+     * Number of pages that are populated around a faulting address
+     */
+    uint32_t faultAround;
+
     /**
      * Source file descriptor and offset
      */
@@ -214,8 +289,24 @@ struct g_memory_file_ondemand
      * Total size of the allocated memory, content is followed by 0
      */
     g_ptrsize memSize;
+};
 
-    g_memory_file_ondemand* next;
+/**
+ * On-demand mappings of a process, sorted by their page-aligned start address so
+ * that the mapping of a faulting address is found with a binary search.
+ */
+struct g_memory_ondemand_mappings
+{
+    g_memory_file_ondemand** entries;
+    uint32_t count;
+    uint32_t capacity;
+
+    /**
+     * Index of the mapping of the last lookup, as consecutive faults mostly hit the
+     * same mapping. It is validated on each use, so it needs no update when mappings
+     * are added or removed.
+     */
+    uint32_t lastHit;
 };
 
 /**
@@ -271,9 +362,32 @@ struct g_process
     g_process_spawn_arguments* spawnArgs;
 
     /**
-     * List of on-demand file-to-memory mappings.
+     * On-demand mappings, protected by the process lock.
      */
-    g_memory_file_ondemand* onDemandMappings;
+    g_memory_ondemand_mappings onDemandMappings;
+
+    /**
+     * Page faults that were resolved for this process. Minor faults are served from
+     * memory, major faults read the content of the page from a file.
+     */
+    struct
+    {
+        uint64_t minor;
+        uint64_t major;
+        uint64_t fileReadBytes;
+    } faults;
+
+    /**
+     * System call ring of the process, see syscall_ring.hpp. The number of entries
+     * is kept here so that the process can't make the kernel index beyond the ring.
+     * The drainer is the task that currently executes the submissions.
+     */
+    struct
+    {
+        g_syscall_ring* ring;
+        uint32_t entries;
+        g_tid drainer;
+    } syscallRing;
 };
 
 #endif
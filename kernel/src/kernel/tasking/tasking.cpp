@@ -26,7 +26,10 @@
 #include "kernel/memory/gdt.hpp"
 #include "kernel/memory/memory.hpp"
 #include "kernel/memory/page_reference_tracker.hpp"
+#include "kernel/memory/paging.hpp"
+#include "kernel/memory/zero_pool.hpp"
 #include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/interrupts/requests.hpp"
 #include "kernel/system/processor/processor.hpp"
 #include "kernel/system/system.hpp"
 #include "kernel/tasking/cleanup.hpp"
@@ -36,6 +39,7 @@
 #include "kernel/tasking/tasking_memory.hpp"
 #include "kernel/tasking/tasking_state.hpp"
 #include "kernel/utils/hashmap.hpp"
+#include "kernel/utils/string.hpp"
 #include "kernel/utils/wait_queue.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/panic.hpp"
@@ -47,18 +51,37 @@ static g_tid taskingIdNext = 0;
 g_hashmap<g_tid, g_task*>* taskGlobalMap;
 
 void _taskingInitializeTask(g_task* task, g_process* process, g_security_level level);
+void _taskingSwitchToSpace(g_tasking_local* local, g_physical_address space);
 
-static void taskingFreeOnDemandMappings(g_memory_file_ondemand* mapping)
+static void taskingFreeOnDemandMappings(g_memory_ondemand_mappings* mappings)
 {
-	while(mapping)
+	for(uint32_t i = 0; i < mappings->count; i++)
+		heapFree(mappings->entries[i]);
+	if(mappings->entries)
+		heapFree(mappings->entries);
+	*mappings = {};
+}
+
+static g_memory_ondemand_mappings taskingCloneOnDemandMappings(g_memory_ondemand_mappings* mappings)
+{
+	g_memory_ondemand_mappings clone = {};
+	if(mappings->count == 0)
+		return clone;
+
+	clone.entries = (g_memory_file_ondemand**) heapAllocate(sizeof(g_memory_file_ondemand*) * mappings->capacity);
+	clone.capacity = mappings->capacity;
+	clone.count = mappings->count;
+	for(uint32_t i = 0; i < mappings->count; i++)
 	{
-		g_memory_file_ondemand* next = mapping->next;
-		heapFree(mapping);
-		mapping = next;
+		clone.entries[i] = (g_memory_file_ondemand*) heapAllocate(sizeof(g_memory_file_ondemand));
+		*clone.entries[i] = *mappings->entries[i];
 	}
+	return clone;
 }
 
 g_tasking_local* taskingGetLocal() { return &taskingLocal[processorGetCurrentId()]; }
+
+g_tasking_local* taskingGetLocal(uint32_t processor) { return &taskingLocal[processor]; }
 
 g_task* taskingGetCurrentTask()
 {
@@ -102,6 +125,7 @@ void taskingIdleThread()
 {
 	for(;;)
 	{
+		zeroPoolRefill();
 		asm volatile("hlt");
 	}
 }
@@ -141,6 +165,18 @@ void taskingInitializeLocal()
 	local->scheduling.list = nullptr;
 	local->scheduling.idleTask = nullptr;
 
+	local->spaces.loaded = pagingGetCurrentSpace();
+	local->spaces.loadedGeneration = pagingGetTlbGeneration(local->spaces.loaded);
+	for(uint32_t i = 0; i < G_TASKING_PCID_SLOTS; i++)
+	{
+		local->spaces.pcidSpaces[i] = 0;
+		local->spaces.pcidGenerations[i] = 0;
+	}
+	local->spaces.pcidNext = 0;
+
+	local->fpu.owner = nullptr;
+	local->fpu.dirty = false;
+
 	mutexInitializeGlobal(&local->lock, __func__);
 
 	schedulerInitializeLocal();
@@ -250,6 +286,7 @@ void taskingAssignOnCore(uint8_t core, g_task* task)
 {
 	if(core < processorGetNumberOfProcessors())
 	{
+		task->scheduling.pinned = true;
 		taskingAssign(&taskingLocal[core], task);
 	}
 	else
@@ -281,6 +318,9 @@ void taskingAssign(g_tasking_local* local, g_task* task)
 		newEntry->next = local->scheduling.list;
 		schedulerPrepareEntry(newEntry);
 		local->scheduling.list = newEntry;
+
+		if(task->status == G_TASK_STATUS_RUNNING)
+			schedulerEnqueue(local, task);
 	}
 
 	task->assignment = local;
@@ -295,13 +335,6 @@ void taskingSaveState(g_task* task, g_processor_state* state)
 {
 	// Save latest pointer to interrupt stack top
 	task->state = state;
-
-	// Save FPU state
-	if(task->fpu.state)
-	{
-		processorSaveFpuState(task->fpu.state);
-		task->fpu.stored = true;
-	}
 }
 
 
@@ -311,13 +344,14 @@ void taskingRestoreState(g_task* task)
 		panic("%! tried to restore without a current task", "tasking");
 
 	// Switch to process address space
+	g_tasking_local* local = taskingGetLocal();
 	if(task->overridePageDirectory)
 	{
-		pagingSwitchToSpace(task->overridePageDirectory);
+		_taskingSwitchToSpace(local, task->overridePageDirectory);
 	}
 	else
 	{
-		pagingSwitchToSpace(task->process->pageSpace);
+		_taskingSwitchToSpace(local, task->process->pageSpace);
 	}
 
 	// For TLS: write thread-local addresses
@@ -325,10 +359,99 @@ void taskingRestoreState(g_task* task)
 
 	// Set TSS RSP0 for ring 3 tasks to return onto
 	gdtSetTssRsp0(task->interruptStack.end);
+	task->threadLocal.kernelThreadLocal->syscallStack = task->interruptStack.end;
+
+	// Save FPU state of the owner if it was used, then let the next access trap
+	if(task->fpu.state)
+	{
+		if(local->fpu.dirty)
+		{
+			processorSaveFpuState(local->fpu.owner->fpu.state);
+			local->fpu.dirty = false;
+		}
+		processorSetTaskSwitched();
+	}
+}
 
-	// Restore FPU state
-	if(task->fpu.stored)
+void taskingSwitchToSpace(g_physical_address space)
+{
+	INTERRUPTS_PAUSE;
+	_taskingSwitchToSpace(taskingGetLocal(), space);
+	INTERRUPTS_RESUME;
+}
+
+void _taskingSwitchToSpace(g_tasking_local* local, g_physical_address space)
+{
+	// Publish before reading the generation; a concurrent unmap either sees this
+	// processor as a shootdown target or its generation change is seen here
+	local->spaces.loaded = space;
+	__sync_synchronize();
+
+	// Threads of the same process keep the TLB, unless a mapping of the space changed since
+	uint64_t generation = pagingGetTlbGeneration(space);
+	if(pagingGetCurrentSpace() == space && local->spaces.loadedGeneration == generation)
+		return;
+	local->spaces.loadedGeneration = generation;
+
+	if(!pagingPcidEnabled())
+	{
+		pagingSwitchToSpace(space);
+		return;
+	}
+
+	for(uint32_t i = 0; i < G_TASKING_PCID_SLOTS; i++)
+	{
+		if(local->spaces.pcidSpaces[i] == space)
+		{
+			// Tagged entries can only be kept if no mapping of the space changed since
+			bool stale = local->spaces.pcidGenerations[i] != generation;
+			local->spaces.pcidGenerations[i] = generation;
+			pagingSwitchToSpace(space, i + 1, stale);
+			return;
+		}
+	}
+
+	// Take over the next PCID, its entries belong to another space
+	uint32_t slot = local->spaces.pcidNext;
+	local->spaces.pcidNext = (slot + 1) % G_TASKING_PCID_SLOTS;
+	local->spaces.pcidSpaces[slot] = space;
+	local->spaces.pcidGenerations[slot] = generation;
+	pagingSwitchToSpace(space, slot + 1, true);
+}
+
+void taskingHandleFpuTrap(g_task* task)
+{
+	processorClearTaskSwitched();
+	if(!task || !task->fpu.state)
+		return;
+
+	// Registers still hold the tasks state if nobody else loaded theirs since
+	g_tasking_local* local = taskingGetLocal();
+	if(local->fpu.owner != task || task->fpu.processor != local->processor)
+	{
 		processorRestoreFpuState(task->fpu.state);
+		local->fpu.owner = task;
+		task->fpu.processor = local->processor;
+	}
+	local->fpu.dirty = true;
+}
+
+void taskingSaveFpuState(g_task* task, bool release)
+{
+	INTERRUPTS_PAUSE;
+	g_tasking_local* local = taskingGetLocal();
+	if(local->fpu.owner == task)
+	{
+		if(local->fpu.dirty)
+		{
+			processorSaveFpuState(task->fpu.state);
+			local->fpu.dirty = false;
+			processorSetTaskSwitched();
+		}
+		if(release)
+			local->fpu.owner = nullptr;
+	}
+	INTERRUPTS_RESUME;
 }
 
 void taskingSchedule(bool resetPreference)
@@ -372,12 +495,14 @@ void taskingDestroyProcess(g_process* process)
 		elfObjectDestroy(process->object);
 
 	filesystemProcessRemove(process->id);
+	requestsFreeMsi(process->id);
 
 	taskingMemoryDestroyPageSpace(process->pageSpace);
 
 	addressRangePoolDestroy(process->virtualRangePool);
 	heapFree(process->virtualRangePool);
 
+	taskingFreeOnDemandMappings(&process->onDemandMappings);
 	heapFree(process);
 
 	// TODO there is still some heap wasting
@@ -417,6 +542,8 @@ g_task* taskingCreateTaskVm86(g_process* process, uint32_t intr, g_vm86_register
 
 void taskingDestroyTask(g_task* task)
 {
+	clockUnwaitForTime(task);
+	mutexRemoveWaiter(&task->mutexWaiter);
 	mutexAcquire(&task->lock);
 
 	if(task->status != G_TASK_STATUS_DEAD)
@@ -460,6 +587,7 @@ void _taskingInitializeTask(g_task* task, g_process* process, g_security_level l
 	task->process = process;
 	task->securityLevel = level;
 	task->status = G_TASK_STATUS_RUNNING;
+	task->scheduling.priority = G_SCHEDULER_PRIORITY_DEFAULT;
 	waitQueueInitialize(&task->waitersJoin);
 	mutexInitializeGlobal(&task->lock, __func__);
 }
@@ -538,6 +666,73 @@ g_spawn_result taskingSpawn(g_fd fd, g_security_level securityLevel)
 	return res;
 }
 
+g_task* taskingFork(g_task* parent)
+{
+	// Kernel tasks have no user state to continue from
+	if(parent->securityLevel == G_SECURITY_LEVEL_KERNEL)
+		return nullptr;
+
+	g_process* parentProcess = parent->process;
+	g_process* process = taskingCreateProcess(parent->securityLevel);
+	if(!process)
+		return nullptr;
+	process->parentId = parentProcess->id;
+
+	// Take over the layout of the parent, its ELF objects stay with the parent
+	mutexAcquire(&parentProcess->lock);
+	addressRangePoolCloneRanges(process->virtualRangePool, parentProcess->virtualRangePool);
+	process->image = parentProcess->image;
+	process->heap = parentProcess->heap;
+	process->tlsMaster = parentProcess->tlsMaster;
+	process->userProcessInfo = parentProcess->userProcessInfo;
+	process->onDemandMappings = taskingCloneOnDemandMappings(&parentProcess->onDemandMappings);
+	process->syscallRing.ring = parentProcess->syscallRing.ring;
+	process->syscallRing.entries = parentProcess->syscallRing.entries;
+	process->syscallRing.drainer = G_TID_NONE;
+	if(parentProcess->environment.arguments)
+		process->environment.arguments = stringDuplicate(parentProcess->environment.arguments);
+	if(parentProcess->environment.executablePath)
+		process->environment.executablePath = stringDuplicate(parentProcess->environment.executablePath);
+	if(parentProcess->environment.workingDirectory)
+		process->environment.workingDirectory = stringDuplicate(parentProcess->environment.workingDirectory);
+
+	taskingMemoryForkPageSpace(parentProcess, process->pageSpace);
+	mutexRelease(&parentProcess->lock);
+
+	// Only the calling thread continues in the child, on its own interrupt stack
+	auto task = (g_task*) heapAllocateClear(sizeof(g_task));
+	_taskingInitializeTask(task, process, parent->securityLevel);
+	task->type = G_TASK_TYPE_DEFAULT;
+	task->stack = parent->stack;
+	task->threadLocal.userThreadLocal = parent->threadLocal.userThreadLocal;
+	task->threadLocal.start = parent->threadLocal.start;
+	task->threadLocal.end = parent->threadLocal.end;
+	task->interruptStack = taskingMemoryCreateStack(memoryVirtualRangePool, G_PAGE_TABLE_KERNEL_DEFAULT,
+	                                                G_PAGE_KERNEL_DEFAULT, G_TASKING_MEMORY_INTERRUPT_STACK_PAGES);
+	taskingMemoryInitializeUtility(task);
+	taskingMemoryInitializeTls(task);
+
+	if(task->fpu.state)
+	{
+		taskingSaveFpuState(parent, false);
+		memoryCopy(task->fpu.state, parent->fpu.state, processorGetFpuStateSize());
+	}
+
+	// Continue from the same user state that entered the kernel
+	auto parentState = (g_processor_state*) (parent->interruptStack.end - sizeof(g_processor_state));
+	auto state = (g_processor_state*) (task->interruptStack.end - sizeof(g_processor_state));
+	memoryCopy(state, parentState, sizeof(g_processor_state));
+	task->state = state;
+
+	taskingProcessAddToTaskList(process, task);
+	hashmapPut(taskGlobalMap, task->id, task);
+
+	filesystemProcessCloneAll(parentProcess->id, process->id);
+
+	logDebug("%! forked process %i from %i", "tasking", process->id, parentProcess->id);
+	return task;
+}
+
 void taskingSpawnEntry()
 {
 	auto task = taskingGetCurrentTask();
@@ -592,6 +787,7 @@ g_spawn_status taskExecCurrentProcess(g_task* task, g_fd fd, char* newArgs, char
 	auto oldExecPath = process->environment.executablePath;
 	auto oldTlsMaster = process->tlsMaster;
 	auto oldMappings = process->onDemandMappings;
+	auto oldRing = process->syscallRing;
 
 	g_stack oldStack = task->stack;
 	auto oldThreadLocal = task->threadLocal;
@@ -611,7 +807,8 @@ g_spawn_status taskExecCurrentProcess(g_task* task, g_fd fd, char* newArgs, char
 	process->tlsMaster.location = 0;
 	process->tlsMaster.size = 0;
 	process->tlsMaster.userThreadOffset = 0;
-	process->onDemandMappings = nullptr;
+	process->onDemandMappings = {};
+	process->syscallRing = {};
 
 	task->stack = taskingMemoryCreateStack(newPool, G_PAGE_TABLE_USER_DEFAULT,
 	                                       G_PAGE_USER_DEFAULT, G_TASKING_MEMORY_USER_STACK_PAGES);
@@ -627,6 +824,7 @@ g_spawn_status taskExecCurrentProcess(g_task* task, g_fd fd, char* newArgs, char
 		process->environment.executablePath = oldExecPath;
 		process->tlsMaster = oldTlsMaster;
 		process->onDemandMappings = oldMappings;
+		process->syscallRing = oldRing;
 
 		task->stack = oldStack;
 		task->threadLocal = oldThreadLocal;
@@ -642,7 +840,7 @@ g_spawn_status taskExecCurrentProcess(g_task* task, g_fd fd, char* newArgs, char
 	task->threadLocal.end = 0;
 
 	taskingMemoryInitializeUtility(task);
-	pagingSwitchToSpace(newSpace);
+	taskingSwitchToSpace(newSpace);
 
 	auto loadRes = elfLoadExecutable(fd, task->securityLevel);
 	if(validation)
@@ -653,7 +851,7 @@ g_spawn_status taskExecCurrentProcess(g_task* task, g_fd fd, char* newArgs, char
 		taskingMemoryDestroyUtility(task);
 		taskingMemoryDestroyStack(newPool, task->stack);
 
-		pagingSwitchToSpace(oldSpace);
+		taskingSwitchToSpace(oldSpace);
 
 		process->pageSpace = oldSpace;
 		process->virtualRangePool = oldPool;
@@ -665,6 +863,7 @@ g_spawn_status taskExecCurrentProcess(g_task* task, g_fd fd, char* newArgs, char
 		process->environment.executablePath = oldExecPath;
 		process->tlsMaster = oldTlsMaster;
 		process->onDemandMappings = oldMappings;
+		process->syscallRing = oldRing;
 
 		task->stack = oldStack;
 		task->threadLocal = oldThreadLocal;
@@ -688,7 +887,7 @@ g_spawn_status taskExecCurrentProcess(g_task* task, g_fd fd, char* newArgs, char
 		elfObjectDestroy(oldObject);
 	if(oldFpu.stateMem)
 		heapFree(oldFpu.stateMem);
-	taskingFreeOnDemandMappings(oldMappings);
+	taskingFreeOnDemandMappings(&oldMappings);
 
 	taskingMemoryDestroyPageSpace(oldSpace);
 	addressRangePoolDestroy(oldPool);
@@ -728,9 +927,27 @@ void taskingWake(g_task* task)
 	if(task)
 	{
 		mutexAcquire(&task->lock);
+		bool woken = false;
 		if(task->status == G_TASK_STATUS_WAITING)
+		{
 			task->status = G_TASK_STATUS_RUNNING;
+			woken = true;
+		}
 		mutexRelease(&task->lock);
+
+		if(woken && task->assignment)
+		{
+			g_tasking_local* local = task->assignment;
+
+			// A task that is woken before it yielded is still running; it is
+			// queued again when its processor switches away from it
+			mutexAcquire(&local->lock);
+			if(local->scheduling.current != task)
+				schedulerEnqueue(local, task);
+			mutexRelease(&local->lock);
+
+			schedulerNotify(local);
+		}
 	}
 }
 
@@ -30,12 +30,36 @@
 
 extern g_hashmap<g_tid, g_task*>* taskGlobalMap;
 
+/**
+ * Number of page spaces per processor that keep a PCID and therefore their TLB
+ * entries while other spaces are active.
+ */
+#define G_TASKING_PCID_SLOTS 32
+
 struct g_schedule_entry
 {
     g_task* task;
     g_schedule_entry* next;
 };
 
+/**
+ * Number of priority levels of the scheduler. Each level has its own ready queue,
+ * a bitmap tells which of the queues are non-empty.
+ */
+#define G_SCHEDULER_PRIORITY_LEVELS 32
+#define G_SCHEDULER_PRIORITY_HIGHEST 0
+#define G_SCHEDULER_PRIORITY_DEFAULT 16
+#define G_SCHEDULER_PRIORITY_LOWEST (G_SCHEDULER_PRIORITY_LEVELS - 1)
+
+/**
+ * FIFO of tasks that are ready to run, linked through the tasks themselves.
+ */
+struct g_schedule_queue
+{
+    g_task* head;
+    g_task* tail;
+};
+
 /**
  * Processor local tasking structure. For each processor there is one instance
  * of this struct that contains the current state.
@@ -66,11 +90,82 @@ struct g_tasking_local
      */
     struct
     {
+        /**
+         * List of all tasks that are assigned to this processor, no matter their status.
+         */
         g_schedule_entry* list;
         g_task* current;
 
         g_task* idleTask;
+
+        /**
+         * Tasks that are ready to run. The current task is not part of these queues
+         * while it is running; waiting tasks are only added again once they are woken.
+         */
+        uint32_t readyBitmap;
+        uint32_t readyCount;
+        g_schedule_queue ready[G_SCHEDULER_PRIORITY_LEVELS];
     } scheduling;
+
+    /**
+     * Load balancing information for this processor.
+     */
+    struct
+    {
+        uint64_t lastBalanceTime;
+
+        /**
+         * Number of tasks this processor has pulled from other processors.
+         */
+        uint32_t steals;
+
+        /**
+         * Number of tasks that other processors have pulled from this processor.
+         */
+        uint32_t migrations;
+    } balancing;
+
+    /**
+     * Address space switching information for this processor.
+     */
+    struct
+    {
+        /**
+         * Page space that is currently loaded in CR3, read by other processors to
+         * decide whether a TLB shootdown must target this processor.
+         */
+        volatile g_physical_address loaded;
+
+        /**
+         * TLB generation of the loaded space when it was last validated.
+         */
+        uint64_t loadedGeneration;
+
+        /**
+         * Page space that currently holds each PCID, where slot i is PCID i + 1, and
+         * the TLB generation of that space when its tagged entries were last validated.
+         */
+        g_physical_address pcidSpaces[G_TASKING_PCID_SLOTS];
+        uint64_t pcidGenerations[G_TASKING_PCID_SLOTS];
+        uint32_t pcidNext;
+    } spaces;
+
+    /**
+     * Lazy FPU switching information for this processor.
+     */
+    struct
+    {
+        /**
+         * Task whose FPU state was last loaded into the registers of this processor.
+         */
+        g_task* owner;
+
+        /**
+         * Set when the owner has used the FPU since the last switch, meaning the
+         * registers must be saved before another task may use them.
+         */
+        bool dirty;
+    } fpu;
 };
 
 struct g_spawn_result
@@ -85,6 +180,11 @@ struct g_spawn_result
  */
 g_tasking_local* taskingGetLocal();
 
+/**
+ * @return the tasking structure of the given processor
+ */
+g_tasking_local* taskingGetLocal(uint32_t processor);
+
 /**
  * @return the task that is on this processor currently running or was
  * last running when called from within a system call handler
@@ -199,16 +299,39 @@ void taskingSetCurrent(g_task* task);
 
 /**
  * Saves the state pointer that points to the stored state on the tasks kernel
- * stack. Also stores additional registers like for SSE.
+ * stack. The FPU state is not saved here, see <taskingRestoreState>.
  */
 void taskingSaveState(g_task* task, g_processor_state* state);
 
 /**
  * Applies the context switch to the task which is the current one for this core. This sets
- * the correct page directory and TLS variables.
+ * the correct page directory and TLS variables. If the FPU was used since the last switch,
+ * its state is saved for the owner and CR0.TS is set so the next FPU instruction traps.
  */
 void taskingRestoreState(g_task* task);
 
+/**
+ * Switches the current processor to the given page space. Skips the CR3 write if
+ * the space is already loaded and uses PCIDs if available.
+ */
+void taskingSwitchToSpace(g_physical_address space);
+
+/**
+ * Handles a device-not-available exception (#NM) that occurs when the task uses the
+ * FPU while CR0.TS is set. Clears CR0.TS and loads the tasks FPU state unless it is
+ * still in the registers of this processor.
+ */
+void taskingHandleFpuTrap(g_task* task);
+
+/**
+ * If the task is the FPU owner on this processor and has used the FPU since the last
+ * switch, saves the registers to the tasks state buffer.
+ *
+ * @param release whether this processor should forget about the task as owner, for
+ *	example because its state buffer is about to be replaced
+ */
+void taskingSaveFpuState(g_task* task, bool release);
+
 /**
  * Yields control to the next task. This can only be called while no mutexes
  * are currently acquired by this thread, otherwise the kernel could get deadlocked.
@@ -236,6 +359,15 @@ g_task* taskingGetById(g_tid id);
  */
 g_spawn_result taskingSpawn(g_fd fd, g_security_level securityLevel);
 
+/**
+ * Forks the process of the given ring 3 task. The page space of the new process is
+ * a copy-on-write clone of the parent and the new main task continues with the state
+ * the parent task had when it entered the kernel. The new task is not assigned yet.
+ *
+ * @return the new main task or null
+ */
+g_task* taskingFork(g_task* parent);
+
 /**
  * Entry function for a newly spawned task. Loads the executable binary and then executes a
  * privilege downgrade to enter the user-level task execution.
@@ -23,6 +23,7 @@
 #include "kernel/memory/lower_heap.hpp"
 #include "kernel/memory/memory.hpp"
 #include "kernel/memory/page_reference_tracker.hpp"
+#include "kernel/memory/tlb_shootdown.hpp"
 #include "kernel/system/processor/processor.hpp"
 #include "kernel/memory/constants.hpp"
 #include "kernel/logger/logger.hpp"
@@ -39,7 +40,7 @@ bool taskingMemoryExtendHeap(g_task* task, int32_t amount, g_address* outAddress
 	{
 		g_virtual_address heapStart = process->image.end;
 
-		g_physical_address phys = memoryPhysicalAllocate();
+		g_physical_address phys = memoryPhysicalAllocateZeroed();
 		pagingMapPage(heapStart, phys, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 
 		process->heap.brk = heapStart;
@@ -65,7 +66,7 @@ bool taskingMemoryExtendHeap(g_task* task, int32_t amount, g_address* outAddress
 	g_virtual_address virt_above;
 	while(newBrk > (virt_above = process->heap.start + process->heap.pages * G_PAGE_SIZE))
 	{
-		g_physical_address phys = memoryPhysicalAllocate();
+		g_physical_address phys = memoryPhysicalAllocateZeroed();
 		pagingMapPage(virt_above, phys, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 		++process->heap.pages;
 	}
@@ -100,20 +101,25 @@ void taskingMemoryInitialize(g_task* task)
 
 void taskingMemoryInitializeUtility(g_task* task)
 {
+	// State buffer is replaced on exec, registers of this processor may not be used anymore
+	taskingSaveFpuState(task, true);
+
 	if(processorHasFeature(g_cpuid_standard_edx_feature::SSE))
 	{
+		uint32_t size = processorGetFpuStateSize();
+
 		// TODO Allocator not capable of aligned allocation
-		task->fpu.stateMem = (uint8_t*) heapAllocate(G_SSE_STATE_SIZE + G_SSE_STATE_ALIGNMENT);
-		task->fpu.state = (uint8_t*) G_ALIGN_UP((g_address) task->fpu.stateMem, G_SSE_STATE_ALIGNMENT);
+		task->fpu.stateMem = (uint8_t*) heapAllocate(size + G_FPU_STATE_ALIGNMENT);
+		task->fpu.state = (uint8_t*) G_ALIGN_UP((g_address) task->fpu.stateMem, G_FPU_STATE_ALIGNMENT);
 
 		if(task->process && task->process->main && task->process->main != task)
 		{
-			memoryCopy(task->fpu.state, task->process->main->fpu.state, G_SSE_STATE_SIZE);
-			task->fpu.stored = true;
+			taskingSaveFpuState(task->process->main, false);
+			memoryCopy(task->fpu.state, task->process->main->fpu.state, size);
 		}
 		else
 		{
-			memoryCopy(task->fpu.state, processorGetInitialFpuState(), G_SSE_STATE_SIZE);
+			memoryCopy(task->fpu.state, processorGetInitialFpuState(), size);
 		}
 	}
 	else
@@ -121,7 +127,7 @@ void taskingMemoryInitializeUtility(g_task* task)
 		task->fpu.stateMem = nullptr;
 		task->fpu.state = nullptr;
 	}
-	task->fpu.stored = false;
+	task->fpu.processor = G_FPU_PROCESSOR_NONE;
 }
 
 void taskingMemoryInitializeStacks(g_task* task)
@@ -164,7 +170,7 @@ g_stack taskingMemoryCreateStack(g_address_range_pool* addressRangePool, uint32_
 
 	// Only allocate and map the last page of the stack; when the process faults, lazy-allocate more physical space.
 	// The first page of the allocated virtual range is used as a "guard page" and makes the process fault when accessed.
-	g_physical_address pagePhys = memoryPhysicalAllocate();
+	g_physical_address pagePhys = memoryPhysicalAllocateZeroed();
 	g_address stackEnd = stackVirt + pages * G_PAGE_SIZE;
 	pagingMapPage(stackEnd - G_PAGE_SIZE, pagePhys, tableFlags, pageFlags);
 
@@ -185,25 +191,27 @@ void taskingMemoryDestroyUtility(g_task* task)
 {
 	if(task->fpu.stateMem)
 	{
+		taskingSaveFpuState(task, true);
 		heapFree(task->fpu.stateMem);
 		task->fpu.stateMem = nullptr;
 	}
 }
 
+/**
+ * Unmaps a range of the current space. Other threads of the process may run on other
+ * processors, so the pages are only freed after their TLB entries were shot down.
+ */
+static void _taskingMemoryUnmapAndFree(g_virtual_address start, g_virtual_address end)
+{
+	memoryUnmapRange(pagingGetCurrentSpace(), start, (end - start) / G_PAGE_SIZE);
+}
+
 void taskingMemoryDestroyStacks(g_task* task)
 {
 	// Remove interrupt stack
 	if(task->interruptStack.start)
 	{
-		for(g_virtual_address virt = task->interruptStack.start; virt < task->interruptStack.end; virt += G_PAGE_SIZE)
-		{
-			g_physical_address phys = pagingVirtualToPhysical(virt);
-			if(phys > 0)
-			{
-				memoryPhysicalFree(phys);
-				pagingUnmapPage(virt);
-			}
-		}
+		_taskingMemoryUnmapAndFree(task->interruptStack.start, task->interruptStack.end);
 		addressRangePoolFree(memoryVirtualRangePool, task->interruptStack.start);
 	}
 
@@ -224,16 +232,7 @@ void taskingMemoryDestroyStacks(g_task* task)
 
 void taskingMemoryDestroyStack(g_address_range_pool* addressRangePool, g_stack& stack)
 {
-	for(g_virtual_address page = stack.start; page < stack.end; page += G_PAGE_SIZE)
-	{
-		g_physical_address pagePhys = pagingVirtualToPhysical(page);
-		if(!pagePhys)
-			continue;
-
-		memoryPhysicalFree(pagePhys);
-		pagingUnmapPage(page);
-	}
-
+	_taskingMemoryUnmapAndFree(stack.start, stack.end);
 	addressRangePoolFree(addressRangePool, stack.start);
 }
 
@@ -256,6 +255,121 @@ g_physical_address taskingMemoryCreatePageSpace()
 	return newPml4Phys;
 }
 
+/**
+ * Allocates a page table for a forked space and copies the flags of the source entry.
+ */
+static uint64_t _taskingMemoryForkTable(uint64_t sourceEntry, volatile uint64_t** outTable)
+{
+	g_physical_address table = memoryPhysicalAllocate(true);
+	if(!table)
+		panic("%! failed to allocate physical memory for a page table", "tasking");
+
+	auto tableVirt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(table);
+	for(int i = 0; i < 512; i++)
+		tableVirt[i] = 0;
+
+	*outTable = tableVirt;
+	return table | (sourceEntry & G_PAGE_ALIGN_MASK);
+}
+
+void taskingMemoryForkPageSpace(g_process* source, g_physical_address target)
+{
+	mutexAcquire(&source->lock);
+
+	auto sourcePml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(source->pageSpace);
+	auto targetPml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(target);
+	for(size_t pml4Index = 0; pml4Index < 256; ++pml4Index)
+	{
+		uint64_t pml4Entry = sourcePml4[pml4Index];
+		if(!pml4Entry)
+			continue;
+
+		auto pdpt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pml4Entry & ~G_PAGE_ALIGN_MASK);
+		volatile uint64_t* targetPdpt;
+		targetPml4[pml4Index] = _taskingMemoryForkTable(pml4Entry, &targetPdpt);
+
+		for(size_t pdptIndex = 0; pdptIndex < 512; ++pdptIndex)
+		{
+			uint64_t pdptEntry = pdpt[pdptIndex];
+			if(!pdptEntry)
+				continue;
+
+			auto pd = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pdptEntry & ~G_PAGE_ALIGN_MASK);
+			volatile uint64_t* targetPd;
+			targetPdpt[pdptIndex] = _taskingMemoryForkTable(pdptEntry, &targetPd);
+
+			for(size_t pdIndex = 0; pdIndex < 512; ++pdIndex)
+			{
+				uint64_t pdEntry = pd[pdIndex];
+				if(!pdEntry)
+					continue;
+
+				// Large pages of device or pinned memory are shared as a whole, others are
+				// split so that their pages can be copied on write individually
+				if(pdEntry & G_PAGE_LARGE_PAGE_FLAG)
+				{
+					g_physical_address base = pdEntry & G_PAGE_LARGE_ADDRESS_MASK;
+					if(pageReferenceTrackerGet(base) == 0 ||
+					   (pageReferenceTrackerGetFlags(base) & G_PAGE_FRAME_FLAG_PINNED))
+					{
+						for(uint32_t i = 0; i < G_PAGE_LARGE_PAGES; i++)
+							pageReferenceTrackerIncrement(base + i * G_PAGE_SIZE);
+						targetPd[pdIndex] = pdEntry;
+						pagingCountLargePages(1);
+						continue;
+					}
+
+					pagingSplitLargePage(source->pageSpace, G_PML4_VIRT_ADDRESS(pml4Index, pdptIndex, pdIndex, 0));
+					pdEntry = pd[pdIndex];
+				}
+
+				auto pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pdEntry & ~G_PAGE_ALIGN_MASK);
+				volatile uint64_t* targetPt;
+				targetPd[pdIndex] = _taskingMemoryForkTable(pdEntry, &targetPt);
+
+				for(size_t ptIndex = 0; ptIndex < 512; ++ptIndex)
+				{
+					uint64_t ptEntry = pt[ptIndex];
+					if(!ptEntry)
+						continue;
+
+					// Memory that is not managed by the kernel (for example MMIO) is shared as is
+					g_physical_address page = ptEntry & ~G_PAGE_ALIGN_MASK;
+					if(pageReferenceTrackerGet(page) == 0)
+					{
+						targetPt[ptIndex] = ptEntry;
+						continue;
+					}
+					pageReferenceTrackerIncrement(page);
+
+					// Both processes keep reading the same page until one of them writes to it,
+					// pinned pages are written by devices and must stay the same for both
+					if((ptEntry & G_PAGE_WRITABLE_FLAG) && !(ptEntry & G_PAGE_SHARED_FLAG) &&
+					   !(pageReferenceTrackerGetFlags(page) & G_PAGE_FRAME_FLAG_PINNED))
+					{
+						ptEntry = (ptEntry & ~G_PAGE_WRITABLE_FLAG) | G_PAGE_COPY_ON_WRITE_FLAG;
+						pt[ptIndex] = ptEntry;
+						pageReferenceTrackerSetFlags(page, G_PAGE_FRAME_FLAG_COPY_ON_WRITE);
+					}
+					targetPt[ptIndex] = ptEntry;
+				}
+			}
+		}
+	}
+
+	// Writable entries of the source may be cached on any processor that runs one of its threads
+	pagingMarkTlbStale(source->pageSpace);
+	if(pagingGetCurrentSpace() == source->pageSpace)
+		pagingFlushTlb();
+
+	g_tlb_shootdown_batch batch;
+	tlbShootdownBegin(&batch, source->pageSpace);
+	tlbShootdownAddAll(&batch);
+	tlbShootdownFinish(&batch);
+
+	mutexRelease(&source->lock);
+}
+
 void taskingMemoryDestroyPageSpace(g_physical_address directory)
 {
 	g_physical_address returnDirectory = taskingMemoryTemporarySwitchTo(directory);
@@ -283,8 +397,10 @@ void taskingMemoryDestroyPageSpace(g_physical_address directory)
 
 				if(pdEntry & G_PAGE_LARGE_PAGE_FLAG)
 				{
-					g_physical_address large = pdEntry & ~G_PAGE_ALIGN_MASK;
-					memoryPhysicalFree(large);
+					g_physical_address large = pdEntry & G_PAGE_LARGE_ADDRESS_MASK;
+					for(uint32_t i = 0; i < G_PAGE_LARGE_PAGES; i++)
+						memoryPhysicalFree(large + i * G_PAGE_SIZE);
+					pagingCountLargePages(-1);
 				}
 				else
 				{
@@ -315,6 +431,8 @@ void taskingMemoryDestroyPageSpace(g_physical_address directory)
 
 	taskingMemoryTemporarySwitchBack(returnDirectory);
 
+	// Processors may still have entries tagged for this space, which could be reused
+	pagingMarkTlbStale(directory);
 	memoryPhysicalFree(directory);
 }
 
@@ -325,6 +443,8 @@ void taskingMemoryInitializeTls(g_task* task)
 	{
 		auto kernelThreadLocal = (g_kernel_threadlocal*) heapAllocate(sizeof(g_kernel_threadlocal));
 		kernelThreadLocal->processor = processorGetCurrentId();
+		kernelThreadLocal->syscallStack = 0;
+		kernelThreadLocal->userStack = 0;
 		task->threadLocal.kernelThreadLocal = kernelThreadLocal;
 	}
 
@@ -343,14 +463,10 @@ void taskingMemoryInitializeTls(g_task* task)
 			g_virtual_address tlsStart = addressRangePoolAllocate(process->virtualRangePool, requiredPages);
 			g_virtual_address tlsEnd = tlsStart + requiredPages * G_PAGE_SIZE;
 
-			for(g_virtual_address page = tlsStart; page < tlsEnd; page += G_PAGE_SIZE)
-			{
-				g_physical_address phys = memoryPhysicalAllocate();
-				pagingMapPage(page, phys, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
-			}
+			memoryAllocateRange(process->pageSpace, tlsStart, requiredPages, G_PAGE_TABLE_USER_DEFAULT,
+			                    G_PAGE_USER_DEFAULT);
 
 			// Copy TLS contents
-			memorySetBytes((void*) tlsStart, 0, process->tlsMaster.size);
 			memoryCopy((void*) tlsStart, (void*) process->tlsMaster.location, process->tlsMaster.size);
 
 			// Store information
@@ -369,15 +485,7 @@ void taskingMemoryDestroyTls(g_task* task)
 {
 	if(task->threadLocal.start)
 	{
-		for(g_virtual_address page = task->threadLocal.start; page < task->threadLocal.end; page += G_PAGE_SIZE)
-		{
-			g_physical_address pagePhys = pagingVirtualToPhysical(page);
-			if(pagePhys > 0)
-			{
-				memoryPhysicalFree(pagePhys);
-				pagingUnmapPage(page);
-			}
-		}
+		_taskingMemoryUnmapAndFree(task->threadLocal.start, task->threadLocal.end);
 		addressRangePoolFree(task->process->virtualRangePool, task->threadLocal.start);
 	}
 
@@ -395,7 +503,7 @@ g_physical_address taskingMemoryTemporarySwitchTo(g_physical_address pageDirecto
 
 		local->scheduling.current->overridePageDirectory = pageDirectory;
 	}
-	pagingSwitchToSpace(pageDirectory);
+	taskingSwitchToSpace(pageDirectory);
 	return back;
 }
 
@@ -404,7 +512,7 @@ void taskingMemoryTemporarySwitchBack(g_physical_address back)
 	g_tasking_local* local = taskingGetLocal();
 	if(local->scheduling.current)
 		local->scheduling.current->overridePageDirectory = 0;
-	pagingSwitchToSpace(back);
+	taskingSwitchToSpace(back);
 }
 
 bool taskingMemoryHandleStackOverflow(g_task* task, g_virtual_address accessed)
@@ -437,6 +545,7 @@ bool taskingMemoryHandleStackOverflow(g_task* task, g_virtual_address accessed)
 		pageFlags = G_PAGE_USER_DEFAULT;
 	}
 
-	pagingMapPage(accessedPage, memoryPhysicalAllocate(), tableFlags, pageFlags);
+	pagingMapPage(accessedPage, memoryPhysicalAllocateZeroed(), tableFlags, pageFlags);
+	__sync_fetch_and_add(&task->process->faults.minor, 1);
 	return true;
 }
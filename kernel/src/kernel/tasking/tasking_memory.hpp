@@ -88,6 +88,14 @@ void taskingMemoryDestroyStack(g_address_range_pool* addressRangePool, g_stack&
  */
 g_physical_address taskingMemoryCreatePageSpace();
 
+/**
+ * Fills the lower half of the target space with the mappings of the source process.
+ * Writable pages are marked copy-on-write in both spaces, so they are only copied
+ * once either process writes to them. Pages that are shared with other processes
+ * stay shared.
+ */
+void taskingMemoryForkPageSpace(g_process* source, g_physical_address target);
+
 /**
  * Destory the page directory of a process.
  */
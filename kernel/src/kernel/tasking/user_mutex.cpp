@@ -20,202 +20,204 @@
 
 #include "kernel/tasking/user_mutex.hpp"
 #include "kernel/memory/heap.hpp"
-#include "kernel/utils/hashmap.hpp"
-#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/memory/paging.hpp"
+#include "kernel/memory/page_reference_tracker.hpp"
+#include "kernel/memory/constants.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/logger/logger.hpp"
 
-static g_user_mutex nextMutex;
-static g_mutex globalLock;
-static g_hashmap<g_user_mutex, g_user_mutex_entry*>* mutexMap;
+static g_user_mutex_bucket buckets[G_USER_MUTEX_BUCKETS];
 
-void _userMutexSetTaskWaiting(g_user_mutex_entry* entry, g_task* task);
-void _userMutexWakeWaitingTasks(g_user_mutex_entry* entry);
+g_physical_address _userMutexReferencePage(g_task* task, volatile uint32_t* address);
+g_user_mutex_bucket* _userMutexGetBucket(g_pid process, g_address address);
+void _userMutexUnlinkWaiter(g_user_mutex_bucket* bucket, g_user_mutex_waiter* waiter);
 
 void userMutexInitialize()
 {
-	mutexInitializeGlobal(&globalLock, __func__);
-	nextMutex = 0;
-	mutexMap = hashmapCreateNumeric<g_user_mutex, g_user_mutex_entry*>(128);
-}
-
-g_user_mutex userMutexCreate(bool reentrant)
-{
-	g_user_mutex_entry* entry = (g_user_mutex_entry*) heapAllocate(sizeof(g_user_mutex_entry));
-	mutexInitializeTask(&entry->lock, __func__);
-	entry->value = 0;
-	waitQueueInitialize(&entry->waiters);
-	entry->reentrant = reentrant;
-	entry->owner = -1;
-
-	mutexAcquire(&globalLock);
-	g_user_mutex mutex = ++nextMutex;
-	mutexRelease(&globalLock);
-	hashmapPut(mutexMap, mutex, entry);
-
-	return mutex;
+	for(int i = 0; i < G_USER_MUTEX_BUCKETS; i++)
+	{
+		mutexInitializeGlobal(&buckets[i].lock, __func__);
+		buckets[i].head = nullptr;
+		buckets[i].tail = nullptr;
+	}
 }
 
-g_user_mutex_status userMutexTryAcquire(g_task* task, g_user_mutex mutex)
+g_user_mutex_wait_status userMutexWait(g_task* task, volatile uint32_t* address, uint32_t expected, uint64_t timeout)
 {
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
+	g_physical_address page = _userMutexReferencePage(task, address);
+	if(!page)
 	{
-		logWarn("%! task %i tried to lock unknown mutex %i", "mutex", task->id, mutex);
-		return false;
+		logWarn("%! task %i tried to wait on invalid address %h", "mutex", task->id, address);
+		return G_USER_MUTEX_WAIT_STATUS_INVALID;
 	}
 
-	g_user_mutex_status status;
-	mutexAcquire(&entry->lock);
-	if(entry->value)
-	{
-		if(entry->reentrant && task->id == entry->owner)
-		{
-			entry->value++;
-			status = G_USER_MUTEX_STATUS_ACQUIRED;
-		}
-		else
-			status = G_USER_MUTEX_STATUS_NOT_ACQUIRED;
-	}
-	else
-	{
-		status = G_USER_MUTEX_STATUS_ACQUIRED;
-		entry->value = 1;
-		if(entry->reentrant)
-		{
-			entry->owner = task->id;
-		}
-		else
-			entry->owner = G_TID_NONE;
-	}
-	mutexRelease(&entry->lock);
-	return status;
-}
+	// Read through the direct mapping, another task of the process may unmap the word
+	// at any time and a page fault must not happen while holding the bucket lock
+	auto word = (volatile uint32_t*) G_MEM_PHYS_TO_VIRT(page + ((g_address) address & G_PAGE_ALIGN_MASK));
 
-g_user_mutex_status userMutexAcquire(g_task* task, g_user_mutex mutex, uint64_t timeout, bool trying)
-{
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
+	g_user_mutex_bucket* bucket = _userMutexGetBucket(task->process->id, (g_address) address);
+
+	mutexAcquire(&bucket->lock);
+	bool changed = (*word != expected);
+	memoryPhysicalFree(page);
+	if(changed)
 	{
-		logWarn("%! task %i attempted to acquire unknown mutex %i", "mutex", taskingGetCurrentTask()->id, mutex);
-		return G_USER_MUTEX_STATUS_NOT_ACQUIRED;
+		mutexRelease(&bucket->lock);
+		return G_USER_MUTEX_WAIT_STATUS_CHANGED;
 	}
 
-	bool wasSet = false;
-	bool hasTimeout = false;
+	auto waiter = (g_user_mutex_waiter*) heapAllocate(sizeof(g_user_mutex_waiter));
+	waiter->process = task->process->id;
+	waiter->address = (g_address) address;
+	waiter->task = task->id;
+	waiter->woken = false;
+	waiter->next = nullptr;
+
+	if(bucket->tail)
+		bucket->tail->next = waiter;
+	else
+		bucket->head = waiter;
+	bucket->tail = waiter;
 
 	bool useTimeout = (timeout > 0);
 	if(useTimeout)
-		clockWaitForTime(task->id, clockGetLocal()->time + timeout);
+		clockWaitForTime(task, clockGetNanos() + timeout * 1000000ULL);
 
+	g_user_mutex_wait_status status;
 	while(true)
 	{
-		mutexAcquire(&entry->lock);
-		bool stop = false;
-		if(useTimeout && (hasTimeout = clockHasTimedOut(task->id)))
+		taskingWait(task, __func__, [bucket]()
 		{
-			stop = true;
-		}
-		else
+			mutexRelease(&bucket->lock);
+		});
+
+		mutexAcquire(&bucket->lock);
+		if(waiter->woken)
 		{
-			g_user_mutex_status status = userMutexTryAcquire(task, mutex);
-			wasSet = (status == G_USER_MUTEX_STATUS_ACQUIRED);
-			stop = wasSet || trying;
+			status = G_USER_MUTEX_WAIT_STATUS_WOKEN;
+			break;
 		}
-		if(stop)
+		if(useTimeout && clockHasTimedOut(task))
 		{
-			mutexRelease(&entry->lock);
+			_userMutexUnlinkWaiter(bucket, waiter);
+			status = G_USER_MUTEX_WAIT_STATUS_TIMEOUT;
 			break;
 		}
-
-		taskingWait(task, __func__, [mutex, entry, task]()
-		{
-			userMutexWaitForAcquire(mutex, task->id);
-			mutexRelease(&entry->lock);
-		});
 	}
+	mutexRelease(&bucket->lock);
+	heapFree(waiter);
 
 	if(useTimeout)
-		clockUnwaitForTime(task->id);
-
-	userMutexUnwaitForAcquire(mutex, task->id);
+		clockUnwaitForTime(task);
 
-	return hasTimeout
-		       ? G_USER_MUTEX_STATUS_TIMEOUT
-		       : (wasSet ? G_USER_MUTEX_STATUS_ACQUIRED : G_USER_MUTEX_STATUS_NOT_ACQUIRED);
+	return status;
 }
 
-void userMutexRelease(g_user_mutex mutex)
+uint32_t userMutexWake(g_task* task, volatile uint32_t* address, uint32_t count)
 {
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
-	{
-		logWarn("%! task %i tried to unlock unknown mutex %i", "mutex", taskingGetCurrentTask()->id, mutex);
-		return;
-	}
+	g_pid process = task->process->id;
+	g_user_mutex_bucket* bucket = _userMutexGetBucket(process, (g_address) address);
 
-	mutexAcquire(&entry->lock);
-	if(entry->reentrant)
+	g_tid woken[G_USER_MUTEX_WAKE_BATCH];
+	uint32_t total = 0;
+	while(total < count)
 	{
-		entry->value--;
-		if(entry->value <= 0)
+		// Unlink in batches so that no task is woken while holding the bucket lock
+		uint32_t batch = 0;
+		g_user_mutex_waiter* freeList = nullptr;
+
+		mutexAcquire(&bucket->lock);
+		g_user_mutex_waiter* waiter = bucket->head;
+		while(waiter && batch < G_USER_MUTEX_WAKE_BATCH && total + batch < count)
 		{
-			if(entry->value < 0)
+			g_user_mutex_waiter* next = waiter->next;
+			if(waiter->process == process && waiter->address == (g_address) address)
 			{
-				logInfo("over-release of mutex %x", entry);
+				_userMutexUnlinkWaiter(bucket, waiter);
+
+				// Tasks that died while waiting don't consume the wake-up
+				g_task* waiting = taskingGetById(waiter->task);
+				if(waiting && waiting->status != G_TASK_STATUS_DEAD)
+				{
+					woken[batch++] = waiter->task;
+					waiter->woken = true;
+				}
+				else
+				{
+					waiter->next = freeList;
+					freeList = waiter;
+				}
 			}
-			entry->value = 0;
-			entry->owner = G_TID_NONE;
-			_userMutexWakeWaitingTasks(entry);
+			waiter = next;
 		}
+		bool exhausted = (waiter == nullptr);
+		mutexRelease(&bucket->lock);
+
+		while(freeList)
+		{
+			auto next = freeList->next;
+			heapFree(freeList);
+			freeList = next;
+		}
+
+		for(uint32_t i = 0; i < batch; i++)
+			taskingWake(taskingGetById(woken[i]));
+		total += batch;
+
+		if(exhausted)
+			break;
 	}
-	else
-	{
-		entry->value = 0;
-		_userMutexWakeWaitingTasks(entry);
-	}
-	mutexRelease(&entry->lock);
+	return total;
 }
 
-void userMutexDestroy(g_user_mutex mutex)
+/**
+ * Validates the address of a mutex word and takes a reference on the physical page
+ * behind it, so that the page stays allocated while the word is read.
+ *
+ * @return the referenced page or 0 if the address is not valid
+ */
+g_physical_address _userMutexReferencePage(g_task* task, volatile uint32_t* address)
 {
-	userMutexRelease(mutex);
+	g_address addr = (g_address) address;
+	if(!addr || (addr & (sizeof(uint32_t) - 1)) || addr > G_MEM_LOWER_HALF_END)
+		return 0;
 
-	mutexAcquire(&mutexMap->lock);
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(entry)
-	{
-		hashmapRemove(mutexMap, mutex);
-		heapFree(entry);
-	}
-	mutexRelease(&mutexMap->lock);
+	g_physical_address page = pagingVirtualToPhysical(addr & ~G_PAGE_ALIGN_MASK);
+
+	// The mutex may lie in lazily allocated memory that was not touched yet
+	if(!page && memoryOnDemandHandlePageFault(task, addr))
+		page = pagingVirtualToPhysical(addr & ~G_PAGE_ALIGN_MASK);
+
+	if(!page || !pageReferenceTrackerTryIncrement(page))
+		return 0;
+	return page;
 }
 
-void userMutexWaitForAcquire(g_user_mutex mutex, g_tid task)
+g_user_mutex_bucket* _userMutexGetBucket(g_pid process, g_address address)
 {
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
-	{
-		logWarn("%! tried to add waiter for task %i to unknown mutex %i", "mutex", task, mutex);
-		return;
-	}
-
-	waitQueueAdd(&entry->waiters, task);
+	uint64_t hash = (address >> 2) ^ ((uint64_t) process * 0x9E3779B1);
+	return &buckets[hash % G_USER_MUTEX_BUCKETS];
 }
 
-void userMutexUnwaitForAcquire(g_user_mutex mutex, g_tid task)
+void _userMutexUnlinkWaiter(g_user_mutex_bucket* bucket, g_user_mutex_waiter* waiter)
 {
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
+	g_user_mutex_waiter* previous = nullptr;
+	g_user_mutex_waiter* entry = bucket->head;
+	while(entry && entry != waiter)
 	{
-		logWarn("%! tried to remove waiter for task %i from unknown mutex %i", "mutex", task, mutex);
-		return;
+		previous = entry;
+		entry = entry->next;
 	}
+	if(!entry)
+		return;
 
-	waitQueueRemove(&entry->waiters, task);
-}
+	if(previous)
+		previous->next = waiter->next;
+	else
+		bucket->head = waiter->next;
 
-void _userMutexWakeWaitingTasks(g_user_mutex_entry* entry)
-{
-	waitQueueWake(&entry->waiters);
+	if(bucket->tail == waiter)
+		bucket->tail = previous;
+	waiter->next = nullptr;
 }
@@ -21,65 +21,51 @@
 #ifndef __KERNEL_USER_MUTEX__
 #define __KERNEL_USER_MUTEX__
 
-#include "kernel/filesystem/filesystem.hpp"
 #include "kernel/tasking/tasking.hpp"
 #include <ghost/tasks/types.h>
 #include <ghost/mutex/types.h>
 
-struct g_user_mutex_entry
-{
-    g_mutex lock;
-    int value;
+/**
+ * User mutexes keep their lock word in the memory of the process. The kernel is
+ * only entered when a task must sleep on a contended lock word, or when the
+ * releasing task must wake one of the sleeping tasks. Waiters are kept in
+ * buckets hashed by process and address.
+ */
+#define G_USER_MUTEX_BUCKETS		64
+#define G_USER_MUTEX_WAKE_BATCH		8
 
-    bool reentrant;
-    g_tid owner;
+struct g_user_mutex_waiter
+{
+    g_pid process;
+    g_address address;
+    g_tid task;
+    bool woken;
 
-    g_wait_queue waiters;
+    g_user_mutex_waiter* next;
 };
 
-typedef uint32_t g_user_mutex_status;
-#define G_USER_MUTEX_STATUS_ACQUIRED      ((g_user_mutex_status) 1)
-#define G_USER_MUTEX_STATUS_TIMEOUT       ((g_user_mutex_status) 2)
-#define G_USER_MUTEX_STATUS_NOT_ACQUIRED  ((g_user_mutex_status) 3)
+struct g_user_mutex_bucket
+{
+    g_mutex lock;
+    g_user_mutex_waiter* head;
+    g_user_mutex_waiter* tail;
+};
 
-/**
- * Initializes the mutexes.
- */
 void userMutexInitialize();
 
 /**
- * Creates a new mutex that can then be locked with the other functions.
- */
-g_user_mutex userMutexCreate(bool reentrant);
-
-/**
- * Destroys a mutex.
+ * Puts the task to sleep on the given lock word, if the word still contains the
+ * expected value. Returns once the task was woken, the timeout has elapsed or
+ * the value did not match.
  */
-void userMutexDestroy(g_user_mutex mutex);
+g_user_mutex_wait_status userMutexWait(g_task* task, volatile uint32_t* address, uint32_t expected, uint64_t timeout);
 
 /**
+ * Wakes up to count tasks of the process that sleep on the given lock word, in
+ * the order they started waiting.
  *
+ * @return the number of woken tasks
  */
-g_user_mutex_status userMutexAcquire(g_task* task, g_user_mutex mutex, uint64_t timeout, bool trying);
-
-/**
- *
- */
-g_user_mutex_status userMutexTryAcquire(g_task* task, g_user_mutex mutex);
-
-/**
- * Unlocks the mutex and wakes the next waiting task.
- */
-void userMutexRelease(g_user_mutex mutex);
-
-/**
- * Removes the task from a wait queue, for example in case of timeouts.
- */
-void userMutexUnwaitForAcquire(g_user_mutex mutex, g_tid task);
-
-/**
- * Adds the task to the wait queue for the mutex.
- */
-void userMutexWaitForAcquire(g_user_mutex mutex, g_tid task);
+uint32_t userMutexWake(g_task* task, volatile uint32_t* address, uint32_t count);
 
 #endif
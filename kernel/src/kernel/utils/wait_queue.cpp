@@ -24,7 +24,7 @@
 
 void waitQueueInitialize(g_wait_queue* queue)
 {
-	mutexInitializeTask(&queue->lock);
+	mutexInitializeTask(&queue->lock, __func__);
 	queue->head = nullptr;
 }
 
@@ -0,0 +1,323 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "kernel/memory/address_range_pool.cpp"
+
+/**
+ * Host-side test of the address range pool. The kernel functions the pool depends on
+ * are replaced with stubs, then random sequences of allocations and frees are checked
+ * against the tree invariants and a list of the expected used ranges.
+ */
+
+void* heapAllocate(uint32_t size)
+{
+	return malloc(size);
+}
+
+void heapFree(void* memory)
+{
+	free(memory);
+}
+
+void mutexInitializeGlobal(g_mutex* mutex, const char* location)
+{
+}
+
+void mutexAcquire(g_mutex* mutex)
+{
+}
+
+void mutexRelease(g_mutex* mutex)
+{
+}
+
+void loggerPrintlnLocked(const char* message, ...)
+{
+}
+
+void loggerPrintLocked(const char* message, ...)
+{
+}
+
+void panic(const char* message, ...)
+{
+	va_list args;
+	va_start(args, message);
+	vprintf(message, args);
+	va_end(args);
+	printf("\n");
+	exit(1);
+}
+
+#define TEST_POOL_START 0x10000000ULL
+#define TEST_POOL_PAGES 0x10000
+#define TEST_ROUNDS 200
+#define TEST_OPERATIONS 2000
+#define TEST_MAXIMUM_USED 256
+
+struct test_allocation
+{
+	g_address base;
+	uint32_t pages;
+};
+
+static int testFailures = 0;
+
+#define TEST_ASSERT(condition, message...)                                                                             \
+	if(!(condition))                                                                                                   \
+	{                                                                                                                  \
+		printf("  failed: " message);                                                                                  \
+		printf("\n");                                                                                                  \
+		testFailures++;                                                                                                \
+		return false;                                                                                                  \
+	}
+
+struct test_walk
+{
+	g_address_range* previous;
+	uint32_t ranges;
+	uint32_t usedRanges;
+	uint64_t pages;
+};
+
+/**
+ * Checks the ordering, balance and augmentation of the subtree and that the ranges
+ * cover the pool without gaps or adjacent free ranges.
+ */
+static bool testCheckNode(g_address_range* node, test_walk* walk, uint32_t* outHeight, uint32_t* outLargestFree)
+{
+	if(!node)
+	{
+		*outHeight = 0;
+		*outLargestFree = 0;
+		return true;
+	}
+
+	uint32_t leftHeight, leftFree;
+	if(!testCheckNode(node->left, walk, &leftHeight, &leftFree))
+		return false;
+
+	TEST_ASSERT(node->pages > 0, "empty range at %lx", (unsigned long) node->base);
+	if(walk->previous)
+	{
+		TEST_ASSERT(_addressRangeEnd(walk->previous) == node->base, "gap or overlap before %lx",
+		            (unsigned long) node->base);
+		TEST_ASSERT(walk->previous->used || node->used, "adjacent free ranges at %lx", (unsigned long) node->base);
+	}
+	else
+	{
+		TEST_ASSERT(node->base == TEST_POOL_START, "first range starts at %lx", (unsigned long) node->base);
+	}
+	walk->previous = node;
+	walk->ranges++;
+	walk->pages += node->pages;
+	if(node->used)
+		walk->usedRanges++;
+
+	uint32_t rightHeight, rightFree;
+	if(!testCheckNode(node->right, walk, &rightHeight, &rightFree))
+		return false;
+
+	int32_t balance = (int32_t) leftHeight - (int32_t) rightHeight;
+	TEST_ASSERT(balance >= -1 && balance <= 1, "unbalanced at %lx", (unsigned long) node->base);
+
+	uint32_t height = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+	TEST_ASSERT(node->height == height, "wrong height at %lx", (unsigned long) node->base);
+
+	uint32_t largestFree = node->used ? 0 : node->pages;
+	if(leftFree > largestFree)
+		largestFree = leftFree;
+	if(rightFree > largestFree)
+		largestFree = rightFree;
+	TEST_ASSERT(node->largestFree == largestFree, "wrong largest free range at %lx", (unsigned long) node->base);
+
+	*outHeight = height;
+	*outLargestFree = largestFree;
+	return true;
+}
+
+static bool testCheckPool(g_address_range_pool* pool, test_allocation* used, uint32_t usedCount)
+{
+	test_walk walk = {};
+	uint32_t height, largestFree;
+	if(!testCheckNode(pool->root, &walk, &height, &largestFree))
+		return false;
+
+	TEST_ASSERT(walk.pages == TEST_POOL_PAGES, "pool covers %lu pages", (unsigned long) walk.pages);
+	TEST_ASSERT(walk.usedRanges == usedCount, "%u used ranges instead of %u", walk.usedRanges, usedCount);
+
+	for(uint32_t i = 0; i < usedCount; i++)
+	{
+		g_address_range* range = addressRangePoolFind(pool, used[i].base);
+		TEST_ASSERT(range && range->used && range->pages == used[i].pages, "allocation at %lx is missing",
+		            (unsigned long) used[i].base);
+	}
+	return true;
+}
+
+/**
+ * @return whether a free range of the pool could hold the allocation
+ */
+static bool testCouldFit(g_address_range* node, uint32_t pages, g_size alignment)
+{
+	if(!node)
+		return false;
+
+	if(!node->used)
+	{
+		g_address aligned = (node->base + alignment - 1) & ~((g_address) alignment - 1);
+		if(aligned + (g_address) pages * G_PAGE_SIZE <= _addressRangeEnd(node))
+			return true;
+	}
+	return testCouldFit(node->left, pages, alignment) || testCouldFit(node->right, pages, alignment);
+}
+
+static bool testRandomRound(uint32_t seed)
+{
+	srand(seed);
+
+	g_address_range_pool pool;
+	addressRangePoolInitialize(&pool);
+
+	// Add the range in two halves, so that they are merged
+	g_address middle = TEST_POOL_START + (TEST_POOL_PAGES / 2) * G_PAGE_SIZE;
+	addressRangePoolAddRange(&pool, middle, TEST_POOL_START + TEST_POOL_PAGES * G_PAGE_SIZE);
+	addressRangePoolAddRange(&pool, TEST_POOL_START, middle);
+	TEST_ASSERT(pool.root && !pool.root->left && !pool.root->right, "added ranges were not merged");
+
+	test_allocation used[TEST_MAXIMUM_USED];
+	uint32_t usedCount = 0;
+
+	for(uint32_t operation = 0; operation < TEST_OPERATIONS; operation++)
+	{
+		bool allocate = usedCount == 0 || (usedCount < TEST_MAXIMUM_USED && rand() % 3 != 0);
+		if(allocate)
+		{
+			uint32_t pages = rand() % 4 == 0 ? 1 + rand() % 512 : 1 + rand() % 16;
+			g_size alignment = rand() % 8 == 0 ? (G_PAGE_SIZE << (rand() % 10)) : G_PAGE_SIZE;
+			bool couldFit = testCouldFit(pool.root, pages, alignment);
+
+			g_address base = addressRangePoolAllocateAligned(&pool, pages, alignment);
+			if(!base)
+			{
+				TEST_ASSERT(!couldFit, "allocation of %u pages failed although it fits", pages);
+				continue;
+			}
+
+			TEST_ASSERT(base % alignment == 0, "base %lx is not aligned to %lx", (unsigned long) base,
+			            (unsigned long) alignment);
+			for(uint32_t i = 0; i < usedCount; i++)
+			{
+				bool overlaps = base < used[i].base + used[i].pages * G_PAGE_SIZE &&
+				                used[i].base < base + pages * G_PAGE_SIZE;
+				TEST_ASSERT(!overlaps, "allocation at %lx overlaps %lx", (unsigned long) base,
+				            (unsigned long) used[i].base);
+			}
+			used[usedCount].base = base;
+			used[usedCount].pages = pages;
+			usedCount++;
+		}
+		else
+		{
+			uint32_t index = rand() % usedCount;
+			int32_t freed = addressRangePoolFree(&pool, used[index].base);
+			TEST_ASSERT(freed == (int32_t) used[index].pages, "freed %i pages instead of %u", freed,
+			            used[index].pages);
+			TEST_ASSERT(addressRangePoolFree(&pool, used[index].base) == -1, "range was freed twice");
+			used[index] = used[--usedCount];
+		}
+
+		if(!testCheckPool(&pool, used, usedCount))
+			return false;
+	}
+
+	// A clone must have the same layout
+	g_address_range_pool clone;
+	addressRangePoolInitialize(&clone);
+	addressRangePoolCloneRanges(&clone, &pool);
+	if(!testCheckPool(&clone, used, usedCount))
+		return false;
+	addressRangePoolDestroy(&clone);
+
+	while(usedCount > 0)
+	{
+		addressRangePoolFree(&pool, used[usedCount - 1].base);
+		usedCount--;
+	}
+	if(!testCheckPool(&pool, used, usedCount))
+		return false;
+	TEST_ASSERT(pool.root && !pool.root->left && !pool.root->right, "ranges were not merged after freeing all");
+
+	addressRangePoolDestroy(&pool);
+	return true;
+}
+
+/**
+ * Allocations without alignment take the free range with the lowest address.
+ */
+static bool testLowestAddressFirst()
+{
+	g_address_range_pool pool;
+	addressRangePoolInitialize(&pool);
+	addressRangePoolAddRange(&pool, TEST_POOL_START, TEST_POOL_START + TEST_POOL_PAGES * G_PAGE_SIZE);
+
+	g_address a = addressRangePoolAllocate(&pool, 4);
+	g_address b = addressRangePoolAllocate(&pool, 1);
+	g_address c = addressRangePoolAllocate(&pool, 8);
+	TEST_ASSERT(a == TEST_POOL_START && b == a + 4 * G_PAGE_SIZE && c == b + G_PAGE_SIZE, "ranges are not packed");
+
+	addressRangePoolFree(&pool, a);
+	TEST_ASSERT(addressRangePoolAllocate(&pool, 2) == a, "freed range was not reused");
+	TEST_ASSERT(addressRangePoolAllocate(&pool, 4) == c + 8 * G_PAGE_SIZE, "too small range was used");
+	TEST_ASSERT(addressRangePoolAllocate(&pool, 2) == a + 2 * G_PAGE_SIZE, "remaining range was not reused");
+
+	addressRangePoolDestroy(&pool);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seed = argc > 1 ? (uint32_t) strtoul(argv[1], nullptr, 0) : 1;
+
+	printf("address range pool: lowest address first\n");
+	testLowestAddressFirst();
+
+	printf("address range pool: %i random rounds from seed %u\n", TEST_ROUNDS, seed);
+	for(uint32_t round = 0; round < TEST_ROUNDS; round++)
+	{
+		if(!testRandomRound(seed + round))
+		{
+			printf("  in round with seed %u\n", seed + round);
+			break;
+		}
+	}
+
+	if(testFailures)
+	{
+		printf("%i failures\n", testFailures);
+		return 1;
+	}
+	printf("all passed\n");
+	return 0;
+}
@@ -42,6 +42,9 @@ typedef int g_kernquery_status;
 #define G_KERNQUERY_TASK_COUNT 0x600
 #define G_KERNQUERY_TASK_LIST 0x601
 #define G_KERNQUERY_TASK_GET_BY_ID 0x602
+#define G_KERNQUERY_TASK_FAULTS 0x603
+
+#define G_KERNQUERY_MEMORY_PAGING 0x700
 
 /**
  * Used in the {G_KERNQUERY_TASK_COUNT} query to retrieve the number
@@ -82,6 +85,32 @@ typedef struct
 	uint64_t cpu_time;
 } __attribute__((packed)) g_kernquery_task_get_data;
 
+/**
+ * Used in the {G_KERNQUERY_TASK_FAULTS} query to retrieve the page fault
+ * counters of the process of a task. Minor faults are resolved from memory,
+ * major faults read the page content from a file.
+ */
+typedef struct
+{
+	g_tid id;
+	uint8_t found;
+
+	uint64_t minor_faults;
+	uint64_t major_faults;
+	uint64_t file_read_bytes;
+} __attribute__((packed)) g_kernquery_task_faults_data;
+
+/**
+ * Used in the {G_KERNQUERY_MEMORY_PAGING} query to retrieve the number
+ * of 2 MiB pages that are mapped and how often one had to be split into
+ * small pages.
+ */
+typedef struct
+{
+	uint64_t large_pages;
+	uint64_t large_pages_split;
+} __attribute__((packed)) g_kernquery_memory_paging_data;
+
 __END_C
 
 #endif
@@ -34,7 +34,8 @@ __BEGIN_C
  * size in bytes. This region can for example be used as shared memory.
  *
  * Allocating memory using this call makes the requesting process the physical owner of the
- * pages in its virtual space (important for unmapping).
+ * pages in its virtual space (important for unmapping). The pages are only allocated and
+ * filled with zeros when they are first accessed, except when using <g_alloc_mem_p>.
  *
  * @param size
  * 		the size in bytes
@@ -50,6 +51,25 @@ __BEGIN_C
 void* g_alloc_mem(g_size size);
 void* g_alloc_mem_p(g_size size, void** out_phys);
 
+/**
+ * Allocates a physically contiguous memory region, for example for DMA buffers
+ * that span multiple pages.
+ *
+ * @param size
+ * 		the size in bytes
+ * @param alignment
+ * 		the required physical alignment in bytes, a power of two
+ * @param flags
+ * 		G_ALLOC_MEM_FLAG_BELOW_4G if the device can only address 32 bits
+ * @param out_phys
+ *		the physical address of the region
+ *
+ * @return a pointer to the allocated memory region, or 0 if failed
+ *
+ * @security-level DRIVER
+ */
+void* g_alloc_mem_dma(g_size size, g_size alignment, uint32_t flags, void** out_phys);
+
 /**
  * Shares a memory area with another process.
  *
@@ -68,18 +88,22 @@ void* g_share_mem(void* memory, int32_t size, g_pid pid);
 
 /**
  * Maps the given physical address to the executing processes address space so
- * it can access it directly.
+ * it can access it directly. Without a caching type, the area is mapped with
+ * G_MEMORY_CACHING_DEFAULT, leaving the caching type to the MTRRs.
  *
  * @param addr
  * 		the physical memory address that should be mapped
  * @param size
  * 		the size that should be mapped
+ * @param caching
+ * 		one of the G_MEMORY_CACHING_* types; framebuffers should use write-combining
  *
  * @return a pointer to the mapped area within the executing processes address space
  *
  * @security-level DRIVER
  */
 void* g_map_mmio(void* addr, uint32_t size);
+void* g_map_mmio_c(void* addr, uint32_t size, g_memory_caching caching);
 
 /**
  * Unmaps the given memory area.
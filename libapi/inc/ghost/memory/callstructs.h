@@ -28,6 +28,12 @@
  * @field size
  * 		the required size in bytes
  *
+ * @field flags
+ * 		combination of G_ALLOC_MEM_FLAG_* flags
+ *
+ * @field alignment
+ * 		required physical alignment in bytes for contiguous allocations
+ *
  * @field virtualResult
  * 		the virtual address of the allocated area in the current processes
  * 		address space. this address is page-aligned. if allocation
@@ -36,13 +42,15 @@
  * @field physicalResult
  *		the physical address of the allocated area, only exposed when the
  *		executing process has security-level DRIVER and only if just one
- *		page was allocated
+ *		page was allocated or the area is contiguous
  *
  * @security-level APPLICATION
  */
 typedef struct
 {
 	g_size size;
+	uint32_t flags;
+	g_size alignment;
 
 	void* virtualResult;
 	void* physicalResult;
@@ -80,6 +88,9 @@ typedef struct
  * @field size
  * 		the minimum size to map
  *
+ * @field caching
+ * 		one of the G_MEMORY_CACHING_* types to map the area with
+ *
  * @field virtualAddress
  * 		the resulting page-aligned virtual address in the current
  * 		processes address space. if mapping fails, this field is 0.
@@ -90,6 +101,7 @@ typedef struct
 {
 	g_physical_address physicalAddress;
 	uint32_t size;
+	g_memory_caching caching;
 
 	void* virtualAddress;
 }__attribute__((packed)) g_syscall_map_mmio;
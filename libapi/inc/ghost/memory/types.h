@@ -40,6 +40,24 @@ __BEGIN_C
 #define G_TABLE_IN_DIRECTORY_INDEX(address)	((uint32_t)((address / G_PAGE_SIZE) / 1024))
 #define G_PAGE_IN_TABLE_INDEX(address)		((uint32_t)((address / G_PAGE_SIZE) % 1024))
 
+/**
+ * Flags for memory allocation
+ */
+#define G_ALLOC_MEM_FLAG_CONTIGUOUS			1
+#define G_ALLOC_MEM_FLAG_BELOW_4G			2
+#define G_ALLOC_MEM_FLAG_POPULATE			4
+
+/**
+ * Caching types for memory-mapped device memory. The default keeps the page flags
+ * that areas were always mapped with, so the MTRRs decide the caching type.
+ */
+typedef uint8_t g_memory_caching;
+#define G_MEMORY_CACHING_UNCACHEABLE		0
+#define G_MEMORY_CACHING_WRITE_COMBINING	1
+#define G_MEMORY_CACHING_WRITE_THROUGH		2
+#define G_MEMORY_CACHING_WRITE_BACK			3
+#define G_MEMORY_CACHING_DEFAULT			4
+
 // address types
 #if __i386__
 typedef uint32_t g_address;
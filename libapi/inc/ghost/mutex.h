@@ -26,7 +26,9 @@
 
 __BEGIN_C
 /**
- * Creates an mutex used for locking.
+ * Creates an mutex used for locking. The state of the mutex lives in the
+ * memory of the calling process, so acquiring a free mutex and releasing a
+ * mutex without waiters doesn't enter the kernel.
  *
  * @returns mutex
  * 		the mutex
@@ -82,6 +84,37 @@ void g_mutex_release(g_user_mutex mutex);
  */
 void g_mutex_destroy(g_user_mutex mutex);
 
+/**
+ * Puts the executing task to sleep until another task wakes it through
+ * {g_mutex_wake_on} on the same address. If the value at the address is not
+ * equal to the expected value, the call returns immediately. Addresses are
+ * private to the calling process.
+ *
+ * @param address
+ * 		address of the lock word
+ * @param expected
+ * 		value that the lock word must have for the task to sleep
+ * @param timeout
+ * 		timeout in milliseconds, 0 to wait without timeout
+ * @return one of the {g_user_mutex_wait_status} codes
+ *
+ * @security-level APPLICATION
+ */
+g_user_mutex_wait_status g_mutex_wait_on(volatile uint32_t* address, uint32_t expected, uint64_t timeout);
+
+/**
+ * Wakes up to the given number of tasks that wait on the address.
+ *
+ * @param address
+ * 		address of the lock word
+ * @param count
+ * 		maximum number of tasks to wake
+ * @return the number of tasks that were woken
+ *
+ * @security-level APPLICATION
+ */
+uint32_t g_mutex_wake_on(volatile uint32_t* address, uint32_t count);
+
 
 __END_C
 
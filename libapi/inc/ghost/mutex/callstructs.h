@@ -31,45 +31,44 @@ __BEGIN_C
  * @field mutex
  * 		the mutex
  */
-typedef struct
-{
-	uint8_t reentrant : 1;
-
-	g_user_mutex mutex;
-} __attribute__((packed)) g_syscall_user_mutex_initialize;
-
 /**
- * @field mutex
- * 		the mutex
+ * @field address
+ * 		address of the lock word to wait on
+ * @field expected
+ * 		the task only sleeps if the lock word still has this value
+ * @field timeout
+ * 		timeout in milliseconds, 0 to wait without timeout
+ * @field status
+ * 		one of the {g_user_mutex_wait_status} codes
+ *
+ * @security-level APPLICATION
  */
 typedef struct
 {
-	g_user_mutex mutex;
-} __attribute__((packed)) g_syscall_user_mutex_destroy;
-
-/**
- * @field mutex
- *      the mutex
- * @property isTry
- */
-typedef struct
-{
-	g_user_mutex mutex;
-	uint8_t trying : 1;
+	volatile uint32_t* address;
+	uint32_t expected;
 	uint64_t timeout;
 
-	uint8_t hasTimedOut : 1;
-	uint8_t wasSet : 1;
-} __attribute__((packed)) g_syscall_user_mutex_acquire;
+	g_user_mutex_wait_status status;
+} __attribute__((packed)) g_syscall_user_mutex_wait;
 
 /**
- * @field mutex
- * 		the mutex
+ * @field address
+ * 		address of the lock word to wake waiters on
+ * @field count
+ * 		maximum number of waiters to wake
+ * @field woken
+ * 		number of waiters that were woken
+ *
+ * @security-level APPLICATION
  */
 typedef struct
 {
-	g_user_mutex mutex;
-} __attribute__((packed)) g_syscall_user_mutex_release;
+	volatile uint32_t* address;
+	uint32_t count;
+
+	uint32_t woken;
+} __attribute__((packed)) g_syscall_user_mutex_wake;
 
 __END_C
 
@@ -26,7 +26,36 @@
 
 __BEGIN_C
 
-typedef uint32_t g_user_mutex;
+/**
+ * Values of the lock word of a user mutex. The uncontended case is handled
+ * completely in userspace by a compare-and-swap from FREE to LOCKED. A task
+ * that finds the mutex locked marks it CONTENDED and sleeps on the address of
+ * the word, so that the releasing task knows it must enter the kernel to wake
+ * one of the waiters.
+ */
+#define G_USER_MUTEX_STATE_FREE			0
+#define G_USER_MUTEX_STATE_LOCKED		1
+#define G_USER_MUTEX_STATE_CONTENDED	2
+
+typedef struct _g_user_mutex_state
+{
+	volatile uint32_t state;
+
+	uint8_t reentrant;
+	void* volatile owner;
+	uint32_t depth;
+} g_user_mutex_state;
+
+typedef g_user_mutex_state* g_user_mutex;
+
+/**
+ * Result of waiting on the address of a lock word
+ */
+typedef uint8_t g_user_mutex_wait_status;
+#define G_USER_MUTEX_WAIT_STATUS_WOKEN		((g_user_mutex_wait_status) 0)
+#define G_USER_MUTEX_WAIT_STATUS_CHANGED	((g_user_mutex_wait_status) 1)
+#define G_USER_MUTEX_WAIT_STATUS_TIMEOUT	((g_user_mutex_wait_status) 2)
+#define G_USER_MUTEX_WAIT_STATUS_INVALID	((g_user_mutex_wait_status) 3)
 
 __END_C
 
@@ -25,12 +25,14 @@
 #include "stdint.h"
 #include "memory/types.h"
 #include "syscall/definitions.h"
+#include "syscall/types.h"
 
 __BEGIN_C
 
 /**
- * Performs the software interrupt necessary for the system call passing the
- * given data (usually a pointer to a call struct).
+ * Performs the system call passing the given data (usually a pointer to a call
+ * struct). Uses the SYSCALL instruction if the processor supports it and falls
+ * back to the software interrupt 0x80 otherwise.
  *
  * @param call
  * 		the call to execute
@@ -47,6 +49,69 @@ __BEGIN_C
  */
 void g_syscall(uint32_t call, g_address data);
 
+/**
+ * Creates the system call ring of this process. Each process can have one ring.
+ * The ring helpers don't synchronize, so threads that share the ring must do so.
+ *
+ * @param entries
+ * 		number of submission and completion entries, a power of two up to
+ * 		G_SYSCALL_RING_MAX_ENTRIES
+ * @param-opt out_status
+ * 		filled with one of the {g_syscall_ring_setup_status} codes
+ *
+ * @return the ring or NULL on failure
+ *
+ * @security-level APPLICATION
+ */
+g_syscall_ring* g_syscall_ring_setup(uint32_t entries);
+g_syscall_ring* g_syscall_ring_setup_s(uint32_t entries, g_syscall_ring_setup_status* out_status);
+
+/**
+ * Queues a system call on the ring without entering the kernel. The call struct
+ * must stay valid until the call was completed.
+ *
+ * @param ring
+ * 		the ring
+ * @param call
+ * 		the system call number
+ * @param data
+ * 		the call struct
+ * @param userData
+ * 		value that is passed back in the completion
+ *
+ * @return whether there was a free submission entry
+ *
+ * @security-level APPLICATION
+ */
+g_bool g_syscall_ring_submit(g_syscall_ring* ring, uint32_t call, void* data, uint64_t userData);
+
+/**
+ * Lets the kernel execute all queued system calls in the order they were submitted.
+ * Returns once the calls were completed or the completion ring is full.
+ *
+ * @param ring
+ * 		the ring
+ *
+ * @return the number of completed calls
+ *
+ * @security-level APPLICATION
+ */
+uint32_t g_syscall_ring_enter(g_syscall_ring* ring);
+
+/**
+ * Takes the next completion from the ring.
+ *
+ * @param ring
+ * 		the ring
+ * @param out
+ * 		receives the completion
+ *
+ * @return whether there was a completion
+ *
+ * @security-level APPLICATION
+ */
+g_bool g_syscall_ring_complete(g_syscall_ring* ring, g_syscall_ring_completion* out);
+
 __END_C
 
 #endif
@@ -0,0 +1,60 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GHOST_API_SYSCALL_CALLSTRUCTS
+#define GHOST_API_SYSCALL_CALLSTRUCTS
+
+#include "../common.h"
+#include "../stdint.h"
+#include "types.h"
+
+__BEGIN_C
+
+/**
+ * @field entries
+ * 		number of submission and completion entries, a power of two
+ * @field ring
+ * 		the mapped ring
+ * @field status
+ * 		the setup status
+ */
+typedef struct
+{
+	uint32_t entries;
+
+	g_syscall_ring* ring;
+	g_syscall_ring_setup_status status;
+} __attribute__((packed)) g_syscall_setup_ring;
+
+/**
+ * @field processed
+ * 		number of submissions that were completed
+ * @field status
+ * 		the enter status
+ */
+typedef struct
+{
+	uint32_t processed;
+	g_syscall_ring_enter_status status;
+} __attribute__((packed)) g_syscall_enter_ring;
+
+__END_C
+
+#endif
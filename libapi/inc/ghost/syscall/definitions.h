@@ -53,6 +53,7 @@ __BEGIN_C
 #define G_SYSCALL_GET_NANOSECONDS				25
 #define G_SYSCALL_TASK_AWAIT_BY_NAME		26
 #define G_SYSCALL_EXECVE					27
+#define G_SYSCALL_SLEEP_NANOS				28
 
 // Memory
 #define G_SYSCALL_LOWER_MEMORY_ALLOCATE			40
@@ -64,10 +65,8 @@ __BEGIN_C
 #define G_SYSCALL_SBRK							46
 
 // Mutex
-#define G_SYSCALL_USER_MUTEX_INITIALIZE 		60
-#define G_SYSCALL_USER_MUTEX_ACQUIRE			61
-#define G_SYSCALL_USER_MUTEX_RELEASE			62
-#define G_SYSCALL_USER_MUTEX_DESTROY			63
+#define G_SYSCALL_USER_MUTEX_WAIT				60
+#define G_SYSCALL_USER_MUTEX_WAKE				61
 
 // Messages
 #define G_SYSCALL_MESSAGE_SEND                  70
@@ -111,11 +110,16 @@ __BEGIN_C
 #define G_SYSCALL_GET_EFI_FRAMEBUFFER			126
 #define G_SYSCALL_OPEN_LOG_PIPE					127
 #define G_SYSCALL_READ_LOG_HISTORY				128
+#define G_SYSCALL_IRQ_ALLOCATE_MSI				132
 
 // Kernquery
 #define G_SYSCALL_KERNQUERY						129
 
-#define G_SYSCALL_MAX							131
+// Syscall rings
+#define G_SYSCALL_RING_SETUP					130
+#define G_SYSCALL_RING_ENTER					131
+
+#define G_SYSCALL_MAX							134
 
 __END_C
 
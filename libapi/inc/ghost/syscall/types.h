@@ -0,0 +1,118 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GHOST_API_SYSCALL_TYPES
+#define GHOST_API_SYSCALL_TYPES
+
+#include "../common.h"
+#include "../stdint.h"
+
+__BEGIN_C
+
+/**
+ * Maximum number of entries of a system call ring
+ */
+#define G_SYSCALL_RING_MAX_ENTRIES						4096
+
+/**
+ * Status of a system call ring setup
+ */
+typedef uint8_t g_syscall_ring_setup_status;
+#define G_SYSCALL_RING_SETUP_SUCCESSFUL					((g_syscall_ring_setup_status) 0)
+#define G_SYSCALL_RING_SETUP_INVALID_ENTRIES			((g_syscall_ring_setup_status) 1)
+#define G_SYSCALL_RING_SETUP_ALREADY_EXISTS				((g_syscall_ring_setup_status) 2)
+#define G_SYSCALL_RING_SETUP_MEMORY_ERROR				((g_syscall_ring_setup_status) 3)
+
+/**
+ * Status of a completed ring entry. The result of the call itself is written
+ * to its call struct, just like for a direct system call.
+ */
+typedef int32_t g_syscall_ring_status;
+#define G_SYSCALL_RING_STATUS_SUCCESSFUL				((g_syscall_ring_status) 0)
+#define G_SYSCALL_RING_STATUS_UNSUPPORTED				((g_syscall_ring_status) 1)
+
+/**
+ * Status of entering a system call ring
+ */
+typedef uint8_t g_syscall_ring_enter_status;
+#define G_SYSCALL_RING_ENTER_SUCCESSFUL					((g_syscall_ring_enter_status) 0)
+#define G_SYSCALL_RING_ENTER_NO_RING					((g_syscall_ring_enter_status) 1)
+#define G_SYSCALL_RING_ENTER_BUSY						((g_syscall_ring_enter_status) 2)
+
+/**
+ * A submitted system call.
+ *
+ * @field call
+ * 		the system call number
+ * @field data
+ * 		address of the call struct, must stay valid until the entry completed
+ * @field userData
+ * 		value that is passed back in the completion
+ */
+typedef struct
+{
+	uint32_t call;
+	uint32_t reserved;
+	uint64_t data;
+	uint64_t userData;
+} __attribute__((packed)) g_syscall_ring_submission;
+
+/**
+ * A completed system call.
+ *
+ * @field userData
+ * 		the value of the submission
+ * @field status
+ * 		whether the call was executed
+ */
+typedef struct
+{
+	uint64_t userData;
+	g_syscall_ring_status status;
+	uint32_t reserved;
+} __attribute__((packed)) g_syscall_ring_completion;
+
+/**
+ * Header of a system call ring that is shared between a process and the kernel.
+ * The submission entries follow directly after the header, the completion entries
+ * after the submissions. The heads and tails are free-running counters, an entry
+ * is found at the counter modulo the number of entries.
+ *
+ * The process writes submissions and moves the submission tail, the kernel moves
+ * the submission head. The kernel writes completions and moves the completion
+ * tail, the process moves the completion head.
+ */
+typedef struct
+{
+	volatile uint32_t submissionHead;
+	volatile uint32_t submissionTail;
+	volatile uint32_t completionHead;
+	volatile uint32_t completionTail;
+	uint32_t entries;
+	uint32_t reserved[3];
+} g_syscall_ring;
+
+#define G_SYSCALL_RING_SUBMISSIONS(ring)				((g_syscall_ring_submission*) ((uint8_t*) (ring) + sizeof(g_syscall_ring)))
+#define G_SYSCALL_RING_COMPLETIONS(ring)				((g_syscall_ring_completion*) (G_SYSCALL_RING_SUBMISSIONS(ring) + (ring)->entries))
+#define G_SYSCALL_RING_SIZE(entries)					(sizeof(g_syscall_ring) + (entries) * (sizeof(g_syscall_ring_submission) + sizeof(g_syscall_ring_completion)))
+
+__END_C
+
+#endif
@@ -119,6 +119,27 @@ void g_irq_create_redirect(uint32_t source, uint32_t irq);
 void g_await_irq(uint8_t irq);
 void g_await_irq_t(uint8_t irq, uint32_t timeout);
 
+/**
+ * Allocates consecutive interrupt vectors for message-signaled interrupts of a
+ * device. The returned message must be programmed into the MSI or MSI-X capability
+ * of the device, vector i uses the message data plus i. The vectors are awaited with
+ * <g_await_irq> like any other IRQ and are freed when the process exits.
+ *
+ * @param count
+ *     number of vectors, a power of two
+ * @param outIrq
+ *     receives the IRQ of the first vector
+ * @param outAddress
+ *     receives the message address
+ * @param outData
+ *     receives the message data of the first vector
+ *
+ * @return one of the {g_irq_allocate_msi_status} codes
+ *
+ * @security-level DRIVER
+ */
+g_irq_allocate_msi_status g_irq_allocate_msi(uint8_t count, uint8_t* outIrq, uint64_t* outAddress, uint32_t* outData);
+
 uint8_t g_io_port_read_byte(uint16_t port);
 uint16_t g_io_port_read_word(uint16_t port);
 uint32_t g_io_port_read_dword(uint16_t port);
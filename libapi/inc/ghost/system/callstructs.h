@@ -119,6 +119,26 @@ typedef struct
 	uint32_t timeout;
 } __attribute__((packed)) g_syscall_await_irq;
 
+/**
+ * @field count
+ * 		number of vectors, a power of two
+ * @field irq
+ * 		IRQ of the first vector, the others follow it
+ * @field address
+ * 		message address to program into the device
+ * @field data
+ * 		message data of the first vector
+ */
+typedef struct
+{
+	uint8_t count;
+
+	uint8_t irq;
+	uint64_t address;
+	uint32_t data;
+	g_irq_allocate_msi_status status;
+} __attribute__((packed)) g_syscall_irq_allocate_msi;
+
 /**
  * @field address
  *		framebuffer address
@@ -46,6 +46,16 @@ typedef struct
 	uint16_t es;
 } __attribute__((packed)) g_vm86_registers;
 
+/**
+ * Message-signaled interrupts
+ */
+typedef uint8_t g_irq_allocate_msi_status;
+
+#define G_IRQ_ALLOCATE_MSI_STATUS_SUCCESSFUL 0
+#define G_IRQ_ALLOCATE_MSI_STATUS_NOT_PERMITTED 1
+#define G_IRQ_ALLOCATE_MSI_STATUS_INVALID_COUNT 2
+#define G_IRQ_ALLOCATE_MSI_STATUS_NO_VECTORS 3
+
 __END_C
 
 #endif
@@ -204,7 +204,8 @@ g_user_threadlocal* g_task_get_tls();
 g_process_info* g_process_get_info();
 
 /**
- * Forks the current process. Only works from the main thread.
+ * Forks the current process. The memory of the process is shared copy-on-write with the
+ * forked process, only the calling thread continues to run in it.
  *
  * @return within the executing process the forked processes id is returned, within the forked process 0 is returned
  *
@@ -231,6 +232,16 @@ void g_join(g_tid tid);
  */
 void g_sleep(uint64_t ms);
 
+/**
+ * Sleeps for the given amount of nanoseconds. The wake-up is accurate to about
+ * 65 microseconds if the kernel runs tickless, otherwise to the timer frequency.
+ *
+ * @param ns the nanoseconds to sleep
+ *
+ * @security-level APPLICATION
+ */
+void g_sleep_nanos(uint64_t ns);
+
 
 /**
  * Yields, causing a switch to the next process.
@@ -254,12 +265,23 @@ void g_yield_t(g_tid target);
 uint64_t g_millis();
 
 /**
- * @return elapsed time from HPET
+ * @return elapsed time in nanoseconds, read from the clock page if possible
  *
  * @security-level APPLICATION
  */
 uint64_t g_nanos();
 
+/**
+ * Reads the time from the clock page that the kernel maps into each process, without
+ * a system call. Only works if the TSC of the processor runs at a constant rate.
+ *
+ * @param out receives the elapsed time in nanoseconds
+ * @return whether the time could be read
+ *
+ * @security-level APPLICATION
+ */
+g_bool g_clock_page_read(uint64_t* out);
+
 /**
  * Sets the working directory for the current process.
  *
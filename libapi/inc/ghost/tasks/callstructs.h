@@ -89,6 +89,14 @@ typedef struct
 	uint64_t milliseconds;
 } __attribute__((packed)) g_syscall_sleep;
 
+/**
+ * @field nanoseconds the number of nanoseconds to sleep
+ */
+typedef struct
+{
+	uint64_t nanoseconds;
+} __attribute__((packed)) g_syscall_sleep_nanos;
+
 /**
  * @field irq the IRQ to wait for
  */
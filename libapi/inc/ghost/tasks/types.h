@@ -114,6 +114,29 @@ typedef struct _g_object_info
 	uint32_t finiArraySize;
 } __attribute__((packed)) g_object_info;
 
+/**
+ * Set in the flags of the <g_clock_page> if the time can be calculated from the TSC.
+ */
+#define G_CLOCK_PAGE_FLAG_TSC	1
+
+/**
+ * Page that the kernel maps read-only into each process to read the time without a
+ * system call. If <G_CLOCK_PAGE_FLAG_TSC> is set, the time in nanoseconds is
+ * baseNanos + (((rdtsc - baseTsc) * multiplier) >> shift).
+ *
+ * The kernel increments the sequence before and after each update. Readers must retry
+ * if it was odd or has changed after reading the other fields.
+ */
+typedef struct
+{
+	volatile uint32_t sequence;
+	uint32_t flags;
+	uint64_t baseTsc;
+	uint64_t baseNanos;
+	uint64_t multiplier;
+	uint32_t shift;
+} __attribute__((packed)) g_clock_page;
+
 /**
  * The object information structure is used within the process information section
  * to provide details about the process.
@@ -131,6 +154,11 @@ typedef struct
 	 * to use a system call while within a user-space interrupt service routine.
 	 */
 	void (*syscallKernelEntry)(uint32_t, void*);
+
+	/**
+	 * Read-only clock page of the kernel.
+	 */
+	const g_clock_page* clockPage;
 } __attribute__((packed)) g_process_info;
 
 /**
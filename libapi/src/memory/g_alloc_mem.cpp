@@ -29,6 +29,8 @@ void* g_alloc_mem(g_size size)
 {
 	g_syscall_alloc_mem data;
 	data.size = size;
+	data.flags = 0;
+	data.alignment = 0;
 
 	g_syscall(G_SYSCALL_ALLOCATE_MEMORY, (g_address) &data);
 
@@ -42,6 +44,25 @@ void* g_alloc_mem_p(g_size size, void** out_phys)
 {
 	g_syscall_alloc_mem data;
 	data.size = size;
+	data.flags = G_ALLOC_MEM_FLAG_POPULATE;
+	data.alignment = 0;
+
+	g_syscall(G_SYSCALL_ALLOCATE_MEMORY, (g_address) &data);
+
+	if(out_phys)
+		*out_phys = data.physicalResult;
+	return data.virtualResult;
+}
+
+/**
+ * @see header
+ */
+void* g_alloc_mem_dma(g_size size, g_size alignment, uint32_t flags, void** out_phys)
+{
+	g_syscall_alloc_mem data;
+	data.size = size;
+	data.flags = flags | G_ALLOC_MEM_FLAG_CONTIGUOUS;
+	data.alignment = alignment;
 
 	g_syscall(G_SYSCALL_ALLOCATE_MEMORY, (g_address) &data);
 
@@ -26,10 +26,19 @@
  *
  */
 void* g_map_mmio(void* physicalAddress, uint32_t size)
+{
+	return g_map_mmio_c(physicalAddress, size, G_MEMORY_CACHING_DEFAULT);
+}
+
+/**
+ *
+ */
+void* g_map_mmio_c(void* physicalAddress, uint32_t size, g_memory_caching caching)
 {
 	g_syscall_map_mmio data;
 	data.physicalAddress = (g_physical_address) physicalAddress;
 	data.size = size;
+	data.caching = caching;
 
 	g_syscall(G_SYSCALL_MAP_MMIO_AREA, (g_address) &data);
 
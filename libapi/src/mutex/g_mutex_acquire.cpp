@@ -20,19 +20,83 @@
 
 #include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
+#include "ghost/tasks.h"
+
+/**
+ * Identifies the executing thread as the owner of a reentrant mutex. The
+ * self-pointer of the user thread-local structure is unique per thread and
+ * can be read from FS without entering the kernel.
+ */
+static void* g_mutex_owner_token()
+{
+	void* self;
+	asm volatile("mov %%fs:0, %0" : "=r"(self));
+	return self;
+}
+
+static g_bool g_mutex_take(g_user_mutex mutex, void* owner)
+{
+	uint32_t expected = G_USER_MUTEX_STATE_FREE;
+	if(!__atomic_compare_exchange_n(&mutex->state, &expected, G_USER_MUTEX_STATE_LOCKED, false,
+	                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+
+	if(mutex->reentrant)
+	{
+		mutex->owner = owner;
+		mutex->depth = 1;
+	}
+	return true;
+}
 
 g_bool __g_mutex_acquire(g_user_mutex mutex, bool trying, uint64_t timeout)
 {
-	g_syscall_user_mutex_acquire data;
-	data.mutex = mutex;
-	data.trying = trying;
-	data.timeout = timeout;
+	void* owner = nullptr;
+	if(mutex->reentrant)
+	{
+		owner = g_mutex_owner_token();
+		if(mutex->owner == owner)
+		{
+			mutex->depth++;
+			return true;
+		}
+	}
+
+	if(g_mutex_take(mutex, owner))
+		return true;
+
+	if(trying)
+		return false;
+
+	uint64_t deadline = 0;
+	if(timeout > 0)
+		deadline = g_millis() + timeout;
+
+	// Mark the mutex contended so that the owner wakes us on release
+	uint32_t state = __atomic_exchange_n(&mutex->state, G_USER_MUTEX_STATE_CONTENDED, __ATOMIC_ACQUIRE);
+	while(state != G_USER_MUTEX_STATE_FREE)
+	{
+		uint64_t remaining = 0;
+		if(deadline)
+		{
+			uint64_t now = g_millis();
+			if(now >= deadline)
+				return false;
+			remaining = deadline - now;
+		}
+
+		if(g_mutex_wait_on(&mutex->state, G_USER_MUTEX_STATE_CONTENDED, remaining) == G_USER_MUTEX_WAIT_STATUS_INVALID)
+			return false;
 
-	data.wasSet = false;
-	g_syscall(G_SYSCALL_USER_MUTEX_ACQUIRE, (g_address) &data);
+		state = __atomic_exchange_n(&mutex->state, G_USER_MUTEX_STATE_CONTENDED, __ATOMIC_ACQUIRE);
+	}
 
-	return data.wasSet;
+	if(mutex->reentrant)
+	{
+		mutex->owner = owner;
+		mutex->depth = 1;
+	}
+	return true;
 }
 
 void g_mutex_acquire(g_user_mutex mutex)
@@ -20,12 +20,11 @@
 
 #include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
+
+#include <stdlib.h>
 
 void g_mutex_destroy(g_user_mutex mutex)
 {
-	g_syscall_user_mutex_destroy data;
-	data.mutex = mutex;
-
-	g_syscall(G_SYSCALL_USER_MUTEX_DESTROY, (g_address) &data);
+	if(mutex)
+		free(mutex);
 }
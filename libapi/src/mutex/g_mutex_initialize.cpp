@@ -20,7 +20,8 @@
 
 #include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
+
+#include <stdlib.h>
 
 g_user_mutex g_mutex_initialize()
 {
@@ -29,10 +30,13 @@ g_user_mutex g_mutex_initialize()
 
 g_user_mutex g_mutex_initialize_r(g_bool reentrant)
 {
-	g_syscall_user_mutex_initialize data;
-	data.reentrant = reentrant;
-
-	g_syscall(G_SYSCALL_USER_MUTEX_INITIALIZE, (g_address) &data);
+	g_user_mutex mutex = (g_user_mutex) malloc(sizeof(g_user_mutex_state));
+	if(!mutex)
+		return nullptr;
 
-	return data.mutex;
+	mutex->state = G_USER_MUTEX_STATE_FREE;
+	mutex->reentrant = reentrant;
+	mutex->owner = nullptr;
+	mutex->depth = 0;
+	return mutex;
 }
@@ -20,13 +20,21 @@
 
 #include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
-
 
 void g_mutex_release(g_user_mutex mutex)
 {
-	g_syscall_user_mutex_release data;
-	data.mutex = mutex;
+	if(mutex->reentrant)
+	{
+		if(mutex->depth > 1)
+		{
+			mutex->depth--;
+			return;
+		}
+		mutex->depth = 0;
+		mutex->owner = nullptr;
+	}
 
-	g_syscall(G_SYSCALL_USER_MUTEX_RELEASE, (g_address) &data);
+	// Only enter the kernel if another task marked the mutex contended
+	if(__atomic_exchange_n(&mutex->state, G_USER_MUTEX_STATE_FREE, __ATOMIC_RELEASE) == G_USER_MUTEX_STATE_CONTENDED)
+		g_mutex_wake_on(&mutex->state, 1);
 }
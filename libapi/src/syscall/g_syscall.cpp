@@ -20,11 +20,43 @@
 
 #include "ghost/syscall.h"
 
+/**
+ * Whether the processor supports SYSCALL/SYSRET, -1 if not checked yet. The
+ * kernel enables the instruction on every processor that reports support.
+ */
+static int g_syscall_fast_available = -1;
+
+static int g_syscall_check_fast()
+{
+	uint32_t eax, ebx, ecx, edx;
+	asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000000));
+	if(eax < 0x80000001)
+		return 0;
+
+	asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000001));
+	return (edx & (1 << 11)) ? 1 : 0;
+}
+
 void g_syscall(uint32_t call, g_address data)
 {
-	asm volatile (
-		"int $0x80"
-		:: "a" (call), "D" (data)
-		: "memory"
-	);
+	if(__builtin_expect(g_syscall_fast_available < 0, 0))
+		g_syscall_fast_available = g_syscall_check_fast();
+
+	if(g_syscall_fast_available)
+	{
+		// SYSCALL stores the return address in RCX and the flags in R11
+		asm volatile (
+			"syscall"
+			:: "a" (call), "D" (data)
+			: "rcx", "r11", "memory"
+		);
+	}
+	else
+	{
+		asm volatile (
+			"int $0x80"
+			:: "a" (call), "D" (data)
+			: "memory"
+		);
+	}
 }
@@ -0,0 +1,45 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/syscall.h"
+#include "ghost/syscall/callstructs.h"
+
+// redirect
+g_syscall_ring* g_syscall_ring_setup(uint32_t entries)
+{
+	return g_syscall_ring_setup_s(entries, nullptr);
+}
+
+/**
+ *
+ */
+g_syscall_ring* g_syscall_ring_setup_s(uint32_t entries, g_syscall_ring_setup_status* out_status)
+{
+	g_syscall_setup_ring data;
+	data.entries = entries;
+	data.ring = nullptr;
+
+	g_syscall(G_SYSCALL_RING_SETUP, (g_address) &data);
+
+	if(out_status)
+		*out_status = data.status;
+
+	return data.ring;
+}
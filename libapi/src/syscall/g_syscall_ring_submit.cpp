@@ -0,0 +1,41 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/syscall.h"
+
+/**
+ *
+ */
+g_bool g_syscall_ring_submit(g_syscall_ring* ring, uint32_t call, void* data, uint64_t userData)
+{
+	uint32_t tail = ring->submissionTail;
+	uint32_t head = __atomic_load_n(&ring->submissionHead, __ATOMIC_ACQUIRE);
+	if(tail - head >= ring->entries)
+		return false;
+
+	g_syscall_ring_submission* entry = &G_SYSCALL_RING_SUBMISSIONS(ring)[tail & (ring->entries - 1)];
+	entry->call = call;
+	entry->reserved = 0;
+	entry->data = (uint64_t) data;
+	entry->userData = userData;
+
+	__atomic_store_n(&ring->submissionTail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
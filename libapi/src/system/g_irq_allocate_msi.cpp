@@ -0,0 +1,42 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/syscall.h"
+#include "ghost/system.h"
+#include "ghost/system/callstructs.h"
+
+/**
+ *
+ */
+g_irq_allocate_msi_status g_irq_allocate_msi(uint8_t count, uint8_t* outIrq, uint64_t* outAddress, uint32_t* outData)
+{
+	g_syscall_irq_allocate_msi data;
+	data.count = count;
+
+	g_syscall(G_SYSCALL_IRQ_ALLOCATE_MSI, (g_address) &data);
+
+	if(data.status == G_IRQ_ALLOCATE_MSI_STATUS_SUCCESSFUL)
+	{
+		*outIrq = data.irq;
+		*outAddress = data.address;
+		*outData = data.data;
+	}
+	return data.status;
+}
@@ -0,0 +1,57 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/tasks.h"
+#include "ghost/tasks/types.h"
+
+/**
+ *
+ */
+g_bool g_clock_page_read(uint64_t* out)
+{
+	if(!g_current_process_info)
+		return false;
+
+	const g_clock_page* page = g_current_process_info->clockPage;
+	if(!page || !(page->flags & G_CLOCK_PAGE_FLAG_TSC))
+		return false;
+
+	uint32_t sequence;
+	uint64_t baseTsc;
+	uint64_t baseNanos;
+	uint64_t multiplier;
+	uint32_t shift;
+	uint32_t lo;
+	uint32_t hi;
+	do
+	{
+		sequence = page->sequence;
+		asm volatile("" ::: "memory");
+		baseTsc = page->baseTsc;
+		baseNanos = page->baseNanos;
+		multiplier = page->multiplier;
+		shift = page->shift;
+		asm volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+	} while((sequence & 1) || sequence != page->sequence);
+
+	uint64_t ticks = (((uint64_t) hi << 32) | lo) - baseTsc;
+	*out = baseNanos + (uint64_t) (((unsigned __int128) ticks * multiplier) >> shift);
+	return true;
+}
@@ -27,6 +27,10 @@
  */
 uint64_t g_millis()
 {
+	uint64_t nanos;
+	if(g_clock_page_read(&nanos))
+		return nanos / 1000000;
+
 	g_syscall_millis data;
 
 	g_syscall(G_SYSCALL_GET_MILLISECONDS, (g_address) &data);
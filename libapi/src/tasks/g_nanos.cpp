@@ -27,6 +27,10 @@
  */
 uint64_t g_nanos()
 {
+	uint64_t nanos;
+	if(g_clock_page_read(&nanos))
+		return nanos;
+
 	g_syscall_nanos data;
 
 	g_syscall(G_SYSCALL_GET_NANOSECONDS, (g_address) &data);
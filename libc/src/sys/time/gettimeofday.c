@@ -36,8 +36,8 @@ int gettimeofday(struct timeval* tp, void* tzp)
 		return -1;
 	}
 
-	uint64_t millis = g_millis();
-	tp->tv_sec = millis / 1000;
-	tp->tv_usec = (millis % 1000) * 1000;
+	uint64_t micros = g_nanos() / 1000;
+	tp->tv_sec = micros / 1000000;
+	tp->tv_usec = micros % 1000000;
 	return 0;
 }
@@ -36,8 +36,7 @@ int nanosleep(const struct timespec* req, struct timespec* rem)
 		rem->tv_nsec = 0;
 	}
 
-	uint64_t millis = req->tv_sec * 1000;
-	millis += (req->tv_nsec + 999999) / 1000000;
-	g_sleep(millis);
+	uint64_t nanos = req->tv_sec * 1000000000ULL + req->tv_nsec;
+	g_sleep_nanos(nanos);
 	return 0;
 }
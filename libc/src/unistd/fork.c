@@ -7,7 +7,7 @@ pid_t fork(void)
     pid_t pid = (pid_t) g_fork();
     if(pid == (pid_t) G_PID_NONE)
     {
-        errno = ENOSYS;
+        errno = ENOMEM;
         return -1;
     }
     return pid;
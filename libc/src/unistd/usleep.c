@@ -23,7 +23,6 @@
 
 int usleep(useconds_t usec)
 {
-	uint64_t millis = (usec + 999) / 1000;
-	g_sleep(millis);
+	g_sleep_nanos((uint64_t) usec * 1000);
 	return 0;
 }